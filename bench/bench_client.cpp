@@ -0,0 +1,107 @@
+// Measures the overhead of the client itself: Docker<FixtureHttp> serves pre-loaded responses from memory,
+// so every call only costs URL building, error checking, JSON decoding and parsing.
+//
+// Prints one JSON object per line:
+//   {"benchmark":"containerList","threads":4,"calls":400000,"seconds":0.52,"calls_per_s":769230,"ns_per_call":1300}
+//
+// Usage: bench_client [--threads 1,2,4] [--min-time 0.5] [--filter name] [--responses dir]
+
+#include <docker_cpp/docker.h>
+#include "fixture_http.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCH_RESPONSES_PATH
+#define BENCH_RESPONSES_PATH "test/responses"
+#endif
+
+using namespace docker_cpp;
+
+typedef Docker<FixtureHttp> Client;
+
+struct Case
+{
+    std::string name;
+    std::function<bool(Client &)> call;
+};
+
+// Runs `call` on `threads` threads for at least `minTime` seconds
+static void run(Client &docker, const Case &c, int threads, double minTime)
+{
+    typedef std::chrono::steady_clock clock;
+    std::atomic<std::size_t> calls(0), failures(0);
+    std::atomic<bool> stop(false);
+    clock::time_point start = clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            std::size_t n = 0, failed = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (int i = 0; i < 64; ++i, ++n)
+                    if (!c.call(docker)) ++failed;
+            }
+            calls += n;
+            failures += failed;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(minTime));
+    stop = true;
+    for (auto &w : workers) w.join();
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::cout << "{\"benchmark\":\"" << c.name << "\",\"threads\":" << threads << ",\"calls\":" << calls
+              << ",\"failures\":" << failures << ",\"seconds\":" << seconds << ",\"calls_per_s\":" << calls / seconds
+              << ",\"ns_per_call\":" << seconds * 1e9 * threads / calls << "}" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> threads = {1};
+    double minTime = 0.5;
+    std::string filter, responses = BENCH_RESPONSES_PATH;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i], value = argv[i + 1];
+        if (arg == "--threads") {
+            threads.clear();
+            std::istringstream list(value);
+            std::string n;
+            while (std::getline(list, n, ','))
+                threads.push_back(std::max(1, std::atoi(n.c_str())));
+        }
+        else if (arg == "--min-time") minTime = std::atof(value.c_str());
+        else if (arg == "--filter") filter = value;
+        else if (arg == "--responses") responses = value;
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    Client docker("http://127.0.0.1:2375");
+    docker.transport().routeDockerApi(responses);
+
+    const std::vector<Case> cases = {
+        {"ping", [](Client &d) { return d.ping().isOk(); }},
+        {"version", [](Client &d) { VersionInfo v; return d.version(v).isOk(); }},
+        {"containerList", [](Client &d) { ContainerList l; return d.containerList(l, true).isOk(); }},
+        {"imageList", [](Client &d) { ImageList l; return d.imageList(l, true).isOk(); }},
+        {"containerStart", [](Client &d) { return d.containerStart("8dfafdbc3a40").isOk(); }},
+        {"execInspect", [](Client &d) { ExecInfo i; return d.execInspectInstance("f33bbfb39f5b", i).isOk(); }},
+        {"execRun", [](Client &d) { ExecRunResult r; return d.execRun("8dfafdbc3a40", ExecConfig(), r).isOk(); }},
+    };
+
+    for (const Case &c : cases) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+        for (int t : threads) run(docker, c, t, minTime);
+    }
+    return 0;
+}
@@ -0,0 +1,293 @@
+// Benchmarks of the JSON-to-struct path: asl::Json::decode and every parse() overload of docker_parse.cpp,
+// on synthetic payloads of increasing size generated from the test fixtures (test/responses).
+//
+// Every measurement is printed as one JSON object per line:
+//   {"benchmark":"containerList","stage":"parse","elements":100,"bytes":84100,"iterations":1200,
+//    "ns_min":..,"ns_median":..,"ns_p99":..,"mb_per_s":..,"docs_per_s":..,"allocs_per_op":..,"alloc_bytes_per_op":..}
+// Stages are "decode" (text to asl::Var), "parse" (asl::Var to struct) and "total" (both, as Docker<T> does).
+//
+// Usage: bench_parse [--sizes 1,10,100,1000] [--min-time 0.2] [--filter name] [--responses dir]
+//                    [--baseline results.jsonl [--threshold 0.25]]
+// With --baseline the run fails (exit code 2) if a median is slower than the baseline by more than the threshold.
+
+#include <docker_cpp/docker_parse.h>
+
+#include <asl/String.h>
+#include <asl/Var.h>
+#include <asl/JSON.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef BENCH_RESPONSES_PATH
+#define BENCH_RESPONSES_PATH "test/responses"
+#endif
+
+using namespace docker_cpp;
+
+////////// Allocation counting
+
+static std::atomic<std::size_t> g_allocs(0);
+static std::atomic<std::size_t> g_allocBytes(0);
+
+// Kept out of line: once GCC inlines a new/delete pair it matches free() against operator new
+// and warns with -Wmismatched-new-delete
+#if defined(__GNUC__) || defined(__clang__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void *operator new(std::size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void *p) noexcept { std::free(p); }
+BENCH_NOINLINE void *operator new[](std::size_t size) { return operator new(size); }
+BENCH_NOINLINE void operator delete[](void *p) noexcept { operator delete(p); }
+
+////////// Payloads
+
+struct Payload
+{
+    std::string text;
+    int elements;
+};
+
+struct Case
+{
+    std::string name;
+    std::string fixture; // file of the responses directory, or inline JSON if it starts with '[' or '{'
+    std::function<void(const asl::Var &)> parse; // empty: there is no struct for this payload, only decode is measured
+};
+
+static std::string readFile(const std::string &path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static std::string trim(const std::string &s)
+{
+    std::size_t b = s.find_first_not_of(" \t\r\n");
+    std::size_t e = s.find_last_not_of(" \t\r\n");
+    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+// Arrays grow by repeating their elements with unique ids; objects grow with an unknown array field, which
+// the decoder has to read and the parser has to skip, like fields added by newer daemons.
+static Payload scale(const std::string &json, int n)
+{
+    std::string t = trim(json);
+    Payload p;
+    p.elements = n;
+    if (!t.empty() && t[0] == '[')
+    {
+        std::string items = trim(t.substr(1, t.size() - 2));
+        static const std::regex id("(\"(Id|ID|Deleted|Untagged)\"\\s*:\\s*\"[^\"]*)\"");
+        p.text = "[";
+        for (int i = 0; i < n; ++i)
+            p.text += (i ? "," : "") + std::regex_replace(items, id, "$1-" + std::to_string(i) + "\"");
+        p.text += "]";
+        return p;
+    }
+    std::string padding = "\"BenchPadding\":[";
+    for (int i = 1; i < n; ++i)
+        padding += std::string(i > 1 ? "," : "") + "{\"Name\":\"item-" + std::to_string(i) + "\",\"Value\":" + std::to_string(i) + "}";
+    padding += "],";
+    p.text = "{" + padding + t.substr(1);
+    return p;
+}
+
+template <typename T>
+static std::function<void(const asl::Var &)> parser()
+{
+    return [](const asl::Var &v) { T out; parse(v, out); };
+}
+
+////////// Measurements
+
+struct Result
+{
+    std::string benchmark, stage;
+    int elements = 0;
+    std::size_t bytes = 0, iterations = 0;
+    double nsMin = 0, nsMedian = 0, nsP99 = 0, mbPerS = 0, docsPerS = 0, allocsPerOp = 0, allocBytesPerOp = 0;
+
+    std::string key() const { return benchmark + "/" + stage + "/" + std::to_string(elements); }
+
+    std::string json() const
+    {
+        std::ostringstream o;
+        o << "{\"benchmark\":\"" << benchmark << "\",\"stage\":\"" << stage << "\",\"elements\":" << elements
+          << ",\"bytes\":" << bytes << ",\"iterations\":" << iterations << ",\"ns_min\":" << nsMin
+          << ",\"ns_median\":" << nsMedian << ",\"ns_p99\":" << nsP99 << ",\"mb_per_s\":" << mbPerS
+          << ",\"docs_per_s\":" << docsPerS << ",\"allocs_per_op\":" << allocsPerOp
+          << ",\"alloc_bytes_per_op\":" << allocBytesPerOp << "}";
+        return o.str();
+    }
+};
+
+static Result measure(const std::string &name, const std::string &stage, const Payload &payload, double minTime,
+                      const std::function<void()> &op)
+{
+    typedef std::chrono::steady_clock clock;
+    op(); // warm up
+
+    std::vector<double> samples;
+    samples.reserve(1024);
+    std::size_t allocs = 0, allocBytes = 0;
+    clock::time_point start = clock::now();
+    double elapsed = 0;
+    while (elapsed < minTime || samples.size() < 10)
+    {
+        std::size_t allocs0 = g_allocs, bytes0 = g_allocBytes;
+        clock::time_point t0 = clock::now();
+        op();
+        clock::time_point t1 = clock::now();
+        allocs += g_allocs - allocs0;
+        allocBytes += g_allocBytes - bytes0;
+        samples.push_back(double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+        elapsed = std::chrono::duration<double>(t1 - start).count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    Result r;
+    r.benchmark = name;
+    r.stage = stage;
+    r.elements = payload.elements;
+    r.bytes = payload.text.size();
+    r.iterations = samples.size();
+    r.nsMin = samples.front();
+    r.nsMedian = samples[samples.size() / 2];
+    r.nsP99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    r.docsPerS = 1e9 / r.nsMedian;
+    r.mbPerS = r.bytes * r.docsPerS / 1e6;
+    r.allocsPerOp = double(allocs) / samples.size();
+    r.allocBytesPerOp = double(allocBytes) / samples.size();
+    return r;
+}
+
+static std::map<std::string, double> readBaseline(const std::string &path)
+{
+    std::map<std::string, double> medians;
+    std::ifstream in(path.c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        asl::Var v = asl::Json::decode(line.c_str());
+        if (!v.has("benchmark")) continue;
+        std::string key = std::string(*v["benchmark"].toString()) + "/" + *v["stage"].toString() + "/" + std::to_string(int(v["elements"]));
+        medians[key] = double(v["ns_median"]);
+    }
+    return medians;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> sizes = {1, 10, 100, 1000};
+    double minTime = 0.2, threshold = 0.25;
+    std::string filter, responses = BENCH_RESPONSES_PATH, baseline;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--sizes")
+        {
+            sizes.clear();
+            std::istringstream list(value);
+            std::string n;
+            while (std::getline(list, n, ','))
+                sizes.push_back(std::max(1, std::atoi(n.c_str())));
+        }
+        else if (arg == "--min-time") minTime = std::atof(value.c_str());
+        else if (arg == "--filter") filter = value;
+        else if (arg == "--responses") responses = value;
+        else if (arg == "--baseline") baseline = value;
+        else if (arg == "--threshold") threshold = std::atof(value.c_str());
+        else
+        {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+        ++i;
+    }
+
+    const std::vector<Case> cases = {
+        {"containerList", "container_list_get.json", parser<ContainerList>()},
+        {"imageList", "image_list_get.json", parser<ImageList>()},
+        {"imageRemove", "image_remove_delet.json", parser<DeletedImageList>()},
+        {"imagePrune", "image_prune_post.json", parser<PruneInfo>()},
+        {"version", "version_get.json", parser<VersionInfo>()},
+        {"execInspect", "exec_inspect_get.json", parser<ExecInfo>()},
+        {"containerWait", "{\"StatusCode\":0,\"Error\":{\"Message\":\"\"}}", parser<WaitInfo>()},
+        {"port", "{\"PrivatePort\":8080,\"PublicPort\":80,\"Type\":\"tcp\",\"Ip\":\"0.0.0.0\"}", parser<Port>()},
+        {"networkSettings", "{\"Networks\":{\"bridge\":{\"NetworkID\":\"7ea29fc1412292a2d7bba362f9253545fecdfa8ce9a6e37dd10ba8bee7129812\","
+                            "\"EndpointID\":\"2cdc4edb1ded3631c81f57966563e5c8525b81121bb3706a9a9a3ae102711f3f\",\"Gateway\":\"172.17.0.1\","
+                            "\"IPAddress\":\"172.17.0.2\",\"IPPrefixLen\":16,\"Links\":[],\"Aliases\":[]}}}", parser<NetworkSettings>()},
+        {"info", "info_get.json", std::function<void(const asl::Var &)>()}, // no SystemInfo struct yet: decode only
+    };
+
+    std::map<std::string, double> reference;
+    if (!baseline.empty())
+        reference = readBaseline(baseline);
+    int regressions = 0;
+
+    for (const Case &c : cases)
+    {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos)
+            continue;
+        std::string json = c.fixture[0] == '{' || c.fixture[0] == '[' ? c.fixture : readFile(responses + "/" + c.fixture);
+        if (trim(json).empty())
+        {
+            std::cerr << "Missing fixture " << responses << "/" << c.fixture << "\n";
+            return 1;
+        }
+
+        for (int n : sizes)
+        {
+            const Payload payload = scale(json, n);
+            const asl::String text = payload.text.c_str();
+            const asl::Var decoded = asl::Json::decode(text);
+
+            std::vector<Result> results;
+            results.push_back(measure(c.name, "decode", payload, minTime, [&]() { asl::Var v = asl::Json::decode(text); }));
+            if (c.parse)
+            {
+                results.push_back(measure(c.name, "parse", payload, minTime, [&]() { c.parse(decoded); }));
+                results.push_back(measure(c.name, "total", payload, minTime, [&]() { c.parse(asl::Json::decode(text)); }));
+            }
+
+            for (const Result &r : results)
+            {
+                std::cout << r.json() << std::endl;
+                auto ref = reference.find(r.key());
+                if (ref != reference.end() && r.nsMedian > ref->second * (1 + threshold))
+                {
+                    std::cerr << "Regression: " << r.key() << " median " << r.nsMedian << " ns, baseline " << ref->second << " ns\n";
+                    ++regressions;
+                }
+            }
+        }
+    }
+    return regressions ? 2 : 0;
+}
@@ -4,11 +4,34 @@
 #include "docker_types.h"
 #include "docker_error.h"
 #include "docker_http.h"
+#include "docker_deadline.h"
+#include "docker_metrics.h"
+#include "docker_replay.h"
 #include "docker_parse.h"
+#include "docker_parallel.h"
+#include "docker_cleanup.h"
+#include "docker_diff.h"
+#include "docker_labels.h"
+#include "docker_build.h"
+#include "docker_stream.h"
+#include "docker_session.h"
+#include "docker_logs.h"
+#include "docker_snapshot.h"
+#include "docker_version.h"
+#include "docker_scheduler.h"
+#include "docker_waiter.h"
+#include "docker_health.h"
 
+#include <cerrno>
+#include <cstring>
 #include <string>
 #include <map>
 #include <numeric>
+#include <vector>
+#include <set>
+#include <ctime>
+#include <mutex>
+#include <thread>
 
 #include <asl/JSON.h>
 
@@ -27,6 +50,15 @@ namespace docker_cpp
 		return '{' + result + '}';
 	}
 
+	/**
+	 * Client of the docker engine API over the transport T.
+	 * Apart from setMetrics(), setRetryPolicy() and the API version (negotiateApiVersion()), Docker objects hold no mutable state of their own: one instance can be shared by many threads when T is
+	 * thread-safe (T::thread_safe), as ASLHttp and SocketHttp are. SocketHttp then gives each concurrent caller
+	 * its own pooled kept-alive connection.
+	 * Per-operation latency metrics can be recorded with setMetrics().
+	 * Calls can be bounded with a deadline and cancelled from another thread with a CallScope; they then fail with
+	 * DOCKER_TIMEOUT or DOCKER_CANCELLED. Idempotent GETs can be retried and hedged with setRetryPolicy().
+	 */
 	template <typename T>
 	class DOCKER_CPP_API Docker
 	{
@@ -34,14 +66,19 @@ namespace docker_cpp
 		static_assert(std::is_base_of<DockerHttpInterface<T>, T>::value, "T must derive from DockerHttpInterface");
 
 	public:
-		Docker(const std::string &uri)
+		/**
+		 * @param [in] uri Base URI of the daemon ("http://127.0.0.1:2375", "unix:///var/run/docker.sock")
+		 * Requests use the API version negotiated earlier with the same URI by this process, if any (see
+		 * negotiateApiVersion()), and DOCKER_API_DEFAULT otherwise.
+		 */
+		Docker(const std::string &uri) : _uri(uri)
 		{
-			_endpoint = uri + "/v1.40";
+			ApiVersion cached;
+			_useApiVersion(ApiVersionCache::lookup(_uri, cached) ? cached : DOCKER_API_DEFAULT);
 		}
 
-		Docker(const std::string &ip, const unsigned int port)
+		Docker(const std::string &ip, const unsigned int port) : Docker("http://" + ip + ":" + std::to_string(port))
 		{
-			Docker("http://" + ip + ":" + std::to_string(port), _net);
 		}
 
 		~Docker() = default;
@@ -55,8 +92,9 @@ namespace docker_cpp
 		 */
 		DockerError version(VersionInfo &result)
 		{
-			const std::string url = _endpoint + "/version/json";
-			return _checkAndParse(_net.get(url), result);
+			OperationScope scope(_metrics, OP_VERSION);
+			const std::string url = _endpoint + "/version";
+			return _checkAndParse(_get(url), result);
 		}
 
 		/**
@@ -64,8 +102,70 @@ namespace docker_cpp
 		 */
 		DockerError ping()
 		{
+			OperationScope scope(_metrics, OP_PING);
 			const std::string url = _endpoint + "/_ping";
-			return _checkError(_net.get(url));
+			return _checkError(_get(url));
+		}
+
+		/**
+		 * Stream the events of the daemon (container, image, network... changes), decoded as they arrive.
+		 * Without options.until the call lasts until the handler returns false or the call is cancelled (see CallScope).
+		 * @param [in] options Time range and filters of the events
+		 * @param [in] onEvent Receives every event. Returning false stops the stream
+		 * @returns DockerError, cancelled if the handler stopped the stream
+		 */
+		DockerError events(const EventOptions &options, const std::function<bool(const EventMessage &)> &onEvent)
+		{
+			OperationScope scope(_metrics, OP_EVENTS);
+			std::string url = _endpoint + "/events";
+			url += query_params(q_arg("since", url_encode(options.since)), q_arg("until", url_encode(options.until)),
+								q_arg("filters", _filtersJson(options.filters)));
+			bool stopped = false;
+			LineSplitter lines([&](const char *line, std::size_t size) {
+				EventMessage event;
+				parse(asl::Json::decode(asl::String(std::string(line, size).c_str())), event);
+				stopped = !onEvent(event);
+				return !stopped;
+			});
+			DockerError err = _checkError(_net.stream("GET", url, "", lines.sink()));
+			if (err.isOk() && stopped)
+				return DockerError::D_CANCELLED();
+			if (err.isOk())
+				lines.finish();
+			return err;
+		}
+
+		/**
+		 * Negotiates the API version with the daemon: the highest one both support (see negotiate_api_version()).
+		 * The result is cached per URI for the whole process (ApiVersionCache), so only the first client of a daemon
+		 * pays the round trip to /version; the clients created afterwards start with it. Call it before sharing the
+		 * object between threads.
+		 * @param [in] force Ask the daemon even if a version is cached for its URI (after an upgrade of the daemon)
+		 * @returns DockerError, an error if the daemon cannot be reached or has no version in common with the client.
+		 * The version in use is then left as it was
+		 */
+		DockerError negotiateApiVersion(bool force = false)
+		{
+			ApiVersion negotiated;
+			if (!force && ApiVersionCache::lookup(_uri, negotiated))
+			{
+				_useApiVersion(negotiated);
+				return DockerError::D_OK();
+			}
+
+			VersionInfo daemon;
+			DockerError err = DockerError::D_OK();
+			{
+				OperationScope scope(_metrics, OP_VERSION);
+				err = _checkAndParse(_get(_uri + "/version"), daemon); // without a version prefix, any daemon answers
+			}
+			if (err.isOk())
+				err = negotiate_api_version(daemon, negotiated);
+			if (err.isError())
+				return err;
+			ApiVersionCache::store(_uri, negotiated);
+			_useApiVersion(negotiated);
+			return err;
 		}
 
 		//////////// Images
@@ -80,13 +180,161 @@ namespace docker_cpp
 		 */
 		DockerError imageList(ImageList &result, bool all = false, const filter_map& filters = filter_map(), bool digests = false)
 		{
+			OperationScope scope(_metrics, OP_IMAGE_LIST);
 			std::string url = _endpoint + "/images/json";
 			url += query_params(q_arg("all", all),
 								q_arg("filters", _map2json(filters)),
 								q_arg("digests", digests));
-			return _checkAndParse(_net.get(url), result);
+			return _checkAndParse(_get(url), result);
+		}
+
+		/**
+		 * Build an image from a directory.
+		 * The directory is packed into a tar archive while it is sent (see ContextPacker), honouring its .dockerignore,
+		 * so the context is never staged in memory or on disk. The build output is decoded line by line as it arrives.
+		 * @param [in] contextDir Directory of the build context
+		 * @param [in] options Tags, Dockerfile, build arguments... of the build
+		 * @param [in] onMessage Receives every message of the build output (may be empty). Returning false stops the build
+		 * @param [in,out] imageId ID of the built image
+		 * @param [in] context How the context is read; its Dockerfile is the one of the options
+		 * @returns DockerError, an error if the context could not be read or the build failed
+		 */
+		DockerError imageBuild(const std::string &contextDir, const BuildOptions &options, const BuildMessageHandler &onMessage, std::string &imageId, ContextOptions context = ContextOptions())
+		{
+			context.dockerfile = options.dockerfile;
+			ContextPacker packer(contextDir, context);
+			if (!packer.scan())
+				return DockerError::D_ERROR(packer.error(), 0);
+			DockerError err = imageBuild(packer.source(), options, onMessage, imageId);
+			if (!packer.error().empty())
+				return DockerError::D_ERROR(packer.error(), 0);
+			return err;
+		}
+
+		/**
+		 * Build an image from a tar archive of the build context, read from `context` while it is sent.
+		 * @param [in] context Source of the archive (plain or compressed with gzip, bzip2 or xz)
+		 * @param [in] options Tags, Dockerfile, build arguments... of the build
+		 * @param [in] onMessage Receives every message of the build output (may be empty). Returning false stops the build
+		 * @param [in,out] imageId ID of the built image
+		 * @returns DockerError, an error if the build failed
+		 */
+		DockerError imageBuild(const StreamSource &context, const BuildOptions &options, const BuildMessageHandler &onMessage, std::string &imageId)
+		{
+			OperationScope scope(_metrics, OP_IMAGE_BUILD);
+			const std::string url = _endpoint + "/build" + _buildQuery(options);
+			std::string failure;
+			bool stopped = false;
+			LineSplitter lines([&](const char *line, std::size_t size) {
+				BuildMessage message;
+				parse(asl::Json::decode(asl::String(std::string(line, size).c_str())), message);
+				if (!message.imageId.empty()) imageId = message.imageId;
+				if (!message.error.empty()) failure = message.error;
+				stopped = onMessage && !onMessage(message);
+				return !stopped;
+			});
+			std::map<std::string, std::string> headers;
+			headers["Content-Type"] = "application/x-tar";
+			auto res = _net.upload("POST", url, context, lines.sink(), headers);
+			DockerError err = _checkError(res);
+			if (err.isError())
+				return err;
+			if (stopped)
+				return DockerError::D_CANCELLED();
+			lines.finish();
+			if (!failure.empty())
+				return DockerError::D_ERROR(failure, 0);
+			return err;
+		}
+
+		/**
+		 * Export an image, with its tags and layers, as a tar archive written to a file descriptor as it arrives.
+		 * Memory use does not depend on the size of the image.
+		 * @param [in] name Image name or ID
+		 * @param [in] fd Descriptor the archive is written to (file, pipe, socket...). It is not closed
+		 * @returns DockerError, an error if the image does not exist or the archive could not be written
+		 */
+		DockerError imageExport(const std::string &name, int fd)
+		{
+			return _toFile(fd, [&](const StreamSink &sink) { return _export(_endpoint + "/images/" + name + "/get", sink); });
+		}
+
+		/**
+		 * Export several images in one tar archive written to a file descriptor. Layers they share are exported once.
+		 * @param [in] names Image names or IDs
+		 * @param [in] fd Descriptor the archive is written to. It is not closed
+		 * @returns DockerError, an error if an image does not exist or the archive could not be written
+		 */
+		DockerError imageExport(const std::vector<std::string> &names, int fd)
+		{
+			return _toFile(fd, [&](const StreamSink &sink) { return imageExport(names, sink); });
+		}
+
+		/**
+		 * Export several images in one tar archive handed to `sink` as it arrives.
+		 * @returns DockerError, cancelled if the sink stopped the transfer
+		 */
+		DockerError imageExport(const std::vector<std::string> &names, const StreamSink &sink)
+		{
+			return _export(_endpoint + "/images/get" + _namesQuery(names), sink);
+		}
+
+		/**
+		 * Load images from a tar archive (as written by imageExport) read from a file descriptor.
+		 * With SocketHttp a regular file goes from the page cache to the socket with sendfile(); otherwise it is
+		 * streamed in chunks. Memory use does not depend on the size of the archive.
+		 * @param [in] fd Descriptor of the archive, read from its current position. It is not closed
+		 * @param [in,out] loaded Names of the loaded images ("repo:tag", or the ID of an untagged image)
+		 * @param [in] onMessage Receives every message of the output (may be empty). Returning false stops the load
+		 * @param [in] quiet Do not report the progress of every layer (default: true)
+		 * @returns DockerError, an error if the archive could not be read or loaded
+		 */
+		DockerError imageLoad(int fd, std::vector<std::string> &loaded, const BuildMessageHandler &onMessage = BuildMessageHandler(), bool quiet = true)
+		{
+			return imageLoad(FileSource(fd), loaded, onMessage, quiet);
+		}
+
+		/**
+		 * Load images from a tar archive read from `archive` while it is sent.
+		 * @see imageLoad(int, std::vector<std::string>&, const BuildMessageHandler&, bool)
+		 */
+		DockerError imageLoad(const StreamSource &archive, std::vector<std::string> &loaded, const BuildMessageHandler &onMessage = BuildMessageHandler(), bool quiet = true)
+		{
+			OperationScope scope(_metrics, OP_IMAGE_LOAD);
+			std::string url = _endpoint + "/images/load";
+			url += query_params(q_arg("quiet", quiet));
+			std::string failure;
+			bool stopped = false;
+			LineSplitter lines([&](const char *line, std::size_t size) {
+				BuildMessage message;
+				parse(asl::Json::decode(asl::String(std::string(line, size).c_str())), message);
+				// "Loaded image: repo:tag\n" or "Loaded image ID: sha256:...\n"
+				static const std::string tagged = "Loaded image: ", untagged = "Loaded image ID: ";
+				const std::string &out = message.stream;
+				std::size_t prefix = out.compare(0, tagged.size(), tagged) == 0 ? tagged.size()
+								   : out.compare(0, untagged.size(), untagged) == 0 ? untagged.size() : 0;
+				if (prefix > 0)
+				{
+					std::string name = out.substr(prefix);
+					name.erase(name.find_last_not_of(" \r\n") + 1);
+					loaded.push_back(name);
+				}
+				if (!message.error.empty()) failure = message.error;
+				stopped = onMessage && !onMessage(message);
+				return !stopped;
+			});
+			std::map<std::string, std::string> headers;
+			headers["Content-Type"] = "application/x-tar";
+			DockerError err = _checkError(_net.upload("POST", url, archive, lines.sink(), headers));
+			if (err.isError())
+				return err;
+			if (stopped)
+				return DockerError::D_CANCELLED();
+			lines.finish();
+			if (!failure.empty())
+				return DockerError::D_ERROR(failure, 0);
+			return err;
 		}
-		//DockerError image_build(const std::string &id);
 
 		/**
 		 * Create an image by either pulling it from a registry or importing it.
@@ -100,6 +348,7 @@ namespace docker_cpp
 		 */
 		DockerError imageCreate(const std::string &fromImage, const std::string &fromSrc, const std::string &repo, const std::string &tag, const std::string &message, const std::string &platform = "")
 		{
+			OperationScope scope(_metrics, OP_IMAGE_CREATE);
 			std::string url = _endpoint + "/images/create";
 			url += query_params(q_arg("fromImage", fromImage), q_arg("fromSrc", fromSrc),
 								q_arg("repo", repo), q_arg("tag", tag), q_arg("message", message),
@@ -117,6 +366,7 @@ namespace docker_cpp
 		 */
 		DockerError imageTag(const std::string &name, const std::string &repo, const std::string &tag)
 		{
+			OperationScope scope(_metrics, OP_IMAGE_TAG);
 			std::string url = _endpoint + "/images/" + name + "/tag";
 			url += query_params(q_arg("repo", repo), q_arg("tag", tag));
 			return _checkError(_net.post(url, ""));
@@ -131,6 +381,7 @@ namespace docker_cpp
 		 */
 		DockerError imageRemove(const std::string &name, DeletedImageList &r, bool force = false, bool noprune = false)
 		{
+			OperationScope scope(_metrics, OP_IMAGE_REMOVE);
 			std::string url = _endpoint + "/images/" + name;
 			url += query_params(q_arg("force", force), q_arg("noprune", noprune));
 			return _checkAndParse( _net.delet(url), r);
@@ -143,11 +394,95 @@ namespace docker_cpp
 		 */
 		DockerError imagePrune(const std::string &name, PruneInfo &r, const filter_map& filters = filter_map())
 		{
+			OperationScope scope(_metrics, OP_IMAGE_PRUNE);
 			std::string url = _endpoint + "/images/prune";
 			url += query_params(q_arg("filters", _map2json(filters)));
 			return _checkAndParse( _net.post(url, ""), r);
 		}
 
+		/**
+		 * Remove every image matched by a cleanup policy, removing independent images in parallel.
+		 * Images are listed once (all=true), along with the containers when keepInUse is set, and planned with
+		 * planImageCleanup; the plan is then removed wave by wave so that children always go before their parents.
+		 * When a removal fails, its ancestors are left in place.
+		 * @param [in] policy Which images to remove and how
+		 * @param [in,out] result Aggregate of the deleted images, the bytes reclaimed and the failed removals
+		 * @returns DockerError, an error if the images could not be listed or any removal failed
+		 */
+		DockerError imageCleanup(const ImageCleanupPolicy &policy, ImageCleanupResult &result)
+		{
+			ImageList images;
+			DockerError err = imageList(images, true, policy.filters);
+			if (err.isError()) return err;
+
+			// The daemon does not count the containers of each image in a list: they are collected from the containers
+			std::set<std::string> inUse;
+			if (policy.keepInUse)
+			{
+				ContainerList containers;
+				err = containerList(containers, true);
+				if (err.isError()) return err;
+				for (const ContainerInfo &c : containers)
+					inUse.insert(c.imageID);
+			}
+
+			ImageRemovalPlan plan;
+			planImageCleanup(images, policy, static_cast<std::int64_t>(std::time(nullptr)), inUse, plan);
+
+			std::set<std::string> gone; // reported as deleted, possibly as an untagged parent of another removal
+			std::set<std::string> kept; // a descendant could not be removed
+			for (const std::vector<std::string> &wave : plan.waves)
+			{
+				std::vector<std::string> todo;
+				for (const std::string &id : wave)
+				{
+					if (kept.count(id))
+						result.failed.push_back(std::make_pair(id, DockerError::D_ERROR("a descendant image could not be removed", 409)));
+					else if (!gone.count(id))
+						todo.push_back(id);
+				}
+
+				std::vector<DeletedImageList> deleted(todo.size());
+				DockerErrorList errors(todo.size(), DockerError::D_OK());
+				parallel_for(todo.size(), policy.concurrency, [&](std::size_t i) {
+					errors[i] = imageRemove(todo[i], deleted[i], policy.force, policy.noprune);
+				});
+
+				for (std::size_t i = 0; i < todo.size(); ++i)
+				{
+					if (errors[i].isError())
+					{
+						result.failed.push_back(std::make_pair(todo[i], errors[i]));
+						for (auto p = plan.parents.find(todo[i]); p != plan.parents.end(); p = plan.parents.find(p->second))
+							kept.insert(p->second);
+						continue;
+					}
+					for (DeletedImageInfo &d : deleted[i])
+					{
+						if (!d.deleted.empty()) gone.insert(d.deleted);
+						result.deleted.push_back(d);
+					}
+				}
+			}
+
+			for (auto &b : plan.bytes)
+			{
+				if (gone.count(b.first)) result.spaceReclaimed += b.second;
+			}
+
+			if (policy.prune)
+			{
+				PruneInfo pruned;
+				DockerError pruneErr = imagePrune("", pruned, policy.pruneFilters);
+				if (pruneErr.isError()) return pruneErr;
+				result.deleted.insert(result.deleted.end(), pruned.imagesDeleted.begin(), pruned.imagesDeleted.end());
+				result.spaceReclaimed += pruned.spaceReclaimed;
+			}
+
+			if (result.failed.empty()) return DockerError::D_OK();
+			return DockerError::D_ERROR(std::to_string(result.failed.size()) + " images could not be removed", result.failed.front().second.apiErrorCode);
+		}
+
 		//////////// Containers
 
 		/**
@@ -161,17 +496,86 @@ namespace docker_cpp
 		 */
 		DockerError containerList(ContainerList &result, bool all = false, int limit = -1, bool size = false, const filter_map& filters = filter_map())
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_LIST);
 			std::string url = _endpoint + "/containers/json";
 			url += query_params(q_arg("all", all), q_arg("limit", limit), q_arg("size", size),
 								q_arg("filters", _map2json(filters)));
-			auto res = _net.get(url);
-			DockerError err = _checkError(res);
+			return _listContainers(url, result);
+		}
+
+		/**
+		 * Returns a list of containers, with filters of several values ({"id": {"3f2a", "b81c"}}, {"status": {"exited", "dead"}}).
+		 * The values of a filter are alternatives; different filters must all match.
+		 * @param [in,out] result A list of information (containerInfo) of each container in the server
+		 * @param [in] all Return all containers. By default, only running containers are shown
+		 * @param [in] filters Filters to process on the container list
+		 * @returns DockerError
+		 */
+		DockerError containerList(ContainerList &result, bool all, const std::map<std::string, std::vector<std::string> > &filters)
+		{
+			OperationScope scope(_metrics, OP_CONTAINER_LIST);
+			std::string url = _endpoint + "/containers/json";
+			url += query_params(q_arg("all", all), q_arg("filters", _filtersJson(filters)));
+			return _listContainers(url, result);
+		}
+
+		/**
+		 * Returns the changes in the list of containers since a previous call.
+		 * @param [in,out] snapshot The list returned by the previous call (empty on the first one). It is replaced with the new list.
+		 * @param [in,out] delta Containers added, removed or changed since the snapshot; it can be reused between calls
+		 * @param [in] all Return all containers. By default, only running containers are shown (default: false)
+		 * @param [in] filters Filters to process on the container list.
+		 * @returns DockerError
+		 */
+		DockerError containerListDelta(ContainerList &snapshot, ContainerListDelta &delta, bool all = false, const filter_map& filters = filter_map())
+		{
+			ContainerList current;
+			DockerError err = containerList(current, all, -1, false, filters);
 			if (!err.isOk())
 				return err;
-			auto data = asl::Json::decode(res.text().replace("\\\"", "")); // AAA: scaping is necessary for commands
-			parse(data, result);
+			diff(snapshot, current, delta);
+			snapshot.swap(current);
 			return err;
 		}
+
+		/**
+		 * Looks containers up by ID, ID prefix or name with at most two list requests, stopped containers included:
+		 * one by ID, then one by name for the others, since the filters of a list must all match.
+		 * Costs the same for a hundred containers as for one, where inspecting them takes a request each.
+		 * @param [in] keys IDs, ID prefixes or names
+		 * @param [in,out] found The container of each key, in the same order; with an empty id for the keys not found
+		 * @returns DockerError
+		 */
+		DockerError containerFind(const std::vector<std::string> &keys, ContainerList &found)
+		{
+			found.assign(keys.size(), ContainerInfo());
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				std::map<std::string, std::vector<std::string> > filters;
+				std::vector<std::string> &values = filters[pass == 0 ? "id" : "name"];
+				for (std::size_t i = 0; i < keys.size(); ++i)
+				{
+					IdPrefix prefix;
+					if (found[i].id.empty() && (pass == 1 || (prefix.parse(keys[i]) && prefix.digits() > 0)))
+						values.push_back(keys[i]);
+				}
+				if (values.empty())
+					continue;
+				ContainerList containers;
+				DockerError err = containerList(containers, true, filters);
+				if (!err.isOk())
+					return err;
+				for (std::size_t i = 0; i < keys.size(); ++i)
+				{
+					for (std::size_t c = 0; c < containers.size() && found[i].id.empty(); ++c)
+					{
+						if (container_matches(containers[c], keys[i]))
+							found[i] = containers[c];
+					}
+				}
+			}
+			return DockerError::D_OK();
+		}
 		//DockerError createContainer(const std::string &name);
 
 		/**
@@ -182,6 +586,7 @@ namespace docker_cpp
 		 */
 		DockerError containerStart(const std::string &id, const std::string &detachKeys = "ctrl-c")
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_START);
 			std::string url = _endpoint + "/containers/" + id + "/start";
 			url += query_params(q_arg("detachKeys", detachKeys));
 			return _checkError(_net.post(url, ""));
@@ -195,6 +600,7 @@ namespace docker_cpp
 		 */
 		DockerError containerStop(const std::string &id, int t = -1)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_STOP);
 			std::string url = _endpoint + "/containers/" + id + "/stop";
 			url += query_params(q_arg("t", t));
 			return _checkError(_net.post(url, ""));
@@ -208,6 +614,7 @@ namespace docker_cpp
 		 */
 		DockerError containerRestart(const std::string &id, int t = -1)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_RESTART);
 			std::string url = _endpoint + "/containers/" + id + "/restart";
 			url += query_params(q_arg("t", t));
 			return _checkError(_net.post(url, ""));
@@ -221,6 +628,7 @@ namespace docker_cpp
 		 */
 		DockerError containerKill(const std::string &id, const std::string &signal = "SIGKILL")
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_KILL);
 			std::string url = _endpoint + "/containers/" + id + "/kill";
 			url += query_params(q_arg("signal", signal));
 			return _checkError(_net.post(url, ""));
@@ -234,6 +642,7 @@ namespace docker_cpp
 		 */
 		DockerError containerRename(const std::string &id, const std::string &name)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_RENAME);
 			std::string url = _endpoint + "/containers/" + id + "/rename";
 			url += query_params(q_arg("name", name));
 			return _checkError(_net.post(url, ""));
@@ -248,6 +657,7 @@ namespace docker_cpp
 		 */
 		DockerError containerPause(const std::string &id)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_PAUSE);
 			const std::string url = _endpoint + "/containers/" + id + "/pause";
 			return _checkError(_net.post(url, ""));
 		}
@@ -259,6 +669,7 @@ namespace docker_cpp
 		 */
 		DockerError containerUnpause(const std::string &id)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_UNPAUSE);
 			const std::string url = _endpoint + "/containers/" + id + "/unpause";
 			return _checkError(_net.post(url, ""));
 		}
@@ -267,13 +678,15 @@ namespace docker_cpp
 		 * Block until a container stops, then returns the exit code.
 		 * @param [in] id ID or name of the container
 		 * @param [in,out] result Result with the exit code of the container
-		 * @param [in] condition Wait until a container state reaches the given condition, either 'not-running' (default), 'next-exit', or 'removed'.
+		 * @param [in] condition Wait until a container state reaches the given condition, either 'not-running' (default), 'next-exit', or 'removed'. Ignored before API 1.30, where the call waits until the container is not running
 		 * @returns DockerError
 		 */
 		DockerError containerWait(const std::string &id, WaitInfo &result, const std::string &condition = "not-running")
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_WAIT);
 			std::string url = _endpoint + "/containers/" + id + "/wait";
-			url += query_params(q_arg("condition", condition));
+			if (apiSupports(ApiVersion(1, 30)))
+				url += query_params(q_arg("condition", condition));
 			return _checkAndParse(_net.post(url, ""), result);
 		}
 
@@ -287,11 +700,221 @@ namespace docker_cpp
 		 */
 		DockerError containerRemove(const std::string &id, bool v = false, bool force = false, bool link = false)
 		{
+			OperationScope scope(_metrics, OP_CONTAINER_REMOVE);
 			std::string url = _endpoint + "/containers/" + id;
 			url += query_params(q_arg("v", v), q_arg("force", force), q_arg("link", link));
 			return _checkError(_net.delet(url));
 		}
 
+		//////////// Containers (batch)
+
+		/**
+		 * Start several containers concurrently.
+		 * The transport must support concurrent calls (ASLHttp opens a connection per request).
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] detachKeys Override the key sequence for detaching a container
+		 * @param [in] concurrency Maximum number of requests in flight (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError containerStartBatch(const std::vector<std::string> &ids, DockerErrorList &errors, const std::string &detachKeys = "ctrl-c", unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return containerStart(ids[i], detachKeys); });
+		}
+
+		/**
+		 * Stop several containers concurrently.
+		 * With enough concurrency the whole batch takes about as long as the slowest stop.
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] t Number of seconds to wait before killing each container
+		 * @param [in] concurrency Maximum number of requests in flight (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError containerStopBatch(const std::vector<std::string> &ids, DockerErrorList &errors, int t = -1, unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return containerStop(ids[i], t); });
+		}
+
+		/**
+		 * Restart several containers concurrently.
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] t Number of seconds to wait before killing each container
+		 * @param [in] concurrency Maximum number of requests in flight (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError containerRestartBatch(const std::vector<std::string> &ids, DockerErrorList &errors, int t = -1, unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return containerRestart(ids[i], t); });
+		}
+
+		/**
+		 * Kill several containers concurrently.
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] signal Signal to send to each container (default: SIGKILL)
+		 * @param [in] concurrency Maximum number of requests in flight (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError containerKillBatch(const std::vector<std::string> &ids, DockerErrorList &errors, const std::string &signal = "SIGKILL", unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return containerKill(ids[i], signal); });
+		}
+
+		/**
+		 * Remove several containers concurrently.
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] v Remove the volumes associated with each container (default: false)
+		 * @param [in] force If a container is running, kill it before removing it (default: false)
+		 * @param [in] concurrency Maximum number of requests in flight (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError containerRemoveBatch(const std::vector<std::string> &ids, DockerErrorList &errors, bool v = false, bool force = false, unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return containerRemove(ids[i], v, force); });
+		}
+
+		/**
+		 * Get information about a file or directory in a container.
+		 * @param [in] id ID or name of the container
+		 * @param [in] path Path in the container
+		 * @param [in,out] stat Name, size, mode... of the path
+		 * @returns DockerError, not found if the path does not exist
+		 */
+		DockerError containerArchiveInfo(const std::string &id, const std::string &path, PathStat &stat)
+		{
+			OperationScope scope(_metrics, OP_CONTAINER_ARCHIVE_INFO);
+			auto res = _net.stream("HEAD", _archiveUrl(id, path), "", StreamSink());
+			DockerError err = _checkError(res);
+			if (err.isOk() && !_pathStat(res, stat))
+				return DockerError::D_ERROR("no description of " + path + " in the response", 0);
+			return err;
+		}
+
+		/**
+		 * Get a tar archive of a file or directory of a container, handed to `sink` as it arrives.
+		 * @param [in] id ID or name of the container
+		 * @param [in] path Path in the container
+		 * @param [in] sink Receives the archive. Returning false stops the transfer
+		 * @param [in,out] stat If not null, receives the description of `path` sent with the archive
+		 * @returns DockerError, cancelled if the sink stopped the transfer
+		 */
+		DockerError containerArchiveGet(const std::string &id, const std::string &path, const StreamSink &sink, PathStat *stat = nullptr)
+		{
+			OperationScope scope(_metrics, OP_CONTAINER_ARCHIVE_GET);
+			bool stopped = false;
+			auto res = _net.stream("GET", _archiveUrl(id, path), "", [&](const char *data, std::size_t size) {
+				stopped = !sink(data, size);
+				return !stopped;
+			});
+			DockerError err = _checkError(res);
+			if (err.isError())
+				return err;
+			if (stopped)
+				return DockerError::D_CANCELLED();
+			if (stat)
+				_pathStat(res, *stat);
+			return err;
+		}
+
+		/**
+		 * Get a tar archive of a file or directory of a container, written to a file descriptor (not closed) as it
+		 * arrives.
+		 * @returns DockerError, an error if the path does not exist or the archive could not be written
+		 */
+		DockerError containerArchiveGet(const std::string &id, const std::string &path, int fd, PathStat *stat = nullptr)
+		{
+			return _toFile(fd, [&](const StreamSink &sink) { return containerArchiveGet(id, path, sink, stat); });
+		}
+
+		/**
+		 * Extract a tar archive into a directory of a container. The archive is read from `archive` while it is sent;
+		 * with SocketHttp a FileSource is sent with sendfile() and a BufferSource straight from its buffers.
+		 * @param [in] id ID or name of the container
+		 * @param [in] path Directory of the container the archive is extracted into. It must exist
+		 * @param [in] archive Source of the archive (plain or compressed with gzip, bzip2 or xz)
+		 * @param [in] noOverwriteDirNonDir Fail if a directory would be replaced by a file or the opposite (default: false)
+		 * @param [in] copyUIDGID Give the files the owner of the container's user instead of the archive's (default: false)
+		 * @returns DockerError
+		 */
+		DockerError containerArchivePut(const std::string &id, const std::string &path, const StreamSource &archive, bool noOverwriteDirNonDir = false, bool copyUIDGID = false)
+		{
+			OperationScope scope(_metrics, OP_CONTAINER_ARCHIVE_PUT);
+			std::string url = _archiveUrl(id, path);
+			if (noOverwriteDirNonDir)
+				url += "&noOverwriteDirNonDir=true";
+			if (copyUIDGID)
+				url += "&copyUIDGID=true";
+			std::map<std::string, std::string> headers;
+			headers["Content-Type"] = "application/x-tar";
+			return _checkError(_net.upload("PUT", url, archive, StreamSink(), headers));
+		}
+
+		/// Extract a tar archive read from a file descriptor (from its current position, not closed)
+		DockerError containerArchivePut(const std::string &id, const std::string &path, int fd, bool noOverwriteDirNonDir = false, bool copyUIDGID = false)
+		{
+			return containerArchivePut(id, path, FileSource(fd), noOverwriteDirNonDir, copyUIDGID);
+		}
+
+		/**
+		 * Copy host files and directories into a directory of a container, as `docker cp` does. They are packed into a
+		 * tar archive while it is sent (see ContextPacker), each under its base name.
+		 * @param [in] hostPaths Files and directories of the host
+		 * @returns DockerError, an error if a host path could not be read
+		 */
+		DockerError containerArchivePut(const std::string &id, const std::string &path, const std::vector<std::string> &hostPaths, bool noOverwriteDirNonDir = false, bool copyUIDGID = false)
+		{
+			ContextPacker packer(hostPaths);
+			if (!packer.scan())
+				return DockerError::D_ERROR(packer.error(), 0);
+			DockerError err = containerArchivePut(id, path, packer.source(), noOverwriteDirNonDir, copyUIDGID);
+			if (!packer.error().empty())
+				return DockerError::D_ERROR(packer.error(), 0);
+			return err;
+		}
+
+		/**
+		 * Get the logs of a container as the daemon sends them: multiplexed (see StreamDemuxer) unless the container
+		 * has a TTY. With `follow` the call lasts until the container stops, the sink returns false or the call is
+		 * cancelled (see CallScope). LogParser turns a stream requested with timestamps into batches of lines and
+		 * LogFollower follows many containers with resumable cursors.
+		 * @param [in] id ID or name of the container
+		 * @param [in] options Streams, time range and tail of the log
+		 * @param [in] stream Receives the stream. Returning false stops the transfer
+		 * @returns DockerError, cancelled if the sink stopped the transfer
+		 */
+		DockerError containerLogs(const std::string &id, const LogOptions &options, const StreamSink &stream)
+		{
+			OperationScope scope(_metrics, OP_CONTAINER_LOGS);
+			std::string url = _endpoint + "/containers/" + id + "/logs";
+			url += query_params(q_arg("follow", options.follow), q_arg("stdout", options.stdOut), q_arg("stderr", options.stdErr),
+								q_arg("since", url_encode(options.since)), q_arg("until", url_encode(options.until)),
+								q_arg("timestamps", options.timestamps), q_arg("tail", url_encode(options.tail)));
+			bool stopped = false;
+			DockerError err = _checkError(_net.stream("GET", url, "", [&](const char *data, std::size_t size) {
+				stopped = !stream(data, size);
+				return !stopped;
+			}));
+			if (err.isOk() && stopped)
+				return DockerError::D_CANCELLED();
+			return err;
+		}
+
+		/**
+		 * Get the logs of a container, split into its standard output and error.
+		 * @param [in] onStdout Receives the standard output (the whole log with tty)
+		 * @param [in] onStderr Receives the standard error
+		 * @param [in] tty The container has a TTY, so its log is not multiplexed
+		 * @returns DockerError
+		 */
+		DockerError containerLogs(const std::string &id, const LogOptions &options, const StreamSink &onStdout, const StreamSink &onStderr, bool tty = false)
+		{
+			StreamDemuxer demux(onStdout, onStderr, tty);
+			return containerLogs(id, options, demux.sink());
+		}
+
 		////////// Exec
 
 		/**
@@ -303,11 +926,13 @@ namespace docker_cpp
 		 */
 		DockerError execCreateInstance(const std::string &id, const ExecConfig &config, std::string &execId)
 		{
+			OperationScope scope(_metrics, OP_EXEC_CREATE);
 			const std::string url = _endpoint + "/containers/" + id + "/exec";
 			auto res = _net.post(url, config.str());
 			DockerError err = _checkError(res);
 			if (err.isError())
 				return err;
+			ParseTimer timer;
 			auto data = res.json();
 			execId = *(data["Id"].toString());
 			return err;
@@ -324,10 +949,29 @@ namespace docker_cpp
 		 */
 		DockerError execStartInstance(const std::string &id, bool detach = false, bool tty = false)
 		{
+			OperationScope scope(_metrics, OP_EXEC_START);
 			const std::string url = _endpoint + "/exec/" + id + "/start";
-			std::stringstream ss;
-			ss << std::boolalpha << "{\"detach\":\"" << detach << "\",\"tty\":" << tty << "\"}";
-			return _checkError(_net.post(url, ss.str()));
+			return _checkError(_net.post(url, _execStartBody(detach, tty)));
+		}
+
+		/**
+		 * Starts a previously set up exec instance and takes over the hijacked connection for an interactive session.
+		 * The session can then read stdout/stderr, write stdin and resize the TTY while the command runs.
+		 * This Docker object must outlive the session if resize() is used.
+		 * @param [in] id Exec instance ID
+		 * @param [in,out] session Session that receives the hijacked connection
+		 * @param [in] tty Allocate a pseudo-TTY (it must match the Tty of the exec configuration)
+		 * @returns DockerError
+		 */
+		DockerError execAttach(const std::string &id, ExecSession &session, bool tty = false)
+		{
+			OperationScope scope(_metrics, OP_EXEC_START);
+			const std::string url = _endpoint + "/exec/" + id + "/start";
+			DockerError err = _checkError(_net.upgrade("POST", url, _execStartBody(false, tty), session.connection()));
+			if (err.isError())
+				return err;
+			session.start(tty, [this, id](int h, int w) { return execResizeInstance(id, h, w); });
+			return err;
 		}
 
 		/**
@@ -340,6 +984,7 @@ namespace docker_cpp
 		 */
 		DockerError execResizeInstance(const std::string &id, int h, int w)
 		{
+			OperationScope scope(_metrics, OP_EXEC_RESIZE);
 			std::string url = _endpoint + "/exec/" + id + "/resize";
 			url += query_params(q_arg("h", h), q_arg("w", w));
 			return _checkError(_net.post(url, ""));
@@ -353,49 +998,338 @@ namespace docker_cpp
 		 */
 		DockerError execInspectInstance(const std::string &id, ExecInfo &result)
 		{
+			OperationScope scope(_metrics, OP_EXEC_INSPECT);
 			const std::string url = _endpoint + "/exec/" + id + "/json";
-			auto res = _net.get(url);
+			auto res = _get(url);
 			DockerError err = _checkError(res);
 			if (err.isError())
 				return err;
+			ParseTimer timer;
 			auto data = asl::Json::decode(res.text().replace("\\\"", "")); // AAA: scaping is necessary for commands
 			parse(data, result);
 			return err;
 		}
 
+		/**
+		 * Run a command inside a running container and wait for it to finish.
+		 * The exec instance is created and started on the same connection when the transport keeps connections alive
+		 * (SocketHttp), and its output is streamed to the sinks as it is produced.
+		 * @param [in] id ID or name of the container
+		 * @param [in] config Configuration parameters to execute a command (with tty the output is not multiplexed)
+		 * @param [in] onStdout Receives the standard output of the command (the whole output with tty)
+		 * @param [in] onStderr Receives the standard error of the command
+		 * @param [in,out] exitCode Exit code of the command
+		 * @returns DockerError
+		 */
+		DockerError execRun(const std::string &id, const ExecConfig &config, const StreamSink &onStdout, const StreamSink &onStderr, int &exitCode)
+		{
+			std::string execId;
+			DockerError err = execCreateInstance(id, config, execId);
+			if (err.isError())
+				return err;
+
+			{
+				OperationScope scope(_metrics, OP_EXEC_START);
+				StreamDemuxer demux(onStdout, onStderr, config.tty);
+				const std::string url = _endpoint + "/exec/" + execId + "/start";
+				err = _checkError(_net.stream("POST", url, _execStartBody(false, config.tty), demux.sink()));
+				if (err.isError())
+					return err;
+			}
+
+			ExecInfo info;
+			err = execInspectInstance(execId, info);
+			if (err.isError())
+				return err;
+			exitCode = info.exitCode;
+			return err;
+		}
+
+		/**
+		 * Run a command inside a running container and capture its output.
+		 * @param [in] id ID or name of the container
+		 * @param [in] config Configuration parameters to execute a command
+		 * @param [in,out] result Exit code and captured stdout/stderr of the command
+		 * @returns DockerError
+		 */
+		DockerError execRun(const std::string &id, const ExecConfig &config, ExecRunResult &result)
+		{
+			return execRun(id, config, append_to(result.stdOut), append_to(result.stdErr), result.exitCode);
+		}
+
+		/**
+		 * Run the same command in several containers concurrently.
+		 * The transport must support concurrent calls.
+		 * @param [in] ids IDs or names of the containers
+		 * @param [in] config Configuration parameters to execute the command
+		 * @param [in,out] results Exit code and output of each command, in the same order as ids
+		 * @param [in,out] errors Result of each operation, in the same order as ids
+		 * @param [in] concurrency Maximum number of commands running at the same time (default: DOCKER_DEFAULT_CONCURRENCY)
+		 * @returns DockerError, an error if any of the operations failed
+		 */
+		DockerError execRunBatch(const std::vector<std::string> &ids, const ExecConfig &config, std::vector<ExecRunResult> &results, DockerErrorList &errors, unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY)
+		{
+			results.assign(ids.size(), ExecRunResult());
+			return _batch(ids, errors, concurrency, [&](std::size_t i) { return execRun(ids[i], config, results[i]); });
+		}
+
 		////////// Helper functions
 
 		bool checkConnection() { return this->ping().isOk(); }
 
+		/// True if this object can be used from several threads at the same time
+		static constexpr bool isThreadSafe() { return T::thread_safe; }
+
+		/**
+		 * Records the latency (connect, first byte, transfer, parse), bytes and status of every operation in `metrics`.
+		 * Set it before sharing the object between threads. Recording is disabled by default (or with nullptr);
+		 * it then costs a pointer test per operation.
+		 * @param [in] metrics Metrics to record to. It must outlive this object, or be reset with setMetrics(nullptr)
+		 */
+		void setMetrics(DockerMetrics *metrics) { _metrics = metrics; }
+		DockerMetrics *metrics() const { return _metrics; }
+
+		/// URI of the daemon, as given to the constructor
+		const std::string &uri() const { return _uri; }
+
+		/**
+		 * Retries and hedging of the idempotent GET requests (ping, version, imageList, containerList, execInspectInstance).
+		 * Disabled by default. Set it before sharing the object between threads. Every hedged request runs its second
+		 * attempt on a thread of its own; hedging is ignored when the transport is not thread-safe.
+		 */
+		void setRetryPolicy(const RetryPolicy &policy) { _retry = policy; }
+		const RetryPolicy &retryPolicy() const { return _retry; }
+
+		/// Transport used by this object, to configure it (e.g. the log of a RecordingHttp)
+		T &transport() { return _net; }
+
+		/// API version of the requests
+		const ApiVersion &apiVersion() const { return _api; }
+		/// True if the API version in use has the endpoints and parameters introduced in `version`
+		bool apiSupports(const ApiVersion &version) const { return _api >= version; }
+		/// Uses a given API version rather than a negotiated one. Set it before sharing the object between threads
+		void setApiVersion(const ApiVersion &version) { _useApiVersion(version); }
+
 	private:
+		std::string _uri;
+		ApiVersion _api;
 		std::string _endpoint;
 		T _net;
+		DockerMetrics *_metrics = nullptr;
+		RetryPolicy _retry;
+
+		void _useApiVersion(const ApiVersion &version)
+		{
+			_api = version;
+			_endpoint = _uri + "/v" + version.str();
+		}
 
 		template <typename U>
 		DockerError _checkAndParse(const asl::HttpResponse &res, U& d){
 			DockerError err = _checkError(res);
 			if (err.isError()) return err;
+			ParseTimer timer;
 			parse(res.json(), d);
 			return err;
 		}
 
-		DockerError _checkError(const asl::HttpResponse &res)
+		/// GET of an idempotent request, retried and hedged as set by setRetryPolicy()
+		asl::HttpResponse _get(const std::string &url)
 		{
-			int code = res.code();
-			if (code >= 200 && code < 300)
+			asl::HttpResponse res = _hedgedGet(url);
+			for (int retry = 0; retry + 1 < _retry.attempts && RetryPolicy::retryable(res.code()) && !call_interrupted(); ++retry)
 			{
-				return DockerError::D_OK();
+				if (!call_sleep(_retry.delay(retry)))
+					break;
+				res = _hedgedGet(url);
 			}
-			else if (code < 400)
+			return res;
+		}
+
+		asl::HttpResponse _hedgedGet(const std::string &url)
+		{
+			if (!T::thread_safe || _retry.hedgeAfter.count() <= 0)
+				return _net.get(url);
+
+			// The first request runs on this thread and the hedged one on a helper; whichever answers first cancels the other
+			CallContext context = current_call_context() ? *current_call_context() : CallContext();
+			const RequestPriority priority = PriorityScope::current();
+			CancellationToken primary = CancellationToken::create();
+			CancellationToken hedge = CancellationToken::create();
+			std::mutex mutex;
+			bool answered = false, hedgeWon = false;
+			asl::HttpResponse hedged;
+			std::thread helper([&] {
+				CallScope outer(context);
+				CallScope scope(hedge);
+				PriorityScope sameClass(priority);
+				if (!call_sleep(_retry.hedgeAfter))
+					return;
+				asl::HttpResponse res = _net.get(url);
+				std::lock_guard<std::mutex> lock(mutex);
+				if (answered || res.code() == 0)
+					return;
+				answered = hedgeWon = true;
+				hedged = res;
+				primary.cancel();
+			});
+
+			asl::HttpResponse res;
+			{
+				CallScope scope(primary);
+				res = _net.get(url);
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				answered = true;
+			}
+			hedge.cancel();
+			helper.join();
+			return hedgeWon ? hedged : res;
+		}
+
+		template <typename F>
+		DockerError _batch(const std::vector<std::string> &ids, DockerErrorList &errors, unsigned int concurrency, F op)
+		{
+			static_assert(T::thread_safe, "Batch operations need a thread-safe transport (T::thread_safe)");
+			errors.assign(ids.size(), DockerError::D_OK());
+			parallel_for(ids.size(), concurrency, [&](std::size_t i) { errors[i] = op(i); });
+
+			std::size_t failed = 0;
+			int firstCode = 0;
+			for (DockerError &e : errors)
+			{
+				if (!e.isError()) continue;
+				if (failed++ == 0) firstCode = e.apiErrorCode;
+			}
+			if (failed == 0) return DockerError::D_OK();
+			return DockerError::D_ERROR(std::to_string(failed) + " of " + std::to_string(ids.size()) + " operations failed", firstCode);
+		}
+
+		DockerError _listContainers(const std::string &url, ContainerList &result)
+		{
+			auto res = _get(url);
+			DockerError err = _checkError(res);
+			if (!err.isOk())
+				return err;
+			ParseTimer timer;
+			auto data = asl::Json::decode(res.text().replace("\\\"", "")); // AAA: scaping is necessary for commands
+			parse(data, result);
+			return err;
+		}
+
+		// {"key":["a","b"]}, percent-encoded
+		static std::string _filtersJson(const std::map<std::string, std::vector<std::string> > &filters)
+		{
+			std::string out;
+			for (const auto &f : filters)
 			{
-				std::string msg = *(res.json()["message"].toString());
-				return DockerError::D_INFO(msg, code);
+				out += (out.empty() ? "{" : ",") + json_string(f.first) + ":[";
+				for (std::size_t i = 0; i < f.second.size(); ++i)
+					out += (i ? "," : "") + json_string(f.second[i]);
+				out += "]";
 			}
-			else
+			return out.empty() ? out : url_encode(out + "}");
+		}
+
+		static std::string _namesQuery(const std::vector<std::string> &names)
+		{
+			std::string query;
+			for (const std::string &name : names)
+				query += (query.empty() ? "?names=" : "&names=") + url_encode(name);
+			return query;
+		}
+
+		DockerError _export(const std::string &url, const StreamSink &sink)
+		{
+			OperationScope scope(_metrics, OP_IMAGE_EXPORT);
+			bool stopped = false;
+			DockerError err = _checkError(_net.stream("GET", url, "", [&](const char *data, std::size_t size) {
+				stopped = !sink(data, size);
+				return !stopped;
+			}));
+			if (err.isOk() && stopped)
+				return DockerError::D_CANCELLED();
+			return err;
+		}
+
+		// Runs a download into a file descriptor; a failed write is reported as such rather than as a cancellation
+		DockerError _toFile(int fd, const std::function<DockerError(const StreamSink &)> &download)
+		{
+			FileSink file(fd);
+			int error = 0;
+			DockerError err = download([&](const char *data, std::size_t size) {
+				if (file(data, size)) return true;
+				error = errno;
+				return false;
+			});
+			if (error != 0)
+				return DockerError::D_ERROR(std::string("cannot write the archive: ") + std::strerror(error), 0);
+			return err;
+		}
+
+		std::string _archiveUrl(const std::string &id, const std::string &path) const
+		{
+			return _endpoint + "/containers/" + id + "/archive?path=" + url_encode(path);
+		}
+
+		// The X-Docker-Container-Path-Stat header of an archive response
+		static bool _pathStat(const asl::HttpResponse &res, PathStat &stat)
+		{
+			static const char *const name = "X-Docker-Container-Path-Stat";
+			asl::String header = res.hasHeader(name) ? res.header(name) : res.header("x-docker-container-path-stat");
+			return parse_path_stat(*header, stat);
+		}
+
+		static std::string _buildQuery(const BuildOptions &options)
+		{
+			auto json = [](const std::vector<std::pair<std::string, std::string> > &values) {
+				std::string out;
+				for (const auto &v : values)
+					out += (out.empty() ? "{" : ",") + json_string(v.first) + ":" + json_string(v.second);
+				return out.empty() ? out : url_encode(out + "}");
+			};
+			std::string tags;
+			for (const std::string &t : options.tags)
+				tags += "&t=" + url_encode(t);
+			std::string query = query_params(q_arg("dockerfile", url_encode(options.dockerfile)),
+								q_arg("buildargs", json(options.buildArgs)),
+								q_arg("labels", json(options.labels)),
+								q_arg("target", url_encode(options.target)),
+								q_arg("platform", url_encode(options.platform)),
+								q_arg("networkmode", url_encode(options.networkMode)),
+								q_arg("nocache", options.noCache), q_arg("pull", options.pull),
+								q_arg("rm", options.rm), q_arg("forcerm", options.forceRm),
+								q_arg("q", options.quiet));
+			if (query.empty() && !tags.empty())
+				tags[0] = '?';
+			return query + tags;
+		}
+
+		static std::string _execStartBody(bool detach, bool tty)
+		{
+			std::stringstream ss;
+			ss << std::boolalpha << "{\"Detach\":" << detach << ",\"Tty\":" << tty << "}";
+			return ss.str();
+		}
+
+		/// Status of a response. Only the "message" field of error bodies is read, without a full JSON parse
+		DockerError _checkError(const asl::HttpResponse &res)
+		{
+			int code = res.code();
+			if (code > 0 && code < 300) // 2xx, and 101 for hijacked connections
+				return DockerError::D_OK();
+			if (code == 0)
 			{
-				std::string msg = *(res.json()["message"].toString());
-				return DockerError::D_ERROR(msg, code);
+				CallContext *context = current_call_context();
+				if (context && context->cancelled())
+					return DockerError::D_CANCELLED();
+				if (context && context->expired())
+					return DockerError::D_TIMEOUT();
+				return DockerError::D_CONNECTION();
 			}
+			const asl::ByteArray &body = res.body();
+			return DockerError::D_HTTP(code, reinterpret_cast<const char *>(body.ptr()), static_cast<std::size_t>(body.length()));
 		}
 	};
 
@@ -0,0 +1,208 @@
+#ifndef _DOCKER_BUILD_H
+#define _DOCKER_BUILD_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_stream.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace docker_cpp
+{
+	/// Receives every message of a build output as it arrives. Return false to stop the build
+	typedef std::function<bool(const BuildMessage &message)> BuildMessageHandler;
+
+	/**
+	 * Exclusion rules of a .dockerignore file, with the semantics of the docker CLI.
+	 * Patterns are paths relative to the context root made of '*', '?', '[...]' and '\' escapes within a path
+	 * component, and "**" for any number of components. A pattern matching a directory excludes everything below it.
+	 * "!pattern" re-includes what earlier patterns excluded: the last matching pattern wins.
+	 */
+	class DOCKER_CPP_API DockerIgnore
+	{
+	public:
+		/// Reads `<dir>/.dockerignore`. A missing file gives no rules; returns false if the file cannot be read
+		bool load(const std::string &dir);
+		/// Adds the rules of the text of a .dockerignore file: one pattern per line, '#' starts a comment
+		void parse(const std::string &text);
+		/// Adds one pattern
+		void add(const std::string &pattern);
+
+		/// True if the path (relative to the context root, '/'-separated) is excluded
+		bool excluded(const std::string &path) const;
+		/// False if no "!" rule can re-include anything below the directory `dir`, so an excluded `dir` need not be walked
+		bool mayIncludeBelow(const std::string &dir) const;
+		bool empty() const { return _rules.empty(); }
+
+	private:
+		struct Rule
+		{
+			std::vector<std::string> parts;
+			bool exception;
+		};
+
+		std::vector<Rule> _rules;
+		bool _hasExceptions = false;
+	};
+
+	/// A file, directory or symbolic link of a build context
+	struct DOCKER_CPP_API ContextEntry
+	{
+		std::string path; //!< Path in the archive, relative to the context root
+		char type; //!< Tar type: '0' regular file, '2' symbolic link, '5' directory
+		unsigned int mode; //!< Permission bits
+		std::uint64_t size; //!< Size of a regular file when it was scanned
+		std::int64_t mtime; //!< Modification time (UNIX timestamp)
+		std::string link; //!< Target of a symbolic link
+	};
+
+	struct DOCKER_CPP_API ContextOptions
+	{
+		std::string dockerfile = "Dockerfile"; //!< Path of the Dockerfile in the context, sent even if .dockerignore excludes it
+		unsigned int threads = 0; //!< Threads reading files ahead of the stream (0: the hardware concurrency, at most 8)
+		std::size_t readAhead = 16 * 1024 * 1024; //!< Most bytes of file data read ahead of the stream
+		std::size_t blockSize = 256 * 1024; //!< Most bytes read ahead of one file; the rest is read when it is sent
+		std::string cacheDir; //!< Directory of a persistent cache of the files sent (none if empty), see ContextPacker
+	};
+
+	class ContextCache;
+
+	/**
+	 * Streams a directory as the tar archive of a build context, without staging it in memory or on disk.
+	 * The directory is walked in sorted order (so the same tree gives the same archive), skipping what .dockerignore
+	 * excludes. While the archive is read, worker threads open and read the next files ahead of it within a bounded
+	 * window, so a context of many small files is not limited by the latency of one open/read at a time; the part of a
+	 * large file beyond blockSize is read by the consumer straight into its buffer.
+	 * Files are archived with owner 0:0, as the docker CLI does. A file that changes size while it is read is cut or
+	 * padded with zeros to its scanned size.
+	 * One object produces one archive; read() must be called from one thread at a time.
+	 *
+	 * With a cacheDir, the contents of the files sent are kept in a store under it, addressed by hash so identical
+	 * files are stored once, with an index of the size, mtime, ctime and inode each file had. The next archive of the
+	 * same directory sends a file whose stat still matches from the store, without opening or reading it again; only
+	 * new and changed files are read from the tree. A file modified less than 2 seconds before the archive that
+	 * indexed it is always read again, as its mtime may not show a later change. The cache of a directory is used by
+	 * one packer at a time: another one packs without it.
+	 *
+	 * A packer can also archive a list of host files and directories, each at the root of the archive under its base
+	 * name as `docker cp` does (see Docker::containerArchivePut). No .dockerignore applies and no cache is used then.
+	 */
+	class DOCKER_CPP_API ContextPacker
+	{
+	public:
+		explicit ContextPacker(const std::string &dir, const ContextOptions &options = ContextOptions());
+		/// Archives host paths (files, directories with their content, symbolic links) under their base names
+		explicit ContextPacker(const std::vector<std::string> &paths, const ContextOptions &options = ContextOptions());
+		~ContextPacker();
+		ContextPacker(const ContextPacker &) = delete;
+		ContextPacker &operator=(const ContextPacker &) = delete;
+
+		/// Reads .dockerignore and walks the directory. Called by the first read() if needed
+		bool scan();
+		/// Entries of the archive, in order (after scan())
+		const std::vector<ContextEntry> &entries() const { return _entries; }
+		/// Bytes of file data in the archive (after scan())
+		std::uint64_t dataSize() const { return _dataSize; }
+
+		/// Next bytes of the archive: returns the number of bytes written, 0 at the end and -1 on error (see error())
+		long read(char *data, std::size_t size);
+		/// A StreamSource reading this archive
+		StreamSource source() { return [this](char *data, std::size_t size) { return read(data, size); }; }
+
+		/// What failed, after read() or scan() returned an error
+		const std::string &error() const { return _error; }
+
+		/// Files sent from the cache rather than read from the tree (after scan())
+		std::size_t reused() const { return _reused; }
+		/// Bytes of file data sent from the cache (after scan())
+		std::uint64_t reusedBytes() const { return _reusedBytes; }
+		/// Directory holding the cache of the context `dir` under `cacheDir`
+		static std::string cachePath(const std::string &cacheDir, const std::string &dir);
+
+	private:
+		/// An entry read ahead of the stream by a worker
+		struct Slot
+		{
+			std::string data; //!< Head of the file, at most blockSize bytes
+			int fd = -1; //!< Still open when the file is larger than data
+			bool owned = true; //!< False if fd is the cache store
+			std::uint64_t offset = 0; //!< Position of the rest of the data in fd
+			bool ready = false;
+			std::string error;
+		};
+
+		/// Stat signature of a regular file and where its data is in the cache
+		struct CacheState
+		{
+			std::int64_t mtime = 0; //!< Nanoseconds
+			std::int64_t ctime = 0;
+			std::uint64_t inode = 0;
+			std::uint64_t hash = 0;
+			std::uint64_t offset = 0;
+			bool hit = false;
+		};
+
+		enum Stage { NEXT_ENTRY, HEADER, DATA, REST, PADDING, TRAILER, END };
+
+		bool _walk(const std::string &dir, const std::string &prefix, const DockerIgnore &ignore);
+		bool _add(const std::string &source, const std::string &path, const DockerIgnore &ignore);
+		bool _keep(const std::string &path) const;
+		void _start();
+		void _stop();
+		void _work();
+		void _fill(std::size_t index, Slot &slot);
+		void _release();
+		bool _nextEntry();
+		void _openCache();
+		void _saveCache();
+		void _toCache(const char *data, std::size_t size);
+
+		std::string _dir;
+		std::vector<std::string> _paths; //!< Host paths archived instead of _dir
+		ContextOptions _options;
+		std::vector<ContextEntry> _entries;
+		std::vector<std::string> _sources; //!< Path on disk of every entry
+		std::uint64_t _dataSize;
+		bool _scanned;
+		std::string _error;
+
+		std::unique_ptr<ContextCache> _cache;
+		std::vector<CacheState> _states; //!< Cache state of every entry
+		std::int64_t _stamp; //!< Time of the scan (ns)
+		std::size_t _reused;
+		std::uint64_t _reusedBytes;
+		bool _storing; //!< The data of the current entry goes to the cache
+
+		// Read-ahead window shared with the workers: entry i uses slot i % _slots.size()
+		std::mutex _mutex;
+		std::condition_variable _workReady;
+		std::condition_variable _slotReady;
+		std::vector<Slot> _slots;
+		std::vector<std::thread> _workers;
+		std::size_t _next; //!< Next entry to read ahead
+		std::size_t _current; //!< Entry being streamed; slots of earlier entries are free
+		bool _stopping;
+
+		// Output state of read()
+		Stage _stage;
+		std::string _out; //!< Header, padding or trailer being written
+		std::size_t _outPos;
+		std::size_t _dataPos; //!< Position in the data of the current slot
+		std::uint64_t _remaining; //!< Bytes of the current file still to read from its descriptor
+	};
+
+	/**
+	 * Writes the tar header (ustar, with a PAX header first for long names or sizes over 8 GiB) of an entry to `out`.
+	 * Exposed for archives built by other means.
+	 */
+	DOCKER_CPP_API void tar_header(const ContextEntry &entry, std::string &out);
+} // namespace docker_cpp
+
+#endif //_DOCKER_BUILD_H
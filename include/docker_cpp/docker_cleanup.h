@@ -0,0 +1,64 @@
+#ifndef _DOCKER_CLEANUP_H
+#define _DOCKER_CLEANUP_H
+
+#include "docker_types.h"
+#include "docker_error.h"
+#include "docker_parallel.h"
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace docker_cpp
+{
+    struct DOCKER_CPP_API ImageCleanupPolicy
+    {
+        std::map<std::string, std::string> filters; //!< Filters passed to imageList when collecting candidates
+        std::int64_t minAge = 0; //!< Only remove images created at least this many seconds ago (0: any age)
+        std::int64_t minSize = 0; //!< Only remove images whose own layers take at least this many bytes (0: any size)
+        bool danglingOnly = false; //!< Only remove untagged images
+        bool keepInUse = true; //!< Keep images that are used by containers, including stopped ones
+        bool force = false; //!< Passed to imageRemove
+        bool noprune = false; //!< Passed to imageRemove
+        bool prune = false; //!< Call imagePrune once the removals are done
+        std::map<std::string, std::string> pruneFilters; //!< Filters passed to imagePrune
+        unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY; //!< Maximum number of removals in flight
+    };
+
+    struct DOCKER_CPP_API ImageRemovalPlan
+    {
+        std::vector<std::vector<std::string> > waves; //!< Image IDs to remove; images of a wave only depend on earlier waves
+        std::vector<std::string> blocked; //!< Candidates kept because a descendant image is not being removed
+        std::map<std::string, std::string> parents; //!< Parent image ID of each planned image (if it is planned too)
+        std::map<std::string, std::int64_t> bytes; //!< Bytes owned by each planned image (its size minus its parent's)
+        std::int64_t totalBytes = 0; //!< Sum of bytes of all the planned images
+    };
+
+    struct DOCKER_CPP_API ImageCleanupResult
+    {
+        DeletedImageList deleted; //!< Aggregate of every imageRemove (and imagePrune) response
+        std::int64_t spaceReclaimed = 0; //!< Bytes freed by the removed images plus the prune
+        std::vector<std::pair<std::string, DockerError> > failed; //!< Planned images that could not be removed
+    };
+
+    /**
+     * Computes which images of a list (as returned by imageList with all=true) should be removed.
+     * Children are always scheduled in an earlier wave than their parents, so every wave can be removed in parallel.
+     * @param [in] images Every image in the server
+     * @param [in] policy Age/size/usage rules an image must match to be removed
+     * @param [in] now Current UNIX timestamp, used by minAge
+     * With keepInUse, an image whose container count was not computed (-1, as /images/json returns it) is kept.
+     * @param [in,out] out The removal plan
+     */
+    void planImageCleanup(const ImageList &images, const ImageCleanupPolicy &policy, std::int64_t now, ImageRemovalPlan &out);
+
+    /**
+     * Same as above, with the images in use given by the containers of the server rather than by the image counts.
+     * @param [in] inUse Image IDs of every container (as listed by containerList with all=true)
+     */
+    void planImageCleanup(const ImageList &images, const ImageCleanupPolicy &policy, std::int64_t now, const std::set<std::string> &inUse,
+                          ImageRemovalPlan &out);
+} // namespace docker_cpp
+
+#endif //_DOCKER_CLEANUP_H
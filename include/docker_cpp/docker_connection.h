@@ -0,0 +1,177 @@
+#ifndef _DOCKER_CONNECTION_H
+#define _DOCKER_CONNECTION_H
+
+#include "export.h"
+#include "docker_stream.h"
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace docker_cpp
+{
+	typedef std::map<std::string, std::string> header_map;
+	struct RequestTimings;
+
+	/**
+	 * Address of a daemon and path of a request, split from an URL.
+	 * Supported forms are "http://host[:port]/path", "tcp://host[:port]/path" and "unix:///path/to/docker.sock/path".
+	 * For Unix sockets the socket path ends at the first component ending in ".sock".
+	 */
+	struct DOCKER_CPP_API DockerUrl
+	{
+		std::string scheme; //!< "http", "tcp" or "unix"
+		std::string host; //!< Host name or IP, or the socket path for "unix"
+		int port = 0; //!< TCP port (80 if not given)
+		std::string path; //!< Path and query of the request, starting with '/'
+
+		/// Parses an URL. Returns false if it is not a supported daemon URL
+		static bool parse(const std::string &url, DockerUrl &out);
+		/// True if both URLs point to the same daemon
+		bool sameDaemon(const DockerUrl &o) const { return scheme == o.scheme && host == o.host && port == o.port; }
+	};
+
+	/**
+	 * A persistent HTTP/1.1 connection to a docker daemon over TCP or a Unix domain socket (POSIX sockets).
+	 * Requests are sent one at a time; the connection is kept alive between them when the daemon allows it.
+	 * After a request is hijacked (101 Switching Protocols, or a raw stream without length) the socket can be
+	 * used directly through read(), write() and handle().
+	 * Socket operations honour the deadline and cancellation tokens of the calling thread (see CallScope): they fail
+	 * when one of them interrupts the call, and the connection must then be closed.
+	 * A connection must only be used by one thread at a time.
+	 */
+	class DOCKER_CPP_API DockerConnection
+	{
+	public:
+		DockerConnection();
+		~DockerConnection();
+		DockerConnection(const DockerConnection &) = delete;
+		DockerConnection &operator=(const DockerConnection &) = delete;
+
+		/// Connects to the daemon of `url`, reusing the current socket if it is open and points to the same daemon
+		bool connect(const DockerUrl &url);
+		/// Takes ownership of an already connected socket
+		void adopt(int fd);
+		bool isOpen() const { return _fd >= 0; }
+		void close();
+		/// Native socket descriptor (-1 if closed)
+		int handle() const { return _fd; }
+		/// True if the last response allows sending another request on this connection
+		bool reusable() const { return _fd >= 0 && _keepAlive; }
+		/// Daemon this connection is connected to
+		const DockerUrl &daemon() const { return _url; }
+
+		/**
+		 * Sends the request line, headers and body. Adds Host and Content-Length.
+		 * @param [in] method HTTP method
+		 * @param [in] path Path and query (DockerUrl::path)
+		 * @param [in] body Request body (may be empty)
+		 * @param [in] headers Extra headers
+		 */
+		bool sendRequest(const std::string &method, const std::string &path, const std::string &body, const header_map &headers = header_map());
+
+		/**
+		 * Sends the request line and headers, then the body produced by `body` with chunked transfer encoding.
+		 * @returns false on I/O errors or if the source failed
+		 */
+		bool sendRequest(const std::string &method, const std::string &path, const StreamSource &body, const header_map &headers = header_map());
+
+		/**
+		 * Reads the status line and headers of the response. Header names are lower-cased.
+		 */
+		bool readHead(int &code, header_map &headers);
+
+		/**
+		 * Reads the response body framed by Content-Length, chunked encoding or the end of the connection,
+		 * and hands it to `sink` as it arrives.
+		 * @param [in] method Method of the request (HEAD responses have no body)
+		 * @param [in] code Response status code
+		 * @param [in] headers Response headers as returned by readHead()
+		 * @param [in] sink Receives the body; returning false aborts the transfer and closes the connection
+		 * @returns false on I/O errors or if the transfer was aborted
+		 */
+		bool readBody(const std::string &method, int code, const header_map &headers, const StreamSink &sink);
+
+		/**
+		 * Convenience: sendRequest() + readHead() + readBody().
+		 * Connects or reconnects as needed: a kept-alive socket already closed by the daemon is replaced before sending.
+		 * A GET, HEAD, PUT, DELETE or OPTIONS request dropped by the daemon on a kept-alive socket is retried once on a
+		 * new one; other methods are not, as the daemon may have processed them.
+		 * Fills the timings of the operation being recorded on this thread, if any (see DockerMetrics).
+		 */
+		bool request(const DockerUrl &url, const std::string &method, const std::string &body, const header_map &headers,
+					 int &code, header_map &responseHeaders, const StreamSink &sink);
+
+		/**
+		 * request() with a body streamed from `body`. A streamed body cannot be sent twice, so instead of retrying on a
+		 * stale kept-alive socket, a socket already closed by the daemon is replaced before sending. If the daemon
+		 * stops reading the body to answer with an error, that answer is still read.
+		 * A FileSource of a regular file is sent with sendfile() and a Content-Length (Linux), and a BufferSource with
+		 * gather writes and a Content-Length.
+		 */
+		bool request(const DockerUrl &url, const std::string &method, const StreamSource &body, const header_map &headers,
+					 int &code, header_map &responseHeaders, const StreamSink &sink);
+
+		/**
+		 * Sends a request asking the daemon to hijack the connection ("Upgrade: tcp") and reads the response head.
+		 * On success (101, or 200 with a raw stream) the socket carries the raw stream from then on.
+		 */
+		bool upgrade(const DockerUrl &url, const std::string &method, const std::string &body, const header_map &headers,
+					 int &code, header_map &responseHeaders);
+
+		/// Reads raw bytes, returning buffered data first. Returns 0 at end of stream and -1 on error
+		long read(char *data, std::size_t size);
+		/// Writes all the bytes
+		bool write(const char *data, std::size_t size);
+		/// Bytes already received but not consumed yet
+		std::size_t buffered() const { return _buf.size() - _pos; }
+		/// Closes the sending half of the socket, signaling the end of stdin to the daemon
+		bool shutdownWrite();
+
+	private:
+		bool _fill();
+		bool _stale() const;
+		bool _sendFile(const std::string &method, const std::string &path, const FileSource &file, long long size,
+					   const header_map &headers, bool &sourceFailed);
+		bool _sendBuffers(const std::string &method, const std::string &path, const BufferSource &buffers, const header_map &headers);
+		bool _readLine(std::string &line);
+		bool _readExact(std::size_t size, const StreamSink &sink);
+
+		int _fd;
+		DockerUrl _url;
+		std::string _buf;
+		std::size_t _pos;
+		bool _keepAlive;
+	};
+
+	/**
+	 * Thread-safe set of idle kept-alive connections.
+	 * Every caller checks out a connection of its own, so concurrent requests never share a socket, and returns it
+	 * when the response has been read so that the next request to the same daemon skips the connection setup.
+	 */
+	class DOCKER_CPP_API ConnectionPool
+	{
+	public:
+		/// @param [in] maxIdle Maximum number of idle connections kept open
+		ConnectionPool(std::size_t maxIdle = 32) : _maxIdle(maxIdle) {}
+		ConnectionPool(const ConnectionPool &) = delete;
+		ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+		/// Returns an idle connection to the daemon of `url`, or a new unconnected one
+		std::unique_ptr<DockerConnection> acquire(const DockerUrl &url);
+		/// Keeps the connection for later if it can still be used, closes it otherwise
+		void release(std::unique_ptr<DockerConnection> conn);
+		/// Number of idle connections
+		std::size_t idle() const;
+
+	private:
+		mutable std::mutex _mutex;
+		std::vector<std::unique_ptr<DockerConnection> > _idle;
+		std::size_t _maxIdle;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_CONNECTION_H
@@ -0,0 +1,142 @@
+#ifndef _DOCKER_DEADLINE_H
+#define _DOCKER_DEADLINE_H
+
+#include "export.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace docker_cpp
+{
+	/**
+	 * Cancels the operations of one or more threads from any thread.
+	 * Copies share the same state. A token wakes up the requests blocked on it through a pipe, so SocketHttp
+	 * returns as soon as cancel() is called instead of waiting for the daemon.
+	 * An empty token (default constructed) is never cancelled.
+	 */
+	class DOCKER_CPP_API CancellationToken
+	{
+	public:
+		CancellationToken() {}
+		/// A new token that can be cancelled
+		static CancellationToken create();
+
+		/// Cancels the token and the tokens created with child()
+		void cancel();
+		bool cancelled() const { return _state && _state->cancelled.load(std::memory_order_acquire); }
+		/// A new token that is cancelled with this one, and can also be cancelled on its own
+		CancellationToken child() const;
+		/// Descriptor that becomes readable when the token is cancelled (-1 for an empty token)
+		int handle() const { return _state ? _state->fds[0] : -1; }
+		bool empty() const { return !_state; }
+
+	private:
+		struct State
+		{
+			State();
+			~State();
+			std::atomic<bool> cancelled;
+			int fds[2];
+			std::mutex mutex;
+			std::vector<std::weak_ptr<State> > children;
+		};
+
+		static void _cancel(const std::shared_ptr<State> &state);
+
+		std::shared_ptr<State> _state;
+	};
+
+	/**
+	 * Deadline and cancellation tokens of the calls made on a thread, installed by CallScope.
+	 * DockerConnection waits for the socket with poll() and gives up when the deadline passes or a token is cancelled;
+	 * the Docker operation then fails with DOCKER_TIMEOUT or DOCKER_CANCELLED.
+	 */
+	struct DOCKER_CPP_API CallContext
+	{
+		typedef std::chrono::steady_clock clock;
+
+		clock::time_point deadline = clock::time_point::max();
+		std::vector<CancellationToken> tokens;
+
+		bool hasDeadline() const { return deadline != clock::time_point::max(); }
+		bool expired() const { return hasDeadline() && clock::now() >= deadline; }
+		bool cancelled() const;
+		/// Milliseconds left before the deadline, rounded up (-1 without deadline)
+		int remainingMs() const;
+	};
+
+	/// Context of the calls made on this thread, or null when they have no deadline and cannot be cancelled
+	DOCKER_CPP_API CallContext *&current_call_context();
+
+	/// True if the calls of this thread must give up: their deadline has passed or they were cancelled
+	inline bool call_interrupted()
+	{
+		CallContext *context = current_call_context();
+		return context && (context->expired() || context->cancelled());
+	}
+
+	/**
+	 * Waits until `fd` is ready for `events` (POLLIN, POLLOUT) within the context of this thread.
+	 * Returns at once without a context. Returns false on timeout, cancellation or error.
+	 */
+	DOCKER_CPP_API bool call_wait(int fd, short events);
+
+	/// Sleeps, waking up early if the calls of this thread are cancelled. Returns false if interrupted
+	DOCKER_CPP_API bool call_sleep(std::chrono::milliseconds duration);
+
+	/**
+	 * Bounds the Docker calls made by this thread during its lifetime:
+	 * @code
+	 * CallScope scope(std::chrono::seconds(5), token);
+	 * DockerError err = docker.containerWait(id, info); // DOCKER_TIMEOUT after 5 s, DOCKER_CANCELLED on token.cancel()
+	 * @endcode
+	 * Scopes nest: an inner scope keeps the earliest deadline and adds its token to those of the outer scope.
+	 * The deadline is shared by all the calls of the scope. The daemon may still carry out an operation whose
+	 * call timed out (a container being stopped keeps stopping).
+	 * Transports that cannot be interrupted (ASLHttp) only check the deadline before sending a request.
+	 */
+	class DOCKER_CPP_API CallScope
+	{
+	public:
+		/// @param timeout Time allowed to the calls of the scope (zero or negative: no deadline)
+		explicit CallScope(std::chrono::milliseconds timeout, const CancellationToken &token = CancellationToken());
+		explicit CallScope(const CancellationToken &token);
+		/// Installs a copy of a context, to carry the deadline of a call to another thread
+		explicit CallScope(const CallContext &context);
+		~CallScope();
+
+		CallScope(const CallScope &) = delete;
+		CallScope &operator=(const CallScope &) = delete;
+
+	private:
+		void _install(CallContext::clock::time_point deadline, const CancellationToken &token);
+
+		CallContext _context;
+		CallContext *_outer;
+	};
+
+	/**
+	 * Retries and hedging of the idempotent GET requests of Docker (ping, version, lists, inspect).
+	 * A request is retried when it failed without a response, or with 429 or a 5xx status, after a delay drawn
+	 * uniformly between 0 and min(maxBackoff, backoff * 2^retry) ("full jitter"), within the deadline of the call.
+	 * With hedging, a second identical request is sent when the first has not answered after hedgeAfter, and the
+	 * first response wins; the other request is cancelled. Hedging needs a thread-safe transport.
+	 */
+	struct DOCKER_CPP_API RetryPolicy
+	{
+		int attempts = 1; //!< Requests sent at most, retries included (1: no retry)
+		std::chrono::milliseconds backoff = std::chrono::milliseconds(50); //!< Base delay before a retry
+		std::chrono::milliseconds maxBackoff = std::chrono::milliseconds(2000); //!< Cap of the delay
+		std::chrono::milliseconds hedgeAfter = std::chrono::milliseconds(0); //!< Delay before a hedged request (0: no hedging)
+
+		/// True if a response with this status deserves another attempt
+		static bool retryable(int code) { return code == 0 || code == 429 || code >= 500; }
+		/// Random delay before retry number `retry` (0 for the first retry)
+		std::chrono::milliseconds delay(int retry) const;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_DEADLINE_H
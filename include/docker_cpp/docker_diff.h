@@ -0,0 +1,18 @@
+#ifndef _DOCKER_DIFF_H
+#define _DOCKER_DIFF_H
+
+#include "docker_types.h"
+
+namespace docker_cpp
+{
+    /**
+     * Computes the changes between two container lists in linear time.
+     * Containers are matched by ID; a container is reported as changed when its state, status or labels differ.
+     * @param [in] previous Previous snapshot of the list
+     * @param [in] current New list
+     * @param [in,out] out Added, removed and changed containers; previous contents are discarded
+     */
+    void diff(const ContainerList &previous, const ContainerList &current, ContainerListDelta &out);
+} // namespace docker_cpp
+
+#endif //_DOCKER_DIFF_H
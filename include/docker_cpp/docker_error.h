@@ -3,25 +3,53 @@
 
 #include "docker_cpp/docker_types.h"
 
+#include <cstddef>
 #include <string>
 #include <iostream>
+#include <vector>
 
 namespace docker_cpp {
+    /// Kind of error of an HTTP status (ERR_NONE for 2xx, ERR_CONNECTION for 0)
+    DOCKER_CPP_API dockErrKind error_kind(int httpStatus);
+
+    /**
+     * Value of the top-level "message" field of a docker error body ({"message":"No such container: foo"}).
+     * Bodies that are not JSON objects are returned as they are, without surrounding whitespace.
+     */
+    DOCKER_CPP_API std::string error_message(const char *body, std::size_t size);
+
     class DOCKER_CPP_API DockerError {
         public:
             DockerError(dockErr code, const std::string& msg, int codeAPI);
-            bool isOk();
-            bool isError();
+            bool isOk() const;
+            bool isError() const;
+            bool isTimeout() const { return errorCode == DOCKER_TIMEOUT; }
+            bool isCancelled() const { return errorCode == DOCKER_CANCELLED; }
+            bool isNotModified() const { return kind == ERR_NOT_MODIFIED; }
+            bool isNotFound() const { return kind == ERR_NOT_FOUND; }
+            bool isConflict() const { return kind == ERR_CONFLICT; }
+
+            /// Message of the error; daemon errors without a message give a generic one for their status
+            std::string message() const;
             friend std::ostream& operator<<(std::ostream& os, const DockerError& err);
 
             static DockerError D_OK();
             static DockerError D_INFO(const std::string& msg, int codeAPI);
             static DockerError D_ERROR(const std::string& msg, int codeAPI);
+            static DockerError D_TIMEOUT();
+            static DockerError D_CANCELLED();
+            /// Daemon response with status `code` (>= 300) and the given body, whose "message" field goes to `msg`
+            static DockerError D_HTTP(int code, const char *body, std::size_t size);
+            /// The daemon could not be reached or closed the connection without answering
+            static DockerError D_CONNECTION();
 
-            std::string msg;
+            std::string msg; //!< Message of a client-side error, or the "message" field sent by the daemon (possibly empty)
             dockErr errorCode;
             int apiErrorCode;
+            dockErrKind kind;
     };
+
+    using DockerErrorList = std::vector<DockerError>;
 }
 
 #endif //_DOCKER_ERROR_H
@@ -0,0 +1,390 @@
+#ifndef _DOCKER_HEALTH_H
+#define _DOCKER_HEALTH_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_error.h"
+#include "docker_deadline.h"
+#include "docker_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace docker_cpp
+{
+	template <typename T>
+	class Docker;
+
+	/// Result of the health check of a container
+	enum ContainerHealth
+	{
+		HEALTH_NONE, //!< The container has no health check
+		HEALTH_STARTING,
+		HEALTH_HEALTHY,
+		HEALTH_UNHEALTHY
+	};
+
+	/// Name of a health result ("none", "starting", "healthy", "unhealthy")
+	DOCKER_CPP_API const char *health_name(ContainerHealth health);
+
+	/// Health of a container from the status of a container list ("Up 2 hours (healthy)", "Up 3 seconds (health: starting)")
+	DOCKER_CPP_API ContainerHealth parse_health(const std::string &status);
+
+	/// What a HealthMonitor knows of a container
+	struct DOCKER_CPP_API ContainerStatus
+	{
+		std::string state; //!< "running", "exited"... "removed" once the container is gone, empty before it was polled
+		ContainerHealth health = HEALTH_NONE;
+
+		bool operator==(const ContainerStatus &o) const { return state == o.state && health == o.health; }
+		bool operator!=(const ContainerStatus &o) const { return !(*this == o); }
+	};
+
+	/// A change of state or health seen by a HealthMonitor
+	struct DOCKER_CPP_API StatusChange
+	{
+		std::string daemon; //!< URI of the daemon of the container
+		std::string id; //!< ID or name the container is watched with
+		ContainerStatus before; //!< Empty state for the first poll of the container
+		ContainerStatus after;
+	};
+
+	struct DOCKER_CPP_API HealthMonitorOptions
+	{
+		std::chrono::milliseconds minInterval = std::chrono::seconds(1); //!< Poll interval of the containers that just changed, are starting or unhealthy
+		std::chrono::milliseconds maxInterval = std::chrono::seconds(30); //!< The interval doubles up to this while a container stays the same
+		std::size_t batchSize = 100; //!< Most containers looked up by one list request
+		unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY; //!< Daemons polled at the same time
+	};
+
+	/**
+	 * Polls the state and health of many containers, on one or several daemons, and reports their changes to
+	 * subscribers.
+	 * Each container has its own poll interval: it starts at minInterval and doubles up to maxInterval for every
+	 * poll that finds the container as it was; a change, a starting or an unhealthy health check brings it back to
+	 * minInterval. The containers due on a daemon are looked up together by list requests of batchSize IDs
+	 * (containerFind()), so polling costs a request per hundred containers rather than one inspect each; the free
+	 * room of the last batch goes to the containers due next. Containers found missing are reported as "removed" and
+	 * no longer watched. A daemon that fails to answer keeps the status of its containers until the next poll
+	 * (error()).
+	 * Subscribers run on the thread of the monitor: they must be short and must not call stop().
+	 * @code
+	 * HealthMonitor<SocketHttp> monitor;
+	 * monitor.subscribe([](const StatusChange &c) { if (c.after.health == HEALTH_UNHEALTHY) page(c.id); });
+	 * for (const std::string &id : services) monitor.watch(docker, id);
+	 * @endcode
+	 */
+	template <typename T>
+	class HealthMonitor
+	{
+		static_assert(T::thread_safe, "A health monitor needs a thread-safe transport (T::thread_safe)");
+
+	public:
+		/// Receives a change of state or health
+		typedef std::function<void(const StatusChange &change)> ChangeHandler;
+
+		explicit HealthMonitor(const HealthMonitorOptions &options = HealthMonitorOptions())
+			: _options(options), _token(CancellationToken::create()), _nextSubscription(1), _lookups(0), _stopped(false)
+		{
+			_options.batchSize = std::max<std::size_t>(_options.batchSize, 1);
+			_options.maxInterval = std::max(_options.maxInterval, _options.minInterval);
+			_poller = std::thread([this] { _run(); });
+		}
+
+		~HealthMonitor() { stop(); }
+		HealthMonitor(const HealthMonitor &) = delete;
+		HealthMonitor &operator=(const HealthMonitor &) = delete;
+
+		/**
+		 * Starts watching a container; it is polled at once. The Docker object must outlive the monitor or the watch.
+		 * @param [in] id ID, ID prefix or name of the container
+		 * @returns false if the container is already watched on that daemon
+		 */
+		bool watch(Docker<T> &docker, const std::string &id)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			Daemon &daemon = _daemons[&docker];
+			daemon.docker = &docker;
+			if (daemon.watches.count(id))
+				return false;
+			Watch &w = daemon.watches[id];
+			w.interval = _options.minInterval;
+			w.due = std::chrono::steady_clock::now();
+			_wake.notify_one();
+			return true;
+		}
+
+		/// Stops watching a container. Returns false if it was not watched
+		bool unwatch(Docker<T> &docker, const std::string &id)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto daemon = _daemons.find(&docker);
+			return daemon != _daemons.end() && daemon->second.watches.erase(id) > 0;
+		}
+
+		/// Registers a handler for the changes of every watched container. Returns its subscription number
+		std::size_t subscribe(const ChangeHandler &handler)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_subscribers[_nextSubscription] = handler;
+			return _nextSubscription++;
+		}
+
+		void unsubscribe(std::size_t subscription)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_subscribers.erase(subscription);
+		}
+
+		/// Last status of a watched container (empty state before its first poll, or if it is not watched)
+		ContainerStatus status(Docker<T> &docker, const std::string &id) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const Watch *w = _find(docker, id);
+			return w ? w->status : ContainerStatus();
+		}
+
+		/// Current poll interval of a watched container
+		std::chrono::milliseconds interval(Docker<T> &docker, const std::string &id) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			const Watch *w = _find(docker, id);
+			return w ? w->interval : std::chrono::milliseconds(0);
+		}
+
+		/// Containers watched on every daemon
+		std::size_t watched() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::size_t count = 0;
+			for (const auto &d : _daemons)
+				count += d.second.watches.size();
+			return count;
+		}
+
+		/// Result of the last poll of a daemon
+		DockerError error(Docker<T> &docker) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto daemon = _daemons.find(&docker);
+			return daemon != _daemons.end() ? daemon->second.error : DockerError::D_OK();
+		}
+
+		/// Batches looked up so far (each takes one or two list requests)
+		std::uint64_t lookups() const { return _lookups.load(std::memory_order_relaxed); }
+
+		/// Stops polling. Subscribers are no longer called once it returns
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopped = true;
+				_wake.notify_all();
+			}
+			_token.cancel();
+			if (_poller.joinable())
+				_poller.join();
+		}
+
+	private:
+		typedef std::chrono::steady_clock::time_point time_point;
+
+		struct Watch
+		{
+			std::string id; //!< Full ID, once found
+			ContainerStatus status;
+			std::chrono::milliseconds interval;
+			time_point due;
+		};
+
+		struct Daemon
+		{
+			Docker<T> *docker = nullptr;
+			std::map<std::string, Watch> watches; //!< By the key they are watched with
+			DockerError error = DockerError::D_OK();
+		};
+
+		// Containers of a daemon polled together
+		struct Round
+		{
+			Docker<T> *docker;
+			std::vector<std::string> keys; //!< Keys of the watches
+			std::vector<std::string> lookup; //!< Full ID when known, else the key
+			ContainerList found;
+			DockerError error = DockerError::D_OK();
+		};
+
+		const Watch *_find(Docker<T> &docker, const std::string &id) const
+		{
+			auto daemon = _daemons.find(&docker);
+			if (daemon == _daemons.end())
+				return nullptr;
+			auto w = daemon->second.watches.find(id);
+			return w != daemon->second.watches.end() ? &w->second : nullptr;
+		}
+
+		void _run()
+		{
+			CallScope scope(_token);
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!_stopped)
+			{
+				time_point now = std::chrono::steady_clock::now();
+				time_point next = time_point::max();
+				std::vector<Round> rounds;
+				for (auto &d : _daemons)
+				{
+					Round round;
+					round.docker = d.second.docker;
+					_due(d.second, now, round, next);
+					if (!round.keys.empty())
+						rounds.push_back(std::move(round));
+				}
+				if (rounds.empty())
+				{
+					if (next == time_point::max())
+						_wake.wait(lock);
+					else
+						_wake.wait_until(lock, next);
+					continue;
+				}
+
+				lock.unlock();
+				parallel_for(rounds.size(), _options.concurrency, [&](std::size_t i) { _poll(rounds[i]); });
+				lock.lock();
+				if (_stopped)
+					break;
+
+				std::vector<StatusChange> changes;
+				now = std::chrono::steady_clock::now();
+				for (Round &round : rounds)
+					_apply(round, now, changes);
+				if (changes.empty())
+					continue;
+				std::vector<ChangeHandler> subscribers;
+				for (const auto &s : _subscribers)
+					subscribers.push_back(s.second);
+				lock.unlock();
+				for (const StatusChange &change : changes)
+				{
+					for (const ChangeHandler &handler : subscribers)
+						handler(change);
+				}
+				lock.lock();
+			}
+		}
+
+		/**
+		 * Picks the containers of a daemon to poll: the ones due, then the ones due next to fill the last batch.
+		 * Lowers `next` to the earliest due time of the others.
+		 */
+		void _due(const Daemon &daemon, time_point now, Round &round, time_point &next)
+		{
+			std::vector<std::pair<time_point, const std::string *> > later;
+			for (const auto &w : daemon.watches)
+			{
+				if (w.second.due <= now)
+					_add(round, w.first, w.second);
+				else
+					later.push_back(std::make_pair(w.second.due, &w.first));
+			}
+			std::size_t room = round.keys.empty() ? 0 : (_options.batchSize - round.keys.size() % _options.batchSize) % _options.batchSize;
+			std::size_t fill = std::min(room, later.size());
+			std::partial_sort(later.begin(), later.begin() + fill, later.end());
+			for (std::size_t i = 0; i < later.size(); ++i)
+			{
+				if (i < fill)
+					_add(round, *later[i].second, daemon.watches.find(*later[i].second)->second);
+				else
+					next = std::min(next, later[i].first);
+			}
+		}
+
+		static void _add(Round &round, const std::string &key, const Watch &w)
+		{
+			round.keys.push_back(key);
+			round.lookup.push_back(w.id.empty() ? key : w.id);
+		}
+
+		// Looks the containers of a round up, by batches
+		void _poll(Round &round)
+		{
+			for (std::size_t start = 0; start < round.lookup.size(); start += _options.batchSize)
+			{
+				std::size_t end = std::min(start + _options.batchSize, round.lookup.size());
+				std::vector<std::string> batch(round.lookup.begin() + start, round.lookup.begin() + end);
+				ContainerList found;
+				_lookups.fetch_add(1, std::memory_order_relaxed);
+				round.error = round.docker->containerFind(batch, found);
+				if (!round.error.isOk())
+					return;
+				round.found.insert(round.found.end(), found.begin(), found.end());
+			}
+		}
+
+		void _apply(Round &round, time_point now, std::vector<StatusChange> &changes)
+		{
+			Daemon &daemon = _daemons[round.docker];
+			daemon.error = round.error;
+			for (std::size_t i = 0; i < round.keys.size(); ++i)
+			{
+				auto it = daemon.watches.find(round.keys[i]);
+				if (it == daemon.watches.end())
+					continue; // unwatched meanwhile
+				Watch &w = it->second;
+				if (!round.error.isOk())
+				{
+					w.due = now + w.interval;
+					continue;
+				}
+
+				ContainerStatus status;
+				const ContainerInfo &info = round.found[i];
+				status.state = info.id.empty() ? "removed" : info.state;
+				status.health = info.id.empty() ? HEALTH_NONE : parse_health(info.status);
+				if (status != w.status || w.status.state.empty())
+				{
+					changes.push_back(StatusChange{round.docker->uri(), round.keys[i], w.status, status});
+					w.status = status;
+					w.interval = _options.minInterval;
+				}
+				else
+				{
+					w.interval = std::min(w.interval * 2, _options.maxInterval);
+				}
+				if (status.health == HEALTH_STARTING || status.health == HEALTH_UNHEALTHY)
+					w.interval = _options.minInterval;
+				if (info.id.empty())
+				{
+					daemon.watches.erase(it);
+					continue;
+				}
+				w.id = info.id;
+				w.due = now + w.interval;
+			}
+		}
+
+		HealthMonitorOptions _options;
+		CancellationToken _token;
+		mutable std::mutex _mutex;
+		std::condition_variable _wake;
+		std::map<Docker<T> *, Daemon> _daemons;
+		std::map<std::size_t, ChangeHandler> _subscribers;
+		std::size_t _nextSubscription;
+		std::atomic<std::uint64_t> _lookups;
+		bool _stopped;
+		std::thread _poller;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_HEALTH_H
@@ -1,6 +1,11 @@
 #ifndef _DOCKER_HTTPSERVER_H
 #define _DOCKER_HTTPSERVER_H
 
+#include "docker_connection.h"
+#include "docker_deadline.h"
+#include "docker_metrics.h"
+#include "docker_stream.h"
+
 #include <asl/String.h>
 #include <asl/Http.h>
 
@@ -8,6 +13,9 @@
 #include <sstream>
 #include <map>
 
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
 //#include <type_traits>
 
@@ -61,57 +69,322 @@ namespace docker_cpp
 		return std::make_pair(std::move(fst), std::move(scd));
 	}
 
+	/// Percent-encodes a query parameter value
+	inline std::string url_encode(const std::string &value)
+	{
+		static const char hex[] = "0123456789ABCDEF";
+		std::string out;
+		out.reserve(value.size());
+		for (char c : value)
+		{
+			unsigned char u = static_cast<unsigned char>(c);
+			if (std::isalnum(u) || c == '-' || c == '_' || c == '.' || c == '~')
+			{
+				out += c;
+				continue;
+			}
+			out += '%';
+			out += hex[u >> 4];
+			out += hex[u & 0xf];
+		}
+		return out;
+	}
+
+	/// Value of a `since` or `until` parameter for a time in nanoseconds since the epoch ("seconds.nanoseconds")
+	inline std::string ns_timestamp_param(std::int64_t ns)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%lld.%09lld", static_cast<long long>(ns / 1000000000), static_cast<long long>(ns % 1000000000));
+		return text;
+	}
+
+	inline std::string body_string(const std::string &body) { return body; }
+	inline std::string body_string(const char *body) { return body; }
+	inline std::string body_string(const asl::String &body) { return *body; }
+
+	/**
+	 * Performs a request on a DockerConnection and wraps the result in an asl::HttpResponse.
+	 * The body is a std::string, or a StreamSource to stream it with chunked transfer encoding.
+	 * Successful bodies go to `sink` as they arrive (or into the response if `sink` is empty); error bodies
+	 * are always stored in the response so that their message can be read. I/O errors give a code of 0.
+	 */
+	template <typename Body>
+	asl::HttpResponse http_request(DockerConnection &conn, const std::string &method, const DockerUrl &url, const Body &body,
+								   const StreamSink &sink, const header_map &headers)
+	{
+		asl::HttpResponse res;
+		int code = 0;
+		bool aborted = false;
+		std::string data;
+		header_map responseHeaders;
+		bool ok = conn.request(url, method, body, headers, code, responseHeaders, [&](const char *p, std::size_t n) {
+			if (code >= 300 || !sink)
+			{
+				data.append(p, n);
+				return true;
+			}
+			aborted = !sink(p, n);
+			return !aborted;
+		});
+
+		res.setCode(ok || aborted ? code : 0);
+		for (auto &h : responseHeaders)
+			res.setHeader(h.first.c_str(), h.second.c_str());
+		if (!data.empty())
+			res.put(asl::ByteArray(reinterpret_cast<const byte *>(data.data()), static_cast<int>(data.size())));
+		return res;
+	}
+
+	template <typename Body>
+	asl::HttpResponse http_request(DockerConnection &conn, const std::string &method, const std::string &uri, const Body &body,
+								   const StreamSink &sink, const header_map &headers)
+	{
+		DockerUrl url;
+		if (!DockerUrl::parse(uri, url))
+		{
+			asl::HttpResponse res;
+			res.setCode(0);
+			return res;
+		}
+		return http_request(conn, method, url, body, sink, headers);
+	}
+
+	/**
+	 * Sends a request that hijacks `conn` for a raw bidirectional stream (attach, interactive exec).
+	 * On success the caller owns the raw stream on `conn`; error bodies are read into the response.
+	 */
+	inline asl::HttpResponse http_upgrade(DockerConnection &conn, const std::string &method, const std::string &uri, const std::string &body,
+										  const header_map &headers)
+	{
+		asl::HttpResponse res;
+		DockerUrl url;
+		int code = 0;
+		header_map responseHeaders;
+		if (!DockerUrl::parse(uri, url) || !conn.upgrade(url, method, body, headers, code, responseHeaders))
+		{
+			res.setCode(0);
+			return res;
+		}
+		res.setCode(code);
+		if (code >= 300)
+		{
+			std::string data;
+			conn.readBody(method, code, responseHeaders, append_to(data));
+			conn.close();
+			if (!data.empty())
+				res.put(asl::ByteArray(reinterpret_cast<const byte *>(data.data()), static_cast<int>(data.size())));
+		}
+		return res;
+	}
+
+	/**
+	 * Runs a request of a transport that cannot see inside the exchange, recording it in the operation being
+	 * measured on this thread (if any): the whole exchange counts as time to first byte.
+	 */
+	template <typename F>
+	asl::HttpResponse timed_response(F request)
+	{
+		RequestTimings *timings = current_request_timings();
+		if (!timings)
+			return request();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		asl::HttpResponse res = request();
+		timings->firstByteNs = elapsed_ns(start);
+		timings->status = res.code();
+		timings->bytes += static_cast<std::uint64_t>(res.body().length());
+		return res;
+	}
+
+	/// Response of a request that could not be sent or got no answer (code 0)
+	inline asl::HttpResponse no_response()
+	{
+		asl::HttpResponse res;
+		res.setCode(0);
+		return res;
+	}
+
+	/**
+	 * Base of the transports used by Docker<T> (CRTP).
+	 * A transport declares `static const bool thread_safe = true;` when one instance can serve concurrent calls;
+	 * only then can a Docker<T> object be shared between threads and run batch operations.
+	 * Requests are not sent once the deadline of the calling thread has passed or its call was cancelled (see CallScope).
+	 */
 	template <typename Derived>
 	struct DockerHttpInterface
 	{
+		static const bool thread_safe = false;
+
 		asl::HttpResponse get(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
+			if (call_interrupted()) return no_response();
 			return static_cast<Derived*>(this)->getImpl(uri, headers);
 		}
 
 		template <typename T>
 		asl::HttpResponse post(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
+			if (call_interrupted()) return no_response();
 			return static_cast<Derived*>(this)->postImpl(uri, body, headers);
 		}
 
 		template <typename T>
 		asl::HttpResponse put(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
+			if (call_interrupted()) return no_response();
 			return static_cast<Derived*>(this)->putImpl(uri, body, headers);
 		}
 
 		asl::HttpResponse delet(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
+			if (call_interrupted()) return no_response();
 			return static_cast<Derived*>(this)->deletImpl(uri, headers);
 		}
+
+		/**
+		 * Sends a request and hands the response body to `sink` as it arrives, for endpoints that stream
+		 * (exec/attach output, logs, events, pulls...). The returned response only carries the status code and,
+		 * for errors, the body.
+		 */
+		asl::HttpResponse stream(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			if (call_interrupted()) return no_response();
+			return static_cast<Derived*>(this)->streamImpl(method, uri, body, sink, headers);
+		}
+
+		/// Default streaming implementation: a dedicated connection for every call
+		asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			DockerConnection conn;
+			return http_request(conn, method, uri, body, sink, headers);
+		}
+
+		/**
+		 * Sends a request whose body is produced by `body` while it is sent (chunked transfer encoding), for uploads
+		 * too large to hold in memory such as build contexts, and hands the response body to `sink` as it arrives.
+		 */
+		asl::HttpResponse upload(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			if (call_interrupted()) return no_response();
+			return static_cast<Derived*>(this)->uploadImpl(method, uri, body, sink, headers);
+		}
+
+		/// Default upload implementation: a dedicated connection for every call
+		asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			DockerConnection conn;
+			return http_request(conn, method, uri, body, sink, headers);
+		}
+
+		/**
+		 * Sends a request that hijacks the connection (attach, interactive exec). On success `conn` carries the
+		 * raw stream and belongs to the caller.
+		 */
+		asl::HttpResponse upgrade(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			if (call_interrupted()) return no_response();
+			return static_cast<Derived*>(this)->upgradeImpl(method, uri, body, conn, headers);
+		}
+
+		/// Default upgrade implementation: hijacks a new connection
+		asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return http_upgrade(conn, method, uri, body, headers);
+		}
 	};
 
+	/// Transport based on asl::Http. Every request opens its own connection, so it is thread-safe.
 	struct ASLHttp : DockerHttpInterface<ASLHttp>
 	{
+		static const bool thread_safe = true;
+
 		asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
-			return asl::Http::get(asl::String(uri.c_str()));
+			return timed_response([&] { return asl::Http::get(asl::String(uri.c_str())); });
 		};
 		
 		template <typename T>
 		asl::HttpResponse postImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{ 
-			return asl::Http::post(asl::String(uri.c_str()), body);
+			return timed_response([&] { return asl::Http::post(asl::String(uri.c_str()), body); });
 		};
 
 		template <typename T>
 		asl::HttpResponse putImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{ 
-			return asl::Http::put(asl::String(uri.c_str()), body);
+			return timed_response([&] { return asl::Http::put(asl::String(uri.c_str()), body); });
 		};
 
 		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
 		{
-			return asl::Http::delet(asl::String(uri.c_str()));
+			return timed_response([&] { return asl::Http::delet(asl::String(uri.c_str())); });
 		};
 	};
 
+	/**
+	 * Transport that keeps HTTP/1.1 connections alive across requests and also talks to Unix sockets
+	 * ("unix:///var/run/docker.sock"). It is thread-safe: each concurrent call checks out its own connection
+	 * from a pool, so a single-threaded client reuses one connection and N threads use at most N.
+	 */
+	struct SocketHttp : DockerHttpInterface<SocketHttp>
+	{
+		static const bool thread_safe = true;
+
+		asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request("GET", uri, "", StreamSink(), headers);
+		}
+
+		template <typename T>
+		asl::HttpResponse postImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request("POST", uri, body_string(body), StreamSink(), headers);
+		}
+
+		template <typename T>
+		asl::HttpResponse putImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request("PUT", uri, body_string(body), StreamSink(), headers);
+		}
+
+		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request("DELETE", uri, "", StreamSink(), headers);
+		}
+
+		asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request(method, uri, body, sink, headers);
+		}
+
+		asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _request(method, uri, body, sink, headers);
+		}
+
+		/// Idle connections kept by the transport
+		std::size_t idleConnections() const { return _pool.idle(); }
+
+	private:
+		template <typename Body>
+		asl::HttpResponse _request(const std::string &method, const std::string &uri, const Body &body, const StreamSink &sink, const header_map &headers)
+		{
+			DockerUrl url;
+			if (!DockerUrl::parse(uri, url))
+			{
+				asl::HttpResponse res;
+				res.setCode(0);
+				return res;
+			}
+			std::unique_ptr<DockerConnection> conn = _pool.acquire(url);
+			asl::HttpResponse res = http_request(*conn, method, url, body, sink, headers);
+			_pool.release(std::move(conn));
+			return res;
+		}
+
+		ConnectionPool _pool;
+	};
+
 	typedef ASLHttp asl_interface;
+	typedef SocketHttp socket_interface;
 } // namespace docker_cpp
 #endif
\ No newline at end of file
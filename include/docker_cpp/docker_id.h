@@ -0,0 +1,162 @@
+#ifndef _DOCKER_ID_H
+#define _DOCKER_ID_H
+
+#include "export.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace docker_cpp
+{
+	/// Size in bytes of a docker object ID (a SHA-256 digest)
+	static const std::size_t ID_SIZE = 32;
+
+	/**
+	 * Converts `2 * size` hex digits (either case) to `size` bytes. Returns false on any other character.
+	 * Uses SSE2 when available, 16 digits at a time.
+	 */
+	DOCKER_CPP_API bool hex_decode(const char *hex, std::size_t size, unsigned char *out);
+	/// Writes the `2 * size` lowercase hex digits of `size` bytes
+	DOCKER_CPP_API void hex_encode(const unsigned char *data, std::size_t size, char *out);
+
+	/**
+	 * Leading hex digits of an ID ("8dfafdbc3a40"), as accepted by the daemon in place of a full ID.
+	 * Parsed once so that matching many IDs compares bytes instead of strings.
+	 */
+	class DOCKER_CPP_API IdPrefix
+	{
+	public:
+		IdPrefix() : _digits(0) { std::memset(_bytes, 0, sizeof(_bytes)); }
+		/// Parses up to 64 hex digits, with an optional "sha256:" prefix. Returns false if it is not hex
+		bool parse(const std::string &hex);
+
+		/// Number of hex digits
+		std::size_t digits() const { return _digits; }
+		/// True if the first `digits()` digits of the ID bytes match
+		bool matches(const unsigned char *id) const
+		{
+			std::size_t full = _digits / 2;
+			if (std::memcmp(id, _bytes, full) != 0) return false;
+			return _digits % 2 == 0 || (id[full] & 0xf0) == _bytes[full];
+		}
+		/// Bytes of the prefix; the low nibble of the last byte is zero for an odd number of digits
+		const unsigned char *bytes() const { return _bytes; }
+
+	private:
+		unsigned char _bytes[ID_SIZE];
+		std::size_t _digits;
+	};
+
+	struct ContainerInfo;
+
+	/**
+	 * True if `key` names the container as the daemon resolves it: a prefix of its ID, or one of its names (with or
+	 * without the leading '/'). Used by Docker::containerFind to match listed containers to the keys looked up.
+	 */
+	DOCKER_CPP_API bool container_matches(const ContainerInfo &info, const std::string &key);
+
+	/**
+	 * 256-bit docker object ID stored as 32 bytes: compared with memcmp, hashed in one load, and sorted in the same
+	 * order as its hex form. An all-zero ID stands for "no ID" (empty()).
+	 * The tag keeps container and image IDs apart; ImageId is formatted with its "sha256:" prefix.
+	 */
+	template <typename Tag>
+	class BasicId
+	{
+	public:
+		BasicId() { std::memset(_bytes, 0, sizeof(_bytes)); }
+
+		/// Parses 64 hex digits, with an optional "sha256:" prefix. Returns an empty ID on anything else (short IDs, names)
+		static BasicId fromHex(const std::string &hex)
+		{
+			BasicId id;
+			id.parse(hex);
+			return id;
+		}
+
+		/// Parses 64 hex digits, with an optional "sha256:" prefix. Leaves the ID empty and returns false on anything else
+		bool parse(const std::string &hex)
+		{
+			std::size_t skip = hex.compare(0, 7, "sha256:") == 0 ? 7 : 0;
+			if (hex.size() - skip == 2 * ID_SIZE && hex_decode(hex.data() + skip, ID_SIZE, _bytes))
+				return true;
+			std::memset(_bytes, 0, sizeof(_bytes));
+			return false;
+		}
+
+		/// 64 lowercase hex digits
+		std::string hex() const
+		{
+			char out[2 * ID_SIZE];
+			hex_encode(_bytes, ID_SIZE, out);
+			return std::string(out, sizeof(out));
+		}
+		/// Form used by the API: the hex digits, prefixed with "sha256:" for images
+		std::string str() const { return Tag::prefix() + hex(); }
+		/// First 12 hex digits, as shown by the docker CLI
+		std::string shortHex() const { return hex().substr(0, 12); }
+		/// Lets an ID be passed where the endpoint methods expect an ID or name
+		operator std::string() const { return str(); }
+
+		bool empty() const
+		{
+			static const unsigned char zero[ID_SIZE] = {0};
+			return std::memcmp(_bytes, zero, ID_SIZE) == 0;
+		}
+		bool matches(const IdPrefix &prefix) const { return prefix.matches(_bytes); }
+		const unsigned char *bytes() const { return _bytes; }
+
+		/// Leading 64 bits, a uniformly distributed hash for a SHA-256 ID
+		std::size_t hash() const
+		{
+			std::uint64_t h;
+			std::memcpy(&h, _bytes, sizeof(h));
+			return static_cast<std::size_t>(h);
+		}
+
+		bool operator==(const BasicId &o) const { return std::memcmp(_bytes, o._bytes, ID_SIZE) == 0; }
+		bool operator!=(const BasicId &o) const { return !(*this == o); }
+		bool operator<(const BasicId &o) const { return std::memcmp(_bytes, o._bytes, ID_SIZE) < 0; }
+
+	private:
+		unsigned char _bytes[ID_SIZE];
+	};
+
+	struct ContainerIdTag { static std::string prefix() { return std::string(); } };
+	struct ImageIdTag { static std::string prefix() { return "sha256:"; } };
+
+	typedef BasicId<ContainerIdTag> ContainerId;
+	typedef BasicId<ImageIdTag> ImageId;
+
+	/**
+	 * Range of the IDs of a sorted vector that start with `prefix`.
+	 * The daemon resolves a prefix only when exactly one ID matches; the range tells unique, ambiguous and unknown apart.
+	 */
+	template <typename Tag>
+	std::pair<typename std::vector<BasicId<Tag> >::const_iterator, typename std::vector<BasicId<Tag> >::const_iterator>
+	prefix_range(const std::vector<BasicId<Tag> > &sorted, const IdPrefix &prefix)
+	{
+		auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix, [](const BasicId<Tag> &id, const IdPrefix &p) {
+			return std::memcmp(id.bytes(), p.bytes(), ID_SIZE) < 0; // the matching IDs start at the zero-padded prefix
+		});
+		auto last = first;
+		while (last != sorted.end() && last->matches(prefix)) ++last;
+		return std::make_pair(first, last);
+	}
+} // namespace docker_cpp
+
+namespace std
+{
+	template <typename Tag>
+	struct hash<docker_cpp::BasicId<Tag> >
+	{
+		std::size_t operator()(const docker_cpp::BasicId<Tag> &id) const { return id.hash(); }
+	};
+} // namespace std
+
+#endif //_DOCKER_ID_H
@@ -0,0 +1,132 @@
+#ifndef _DOCKER_LABELS_H
+#define _DOCKER_LABELS_H
+
+#include "export.h"
+#include "docker_types.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace docker_cpp
+{
+	typedef std::vector<std::pair<std::string, std::string> > label_list;
+
+	/// One condition of a LabelSelector
+	struct DOCKER_CPP_API LabelRequirement
+	{
+		enum Op
+		{
+			EXISTS, //!< "key": the label is set, with any value
+			NOT_EXISTS, //!< "!key"
+			EQUALS, //!< "key=value"
+			NOT_EQUALS, //!< "key!=value": a different value, or no such label
+			IN, //!< "key in (a,b)"
+			NOT_IN, //!< "key notin (a,b)": none of the values, or no such label
+		};
+
+		std::string key;
+		Op op;
+		std::vector<std::string> values; //!< One value for EQUALS and NOT_EQUALS, the set for IN and NOT_IN
+	};
+
+	/**
+	 * Conjunction of label requirements, evaluated on the client.
+	 * The text form follows the Kubernetes selector syntax: "app=web,tier in (front,api),!deprecated,env!=prod".
+	 */
+	class DOCKER_CPP_API LabelSelector
+	{
+	public:
+		/// Parses a selector. Returns false on a syntax error
+		static bool parse(const std::string &text, LabelSelector &out);
+
+		LabelSelector &exists(const std::string &key);
+		LabelSelector &notExists(const std::string &key);
+		LabelSelector &equals(const std::string &key, const std::string &value);
+		LabelSelector &notEquals(const std::string &key, const std::string &value);
+		LabelSelector &in(const std::string &key, const std::vector<std::string> &values);
+		LabelSelector &notIn(const std::string &key, const std::vector<std::string> &values);
+
+		/// True if the labels satisfy every requirement (linear scan, for a single object)
+		bool matches(const label_list &labels) const;
+
+		const std::vector<LabelRequirement> &requirements() const { return _requirements; }
+		bool empty() const { return _requirements.empty(); }
+		std::string str() const;
+
+	private:
+		LabelSelector &_add(const std::string &key, LabelRequirement::Op op, const std::vector<std::string> &values);
+
+		std::vector<LabelRequirement> _requirements;
+	};
+
+	/**
+	 * Inverted index of the labels of a container or image list.
+	 * For every label key it keeps the sorted positions of the objects having it, overall and per value, so a selector
+	 * is answered by intersecting and subtracting the shortest position lists instead of scanning every object.
+	 * The index refers to positions in the list it was built from: rebuild it when the list is replaced.
+	 * Queries do not modify the index and can run concurrently.
+	 */
+	class DOCKER_CPP_API LabelIndex
+	{
+	public:
+		typedef std::vector<std::uint32_t> positions;
+
+		LabelIndex() : _size(0) {}
+		explicit LabelIndex(const ContainerList &containers) { build(containers); }
+		explicit LabelIndex(const ImageList &images) { build(images); }
+
+		void build(const ContainerList &containers);
+		void build(const ImageList &images);
+		/// Builds the index over the label lists of `count` objects, `labels(i)` giving those of object i
+		template <typename F>
+		void build(std::size_t count, F labels)
+		{
+			_clear(count);
+			for (std::size_t i = 0; i < count; ++i)
+				_add(static_cast<std::uint32_t>(i), labels(i));
+		}
+
+		/// Number of indexed objects
+		std::size_t size() const { return _size; }
+
+		/// Positions, in increasing order, of the objects matching the selector
+		void select(const LabelSelector &selector, positions &out) const;
+		std::size_t count(const LabelSelector &selector) const;
+
+		/// Distinct values of a label key, with the number of objects having each
+		std::vector<std::pair<std::string, std::size_t> > values(const std::string &key) const;
+
+		/// Objects of `list` (the list the index was built from) matching the selector
+		template <typename T>
+		std::vector<const T *> select(const std::vector<T> &list, const LabelSelector &selector) const
+		{
+			positions p;
+			select(selector, p);
+			std::vector<const T *> out;
+			out.reserve(p.size());
+			for (std::uint32_t i : p)
+				out.push_back(&list[i]);
+			return out;
+		}
+
+	private:
+		struct KeyPostings
+		{
+			positions all;
+			std::unordered_map<std::string, positions> byValue;
+		};
+
+		void _clear(std::size_t size);
+		void _add(std::uint32_t position, const label_list &labels);
+		const positions *_postings(const std::string &key, const std::string *value) const;
+		void _union(const LabelRequirement &r, positions &out) const;
+
+		std::unordered_map<std::string, KeyPostings> _keys;
+		std::size_t _size;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_LABELS_H
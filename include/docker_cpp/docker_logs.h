@@ -0,0 +1,388 @@
+#ifndef _DOCKER_LOGS_H
+#define _DOCKER_LOGS_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_error.h"
+#include "docker_deadline.h"
+#include "docker_stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace docker_cpp
+{
+	template <typename T>
+	class Docker;
+
+	/**
+	 * Parses an RFC 3339 timestamp ("2020-01-02T03:04:05.123456789Z", or with a "+hh:mm" offset) as the daemon writes
+	 * it in front of log lines.
+	 * @param [in,out] ns Nanoseconds since the UNIX epoch
+	 * @returns false if the text is not a timestamp
+	 */
+	DOCKER_CPP_API bool parse_timestamp(const char *text, std::size_t size, std::int64_t &ns);
+
+	/**
+	 * Position in the log of a container: the timestamp of the last line delivered and how many lines were delivered
+	 * with that exact timestamp. The `since` of the daemon is inclusive, so the lines at the timestamp of a cursor
+	 * come again when a follower resumes from it: the first `count` of them are dropped.
+	 * Cursors are small values, meant to be saved along with the lines they follow.
+	 */
+	struct DOCKER_CPP_API LogCursor
+	{
+		std::int64_t timestamp = 0; //!< Nanoseconds since the UNIX epoch of the last line (0: the start of the log)
+		std::uint32_t count = 0; //!< Lines delivered with that timestamp
+
+		bool empty() const { return timestamp == 0; }
+		/// The `since` parameter of a logs request resuming at this cursor ("seconds.nanoseconds")
+		std::string since() const;
+	};
+
+	/// A line of a LogBatch
+	struct DOCKER_CPP_API LogEntry
+	{
+		std::int64_t timestamp; //!< Nanoseconds since the UNIX epoch (0 if the line had no timestamp)
+		std::uint32_t offset; //!< Position of the text in LogBatch::data
+		std::uint32_t size; //!< Bytes of text, without the timestamp and the line end
+		std::uint8_t stream; //!< StreamDemuxer::STDOUT or StreamDemuxer::STDERR
+	};
+
+	/// Consecutive lines of the log of a container, with their text packed in one buffer
+	struct DOCKER_CPP_API LogBatch
+	{
+		std::string container; //!< ID or name the container was followed by
+		std::string data; //!< Text of the lines, one after the other
+		std::vector<LogEntry> entries;
+		LogCursor cursor; //!< Position after the last line of the batch, to save once the batch is processed
+
+		std::string text(const LogEntry &entry) const { return data.substr(entry.offset, entry.size); }
+		/// Memory taken by the batch, as counted by LogQueue
+		std::size_t bytes() const { return data.size() + entries.size() * sizeof(LogEntry); }
+	};
+
+	/**
+	 * Bounded queue of log batches between followers and a consumer.
+	 * push() blocks while the queue holds `capacity` bytes or more. A slow consumer then stops the followers from
+	 * reading their connections, and the daemon is held back by TCP flow control instead of the client's memory
+	 * growing. An empty queue always accepts a batch, whatever its size.
+	 */
+	class DOCKER_CPP_API LogQueue
+	{
+	public:
+		explicit LogQueue(std::size_t capacity = 8 * 1024 * 1024) : _capacity(capacity), _bytes(0), _closed(false) {}
+		LogQueue(const LogQueue &) = delete;
+		LogQueue &operator=(const LogQueue &) = delete;
+
+		/**
+		 * Adds a batch, waiting for room.
+		 * @returns false if the queue is closed or the calls of this thread were interrupted (see CallScope), the
+		 * batch is then dropped
+		 */
+		bool push(LogBatch &&batch);
+
+		/**
+		 * Moves the oldest batches to `out` (appended), waiting up to `timeout` for the first one.
+		 * @returns The number of batches moved, 0 on timeout or once the queue is closed and empty
+		 */
+		std::size_t pop(std::vector<LogBatch> &out, std::size_t max = 64, std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+		/// Wakes up the threads blocked in push(), so they notice that their calls were cancelled
+		void interrupt();
+		/// Refuses new batches and wakes up every waiting thread. The queued batches can still be popped
+		void close();
+		bool closed() const;
+
+		/// Batches queued
+		std::size_t size() const;
+		/// Bytes queued
+		std::size_t bytes() const;
+		std::size_t capacity() const { return _capacity; }
+
+	private:
+		mutable std::mutex _mutex;
+		std::condition_variable _notFull;
+		std::condition_variable _notEmpty;
+		std::deque<LogBatch> _batches;
+		std::size_t _capacity;
+		std::size_t _bytes;
+		bool _closed;
+	};
+
+	/**
+	 * Turns the output of a logs request made with timestamps into LogBatches.
+	 * The stream is demultiplexed unless its first byte shows the raw output of a container with a TTY. Lines are
+	 * split with LineSplitter and their timestamps parsed. The lines a resumed cursor has already delivered are
+	 * dropped, and the cursor is moved past every line delivered. A batch is handed over at the end of every feed()
+	 * call, or earlier when it is full, so lines are not held back while the stream is idle.
+	 */
+	class DOCKER_CPP_API LogParser
+	{
+	public:
+		/// Receives a batch, which it can move from. Return false to stop the transfer: the batch then counts as not delivered
+		typedef std::function<bool(LogBatch &batch)> BatchHandler;
+
+		/**
+		 * @param [in] container Name set on the batches
+		 * @param [in,out] cursor Where the request resumed; moved past the lines delivered
+		 * @param [in] onBatch Receives the batches
+		 * @param [in] batchLines Most lines in a batch
+		 * @param [in] batchBytes Most bytes of text in a batch (a longer line still makes a batch of its own)
+		 */
+		LogParser(const std::string &container, LogCursor &cursor, const BatchHandler &onBatch, std::size_t batchLines = 512, std::size_t batchBytes = 64 * 1024);
+		LogParser(const LogParser &) = delete;
+		LogParser &operator=(const LogParser &) = delete;
+
+		/**
+		 * Processes the next bytes of the stream.
+		 * @returns false if the handler asked to stop or the stream is malformed
+		 */
+		bool feed(const char *data, std::size_t size);
+		/// Delivers the last lines if the stream did not end with a line break
+		bool finish();
+		/// A StreamSink that feeds this parser
+		StreamSink sink() { return [this](const char *data, std::size_t size) { return feed(data, size); }; }
+
+		/// Lines delivered so far
+		std::size_t lines() const { return _lines; }
+
+	private:
+		bool _line(std::uint8_t stream, const char *line, std::size_t size);
+		bool _flush();
+
+		std::string _container;
+		LogCursor &_cursor;
+		BatchHandler _onBatch;
+		std::size_t _batchLines;
+		std::size_t _batchBytes;
+		LogBatch _batch;
+		LogCursor _pending; //!< Cursor after the lines of _batch, which becomes _cursor once the batch is delivered
+		std::int64_t _skipAt; //!< Timestamp of the lines already delivered before the request
+		std::uint32_t _skip; //!< Lines at _skipAt still to drop
+		std::size_t _lines;
+		LineSplitter _out;
+		LineSplitter _err;
+		std::unique_ptr<StreamDemuxer> _demux; //!< Created on the first byte
+	};
+
+	struct DOCKER_CPP_API LogFollowOptions
+	{
+		bool stdOut = true; //!< Follow the standard output
+		bool stdErr = true; //!< Follow the standard error
+		std::string tail = "all"; //!< Lines of history sent first for a container followed without a cursor ("all" or a number)
+		std::size_t batchLines = 512; //!< Most lines in a batch
+		std::size_t batchBytes = 64 * 1024; //!< Most bytes of text in a batch
+		std::chrono::milliseconds retryDelay = std::chrono::milliseconds(250); //!< Wait before reconnecting after a request ended
+		std::chrono::milliseconds maxRetryDelay = std::chrono::seconds(30); //!< The wait doubles up to this while reconnections bring no lines
+	};
+
+	/**
+	 * Follows the logs of many containers into a LogQueue, one thread and one streaming request per container.
+	 * Each container has a LogCursor. When a request ends (daemon restart, network failure, stopped container), the
+	 * follower reconnects with `since` set to the cursor, so no history is downloaded again and no line is delivered
+	 * twice. A container is followed until it is removed (its request fails with not found), stop() is called or the
+	 * queue is closed.
+	 * While the queue is full the threads stop reading, which holds back the daemon (see LogQueue).
+	 * The lines must carry timestamps, so the follower always requests them. The transport must be thread-safe;
+	 * SocketHttp also lets stop() interrupt a request at once.
+	 * @code
+	 * LogQueue queue(16 * 1024 * 1024);
+	 * LogFollower<SocketHttp> follower(docker, queue);
+	 * follower.follow("web1", saved["web1"]);
+	 * std::vector<LogBatch> batches;
+	 * while (queue.pop(batches) > 0 || !queue.closed()) { ship(batches); for (auto &b : batches) saved[b.container] = b.cursor; batches.clear(); }
+	 * @endcode
+	 */
+	template <typename T>
+	class LogFollower
+	{
+		static_assert(T::thread_safe, "A log follower needs a thread-safe transport (T::thread_safe)");
+
+	public:
+		LogFollower(Docker<T> &docker, LogQueue &queue, const LogFollowOptions &options = LogFollowOptions())
+			: _docker(docker), _queue(queue), _options(options)
+		{
+		}
+
+		~LogFollower() { stopAll(); }
+		LogFollower(const LogFollower &) = delete;
+		LogFollower &operator=(const LogFollower &) = delete;
+
+		/**
+		 * Starts following a container.
+		 * @param [in] id ID or name of the container
+		 * @param [in] from Where to resume. Without a cursor the log starts with the last `tail` lines
+		 * @returns false if the container is already followed
+		 */
+		bool follow(const std::string &id, const LogCursor &from = LogCursor())
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::unique_ptr<Follow> &f = _follows[id];
+			if (f)
+			{
+				if (!f->done)
+					return false;
+				f->thread.join();
+			}
+			f.reset(new Follow());
+			f->token = CancellationToken::create();
+			f->cursor = from;
+			Follow *follow = f.get();
+			f->thread = std::thread([this, id, follow, from] { _run(id, follow, from); });
+			return true;
+		}
+
+		/// Stops following a container, and waits for its thread. Its last cursor stays available
+		void stop(const std::string &id)
+		{
+			std::unique_ptr<Follow> f;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				auto it = _follows.find(id);
+				if (it == _follows.end())
+					return;
+				f.swap(it->second);
+				_follows.erase(it);
+			}
+			_join(*f);
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopped[id] = f->cursor;
+		}
+
+		/// Stops following every container
+		void stopAll()
+		{
+			std::map<std::string, std::unique_ptr<Follow> > follows;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				follows.swap(_follows);
+			}
+			for (auto &f : follows)
+				f.second->token.cancel();
+			_queue.interrupt();
+			for (auto &f : follows)
+			{
+				if (f.second->thread.joinable())
+					f.second->thread.join();
+			}
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto &f : follows)
+				_stopped[f.first] = f.second->cursor;
+		}
+
+		/// True while the container is followed: stop() was not called, it was not removed and the queue is open
+		bool following(const std::string &id) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _follows.find(id);
+			return it != _follows.end() && !it->second->done;
+		}
+
+		/// Cursor after the last batch of the container pushed to the queue
+		LogCursor cursor(const std::string &id) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _follows.find(id);
+			if (it != _follows.end())
+				return it->second->cursor;
+			auto stopped = _stopped.find(id);
+			return stopped != _stopped.end() ? stopped->second : LogCursor();
+		}
+
+		/// Cursors of every container followed so far
+		std::map<std::string, LogCursor> cursors() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::map<std::string, LogCursor> out = _stopped;
+			for (const auto &f : _follows)
+				out[f.first] = f.second->cursor;
+			return out;
+		}
+
+		/// Result of the last request for the logs of the container
+		DockerError error(const std::string &id) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it = _follows.find(id);
+			return it != _follows.end() ? it->second->error : DockerError::D_OK();
+		}
+
+	private:
+		struct Follow
+		{
+			CancellationToken token;
+			std::thread thread;
+			LogCursor cursor; //!< Cursor of the last batch pushed
+			DockerError error = DockerError::D_OK();
+			bool done = false;
+		};
+
+		void _join(Follow &f)
+		{
+			f.token.cancel();
+			_queue.interrupt();
+			if (f.thread.joinable())
+				f.thread.join();
+		}
+
+		void _run(const std::string &id, Follow *f, LogCursor cursor)
+		{
+			CallScope scope(f->token);
+			std::chrono::milliseconds delay = _options.retryDelay;
+			while (!call_interrupted())
+			{
+				LogParser parser(id, cursor, [&](LogBatch &batch) {
+					LogCursor end = batch.cursor;
+					if (!_queue.push(std::move(batch)))
+						return false;
+					std::lock_guard<std::mutex> lock(_mutex);
+					f->cursor = end;
+					return true;
+				}, _options.batchLines, _options.batchBytes);
+
+				LogOptions options;
+				options.follow = true;
+				options.timestamps = true;
+				options.stdOut = _options.stdOut;
+				options.stdErr = _options.stdErr;
+				options.since = cursor.empty() ? std::string() : cursor.since();
+				options.tail = cursor.empty() ? _options.tail : "all";
+				DockerError err = _docker.containerLogs(id, options, parser.sink());
+				// A request closed by the daemon ended the log; otherwise its last line may be cut and comes again
+				if (err.isOk())
+					parser.finish();
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					f->error = err;
+				}
+				// A closed queue refuses the batches of any new request
+				if (err.isNotFound() || _queue.closed() || call_interrupted())
+					break;
+				delay = parser.lines() > 0 ? _options.retryDelay : std::min(delay * 2, _options.maxRetryDelay);
+				if (!call_sleep(delay))
+					break;
+			}
+			std::lock_guard<std::mutex> lock(_mutex);
+			f->done = true;
+		}
+
+		Docker<T> &_docker;
+		LogQueue &_queue;
+		LogFollowOptions _options;
+		mutable std::mutex _mutex;
+		std::map<std::string, std::unique_ptr<Follow> > _follows;
+		std::map<std::string, LogCursor> _stopped; //!< Last cursors of the containers no longer followed
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_LOGS_H
@@ -0,0 +1,199 @@
+#ifndef _DOCKER_METRICS_H
+#define _DOCKER_METRICS_H
+
+#include "export.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace docker_cpp
+{
+	/// Logical operations of the Docker client, as recorded by DockerMetrics
+	enum DockerOperation
+	{
+		OP_VERSION,
+		OP_PING,
+		OP_IMAGE_LIST,
+		OP_IMAGE_CREATE,
+		OP_IMAGE_TAG,
+		OP_IMAGE_REMOVE,
+		OP_IMAGE_PRUNE,
+		OP_IMAGE_BUILD,
+		OP_IMAGE_EXPORT,
+		OP_IMAGE_LOAD,
+		OP_CONTAINER_LIST,
+		OP_CONTAINER_START,
+		OP_CONTAINER_STOP,
+		OP_CONTAINER_RESTART,
+		OP_CONTAINER_KILL,
+		OP_CONTAINER_RENAME,
+		OP_CONTAINER_PAUSE,
+		OP_CONTAINER_UNPAUSE,
+		OP_CONTAINER_WAIT,
+		OP_CONTAINER_REMOVE,
+		OP_CONTAINER_ARCHIVE_INFO,
+		OP_CONTAINER_ARCHIVE_GET,
+		OP_CONTAINER_ARCHIVE_PUT,
+		OP_CONTAINER_LOGS,
+		OP_EVENTS,
+		OP_EXEC_CREATE,
+		OP_EXEC_START,
+		OP_EXEC_RESIZE,
+		OP_EXEC_INSPECT,
+		OP_COUNT
+	};
+
+	/// Name of an operation, as the method of Docker (e.g. "containerList")
+	DOCKER_CPP_API const char *operation_name(DockerOperation op);
+
+	/**
+	 * Timings of one request, filled by the transport and the parser while an instrumented operation runs.
+	 * Durations are in nanoseconds; -1 means the value is unknown to the transport.
+	 */
+	struct DOCKER_CPP_API RequestTimings
+	{
+		std::int64_t connectNs = -1; //!< Connection setup (only when a new connection was opened)
+		std::int64_t firstByteNs = -1; //!< From sending the request to receiving the response head
+		std::int64_t transferNs = -1; //!< Reading the response body
+		std::int64_t parseNs = -1; //!< Decoding the body into the result structures
+		std::uint64_t bytes = 0; //!< Response body bytes
+		int status = 0; //!< HTTP status code (0 if the request failed)
+	};
+
+	/**
+	 * Timings slot of the operation running on the calling thread, or null when nothing is being recorded.
+	 * Transports check it once per request, so recording is free when metrics are disabled.
+	 */
+	DOCKER_CPP_API RequestTimings *&current_request_timings();
+
+	inline std::int64_t elapsed_ns(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	/**
+	 * Lock-free log-linear histogram of non-negative values (8 buckets per power of two, under 12.5% error).
+	 * Recording is a few relaxed atomic increments, so it can be shared by any number of threads.
+	 */
+	class DOCKER_CPP_API LatencyHistogram
+	{
+	public:
+		static const int SUB_BITS = 3;
+		static const int SUB_BUCKETS = 1 << SUB_BITS;
+		static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+		LatencyHistogram() { reset(); }
+		LatencyHistogram(const LatencyHistogram &) = delete;
+		LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+		void record(std::uint64_t value);
+		void reset();
+
+		std::uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+		std::uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+		std::uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+		double mean() const { return count() ? double(sum()) / double(count()) : 0.0; }
+		/// Approximate value below which a fraction q (0..1) of the samples fall
+		std::uint64_t percentile(double q) const;
+
+		static int bucket(std::uint64_t value);
+		static std::uint64_t bucketLow(int bucket);
+
+	private:
+		std::atomic<std::uint64_t> _buckets[BUCKETS];
+		std::atomic<std::uint64_t> _count;
+		std::atomic<std::uint64_t> _sum;
+		std::atomic<std::uint64_t> _max;
+	};
+
+	/// Everything recorded for one operation
+	struct DOCKER_CPP_API OperationMetrics
+	{
+		LatencyHistogram total; //!< Wall time of the whole operation
+		LatencyHistogram connect;
+		LatencyHistogram firstByte;
+		LatencyHistogram transfer;
+		LatencyHistogram parse;
+		std::atomic<std::uint64_t> bytes; //!< Response bytes received
+		std::atomic<std::uint64_t> status[6]; //!< Responses by status class: [0] failed requests, [1] 1xx ... [5] 5xx
+
+		OperationMetrics() : bytes(0) { for (auto &s : status) s = 0; }
+		void reset();
+	};
+
+	/**
+	 * Per-operation latency and throughput metrics of a Docker client (see Docker::setMetrics).
+	 * Thread-safe; one instance can be shared by several clients.
+	 */
+	class DOCKER_CPP_API DockerMetrics
+	{
+	public:
+		void record(DockerOperation op, const RequestTimings &timings, std::int64_t totalNs);
+		const OperationMetrics &operation(DockerOperation op) const { return _ops[op]; }
+		void reset();
+
+		/**
+		 * Exports the operations that recorded something as JSON:
+		 * {"containerList":{"count":..,"bytes":..,"status":{"2xx":..},"total_ns":{"mean":..,"p50":..,"p90":..,"p99":..,"max":..},...},...}
+		 */
+		std::string toJson() const;
+
+	private:
+		OperationMetrics _ops[OP_COUNT];
+	};
+
+	/**
+	 * Records one operation in a DockerMetrics object (if any) for the lifetime of the scope.
+	 * Nested scopes (an operation calling another one) record separately.
+	 */
+	class OperationScope
+	{
+	public:
+		OperationScope(DockerMetrics *metrics, DockerOperation op) : _metrics(metrics), _op(op), _outer(nullptr)
+		{
+			if (!_metrics) return;
+			_start = std::chrono::steady_clock::now();
+			_outer = current_request_timings();
+			current_request_timings() = &_timings;
+		}
+
+		~OperationScope()
+		{
+			if (!_metrics) return;
+			current_request_timings() = _outer;
+			_metrics->record(_op, _timings, elapsed_ns(_start));
+		}
+
+		OperationScope(const OperationScope &) = delete;
+		OperationScope &operator=(const OperationScope &) = delete;
+
+	private:
+		DockerMetrics *_metrics;
+		DockerOperation _op;
+		RequestTimings _timings;
+		RequestTimings *_outer;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	/// Measures the parse time of the operation running on this thread (if it is being recorded)
+	class ParseTimer
+	{
+	public:
+		ParseTimer() : _timings(current_request_timings())
+		{
+			if (_timings) _start = std::chrono::steady_clock::now();
+		}
+		~ParseTimer()
+		{
+			if (_timings) _timings->parseNs = elapsed_ns(_start);
+		}
+
+	private:
+		RequestTimings *_timings;
+		std::chrono::steady_clock::time_point _start;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_METRICS_H
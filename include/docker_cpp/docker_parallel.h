@@ -0,0 +1,43 @@
+#ifndef _DOCKER_PARALLEL_H
+#define _DOCKER_PARALLEL_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+namespace docker_cpp
+{
+	const unsigned int DOCKER_DEFAULT_CONCURRENCY = 8; //!< Default number of requests in flight for batch operations
+
+	/**
+	 * Calls f(i) for every i in [0, n) using at most `concurrency` threads (the calling thread included).
+	 * Indexes are handed out one at a time, so a slow call never holds back the remaining work.
+	 * @param [in] n Number of work items
+	 * @param [in] concurrency Maximum number of items processed at the same time (0 is treated as 1)
+	 * @param [in] f Callable invoked as f(std::size_t)
+	 */
+	template <typename F>
+	void parallel_for(std::size_t n, unsigned int concurrency, F f)
+	{
+		if (n == 0) return;
+		std::size_t workers = concurrency == 0 ? 1 : concurrency;
+		if (workers > n) workers = n;
+
+		std::atomic<std::size_t> next(0);
+		auto work = [&next, n, &f]() {
+			for (std::size_t i = next++; i < n; i = next++)
+				f(i);
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers - 1);
+		for (std::size_t w = 1; w < workers; ++w)
+			threads.emplace_back(work);
+		work();
+		for (auto &t : threads)
+			t.join();
+	}
+} // namespace docker_cpp
+
+#endif //_DOCKER_PARALLEL_H
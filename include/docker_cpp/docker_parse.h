@@ -12,12 +12,18 @@ namespace docker_cpp
     void parse(const asl::Var &in, ImageList &out);
     void parse(const asl::Var &in, DeletedImageList &out);
     void parse(const asl::Var &in, PruneInfo &out);
+    void parse(const asl::Var &in, BuildMessage &out);
     void parse(const asl::Var &in, ContainerList &out);
     void parse(const asl::Var &in, Port &out);
     void parse(const asl::Var &in, NetworkSettings &out);
     void parse(const asl::Var &in, VersionInfo &out);
     void parse(const asl::Var &in, WaitInfo &out);
+    void parse(const asl::Var &in, EventMessage &out);
     void parse(const asl::Var &in, ExecInfo &out);
+    void parse(const asl::Var &in, PathStat &out);
+
+    /// Decodes the X-Docker-Container-Path-Stat header of the archive endpoints (base64 of a JSON object)
+    bool parse_path_stat(const std::string &header, PathStat &out);
 } // namespace docker_cpp
 
 
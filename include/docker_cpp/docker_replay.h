@@ -0,0 +1,249 @@
+#ifndef _DOCKER_REPLAY_H
+#define _DOCKER_REPLAY_H
+
+#include "export.h"
+#include "docker_http.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace docker_cpp
+{
+	/// One request/response exchange captured by RecordingHttp
+	struct DOCKER_CPP_API RecordedExchange
+	{
+		std::uint64_t offsetNs = 0; //!< Start of the request since the recording started
+		std::uint64_t durationNs = 0; //!< Time until the whole response was received
+		int code = 0; //!< Response status code (0 if the request failed)
+		std::string method;
+		std::string path; //!< Path and query, without scheme and daemon address
+		std::string request; //!< Request body
+		std::string response; //!< Response body (streamed bodies included)
+	};
+
+	/**
+	 * Thread-safe list of recorded exchanges, saved in a compact binary file:
+	 * "DKRL", u32 version, then for every exchange u64 offsetNs, u64 durationNs, i32 code and the method, path,
+	 * request and response as u32 length + bytes. Integers are little-endian.
+	 */
+	class DOCKER_CPP_API ExchangeLog
+	{
+	public:
+		void add(const RecordedExchange &exchange);
+		std::vector<RecordedExchange> exchanges() const;
+		std::size_t size() const;
+		void clear();
+
+		bool save(const std::string &path) const;
+		/// Replaces the contents with the file. Returns false if it is missing or not a valid log
+		bool load(const std::string &path);
+
+		/// Path of a request URI as recorded: "http://host:2375/v1.40/_ping" -> "/v1.40/_ping"
+		static std::string relativePath(const std::string &uri);
+
+	private:
+		mutable std::mutex _mutex;
+		std::vector<RecordedExchange> _exchanges;
+	};
+
+	/// Body of a response as a string
+	inline std::string response_body(const asl::HttpResponse &res)
+	{
+		const asl::ByteArray &body = res.body();
+		return std::string(reinterpret_cast<const char *>(body.ptr()), static_cast<std::size_t>(body.length()));
+	}
+
+	/**
+	 * Transport decorator that records every exchange of the transport T, with its timing, in an ExchangeLog.
+	 * Hijacked connections (upgrade) are passed through and only their status code is recorded.
+	 * Thread-safe when T is.
+	 */
+	template <typename T>
+	struct RecordingHttp : DockerHttpInterface<RecordingHttp<T> >
+	{
+		static const bool thread_safe = T::thread_safe;
+
+		RecordingHttp() : _start(std::chrono::steady_clock::now()) {}
+
+		asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _record("GET", uri, std::string(), [&] { return _net.get(uri, headers); });
+		}
+
+		template <typename U>
+		asl::HttpResponse postImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _record("POST", uri, body_string(body), [&] { return _net.post(uri, body, headers); });
+		}
+
+		template <typename U>
+		asl::HttpResponse putImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _record("PUT", uri, body_string(body), [&] { return _net.put(uri, body, headers); });
+		}
+
+		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _record("DELETE", uri, std::string(), [&] { return _net.delet(uri, headers); });
+		}
+
+		asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			std::string data;
+			StreamSink tee = [&data, &sink](const char *p, std::size_t n) {
+				data.append(p, n);
+				return !sink || sink(p, n);
+			};
+			return _record(method, uri, body, [&] { return _net.stream(method, uri, body, tee, headers); }, &data);
+		}
+
+		/// The streamed request body is not recorded
+		asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			std::string data;
+			StreamSink tee = [&data, &sink](const char *p, std::size_t n) {
+				data.append(p, n);
+				return !sink || sink(p, n);
+			};
+			return _record(method, uri, std::string(), [&] { return _net.upload(method, uri, body, tee, headers); }, &data);
+		}
+
+		asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _record(method, uri, body, [&] { return _net.upgrade(method, uri, body, conn, headers); });
+		}
+
+		ExchangeLog &log() { return _log; }
+		/// Recorded transport
+		T &transport() { return _net; }
+		/// Restarts the recording: clears the log and the time origin
+		void restart()
+		{
+			_log.clear();
+			_start = std::chrono::steady_clock::now();
+		}
+
+	private:
+		template <typename F>
+		asl::HttpResponse _record(const std::string &method, const std::string &uri, const std::string &body, F request, const std::string *streamed = nullptr)
+		{
+			typedef std::chrono::steady_clock clock;
+			clock::time_point t0 = clock::now();
+			asl::HttpResponse res = request();
+			clock::time_point t1 = clock::now();
+
+			RecordedExchange e;
+			e.offsetNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t0 - _start).count());
+			e.durationNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+			e.code = res.code();
+			e.method = method;
+			e.path = ExchangeLog::relativePath(uri);
+			e.request = body;
+			e.response = streamed && res.code() < 300 ? *streamed : response_body(res);
+			_log.add(e);
+			return res;
+		}
+
+		T _net;
+		ExchangeLog _log;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	/**
+	 * Transport that serves the exchanges of an ExchangeLog instead of talking to a daemon, to replay a recorded
+	 * workload offline. Every request gets the next unused exchange with the same method and path, so concurrent
+	 * or reordered calls still find their responses; requests that were not recorded fail with code 0.
+	 * Responses are delayed by their recorded duration divided by the speed (0, the default, serves them at once).
+	 * Hijacked connections cannot be replayed.
+	 */
+	struct DOCKER_CPP_API ReplayHttp : DockerHttpInterface<ReplayHttp>
+	{
+		static const bool thread_safe = true;
+
+		ReplayHttp() : _speed(0), _misses(0) {}
+
+		/// Loads the exchanges to serve, replacing the previous ones
+		void load(const ExchangeLog &log);
+		bool load(const std::string &path);
+		/// 1 replays at the recorded speed, 10 ten times faster, 0 without delays
+		void setSpeed(double speed) { _speed = speed; }
+		/// Requests that found no recorded exchange
+		std::size_t misses() const;
+		/// Exchanges not served yet
+		std::size_t remaining() const;
+
+		asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay("GET", uri, StreamSink());
+		}
+
+		template <typename U>
+		asl::HttpResponse postImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay("POST", uri, StreamSink());
+		}
+
+		template <typename U>
+		asl::HttpResponse putImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay("PUT", uri, StreamSink());
+		}
+
+		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay("DELETE", uri, StreamSink());
+		}
+
+		asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay(method, uri, sink);
+		}
+
+		asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _replay(method, uri, sink);
+		}
+
+		asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			asl::HttpResponse res;
+			res.setCode(0);
+			return res;
+		}
+
+	private:
+		bool _next(const std::string &method, const std::string &uri, RecordedExchange &exchange);
+
+		asl::HttpResponse _replay(const std::string &method, const std::string &uri, const StreamSink &sink)
+		{
+			asl::HttpResponse res;
+			RecordedExchange e;
+			if (!_next(method, uri, e))
+			{
+				res.setCode(0);
+				return res;
+			}
+			if (_speed > 0)
+				std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<std::int64_t>(e.durationNs / _speed)));
+			res.setCode(e.code);
+			if (sink && e.code < 300)
+				sink(e.response.data(), e.response.size());
+			else if (!e.response.empty())
+				res.put(asl::ByteArray(reinterpret_cast<const byte *>(e.response.data()), static_cast<int>(e.response.size())));
+			return res;
+		}
+
+		mutable std::mutex _mutex;
+		std::map<std::string, std::deque<RecordedExchange> > _queues;
+		double _speed;
+		std::size_t _misses;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_REPLAY_H
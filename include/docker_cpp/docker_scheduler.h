@@ -0,0 +1,225 @@
+#ifndef _DOCKER_SCHEDULER_H
+#define _DOCKER_SCHEDULER_H
+
+#include "export.h"
+#include "docker_http.h"
+#include "docker_metrics.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace docker_cpp
+{
+	/// Priority classes of the requests sent through a RequestScheduler, from the most urgent
+	enum RequestPriority
+	{
+		PRIORITY_HEALTH, //!< ping, version, info: health checks must answer while the daemon is busy
+		PRIORITY_CONTROL, //!< Lists, inspects, container and exec operations
+		PRIORITY_BULK, //!< Pulls, builds, image loads and exports, removals, prunes, archives
+		PRIORITY_COUNT
+	};
+
+	/// Name of a priority class ("health", "control", "bulk")
+	DOCKER_CPP_API const char *priority_name(RequestPriority priority);
+
+	/// Priority class of a request, from its method and URI (with or without a version prefix)
+	DOCKER_CPP_API RequestPriority request_priority(const std::string &method, const std::string &uri);
+
+	/**
+	 * True for requests that stay open until something happens on the daemon: container waits, followed logs,
+	 * streamed stats, events, attaches and exec starts. They are not scheduled, since holding a slot for that long would
+	 * starve the other requests.
+	 */
+	DOCKER_CPP_API bool request_long_lived(const std::string &method, const std::string &uri);
+
+	/**
+	 * Gives the requests of this thread a priority class of their own during its lifetime, rather than the class of
+	 * their endpoint; for background jobs such as a reconciliation that must not delay interactive calls:
+	 * @code
+	 * PriorityScope background(PRIORITY_BULK);
+	 * docker.containerList(containers, true);
+	 * @endcode
+	 */
+	class DOCKER_CPP_API PriorityScope
+	{
+	public:
+		explicit PriorityScope(RequestPriority priority);
+		~PriorityScope();
+
+		PriorityScope(const PriorityScope &) = delete;
+		PriorityScope &operator=(const PriorityScope &) = delete;
+
+		/// Priority set by the innermost scope of this thread, or PRIORITY_COUNT if there is none
+		static RequestPriority current();
+
+	private:
+		RequestPriority _outer;
+	};
+
+	struct DOCKER_CPP_API SchedulerOptions
+	{
+		unsigned int maxInFlight = 8; //!< Requests sent to the daemon at the same time
+		unsigned int maxBulk = 4; //!< Bulk requests among them, so that long pulls leave slots to the others
+		unsigned int controlWeight = 4; //!< Control requests served for every bulk one while both wait
+	};
+
+	/**
+	 * Admission of the requests to one daemon: at most maxInFlight at a time, queued by priority class.
+	 * Health requests go first. Control and bulk requests share the remaining turns by weighted round robin, so
+	 * neither starves, and bulk requests never hold more than maxBulk slots. Requests of a class are served in
+	 * arrival order. Waiting honours the deadline and cancellation of the calling thread (see CallScope).
+	 * The queue depth and the wait time of every class are kept as metrics. Thread-safe.
+	 */
+	class DOCKER_CPP_API RequestScheduler
+	{
+	public:
+		explicit RequestScheduler(const SchedulerOptions &options = SchedulerOptions());
+		RequestScheduler(const RequestScheduler &) = delete;
+		RequestScheduler &operator=(const RequestScheduler &) = delete;
+
+		/**
+		 * Waits for a slot for a request of the given class. Every successful acquire() must be followed by release().
+		 * @returns false if the calls of this thread were interrupted (deadline or cancellation) while waiting
+		 */
+		bool acquire(RequestPriority priority);
+		void release(RequestPriority priority);
+
+		/// Requests of a class waiting for a slot
+		std::size_t queued(RequestPriority priority) const;
+		/// Highest number of requests of a class that waited at the same time
+		std::size_t maxQueued(RequestPriority priority) const;
+		/// Requests of a class holding a slot
+		std::size_t inFlight(RequestPriority priority) const;
+		/// Requests of a class admitted so far
+		std::uint64_t admitted(RequestPriority priority) const { return _admitted[priority].load(std::memory_order_relaxed); }
+		/// Requests of a class that gave up waiting
+		std::uint64_t abandoned(RequestPriority priority) const { return _abandoned[priority].load(std::memory_order_relaxed); }
+		/// Time the admitted requests of a class waited for their slot, in nanoseconds
+		const LatencyHistogram &waitTime(RequestPriority priority) const { return _wait[priority]; }
+
+		const SchedulerOptions &options() const { return _options; }
+
+		/**
+		 * Exports the metrics as JSON:
+		 * {"health":{"queued":..,"max_queued":..,"in_flight":..,"admitted":..,"abandoned":..,"wait_ns":{"count":..,"mean":..,"p50":..,...}},...}
+		 */
+		std::string toJson() const;
+
+	private:
+		struct Waiter
+		{
+			bool admitted = false;
+			std::condition_variable cv;
+		};
+
+		void _dispatch();
+		void _admit(RequestPriority priority);
+
+		SchedulerOptions _options;
+		mutable std::mutex _mutex;
+		std::deque<Waiter *> _queues[PRIORITY_COUNT];
+		std::size_t _maxQueued[PRIORITY_COUNT];
+		unsigned int _inFlight[PRIORITY_COUNT];
+		unsigned int _total;
+		unsigned int _controlTurns; // control requests admitted since the last bulk one
+		std::atomic<std::uint64_t> _admitted[PRIORITY_COUNT];
+		std::atomic<std::uint64_t> _abandoned[PRIORITY_COUNT];
+		LatencyHistogram _wait[PRIORITY_COUNT];
+	};
+
+	/**
+	 * Transport decorator that sends the requests of the transport T through a RequestScheduler, so that a burst
+	 * of pulls or removals cannot starve the health checks and the control calls of the same daemon:
+	 * @code
+	 * Docker<SchedulingHttp<SocketHttp>> docker("unix:///var/run/docker.sock");
+	 * docker.imageCreate(...); // bulk: at most SchedulerOptions::maxBulk at a time
+	 * docker.ping();           // health: served first
+	 * @endcode
+	 * Clients of the same daemon share its limits by sharing one scheduler (setScheduler()). Hijacked connections
+	 * and long-lived requests (request_long_lived()) bypass the scheduler. Calls that give up while queued fail
+	 * without a response, so Docker reports them as timed out or cancelled.
+	 * Thread-safe when T is.
+	 */
+	template <typename T>
+	struct SchedulingHttp : DockerHttpInterface<SchedulingHttp<T> >
+	{
+		static const bool thread_safe = T::thread_safe;
+
+		SchedulingHttp() : _scheduler(std::make_shared<RequestScheduler>()) {}
+
+		asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule("GET", uri, [&] { return _net.get(uri, headers); });
+		}
+
+		template <typename U>
+		asl::HttpResponse postImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule("POST", uri, [&] { return _net.post(uri, body, headers); });
+		}
+
+		template <typename U>
+		asl::HttpResponse putImpl(const std::string &uri, const U &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule("PUT", uri, [&] { return _net.put(uri, body, headers); });
+		}
+
+		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule("DELETE", uri, [&] { return _net.delet(uri, headers); });
+		}
+
+		asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule(method, uri, [&] { return _net.stream(method, uri, body, sink, headers); });
+		}
+
+		asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _schedule(method, uri, [&] { return _net.upload(method, uri, body, sink, headers); });
+		}
+
+		asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+			return _net.upgrade(method, uri, body, conn, headers);
+		}
+
+		RequestScheduler &scheduler() { return *_scheduler; }
+		/// Uses a scheduler shared with the other clients of the daemon. Set it before sending requests
+		void setScheduler(const std::shared_ptr<RequestScheduler> &scheduler) { _scheduler = scheduler; }
+		/// Scheduled transport
+		T &transport() { return _net; }
+
+	private:
+		template <typename F>
+		asl::HttpResponse _schedule(const std::string &method, const std::string &uri, F request)
+		{
+			if (request_long_lived(method, uri))
+				return request();
+			RequestPriority priority = PriorityScope::current();
+			if (priority == PRIORITY_COUNT)
+				priority = request_priority(method, uri);
+			RequestScheduler &scheduler = *_scheduler;
+			if (!scheduler.acquire(priority))
+				return no_response();
+			struct Slot
+			{
+				RequestScheduler &scheduler;
+				RequestPriority priority;
+				~Slot() { scheduler.release(priority); }
+			} slot = {scheduler, priority};
+			return request();
+		}
+
+		T _net;
+		std::shared_ptr<RequestScheduler> _scheduler;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_SCHEDULER_H
@@ -0,0 +1,75 @@
+#ifndef _DOCKER_SESSION_H
+#define _DOCKER_SESSION_H
+
+#include "export.h"
+#include "docker_error.h"
+#include "docker_stream.h"
+#include "docker_connection.h"
+
+#include <functional>
+
+#include <sys/uio.h>
+
+namespace docker_cpp
+{
+	/**
+	 * Interactive session on a hijacked exec connection (see Docker::execAttach).
+	 * Reads and writes go straight between the socket and the caller's buffers with scatter/gather I/O:
+	 * read() fills the given iovecs and hands stdout/stderr slices of those same buffers to the sinks, so nothing is
+	 * copied on the way. In non-blocking mode read() and write() return -1 with errno EAGAIN when they would block,
+	 * and handle() can be registered in poll/epoll loops together with other sessions.
+	 */
+	class DOCKER_CPP_API ExecSession
+	{
+	public:
+		typedef std::function<DockerError(int h, int w)> ResizeFunction;
+
+		/**
+		 * @param [in] onStdout Receives the standard output (the whole output with tty)
+		 * @param [in] onStderr Receives the standard error
+		 */
+		ExecSession(const StreamSink &onStdout = StreamSink(), const StreamSink &onStderr = StreamSink());
+
+		bool isOpen() const { return _conn.isOpen(); }
+		bool tty() const { return _tty; }
+		/// Native socket descriptor, to wait for readiness with poll/epoll
+		int handle() const { return _conn.handle(); }
+		bool setNonBlocking(bool nonBlocking);
+
+		/**
+		 * Reads available output into the buffers and dispatches it to the sinks.
+		 * @returns Bytes read, 0 at the end of the stream, -1 on error (errno EAGAIN if non-blocking and no data)
+		 */
+		long read(const iovec *iov, int iovcnt);
+
+		/**
+		 * Writes stdin data gathered from the buffers.
+		 * @returns Bytes written (maybe fewer than requested in non-blocking mode), -1 on error
+		 */
+		long write(const iovec *iov, int iovcnt);
+		long write(const char *data, std::size_t size);
+
+		/// Signals the end of stdin to the command
+		bool closeStdin() { return _conn.shutdownWrite(); }
+
+		/// Resizes the TTY of the exec instance (only with tty)
+		DockerError resize(int h, int w);
+
+		void close() { _conn.close(); }
+
+		/// Connection used by Docker::execAttach to hijack the exec start request
+		DockerConnection &connection() { return _conn; }
+		/// Called by Docker::execAttach once the connection is hijacked
+		void start(bool tty, const ResizeFunction &resize);
+
+	private:
+		DockerConnection _conn;
+		StreamSink _out;
+		StreamSink _err;
+		StreamDemuxer _demux;
+		bool _tty;
+		ResizeFunction _resize;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_SESSION_H
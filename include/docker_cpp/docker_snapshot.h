@@ -0,0 +1,196 @@
+#ifndef _DOCKER_SNAPSHOT_H
+#define _DOCKER_SNAPSHOT_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_error.h"
+#include "docker_parallel.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace docker_cpp
+{
+	template <typename T>
+	class Docker;
+
+	/**
+	 * Version, images and containers of a daemon, saved to a binary file so that a restarted process can serve them
+	 * before it has talked to the daemon.
+	 * The file starts with a header: "DKMS", u32 format version, u64 time of the snapshot, u64 payload size and a u64
+	 * checksum of the payload. The payload is a list of sections (u32 tag, u64 size, data), so a reader skips the
+	 * sections it does not know. Integers are little-endian and strings are a u32 size followed by the bytes.
+	 * load() maps the file and decodes it in place; a file of another format version, truncated or with a wrong
+	 * checksum is rejected as a whole. save() writes a temporary file and renames it, so a crash never leaves a
+	 * partial snapshot behind.
+	 * The network settings of the containers are not saved.
+	 */
+	struct DOCKER_CPP_API MetadataSnapshot
+	{
+		static const std::uint32_t FORMAT_VERSION = 1;
+
+		VersionInfo version = VersionInfo();
+		ImageList images;
+		ContainerList containers;
+		std::int64_t takenAt = 0; //!< When the data was fetched from the daemon (UNIX timestamp in nanoseconds, 0: never)
+
+		bool save(const std::string &path) const;
+		/// Replaces the contents with the file. Returns false if it is missing, of another format version or corrupted
+		bool load(const std::string &path);
+	};
+
+	struct DOCKER_CPP_API MetadataCacheOptions
+	{
+		bool allImages = false; //!< imageList with all=true (intermediate images too)
+		bool allContainers = true; //!< containerList with all=true (stopped containers too)
+		bool saveOnRefresh = true; //!< Save the snapshot file after every refresh
+	};
+
+	/**
+	 * Serves the version, images and containers of a daemon from a snapshot file at startup, and reconciles them
+	 * with the daemon in the background:
+	 * @code
+	 * MetadataCache<SocketHttp> cache(docker, "/var/lib/agent/docker.snapshot");
+	 * cache.load();      // served at once: the data of the last run
+	 * cache.reconcile(); // then replaced with the daemon's as soon as it answers, and saved for the next run
+	 * for (const ContainerInfo &c : cache.current()->containers) ...
+	 * @endcode
+	 * Readers get an immutable snapshot that stays valid while they hold it; a refresh swaps in a new one. fresh()
+	 * tells whether the data served came from the daemon in this run.
+	 */
+	template <typename T>
+	class MetadataCache
+	{
+	public:
+		MetadataCache(Docker<T> &docker, const std::string &path, const MetadataCacheOptions &options = MetadataCacheOptions())
+			: _docker(docker), _path(path), _options(options), _current(std::make_shared<MetadataSnapshot>()), _fresh(false),
+			  _result(DockerError::D_OK())
+		{
+		}
+
+		~MetadataCache()
+		{
+			if (_reconciler.joinable())
+				_reconciler.join();
+		}
+
+		MetadataCache(const MetadataCache &) = delete;
+		MetadataCache &operator=(const MetadataCache &) = delete;
+
+		/**
+		 * Serves the snapshot saved at the path, unless data from the daemon is served already.
+		 * @returns false if there is no valid snapshot there
+		 */
+		bool load()
+		{
+			std::shared_ptr<MetadataSnapshot> snapshot = std::make_shared<MetadataSnapshot>();
+			if (!snapshot->load(_path))
+				return false;
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_fresh)
+				_current = snapshot;
+			return true;
+		}
+
+		/**
+		 * Fetches the version, images and containers from the daemon (concurrently when the transport is
+		 * thread-safe), serves them and saves them.
+		 * @returns DockerError, the first error; the data served is then left as it was
+		 */
+		DockerError refresh()
+		{
+			std::shared_ptr<MetadataSnapshot> snapshot = std::make_shared<MetadataSnapshot>();
+			DockerError errors[3] = {DockerError::D_OK(), DockerError::D_OK(), DockerError::D_OK()};
+			parallel_for(3, T::thread_safe ? 3 : 1, [&](std::size_t i) {
+				if (i == 0)
+					errors[0] = _docker.version(snapshot->version);
+				else if (i == 1)
+					errors[1] = _docker.imageList(snapshot->images, _options.allImages);
+				else
+					errors[2] = _docker.containerList(snapshot->containers, _options.allContainers);
+			});
+			for (const DockerError &err : errors)
+			{
+				if (err.isError())
+					return err;
+			}
+			snapshot->takenAt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_current = snapshot;
+				_fresh = true;
+			}
+			if (_options.saveOnRefresh && !snapshot->save(_path))
+				return DockerError::D_ERROR("cannot save the snapshot to " + _path, 0);
+			return DockerError::D_OK();
+		}
+
+		/// Runs refresh() on a background thread, unless one is running. The transport must be thread-safe
+		void reconcile()
+		{
+			static_assert(T::thread_safe, "Reconciling in the background needs a thread-safe transport (T::thread_safe)");
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_running)
+				return;
+			if (_reconciler.joinable())
+				_reconciler.join();
+			_running = true;
+			_reconciler = std::thread([this] {
+				DockerError err = refresh();
+				std::lock_guard<std::mutex> lock(_mutex);
+				_result = err;
+				_running = false;
+				_done.notify_all();
+			});
+		}
+
+		/**
+		 * Waits for the background reconciliation.
+		 * @returns The result of its refresh(), or a timeout error if it is still running after `timeout`
+		 */
+		DockerError wait(std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			auto idle = [this] { return !_running; };
+			if (timeout == std::chrono::milliseconds::max())
+				_done.wait(lock, idle);
+			else if (!_done.wait_for(lock, timeout, idle))
+				return DockerError::D_TIMEOUT();
+			return _result;
+		}
+
+		/// Data served: the loaded snapshot, then the data of the last refresh. Never null
+		std::shared_ptr<const MetadataSnapshot> current() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _current;
+		}
+
+		/// True once the data served was fetched from the daemon by this object
+		bool fresh() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _fresh;
+		}
+
+	private:
+		Docker<T> &_docker;
+		std::string _path;
+		MetadataCacheOptions _options;
+		mutable std::mutex _mutex;
+		std::condition_variable _done;
+		std::shared_ptr<const MetadataSnapshot> _current;
+		bool _fresh;
+		bool _running = false;
+		DockerError _result;
+		std::thread _reconciler;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_SNAPSHOT_H
@@ -0,0 +1,161 @@
+#ifndef _DOCKER_STREAM_H
+#define _DOCKER_STREAM_H
+
+#include "export.h"
+
+#include <string>
+#include <functional>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace docker_cpp
+{
+	/**
+	 * Receives a piece of a streamed body. The data is only valid during the call.
+	 * Return false to stop the transfer.
+	 */
+	typedef std::function<bool(const char *data, std::size_t size)> StreamSink;
+
+	/// Returns a sink that appends everything it receives to `out`
+	inline StreamSink append_to(std::string &out)
+	{
+		return [&out](const char *data, std::size_t size) { out.append(data, size); return true; };
+	}
+
+	/**
+	 * Produces the next piece of a streamed request body (build contexts, archives) into `data`, at most `size` bytes.
+	 * Returns the number of bytes written, 0 at the end of the body and -1 on error, which aborts the request.
+	 */
+	typedef std::function<long(char *data, std::size_t size)> StreamSource;
+
+	/**
+	 * StreamSource reading a file descriptor (not owned) from its current position, for uploads of files.
+	 * The socket transport recognises this source: the rest of a regular file is then sent with sendfile() and a
+	 * Content-Length, without copying it through user space. Other descriptors (pipes) are read in chunks.
+	 */
+	class DOCKER_CPP_API FileSource
+	{
+	public:
+		explicit FileSource(int fd) : _fd(fd) {}
+		long operator()(char *data, std::size_t size) const;
+		int fd() const { return _fd; }
+		/// Bytes from the current position to the end if the descriptor is a regular file, -1 otherwise
+		long long remaining() const;
+
+	private:
+		int _fd;
+	};
+
+	/**
+	 * StreamSource over buffers in memory (not owned, and not to be changed until the upload is done), sent one
+	 * after the other. The socket transport recognises this source: the buffers are then written to the socket with
+	 * gather writes and a Content-Length, without being copied into chunks.
+	 */
+	class DOCKER_CPP_API BufferSource
+	{
+	public:
+		typedef std::pair<const char *, std::size_t> Buffer;
+
+		BufferSource() : _index(0), _offset(0) {}
+		BufferSource &add(const char *data, std::size_t size);
+		BufferSource &add(const std::string &data) { return add(data.data(), data.size()); }
+
+		long operator()(char *data, std::size_t size);
+		const std::vector<Buffer> &buffers() const { return _buffers; }
+		/// Total bytes of the buffers
+		std::size_t size() const;
+
+	private:
+		std::vector<Buffer> _buffers;
+		std::size_t _index; //!< Buffer being read by operator()
+		std::size_t _offset;
+	};
+
+	/// StreamSink writing everything to a file descriptor (not owned). It stops the transfer if a write fails
+	class DOCKER_CPP_API FileSink
+	{
+	public:
+		explicit FileSink(int fd) : _fd(fd) {}
+		bool operator()(const char *data, std::size_t size) const;
+
+	private:
+		int _fd;
+	};
+
+	/**
+	 * Splits a stream into lines, for the endpoints that answer with one JSON message per line (build, pull, events).
+	 * Complete lines are handed over straight from the input buffers; only a line split across several feed() calls
+	 * is copied. Line ends ("\n" or "\r\n") are not included and empty lines are skipped.
+	 * Line ends are searched 16 bytes at a time with SSE2 where available.
+	 */
+	class DOCKER_CPP_API LineSplitter
+	{
+	public:
+		/// Receives a line, only valid during the call. Return false to stop the transfer
+		typedef std::function<bool(const char *line, std::size_t size)> LineHandler;
+
+		explicit LineSplitter(const LineHandler &handler) : _handler(handler) {}
+
+		/**
+		 * Processes the next bytes of the stream.
+		 * @returns false if the handler asked to stop
+		 */
+		bool feed(const char *data, std::size_t size);
+
+		/// Hands over the last line if the stream did not end with a line break
+		bool finish();
+
+		/// A StreamSink that feeds this splitter
+		StreamSink sink() { return [this](const char *data, std::size_t size) { return feed(data, size); }; }
+
+	private:
+		bool _line(const char *line, std::size_t size);
+		bool _end(const char *start, const char *eol);
+
+		LineHandler _handler;
+		std::string _partial;
+	};
+
+	/**
+	 * Splits the multiplexed stream used by attach, exec and logs when no TTY is allocated.
+	 * Every frame has an 8 byte header: [stream type, 0, 0, 0, size (big endian uint32)] followed by the payload.
+	 * Payloads are forwarded to the sinks straight from the input buffers; a frame split across several
+	 * feed() calls is delivered in several pieces.
+	 */
+	class DOCKER_CPP_API StreamDemuxer
+	{
+	public:
+		enum Stream { STDIN = 0, STDOUT = 1, STDERR = 2 };
+
+		/**
+		 * @param [in] out Receives stdout (and stdin echo) payloads
+		 * @param [in] err Receives stderr payloads
+		 * @param [in] raw The stream is not multiplexed (TTY): everything goes to `out`
+		 */
+		StreamDemuxer(const StreamSink &out, const StreamSink &err, bool raw = false);
+
+		/**
+		 * Processes the next bytes of the stream.
+		 * @returns false if a sink asked to stop or the stream is malformed
+		 */
+		bool feed(const char *data, std::size_t size);
+
+		/// A StreamSink that feeds this demuxer
+		StreamSink sink() { return [this](const char *data, std::size_t size) { return feed(data, size); }; }
+
+		/// True when no frame is partially received
+		bool idle() const { return _headerSize == 0 && _remaining == 0; }
+
+	private:
+		StreamSink _out;
+		StreamSink _err;
+		bool _raw;
+		unsigned char _header[8];
+		std::size_t _headerSize;
+		std::size_t _remaining;
+		int _stream;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_STREAM_H
@@ -2,18 +2,65 @@
 #define _DOCKER_TYPES_H
 
 #include "export.h"
+#include "docker_id.h"
 
+#include <map>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 namespace docker_cpp
 {
+    /// Quotes and escapes a string as a JSON string literal
+    inline std::string json_string(const std::string &in)
+    {
+        std::string out = "\"";
+        for (char c : in) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        const char hex[] = "0123456789abcdef";
+                        out += "\\u00";
+                        out += hex[(c >> 4) & 0xf];
+                        out += hex[c & 0xf];
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        return out + '"';
+    }
+
     enum DOCKER_CPP_API dockErr {
         DOCKER_OK = 0, //200, 2014
         DOCKER_INFO = -1,
         DOCKER_ERROR = -2, //500, 404, 200 
+        DOCKER_TIMEOUT = -3, // deadline of the call exceeded (see CallScope)
+        DOCKER_CANCELLED = -4, // call cancelled with a CancellationToken
+    };
+
+    /// What went wrong, mapped from the HTTP status of the response so that callers can branch without reading messages
+    enum DOCKER_CPP_API dockErrKind {
+        ERR_NONE = 0, // 2xx
+        ERR_NOT_MODIFIED, // 304: the container is already started/stopped/paused
+        ERR_BAD_PARAMETER, // 400
+        ERR_UNAUTHORIZED, // 401, 403
+        ERR_NOT_FOUND, // 404
+        ERR_NOT_ACCEPTABLE, // 406: e.g. the container is not running
+        ERR_CONFLICT, // 409: name in use, container running, image in use
+        ERR_SERVER, // 500 and other 5xx
+        ERR_UNAVAILABLE, // 503: the daemon cannot handle the request now
+        ERR_CONNECTION, // no response from the daemon
+        ERR_TIMEOUT, // deadline of the call exceeded
+        ERR_CANCELLED, // call cancelled
+        ERR_OTHER, // any other status, or a client-side error
     };
 
     //////// IMAGE
@@ -21,12 +68,14 @@ namespace docker_cpp
     struct DOCKER_CPP_API ImageInfo {
         std::string id;
         std::string parentId;
+        ImageId key; //!< Binary form of id, for comparisons, hashing and joins (empty if id is not a full ID)
+        ImageId parentKey; //!< Binary form of parentId
         std::vector<std::string> repoTags;
         std::vector<std::string> repoDigests;
-        int created;
-        int size;
-        int virtualSize;
-        int sharedSize;
+        std::int64_t created; //!< When the image was created (UNIX timestamp)
+        std::int64_t size; //!< Total size of the image in bytes, including parent layers
+        std::int64_t virtualSize;
+        std::int64_t sharedSize;
         std::vector<std::pair<std::string, std::string> > labels; //!< User-defined key/value strings
         int containers;
     };
@@ -47,6 +96,33 @@ namespace docker_cpp
         signed long spaceReclaimed; //!< Disk space reclaimed in bytes
     };
 
+    struct DOCKER_CPP_API BuildOptions
+    {
+        std::vector<std::string> tags; //!< Names, with an optional tag ("name:tag"), given to the image
+        std::string dockerfile = "Dockerfile"; //!< Path of the Dockerfile within the build context
+        std::vector<std::pair<std::string, std::string> > buildArgs; //!< Values of the ARG instructions
+        std::vector<std::pair<std::string, std::string> > labels; //!< Labels set on the image
+        std::string target; //!< Stage of a multi-stage Dockerfile to build (default: the last one)
+        std::string platform; //!< Platform of the build, in the format os[/arch[/variant]]
+        std::string networkMode; //!< Network of the RUN instructions (bridge, host, none...)
+        bool noCache = false; //!< Do not use the cache
+        bool pull = false; //!< Pull the base images even if they are present
+        bool rm = true; //!< Remove the intermediate containers of a successful build
+        bool forceRm = false; //!< Always remove the intermediate containers
+        bool quiet = false; //!< Suppress the verbose build output
+    };
+
+    /// One message of the output of an image build, as the daemon streams it
+    struct DOCKER_CPP_API BuildMessage
+    {
+        std::string stream; //!< Output of the build steps
+        std::string status; //!< Status of a pull done by the build
+        std::string id; //!< Layer or image the status is about
+        std::string progress; //!< Progress bar of the status
+        std::string error; //!< Why the build failed
+        std::string imageId; //!< ID of the built image ("aux" message)
+    };
+
     /////////// CONTAINER
 
     struct DOCKER_CPP_API Port {
@@ -99,6 +175,8 @@ namespace docker_cpp
         std::vector<std::string> names; //!< The names that this container has been given
         std::string image; //!< The name of the image used when creating this container
         std::string imageID; //!< The ID of the image that this container was created from
+        ContainerId key; //!< Binary form of id, for comparisons, hashing and joins (empty if id is not a full ID)
+        ImageId imageKey; //!< Binary form of imageID, to join with ImageInfo::key
         std::string command; //!< Command to run when starting the container
         std::int64_t created; //!< When the container was created
         std::vector<Port> ports; //!< The ports exposed by this container
@@ -113,6 +191,40 @@ namespace docker_cpp
 
     using ContainerList = std::vector<ContainerInfo>;
 
+    struct DOCKER_CPP_API ContainerListDelta
+    {
+        ContainerList added; //!< Containers that were not in the previous list
+        ContainerList removed; //!< Containers of the previous list that are gone
+        ContainerList changed; //!< Current info of the containers whose state, status or labels changed
+
+        bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+    };
+
+    /// A file or directory in a container, as described by the archive endpoints
+    struct DOCKER_CPP_API PathStat
+    {
+        std::string name; //!< Base name
+        long long size = 0; //!< Size in bytes
+        unsigned int mode = 0; //!< Permission bits and type bits of a Go os.FileMode (see isDir() and isLink())
+        std::string mtime; //!< Modification time (RFC 3339)
+        std::string linkTarget; //!< Target of a symbolic link
+
+        bool isDir() const { return (mode & 0x80000000u) != 0; }
+        bool isLink() const { return (mode & 0x08000000u) != 0; }
+    };
+
+    /// Parameters of a request for the logs of a container
+    struct DOCKER_CPP_API LogOptions
+    {
+        bool follow = false; //!< Keep the connection open and stream the lines as they are written
+        bool stdOut = true; //!< Return the standard output
+        bool stdErr = true; //!< Return the standard error
+        std::string since; //!< Only lines written at or after this UNIX timestamp ("seconds" or "seconds.nanoseconds")
+        std::string until; //!< Only lines written before this UNIX timestamp
+        bool timestamps = false; //!< Prefix every line with its RFC 3339 timestamp, with nanoseconds, and a space
+        std::string tail = "all"; //!< Number of lines from the end of the log, or "all"
+    };
+
     struct DOCKER_CPP_API ContainerConfig
     {
         std::string hostname = ""; //!< The hostname to use for the container, as a valid RFC 1123 hostname.
@@ -201,6 +313,30 @@ namespace docker_cpp
         std::string buildTime;
     };
 
+    /// One message of the events stream of the daemon
+    struct DOCKER_CPP_API EventMessage {
+        std::string type; //!< Kind of object: "container", "image", "network", "volume"...
+        std::string action; //!< What happened to it: "create", "start", "die", "destroy"...
+        std::string actorId; //!< ID of the object
+        std::vector<std::pair<std::string, std::string> > attributes; //!< Details such as "name", "image" or "exitCode"
+        std::int64_t timeNano = 0; //!< When it happened (UNIX timestamp in nanoseconds)
+
+        /// Value of an attribute, empty if there is none
+        std::string attribute(const std::string &name) const {
+            for (const auto &a : attributes) {
+                if (a.first == name) return a.second;
+            }
+            return std::string();
+        }
+    };
+
+    /// Parameters of a request for the events of the daemon
+    struct DOCKER_CPP_API EventOptions {
+        std::string since; //!< Events at or after this UNIX timestamp ("seconds" or "seconds.nanoseconds"), among those the daemon still holds
+        std::string until; //!< End of the stream (UNIX timestamp); without it the stream lasts until it is stopped
+        std::map<std::string, std::vector<std::string> > filters; //!< e.g. {"type": {"container"}, "event": {"die"}}
+    };
+
     struct DOCKER_CPP_API WaitInfo {
         int statusCode; //!< Exit code of the container
         std::string errorMsg; //!< Details of an error
@@ -230,6 +366,12 @@ namespace docker_cpp
         int pid; //!< The system process ID for the exec process
     };
 
+    struct DOCKER_CPP_API ExecRunResult {
+        int exitCode = -1; //!< Exit code of the command
+        std::string stdOut; //!< Captured standard output (the whole output with tty)
+        std::string stdErr; //!< Captured standard error
+    };
+
     struct DOCKER_CPP_API ExecConfig {
         bool attachStdin = false; //!< Attach to stdin of the exec command
         bool attachStdout = true; //!< Attach to stdout of the exec command
@@ -248,23 +390,23 @@ namespace docker_cpp
             ss << "{\"AttachStdin\":" << attachStdin << ",";
             ss << "\"AttachStdout\":" << attachStdout << ",";
             ss << "\"AttachStderr\":" << attachStderr << ",";
-            ss << "\"DetachKeys\":" << detachKeys << ",";
+            ss << "\"DetachKeys\":" << json_string(detachKeys) << ",";
             ss << "\"Tty\":" << tty << ",";
             ss << "\"Env\": [";
             for (auto &envVar : env) {
-                ss << "\"" << envVar << "\"";
+                ss << json_string(envVar);
                 if (&envVar != &env.back()) ss << ",";
             }
             ss << "],";
             ss << "\"Cmd\": [";
             for (auto &c : cmd) {
-                ss << "\"" << c << "\"";
+                ss << json_string(c);
                 if (&c != &cmd.back()) ss << ",";
             }
             ss << "],";
             ss << "\"Privileged\":" << privileged << ",";
-            ss << "\"User\":" << user << ",";
-            ss << "\"WorkingDir\":" << workingDirectory << "}";
+            ss << "\"User\":" << json_string(user) << ",";
+            ss << "\"WorkingDir\":" << json_string(workingDirectory) << "}";
             return ss.str();
         };
     };
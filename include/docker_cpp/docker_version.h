@@ -0,0 +1,68 @@
+#ifndef _DOCKER_VERSION_H
+#define _DOCKER_VERSION_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_error.h"
+
+#include <string>
+
+namespace docker_cpp
+{
+	/// Version of the engine API, "1.40"
+	struct DOCKER_CPP_API ApiVersion
+	{
+		int majorVersion = 0;
+		int minorVersion = 0;
+
+		ApiVersion() {}
+		ApiVersion(int majorVersion, int minorVersion) : majorVersion(majorVersion), minorVersion(minorVersion) {}
+
+		/// Parses "<major>.<minor>". Returns false on any other text
+		static bool parse(const std::string &text, ApiVersion &out);
+
+		bool empty() const { return majorVersion == 0 && minorVersion == 0; }
+		std::string str() const { return std::to_string(majorVersion) + "." + std::to_string(minorVersion); }
+
+		bool operator==(const ApiVersion &o) const { return majorVersion == o.majorVersion && minorVersion == o.minorVersion; }
+		bool operator!=(const ApiVersion &o) const { return !(*this == o); }
+		bool operator<(const ApiVersion &o) const { return majorVersion < o.majorVersion || (majorVersion == o.majorVersion && minorVersion < o.minorVersion); }
+		bool operator>(const ApiVersion &o) const { return o < *this; }
+		bool operator<=(const ApiVersion &o) const { return !(o < *this); }
+		bool operator>=(const ApiVersion &o) const { return !(*this < o); }
+	};
+
+	/// Oldest API version whose endpoints cover every call of the client (prune endpoints)
+	const ApiVersion DOCKER_API_MIN(1, 25);
+	/// Newest API version the client was checked against
+	const ApiVersion DOCKER_API_MAX(1, 43);
+	/// Version used until one is negotiated
+	const ApiVersion DOCKER_API_DEFAULT(1, 40);
+
+	/**
+	 * Picks the highest API version supported by both the client and the daemon: the version of the daemon,
+	 * capped at DOCKER_API_MAX, if it is not below the oldest one either side accepts.
+	 * @param [in] daemon Versions reported by the daemon (version()); a daemon without minApiVersion accepts any
+	 * @param [in,out] result Negotiated version
+	 * @returns DockerError, an error if there is no version in common
+	 */
+	DOCKER_CPP_API DockerError negotiate_api_version(const VersionInfo &daemon, ApiVersion &result);
+
+	/**
+	 * API versions negotiated with each daemon, shared by the whole process so that the clients created after the
+	 * first one skip the negotiation round trip. Endpoints are the URIs given to the Docker constructor.
+	 * Thread-safe.
+	 */
+	class DOCKER_CPP_API ApiVersionCache
+	{
+	public:
+		/// Returns false if no version was negotiated with `endpoint`
+		static bool lookup(const std::string &endpoint, ApiVersion &version);
+		static void store(const std::string &endpoint, const ApiVersion &version);
+		/// Forgets the version of `endpoint`, after a daemon upgrade for example
+		static void forget(const std::string &endpoint);
+		static void clear();
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_VERSION_H
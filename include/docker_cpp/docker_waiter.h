@@ -0,0 +1,359 @@
+#ifndef _DOCKER_WAITER_H
+#define _DOCKER_WAITER_H
+
+#include "export.h"
+#include "docker_types.h"
+#include "docker_error.h"
+#include "docker_http.h"
+#include "docker_deadline.h"
+#include "docker_parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace docker_cpp
+{
+	template <typename T>
+	class Docker;
+
+	/// End of a container tracked by a ContainerWaiter
+	struct DOCKER_CPP_API ContainerExit
+	{
+		std::string id; //!< ID or name the container was registered with
+		DockerError error = DockerError::D_OK(); //!< Not found, cancelled by stop(), or the failure of the request for the exit code
+		WaitInfo info = WaitInfo(); //!< Exit code of the container, when there is no error
+	};
+
+	struct DOCKER_CPP_API ContainerWaiterOptions
+	{
+		std::size_t batchSize = 100; //!< Most containers looked up by one list request
+		unsigned int concurrency = DOCKER_DEFAULT_CONCURRENCY; //!< Requests in flight for the exit codes of containers found already exited
+		std::size_t recentExits = 4096; //!< Exits remembered to settle the containers that end while they are looked up
+		std::chrono::milliseconds retryDelay = std::chrono::milliseconds(100); //!< Wait before reconnecting after a request failed
+		std::chrono::milliseconds maxRetryDelay = std::chrono::seconds(5); //!< The wait doubles up to this while requests keep failing
+	};
+
+	/**
+	 * Waits for the exit of any number of containers with two threads and one streaming request, where
+	 * containerWait() holds a thread and a connection per container.
+	 * The waiter follows the "die" events of the daemon, and looks the registered containers up by batches of list
+	 * requests: the ones found exited get their exit code at once, the others complete on their die event. Exits that
+	 * arrive while a container is looked up are remembered, so none is missed. When the events stream breaks, it
+	 * resumes from the last event and the pending containers are looked up again, in case the daemon restarted.
+	 * Handlers run on the threads of the waiter: they must be short and must not call stop().
+	 * The transport must be thread-safe; SocketHttp also lets stop() interrupt the requests at once.
+	 * @code
+	 * ContainerWaiter<SocketHttp> waiter(docker);
+	 * std::vector<std::future<ContainerExit>> exits;
+	 * for (const std::string &id : jobs) exits.push_back(waiter.wait(id));
+	 * for (auto &exit : exits) report(exit.get());
+	 * @endcode
+	 */
+	template <typename T>
+	class ContainerWaiter
+	{
+		static_assert(T::thread_safe, "A container waiter needs a thread-safe transport (T::thread_safe)");
+
+	public:
+		/// Receives the exit of a container
+		typedef std::function<void(const ContainerExit &exit)> ExitHandler;
+
+		/// Starts following the events of the daemon: exits from the construction on are seen
+		ContainerWaiter(Docker<T> &docker, const ContainerWaiterOptions &options = ContainerWaiterOptions())
+			: _docker(docker), _options(options), _token(CancellationToken::create()), _since(std::to_string(std::time(nullptr))),
+			  _sequence(0), _pending(0), _stopped(false)
+		{
+			_options.batchSize = std::max<std::size_t>(_options.batchSize, 1);
+			_events = std::thread([this] { _watch(); });
+			_checker = std::thread([this] { _check(); });
+		}
+
+		~ContainerWaiter() { stop(); }
+		ContainerWaiter(const ContainerWaiter &) = delete;
+		ContainerWaiter &operator=(const ContainerWaiter &) = delete;
+
+		/**
+		 * Calls `onExit` once, when the container has exited (at once if it already has), is found missing, or the
+		 * waiter is stopped. A container may be waited for several times.
+		 * @param [in] id ID, ID prefix or name of the container
+		 */
+		void wait(const std::string &id, const ExitHandler &onExit)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (!_stopped)
+				{
+					_queue.push_back(Registration{id, onExit});
+					++_pending;
+					_wake.notify_one();
+					return;
+				}
+			}
+			ContainerExit exit;
+			exit.id = id;
+			exit.error = DockerError::D_CANCELLED();
+			onExit(exit);
+		}
+
+		/// Same as wait(id, onExit), with the exit delivered through a future
+		std::future<ContainerExit> wait(const std::string &id)
+		{
+			std::shared_ptr<std::promise<ContainerExit> > promise = std::make_shared<std::promise<ContainerExit> >();
+			std::future<ContainerExit> exit = promise->get_future();
+			wait(id, [promise](const ContainerExit &e) { promise->set_value(e); });
+			return exit;
+		}
+
+		/// Registrations whose handler has not returned yet
+		std::size_t pending() const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _pending;
+		}
+
+		/// Stops the threads of the waiter and completes the pending registrations as cancelled
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stopped = true;
+				_wake.notify_all();
+			}
+			_token.cancel();
+			if (_events.joinable())
+				_events.join();
+			if (_checker.joinable())
+				_checker.join();
+
+			std::vector<Registration> rest;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				rest.assign(_queue.begin(), _queue.end());
+				_queue.clear();
+				for (auto &w : _waiting)
+					rest.insert(rest.end(), w.second.begin(), w.second.end());
+				_waiting.clear();
+			}
+			ContainerExit cancelled;
+			cancelled.error = DockerError::D_CANCELLED();
+			_complete(rest, cancelled);
+		}
+
+	private:
+		struct Registration
+		{
+			std::string id;
+			ExitHandler onExit;
+		};
+
+		struct Exit
+		{
+			WaitInfo info;
+			std::uint64_t sequence; //!< Value of _sequence once the exit was received
+		};
+
+		// Events thread: completes the containers waiting for their die event
+		void _watch()
+		{
+			CallScope scope(_token);
+			std::chrono::milliseconds delay = _options.retryDelay;
+			std::string since = _since;
+			bool reconnected = false;
+			while (!call_interrupted())
+			{
+				if (reconnected)
+					_recheck();
+				EventOptions options;
+				options.since = since;
+				options.filters["type"].push_back("container");
+				options.filters["event"].push_back("die");
+				std::size_t received = 0;
+				_docker.events(options, [&](const EventMessage &event) {
+					++received;
+					if (event.timeNano > 0)
+						since = ns_timestamp_param(event.timeNano);
+					if (event.type == "container" && event.action == "die")
+						_exited(event);
+					return true;
+				});
+				if (call_interrupted())
+					break;
+				reconnected = true;
+				delay = received > 0 ? _options.retryDelay : std::min(delay * 2, _options.maxRetryDelay);
+				if (!call_sleep(delay))
+					break;
+			}
+		}
+
+		void _exited(const EventMessage &event)
+		{
+			ContainerExit exit;
+			exit.info.statusCode = std::atoi(event.attribute("exitCode").c_str());
+			std::vector<Registration> done;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				++_sequence;
+				_recent[event.actorId] = Exit{exit.info, _sequence};
+				_recentOrder.push_back(std::make_pair(event.actorId, _sequence));
+				while (_recentOrder.size() > _options.recentExits)
+				{
+					auto it = _recent.find(_recentOrder.front().first);
+					if (it != _recent.end() && it->second.sequence == _recentOrder.front().second)
+						_recent.erase(it);
+					_recentOrder.pop_front();
+				}
+				auto it = _waiting.find(event.actorId);
+				if (it != _waiting.end())
+				{
+					done.swap(it->second);
+					_waiting.erase(it);
+				}
+			}
+			_complete(done, exit);
+		}
+
+		// Looks the waiting containers up again: their die events may have been lost while the stream was down
+		void _recheck()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto &w : _waiting)
+				_queue.insert(_queue.end(), w.second.begin(), w.second.end());
+			_waiting.clear();
+			_wake.notify_one();
+		}
+
+		// Checker thread: looks the registered containers up by batches
+		void _check()
+		{
+			CallScope scope(_token);
+			std::chrono::milliseconds delay = _options.retryDelay;
+			for (;;)
+			{
+				std::vector<Registration> batch;
+				std::uint64_t sequence;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_wake.wait(lock, [this] { return _stopped || !_queue.empty(); });
+					if (_stopped)
+						return;
+					while (!_queue.empty() && batch.size() < _options.batchSize)
+					{
+						batch.push_back(std::move(_queue.front()));
+						_queue.pop_front();
+					}
+					sequence = _sequence;
+				}
+				if (_lookup(batch, sequence))
+				{
+					delay = _options.retryDelay;
+					continue;
+				}
+				{
+					// Retried unless stopped, in which case stop() completes them
+					std::lock_guard<std::mutex> lock(_mutex);
+					_queue.insert(_queue.begin(), batch.begin(), batch.end());
+				}
+				if (!call_sleep(delay))
+					return;
+				delay = std::min(delay * 2, _options.maxRetryDelay);
+			}
+		}
+
+		/**
+		 * Looks the containers of a batch up. Exits received after `sequence` happened after the lists were made.
+		 * @returns false if a list failed
+		 */
+		bool _lookup(std::vector<Registration> &batch, std::uint64_t sequence)
+		{
+			std::vector<std::string> keys;
+			for (const Registration &r : batch)
+				keys.push_back(r.id);
+			ContainerList found;
+			if (_docker.containerFind(keys, found).isError())
+				return false;
+
+			std::vector<std::size_t> exited;
+			for (std::size_t i = 0; i < batch.size(); ++i)
+			{
+				ContainerExit exit;
+				std::vector<Registration> done(1, batch[i]);
+				if (found[i].id.empty())
+				{
+					const std::string message = "{\"message\":\"No such container: " + batch[i].id + "\"}";
+					exit.error = DockerError::D_HTTP(404, message.c_str(), message.size());
+				}
+				else if (found[i].state == "exited" || found[i].state == "dead")
+				{
+					exited.push_back(i);
+					continue;
+				}
+				else
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					auto recent = _recent.find(found[i].id);
+					if (recent == _recent.end() || recent->second.sequence <= sequence)
+					{
+						_waiting[found[i].id].push_back(batch[i]);
+						continue;
+					}
+					exit.info = recent->second.info;
+				}
+				_complete(done, exit);
+			}
+
+			// The wait of an exited container returns at once, with its exit code
+			std::vector<ContainerExit> exits(exited.size());
+			parallel_for(exited.size(), _options.concurrency, [&](std::size_t i) {
+				exits[i].error = _docker.containerWait(found[exited[i]].id, exits[i].info);
+			});
+			for (std::size_t i = 0; i < exited.size(); ++i)
+				_complete(std::vector<Registration>(1, batch[exited[i]]), exits[i]);
+			return true;
+		}
+
+		void _complete(const std::vector<Registration> &done, const ContainerExit &exit)
+		{
+			if (done.empty())
+				return;
+			for (const Registration &r : done)
+			{
+				ContainerExit e = exit;
+				e.id = r.id;
+				r.onExit(e);
+			}
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending -= done.size();
+		}
+
+		Docker<T> &_docker;
+		ContainerWaiterOptions _options;
+		CancellationToken _token;
+		std::string _since; //!< Construction time, where the events start
+		mutable std::mutex _mutex;
+		std::condition_variable _wake;
+		std::deque<Registration> _queue; //!< Registrations to look up
+		std::map<std::string, std::vector<Registration> > _waiting; //!< Running containers by full ID, waiting for their die event
+		std::map<std::string, Exit> _recent; //!< Last exits received, by full ID
+		std::deque<std::pair<std::string, std::uint64_t> > _recentOrder; //!< Exits of _recent from the oldest
+		std::uint64_t _sequence; //!< Exits received so far
+		std::size_t _pending;
+		bool _stopped;
+		std::thread _events;
+		std::thread _checker;
+	};
+} // namespace docker_cpp
+
+#endif //_DOCKER_WAITER_H
@@ -0,0 +1,242 @@
+#ifndef __FIXTURE_HTTP_H_
+#define __FIXTURE_HTTP_H_
+
+#include <docker_cpp/docker_http.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace docker_cpp
+{
+    // In-memory transport serving pre-loaded responses, with injected latency and errors.
+    // Requests are matched on method and path (without daemon address, API version and query); a "*" segment
+    // matches any single segment. Serving a request neither allocates nor takes a lock, so the client's own
+    // overhead can be measured at millions of calls per second.
+    // Routes and settings must be configured before the transport is used from several threads.
+    struct FixtureHttp : DockerHttpInterface<FixtureHttp>
+    {
+        static const bool thread_safe = true;
+
+        struct Route
+        {
+            std::string method;
+            std::string path;
+            asl::HttpResponse response;
+            std::string body;
+            double errorRate = 0; // probability of answering with the injected error instead
+        };
+
+        FixtureHttp() : _latencyUs(0), _jitterUs(0), _errorRate(0), _seed(1), _draws(0), _requests(0), _errors(0)
+        {
+            _notFound.setCode(404);
+            _putBody(_notFound, "{\"message\":\"page not found\"}");
+            setErrorRate(0);
+        }
+
+        void route(const std::string &method, const std::string &path, int code, const std::string &body, double errorRate = 0)
+        {
+            Route r;
+            r.method = method;
+            r.path = path;
+            r.body = body;
+            r.errorRate = errorRate;
+            r.response.setCode(code);
+            _putBody(r.response, body);
+            for (Route &existing : _routes) {
+                if (existing.method == method && existing.path == path) {
+                    existing = r;
+                    return;
+                }
+            }
+            _routes.push_back(r);
+        }
+
+        // Loads a file once; returns false if it cannot be read
+        bool routeFile(const std::string &method, const std::string &path, const std::string &file, int code = 200)
+        {
+            std::ifstream in(file.c_str(), std::ios::binary);
+            if (!in) return false;
+            route(method, path, code, std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()));
+            return true;
+        }
+
+        // Routes the endpoints covered by the client to the fixtures of a directory (test/responses)
+        void routeDockerApi(const std::string &fixtures)
+        {
+            route("GET", "/_ping", 200, "OK");
+            routeFile("GET", "/version", fixtures + "/version_get.json");
+            routeFile("GET", "/info", fixtures + "/info_get.json");
+            routeFile("GET", "/containers/json", fixtures + "/container_list_get.json");
+            routeFile("GET", "/images/json", fixtures + "/image_list_get.json");
+            routeFile("DELETE", "/images/*", fixtures + "/image_remove_delet.json");
+            routeFile("POST", "/images/prune", fixtures + "/image_prune_post.json");
+            route("POST", "/images/*/tag", 201, "");
+            route("POST", "/images/create", 200, "{\"status\":\"Pull complete\"}\r\n");
+            for (const char *action : {"start", "stop", "restart", "kill", "pause", "unpause", "rename"})
+                route("POST", std::string("/containers/*/") + action, 204, "");
+            route("POST", "/containers/*/wait", 200, "{\"StatusCode\":0}");
+            route("DELETE", "/containers/*", 204, "");
+            routeFile("POST", "/containers/*/exec", fixtures + "/exec_create_post.json", 201);
+            routeFile("POST", "/exec/*/start", fixtures + "/exec_run_post.stream");
+            route("POST", "/exec/*/resize", 201, "");
+            routeFile("GET", "/exec/*/json", fixtures + "/exec_inspect_get.json");
+        }
+
+        // Delay of every response: `us` plus a uniformly distributed extra of up to `jitterUs`
+        void setLatency(int us, int jitterUs = 0)
+        {
+            _latencyUs = us;
+            _jitterUs = jitterUs;
+        }
+
+        // Probability of answering any request with an error, on top of the error rate of its route.
+        // `code` is the status of all injected errors
+        void setErrorRate(double rate, int code = 500)
+        {
+            _errorRate = rate;
+            _error = asl::HttpResponse();
+            _error.setCode(code);
+            _putBody(_error, "{\"message\":\"injected error\"}");
+        }
+
+        // Seed of the random injections, restarting their sequence: the same seed injects the same errors and delays
+        void setSeed(unsigned seed)
+        {
+            _seed = seed;
+            _draws = 0;
+        }
+
+        std::size_t requests() const { return _requests.load(std::memory_order_relaxed); }
+        std::size_t injectedErrors() const { return _errors.load(std::memory_order_relaxed); }
+
+        asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _serve("GET", uri);
+        }
+
+        template <typename T>
+        asl::HttpResponse postImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _serve("POST", uri);
+        }
+
+        template <typename T>
+        asl::HttpResponse putImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _serve("PUT", uri);
+        }
+
+        asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _serve("DELETE", uri);
+        }
+
+        asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            const Route *route = nullptr;
+            asl::HttpResponse res = _serve(method.c_str(), uri, &route);
+            if (!route || res.code() >= 300 || !sink) return res;
+            asl::HttpResponse head;
+            head.setCode(res.code());
+            sink(route->body.data(), route->body.size());
+            return head;
+        }
+
+        // Reads the whole streamed body, then answers like streamImpl()
+        asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            char buf[64 * 1024];
+            long n;
+            while ((n = body(buf, sizeof(buf))) > 0) {}
+            if (n < 0) return no_response();
+            return streamImpl(method, uri, std::string(), sink, headers);
+        }
+
+    private:
+        static void _putBody(asl::HttpResponse &res, const std::string &body)
+        {
+            if (!body.empty())
+                res.put(asl::ByteArray(reinterpret_cast<const byte *>(body.data()), static_cast<int>(body.size())));
+        }
+
+        // Range of the request path: "http://host/v1.40/containers/json?all=1" -> "/containers/json"
+        static void _path(const std::string &uri, const char *&begin, const char *&end)
+        {
+            std::size_t start = uri.find("/v1.");
+            start = start == std::string::npos ? 0 : uri.find('/', start + 1);
+            if (start == std::string::npos) start = uri.size();
+            std::size_t stop = uri.find('?', start);
+            begin = uri.data() + start;
+            end = uri.data() + (stop == std::string::npos ? uri.size() : stop);
+        }
+
+        static bool _matches(const std::string &pattern, const char *b, const char *e)
+        {
+            const char *p = pattern.data(), *pe = p + pattern.size();
+            while (p < pe && b < e) {
+                if (*p == '*') {
+                    ++p;
+                    while (b < e && *b != '/') ++b;
+                    continue;
+                }
+                if (*p++ != *b++) return false;
+            }
+            if (p < pe && *p == '*' && p + 1 == pe) ++p; // trailing "*" matching an empty segment
+            return p == pe && b == e;
+        }
+
+        // n-th random number of this instance: depends on the seed and n only, whatever the thread (splitmix64)
+        std::uint64_t _random()
+        {
+            std::uint64_t x = _seed + _draws.fetch_add(1, std::memory_order_relaxed) * 0x9E3779B97F4A7C15ull;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+
+        bool _chance(double rate)
+        {
+            return rate > 0 && static_cast<double>(_random() >> 11) * (1.0 / 9007199254740992.0) < rate;
+        }
+
+        asl::HttpResponse _serve(const char *method, const std::string &uri, const Route **matched = nullptr)
+        {
+            _requests.fetch_add(1, std::memory_order_relaxed);
+            if (_latencyUs > 0 || _jitterUs > 0) {
+                int us = _latencyUs + (_jitterUs > 0 ? static_cast<int>(_random() % (static_cast<std::uint64_t>(_jitterUs) + 1)) : 0);
+                std::this_thread::sleep_for(std::chrono::microseconds(us));
+            }
+
+            const char *begin, *end;
+            _path(uri, begin, end);
+            for (const Route &r : _routes) {
+                if (r.method != method || !_matches(r.path, begin, end)) continue;
+                if (_chance(_errorRate) || _chance(r.errorRate)) {
+                    _errors.fetch_add(1, std::memory_order_relaxed);
+                    return _error;
+                }
+                if (matched) *matched = &r;
+                return r.response;
+            }
+            return _notFound;
+        }
+
+        std::vector<Route> _routes;
+        asl::HttpResponse _notFound;
+        asl::HttpResponse _error;
+        int _latencyUs, _jitterUs;
+        double _errorRate;
+        unsigned _seed;
+        std::atomic<std::uint64_t> _draws;
+        std::atomic<std::size_t> _requests;
+        std::atomic<std::size_t> _errors;
+    };
+}
+
+#endif // __FIXTURE_HTTP_H_
@@ -0,0 +1,377 @@
+#include "mock_daemon.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifndef MOCK_FIXTURES_PATH
+#define MOCK_FIXTURES_PATH "test/responses"
+#endif
+
+namespace docker_cpp
+{
+    static std::vector<std::string> split_path(const std::string &path)
+    {
+        std::vector<std::string> parts;
+        std::size_t start = 1;
+        while (start <= path.size()) {
+            std::size_t end = path.find('/', start);
+            if (end == std::string::npos) end = path.size();
+            parts.push_back(path.substr(start, end - start));
+            start = end + 1;
+        }
+        return parts;
+    }
+
+    static bool path_matches(const std::string &pattern, const std::string &path)
+    {
+        std::vector<std::string> p = split_path(pattern), s = split_path(path);
+        if (p.size() != s.size()) return false;
+        for (std::size_t i = 0; i < p.size(); ++i)
+            if (p[i] != "*" && p[i] != s[i]) return false;
+        return true;
+    }
+
+    static void sleep_us(int us)
+    {
+        if (us > 0) std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+
+    // Decodes the chunked request body at the start of buf, receiving more from fd as needed, and erases it from buf
+    static bool read_chunked(int fd, std::string &buf, std::string &body)
+    {
+        char chunk[16 * 1024];
+        auto more = [&]() {
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buf.append(chunk, static_cast<std::size_t>(n));
+            return true;
+        };
+        for (;;) {
+            std::size_t eol;
+            while ((eol = buf.find("\r\n")) == std::string::npos)
+                if (!more()) return false;
+            std::size_t size = std::strtoul(buf.c_str(), nullptr, 16);
+            while (buf.size() < eol + 2 + size + 2)
+                if (!more()) return false;
+            body.append(buf, eol + 2, size);
+            buf.erase(0, eol + 2 + size + 2);
+            if (size == 0) return true;
+        }
+    }
+
+    std::string read_fixture(const std::string &name, const std::string &fixtures)
+    {
+        std::ifstream in(fixtures + "/" + name, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    std::string repeat_fixture(const std::string &json, std::size_t count)
+    {
+        std::size_t open = json.find('['), close = json.rfind(']');
+        if (open == std::string::npos || close == std::string::npos || close <= open) return json;
+        const std::string items = json.substr(open + 1, close - open - 1);
+        std::string out = "[";
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string copy = items;
+            // "Id": "abc" -> "Id": "abc-<i>"
+            for (std::size_t pos = copy.find("\"Id\""); pos != std::string::npos; pos = copy.find("\"Id\"", pos + 1)) {
+                std::size_t q1 = copy.find('"', copy.find(':', pos));
+                std::size_t q2 = q1 == std::string::npos ? q1 : copy.find('"', q1 + 1);
+                if (q2 == std::string::npos) break;
+                copy.insert(q2, "-" + std::to_string(i));
+            }
+            out += (i ? "," : "") + copy;
+        }
+        return out + "]";
+    }
+
+    std::string MockDaemon::default_fixtures()
+    {
+        return MOCK_FIXTURES_PATH;
+    }
+
+    MockDaemon::MockDaemon(const std::string &fixtures)
+        : _fixtures(fixtures), _listener(-1), _port(0), _latencyUs(0), _keepAlive(true), _requests(0), _connections(0), _running(false)
+    {
+    }
+
+    void MockDaemon::route(const std::string &method, const std::string &path, const Response &response)
+    {
+        route(method, path, Handler([response](const Request &) { return response; }));
+    }
+
+    void MockDaemon::route(const std::string &method, const std::string &path, const Handler &handler)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (path.find('*') == std::string::npos) {
+            _routes[method + " " + path] = handler;
+            return;
+        }
+        std::string key = method + " " + path;
+        auto it = std::find_if(_patterns.begin(), _patterns.end(), [&](const std::pair<std::string, Handler> &p) { return p.first == key; });
+        if (it != _patterns.end()) it->second = handler;
+        else _patterns.push_back(std::make_pair(key, handler));
+    }
+
+    void MockDaemon::routeFixture(const std::string &method, const std::string &path, const std::string &fixture)
+    {
+        Response r;
+        r.body = read_fixture(fixture, _fixtures);
+        route(method, path, r);
+    }
+
+    void MockDaemon::routeDockerApi()
+    {
+        Response ok, noContent, created;
+        ok.body = "OK";
+        ok.contentType = "text/plain";
+        noContent.code = 204;
+        created.code = 201;
+
+        route("GET", "/_ping", ok);
+        routeFixture("GET", "/version", "version_get.json");
+        routeFixture("GET", "/info", "info_get.json");
+        routeFixture("GET", "/containers/json", "container_list_get.json");
+        routeFixture("GET", "/images/json", "image_list_get.json");
+        routeFixture("DELETE", "/images/*", "image_remove_delet.json");
+        routeFixture("POST", "/images/prune", "image_prune_post.json");
+        route("POST", "/images/*/tag", created);
+
+        Response pull;
+        pull.chunked = true;
+        pull.body = "{\"status\":\"Pulling from library/alpine\"}\r\n{\"status\":\"Downloading\"}\r\n{\"status\":\"Pull complete\"}\r\n";
+        pull.chunkSize = 32;
+        route("POST", "/images/create", pull);
+
+        for (const char *action : {"start", "stop", "restart", "kill", "pause", "unpause", "rename"})
+            route("POST", std::string("/containers/*/") + action, noContent);
+        Response wait;
+        wait.body = "{\"StatusCode\":0}";
+        route("POST", "/containers/*/wait", wait);
+        route("DELETE", "/containers/*", noContent);
+
+        routeFixture("POST", "/containers/*/exec", "exec_create_post.json");
+        Response output;
+        output.body = read_fixture("exec_run_post.stream", _fixtures);
+        output.contentType = "application/vnd.docker.raw-stream";
+        output.chunked = true;
+        output.chunkSize = 16;
+        route("POST", "/exec/*/start", output);
+        route("POST", "/exec/*/resize", created);
+        routeFixture("GET", "/exec/*/json", "exec_inspect_get.json");
+    }
+
+    bool MockDaemon::_listen(int fd)
+    {
+        _listener = fd;
+        if (::listen(_listener, 128) != 0) {
+            ::close(_listener);
+            _listener = -1;
+            return false;
+        }
+        _running = true;
+        _acceptor = std::thread(&MockDaemon::_accept, this);
+        return true;
+    }
+
+    bool MockDaemon::start(int port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<unsigned short>(port));
+        socklen_t len = sizeof(addr);
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0) {
+            ::close(fd);
+            return false;
+        }
+        _port = ntohs(addr.sin_port);
+        _unixPath.clear();
+        return _listen(fd);
+    }
+
+    bool MockDaemon::startUnix(const std::string &path)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        ::unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            return false;
+        }
+        _port = 0;
+        _unixPath = path;
+        return _listen(fd);
+    }
+
+    void MockDaemon::stop()
+    {
+        if (!_running.exchange(false)) return;
+        ::shutdown(_listener, SHUT_RDWR);
+        ::close(_listener);
+        _acceptor.join();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (int fd : _clients) ::shutdown(fd, SHUT_RDWR);
+        }
+        for (auto &t : _threads) t.join();
+        for (int fd : _clients) ::close(fd); // closed here so that no descriptor is reused while still tracked
+        _threads.clear();
+        _clients.clear();
+        _listener = -1;
+        if (!_unixPath.empty()) ::unlink(_unixPath.c_str());
+    }
+
+    void MockDaemon::_accept()
+    {
+        while (_running) {
+            int fd = ::accept(_listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (!_running) break;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) {
+                ::close(fd);
+                break;
+            }
+            ++_connections;
+            _clients.push_back(fd);
+            _threads.emplace_back(&MockDaemon::_serve, this, fd);
+        }
+    }
+
+    MockDaemon::Response MockDaemon::_respond(const Request &request)
+    {
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _routes.find(request.method + " " + request.path);
+            if (it != _routes.end()) {
+                handler = it->second;
+            } else {
+                for (auto &p : _patterns) {
+                    std::size_t sp = p.first.find(' ');
+                    if (p.first.compare(0, sp, request.method) == 0 && path_matches(p.first.substr(sp + 1), request.path)) {
+                        handler = p.second;
+                        break;
+                    }
+                }
+            }
+        }
+        if (handler) return handler(request);
+        Response notFound;
+        notFound.code = 404;
+        notFound.body = "{\"message\":\"page not found\"}";
+        return notFound;
+    }
+
+    bool MockDaemon::_send(int fd, const Response &r, bool close)
+    {
+        std::string head = "HTTP/1.1 " + std::to_string(r.code) + " Mock\r\nContent-Type: " + r.contentType + "\r\n";
+        if (close) head += "Connection: close\r\n";
+        for (auto &h : r.headers) head += h.first + ": " + h.second + "\r\n";
+        if (!r.chunked) {
+            std::string out = head + "Content-Length: " + std::to_string(r.body.size()) + "\r\n\r\n" + r.body;
+            return ::send(fd, out.data(), out.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(out.size());
+        }
+
+        head += "Transfer-Encoding: chunked\r\n\r\n";
+        if (::send(fd, head.data(), head.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(head.size())) return false;
+        std::size_t step = r.chunkSize ? r.chunkSize : std::max<std::size_t>(r.body.size(), 1);
+        for (std::size_t pos = 0; pos < r.body.size(); pos += step) {
+            if (pos > 0) sleep_us(r.chunkDelayUs);
+            std::size_t n = std::min(step, r.body.size() - pos);
+            char size[32];
+            std::snprintf(size, sizeof(size), "%zx\r\n", n);
+            std::string chunk = size + r.body.substr(pos, n) + "\r\n";
+            if (::send(fd, chunk.data(), chunk.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(chunk.size())) return false;
+        }
+        return ::send(fd, "0\r\n\r\n", 5, MSG_NOSIGNAL) == 5;
+    }
+
+    // The descriptor is closed by stop()
+    void MockDaemon::_serve(int fd)
+    {
+        std::string buf;
+        char chunk[16 * 1024];
+        for (;;) {
+            std::size_t end;
+            while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) return;
+                buf.append(chunk, static_cast<std::size_t>(n));
+            }
+            std::string head = buf.substr(0, end);
+            std::string lower = head;
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::size_t bodySize = 0;
+            std::size_t cl = lower.find("\r\ncontent-length:");
+            if (cl != std::string::npos) bodySize = std::strtoul(head.c_str() + cl + 17, nullptr, 10);
+            bool clientClose = lower.find("\r\nconnection: close") != std::string::npos;
+            bool chunked = lower.find("\r\ntransfer-encoding: chunked") != std::string::npos;
+            while (!chunked && buf.size() < end + 4 + bodySize) {
+                ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0) return;
+                buf.append(chunk, static_cast<std::size_t>(n));
+            }
+
+            Request request;
+            std::size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+            request.method = head.substr(0, sp1);
+            std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+            std::size_t q = target.find('?');
+            request.path = target.substr(0, q);
+            if (q != std::string::npos) request.query = target.substr(q + 1);
+            if (request.path.compare(0, 2, "/v") == 0 && request.path.size() > 2 && std::isdigit(static_cast<unsigned char>(request.path[2])) &&
+                request.path.find('/', 1) != std::string::npos)
+                request.path = request.path.substr(request.path.find('/', 1));
+            if (chunked) {
+                buf.erase(0, end + 4);
+                if (!read_chunked(fd, buf, request.body)) return;
+            } else {
+                request.body = buf.substr(end + 4, bodySize);
+                buf.erase(0, end + 4 + bodySize);
+            }
+
+            Response r = _respond(request);
+            if (request.method == "HEAD") {
+                r.body.clear(); // the head only
+                r.chunked = false;
+            }
+            sleep_us(r.latencyUs >= 0 ? r.latencyUs : _latencyUs.load());
+            bool close = clientClose || !_keepAlive;
+            ++_requests;
+            if (!_send(fd, r, close) || close) {
+                ::shutdown(fd, SHUT_RDWR);
+                return;
+            }
+        }
+    }
+}
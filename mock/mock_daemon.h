@@ -0,0 +1,110 @@
+#ifndef __MOCK_DAEMON_H_
+#define __MOCK_DAEMON_H_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace docker_cpp
+{
+    // Lightweight HTTP/1.1 server standing in for the docker daemon, for end-to-end tests and transport
+    // benchmarks on machines without docker. It listens on a TCP port or a Unix socket and serves fixture,
+    // fixed or generated responses, with optional latency, chunked streaming and keep-alive.
+    // Routes are matched on method and path, ignoring the "/vX.Y" prefix and the query; a "*" segment of a
+    // route matches any single segment ("/containers/*/start").
+    class MockDaemon
+    {
+    public:
+        struct Request
+        {
+            std::string method;
+            std::string path; // without the version prefix and the query
+            std::string query;
+            std::string body;
+        };
+
+        struct Response
+        {
+            int code = 200;
+            std::string body;
+            std::string contentType = "application/json";
+            int latencyUs = -1;      // delay before the response (-1: the daemon default, see setLatency())
+            bool chunked = false;    // send the body with chunked transfer encoding
+            std::size_t chunkSize = 0; // bytes per chunk (0: the whole body in one chunk)
+            int chunkDelayUs = 0;    // delay between chunks, to simulate a stream
+            std::map<std::string, std::string> headers; // extra response headers
+        };
+
+        typedef std::function<Response(const Request &)> Handler;
+
+        // @param fixtures Directory of the files served by routeFixture()
+        explicit MockDaemon(const std::string &fixtures = default_fixtures());
+        ~MockDaemon() { stop(); }
+        MockDaemon(const MockDaemon &) = delete;
+        MockDaemon &operator=(const MockDaemon &) = delete;
+
+        void route(const std::string &method, const std::string &path, const Response &response);
+        // Generates the response of every request
+        void route(const std::string &method, const std::string &path, const Handler &handler);
+        // Serves a file of the fixtures directory
+        void routeFixture(const std::string &method, const std::string &path, const std::string &fixture);
+        // Routes the endpoints covered by the client to the fixtures of the tests
+        void routeDockerApi();
+
+        // Delay before every response that does not set its own
+        void setLatency(int us) { _latencyUs = us; }
+        // Close connections after every response
+        void setKeepAlive(bool keepAlive) { _keepAlive = keepAlive; }
+
+        // Listens on 127.0.0.1 (port 0 picks a free one)
+        bool start(int port = 0);
+        // Listens on a Unix domain socket, replacing any file at that path
+        bool startUnix(const std::string &path);
+        void stop();
+
+        int port() const { return _port; }
+        // Daemon URL for Docker<T> ("http://127.0.0.1:port" or "unix:///path")
+        std::string url() const { return _unixPath.empty() ? "http://127.0.0.1:" + std::to_string(_port) : "unix://" + _unixPath; }
+        // Requests served so far
+        std::size_t requests() const { return _requests; }
+        // Connections accepted so far
+        std::size_t connections() const { return _connections; }
+
+        static std::string default_fixtures();
+
+    private:
+        bool _listen(int fd);
+        void _accept();
+        void _serve(int fd);
+        Response _respond(const Request &request);
+        bool _send(int fd, const Response &r, bool close);
+
+        std::string _fixtures;
+        std::mutex _mutex;
+        std::map<std::string, Handler> _routes;
+        std::vector<std::pair<std::string, Handler> > _patterns;
+        std::vector<std::thread> _threads;
+        std::vector<int> _clients;
+        std::thread _acceptor;
+        std::string _unixPath;
+        int _listener;
+        int _port;
+        std::atomic<int> _latencyUs;
+        std::atomic<bool> _keepAlive;
+        std::atomic<std::size_t> _requests;
+        std::atomic<std::size_t> _connections;
+        std::atomic<bool> _running;
+    };
+
+    // Contents of a file of the fixtures directory
+    std::string read_fixture(const std::string &name, const std::string &fixtures = MockDaemon::default_fixtures());
+
+    // Repeats the elements of a JSON array fixture until it has `count` of them, with unique "Id"s
+    std::string repeat_fixture(const std::string &json, std::size_t count);
+}
+
+#endif // __MOCK_DAEMON_H_
@@ -0,0 +1,79 @@
+// Standalone mock docker daemon serving the test fixtures, to benchmark and stress-test transports end to end
+// without docker.
+//
+// Usage: mock_dockerd [--port 2375 | --unix /tmp/mock-docker.sock] [--fixtures dir] [--latency-us N]
+//                     [--containers N] [--chunk-size N] [--chunk-delay-us N] [--no-keep-alive]
+// --containers serves a container list of N entries; --chunk-size and --chunk-delay-us make /containers/json
+// a slow chunked stream. Stops on SIGINT/SIGTERM and prints the number of requests and connections.
+
+#include "mock_daemon.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace docker_cpp;
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void on_signal(int) { g_stop = 1; }
+
+int main(int argc, char *argv[])
+{
+    int port = 2375, latency = 0, containers = 0, chunkSize = 0, chunkDelay = 0;
+    bool keepAlive = true;
+    std::string unixPath, fixtures = MockDaemon::default_fixtures();
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--no-keep-alive") {
+            keepAlive = false;
+            continue;
+        }
+        if (arg == "--port") port = std::atoi(value.c_str());
+        else if (arg == "--unix") unixPath = value;
+        else if (arg == "--fixtures") fixtures = value;
+        else if (arg == "--latency-us") latency = std::atoi(value.c_str());
+        else if (arg == "--containers") containers = std::atoi(value.c_str());
+        else if (arg == "--chunk-size") chunkSize = std::atoi(value.c_str());
+        else if (arg == "--chunk-delay-us") chunkDelay = std::atoi(value.c_str());
+        else {
+            std::cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+        ++i;
+    }
+
+    MockDaemon daemon(fixtures);
+    daemon.routeDockerApi();
+    daemon.setLatency(latency);
+    daemon.setKeepAlive(keepAlive);
+
+    if (containers > 0 || chunkSize > 0) {
+        MockDaemon::Response list;
+        list.body = read_fixture("container_list_get.json", fixtures);
+        if (containers > 0) list.body = repeat_fixture(list.body, static_cast<std::size_t>(containers));
+        list.chunked = chunkSize > 0;
+        list.chunkSize = static_cast<std::size_t>(chunkSize);
+        list.chunkDelayUs = chunkDelay;
+        daemon.route("GET", "/containers/json", list);
+    }
+
+    bool started = unixPath.empty() ? daemon.start(port) : daemon.startUnix(unixPath);
+    if (!started) {
+        std::cerr << "Could not listen on " << (unixPath.empty() ? "port " + std::to_string(port) : unixPath) << "\n";
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    std::cout << "Serving " << fixtures << " on " << daemon.url() << std::endl;
+
+    while (!g_stop) ::usleep(100 * 1000);
+    daemon.stop();
+    std::cout << daemon.requests() << " requests on " << daemon.connections() << " connections" << std::endl;
+    return 0;
+}
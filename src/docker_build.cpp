@@ -0,0 +1,1137 @@
+#include <docker_cpp/docker_build.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+namespace docker_cpp
+{
+	static const std::uint64_t TAR_MAX_OCTAL = 077777777777ULL; // 11 octal digits
+
+	static std::string trim(const std::string &s)
+	{
+		std::size_t b = s.find_first_not_of(" \t\r\n");
+		if (b == std::string::npos) return std::string();
+		std::size_t e = s.find_last_not_of(" \t\r\n");
+		return s.substr(b, e - b + 1);
+	}
+
+	static std::vector<std::string> split_path(const std::string &path)
+	{
+		std::vector<std::string> parts;
+		std::size_t start = 0;
+		while (start <= path.size())
+		{
+			std::size_t end = path.find('/', start);
+			if (end == std::string::npos) end = path.size();
+			if (end > start) parts.push_back(path.substr(start, end - start));
+			start = end + 1;
+		}
+		return parts;
+	}
+
+	static std::string system_error(const std::string &what, const std::string &path)
+	{
+		return what + " " + path + ": " + std::strerror(errno);
+	}
+
+	//////// DockerIgnore
+
+	// Matches the character c against the pattern element at p: '?', a class, an escape or a literal. Sets `next` after it
+	static bool match_one(const char *p, const char *pe, char c, const char *&next)
+	{
+		if (*p == '?')
+		{
+			next = p + 1;
+			return true;
+		}
+		if (*p == '\\' && p + 1 < pe)
+		{
+			next = p + 2;
+			return p[1] == c;
+		}
+		if (*p == '[')
+		{
+			const char *q = p + 1;
+			bool negate = q < pe && (*q == '^' || *q == '!');
+			if (negate) ++q;
+			bool found = false, any = false;
+			const unsigned char u = static_cast<unsigned char>(c);
+			while (q < pe && (*q != ']' || !any))
+			{
+				unsigned char lo = static_cast<unsigned char>(*q++);
+				if (lo == '\\' && q < pe) lo = static_cast<unsigned char>(*q++);
+				unsigned char hi = lo;
+				if (q + 1 < pe && *q == '-' && q[1] != ']')
+				{
+					++q;
+					hi = static_cast<unsigned char>(*q++);
+					if (hi == '\\' && q < pe) hi = static_cast<unsigned char>(*q++);
+				}
+				found = found || (u >= lo && u <= hi);
+				any = true;
+			}
+			if (q < pe)
+			{
+				next = q + 1;
+				return found != negate;
+			}
+			// not a class: a literal '['
+		}
+		next = p + 1;
+		return *p == c;
+	}
+
+	// Glob match of one path component
+	static bool match_component(const std::string &pattern, const std::string &name)
+	{
+		const char *p = pattern.data(), *pe = p + pattern.size();
+		const char *s = name.data(), *se = s + name.size();
+		const char *starP = nullptr, *starS = nullptr;
+		while (s < se)
+		{
+			if (p < pe && *p == '*')
+			{
+				starP = ++p;
+				starS = s;
+				continue;
+			}
+			const char *next = p;
+			if (p < pe && match_one(p, pe, *s, next))
+			{
+				p = next;
+				++s;
+				continue;
+			}
+			if (!starP) return false;
+			p = starP;
+			s = ++starS;
+		}
+		while (p < pe && *p == '*') ++p;
+		return p == pe;
+	}
+
+	// Matches the pattern components from i against the first n path components from j; "**" spans any number of them
+	static bool match_parts(const std::vector<std::string> &pattern, std::size_t i, const std::vector<std::string> &path, std::size_t j, std::size_t n)
+	{
+		for (; i < pattern.size(); ++i, ++j)
+		{
+			if (pattern[i] == "**")
+			{
+				for (std::size_t k = j; k <= n; ++k)
+				{
+					if (match_parts(pattern, i + 1, path, k, n)) return true;
+				}
+				return false;
+			}
+			if (j == n || !match_component(pattern[i], path[j])) return false;
+		}
+		return j == n;
+	}
+
+	bool DockerIgnore::load(const std::string &dir)
+	{
+		std::string path = dir + "/.dockerignore";
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0) return errno == ENOENT;
+		std::ifstream in(path.c_str(), std::ios::binary);
+		if (!in) return false;
+		std::stringstream text;
+		text << in.rdbuf();
+		parse(text.str());
+		return true;
+	}
+
+	void DockerIgnore::parse(const std::string &text)
+	{
+		std::istringstream in(text);
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (!line.empty() && line[0] == '#') continue;
+			add(line);
+		}
+	}
+
+	void DockerIgnore::add(const std::string &pattern)
+	{
+		std::string p = trim(pattern);
+		if (p.empty()) return;
+		Rule rule;
+		rule.exception = p[0] == '!';
+		if (rule.exception) p = trim(p.substr(1));
+
+		// Cleaned like a path relative to the context root: "/a/./b/../c" is "a/c"
+		for (const std::string &part : split_path(p))
+		{
+			if (part == ".") continue;
+			if (part == "..")
+			{
+				if (!rule.parts.empty()) rule.parts.pop_back();
+				continue;
+			}
+			rule.parts.push_back(part);
+		}
+		if (rule.parts.empty()) return;
+		_hasExceptions = _hasExceptions || rule.exception;
+		_rules.push_back(rule);
+	}
+
+	bool DockerIgnore::excluded(const std::string &path) const
+	{
+		if (_rules.empty()) return false;
+		std::vector<std::string> parts = split_path(path);
+		bool excluded = false;
+		for (const Rule &r : _rules)
+		{
+			if (r.exception != excluded) continue; // it could not change the outcome
+			// A pattern applies to the path or to any of its parent directories
+			for (std::size_t n = parts.size(); n > 0; --n)
+			{
+				if (match_parts(r.parts, 0, parts, 0, n))
+				{
+					excluded = !r.exception;
+					break;
+				}
+			}
+		}
+		return excluded;
+	}
+
+	bool DockerIgnore::mayIncludeBelow(const std::string &dir) const
+	{
+		if (!_hasExceptions) return false;
+		std::vector<std::string> parts = split_path(dir);
+		for (const Rule &r : _rules)
+		{
+			if (!r.exception) continue;
+			// The exception must be able to match a path longer than dir that starts with dir
+			bool possible = r.parts.size() > parts.size();
+			for (std::size_t i = 0; i < parts.size() && i < r.parts.size(); ++i)
+			{
+				if (r.parts[i] == "**")
+				{
+					possible = true;
+					break;
+				}
+				if (!match_component(r.parts[i], parts[i]))
+				{
+					possible = false;
+					break;
+				}
+			}
+			if (possible) return true;
+		}
+		return false;
+	}
+
+	//////// Tar headers
+
+	static void put_octal(char *field, std::size_t width, std::uint64_t value)
+	{
+		field[width - 1] = '\0';
+		for (std::size_t i = width - 1; i-- > 0;)
+		{
+			field[i] = static_cast<char>('0' + (value & 7));
+			value >>= 3;
+		}
+	}
+
+	static void put_string(char *field, std::size_t width, const std::string &s)
+	{
+		std::memcpy(field, s.data(), std::min(s.size(), width));
+	}
+
+	static std::size_t tar_padding(std::uint64_t size)
+	{
+		return static_cast<std::size_t>((512 - size % 512) % 512);
+	}
+
+	// "<length> <key>=<value>\n", the length counting its own digits
+	static void pax_record(std::string &out, const std::string &key, const std::string &value)
+	{
+		std::size_t size = key.size() + value.size() + 3;
+		std::size_t length = size + std::to_string(size).size();
+		length = size + std::to_string(length).size();
+		out += std::to_string(length) + ' ' + key + '=' + value + '\n';
+	}
+
+	static void ustar_block(const std::string &name, const std::string &prefix, char type, unsigned int mode, std::uint64_t size,
+							std::int64_t mtime, const std::string &link, std::string &out)
+	{
+		char h[512];
+		std::memset(h, 0, sizeof(h));
+		put_string(h, 100, name);
+		put_octal(h + 100, 8, mode);
+		put_octal(h + 108, 8, 0); // uid
+		put_octal(h + 116, 8, 0); // gid
+		put_octal(h + 124, 12, size);
+		put_octal(h + 136, 12, static_cast<std::uint64_t>(std::max<std::int64_t>(0, std::min<std::int64_t>(mtime, TAR_MAX_OCTAL))));
+		std::memset(h + 148, ' ', 8);
+		h[156] = type;
+		put_string(h + 157, 100, link);
+		std::memcpy(h + 257, "ustar", 6);
+		std::memcpy(h + 263, "00", 2);
+		put_string(h + 345, 155, prefix);
+
+		unsigned int sum = 0;
+		for (char c : h) sum += static_cast<unsigned char>(c);
+		put_octal(h + 148, 7, sum);
+		h[155] = ' ';
+		out.append(h, sizeof(h));
+	}
+
+	void tar_header(const ContextEntry &entry, std::string &out)
+	{
+		std::string path = entry.type == '5' ? entry.path + '/' : entry.path;
+		std::string name = path, prefix, pax;
+		if (path.size() > 100)
+		{
+			// ustar splits a path at a '/' into a prefix of up to 155 bytes and a name of up to 100
+			std::size_t slash = path.find('/', path.size() - 101);
+			if (slash != std::string::npos && slash > 0 && slash <= 155 && slash + 1 < path.size())
+			{
+				prefix = path.substr(0, slash);
+				name = path.substr(slash + 1);
+			}
+			else
+			{
+				pax_record(pax, "path", path);
+				name = path.substr(0, 100);
+			}
+		}
+		if (entry.link.size() > 100) pax_record(pax, "linkpath", entry.link);
+		std::uint64_t size = entry.type == '0' ? entry.size : 0;
+		if (size > TAR_MAX_OCTAL)
+		{
+			pax_record(pax, "size", std::to_string(size));
+			size = 0;
+		}
+
+		if (!pax.empty())
+		{
+			std::size_t slash = entry.path.rfind('/');
+			std::string base = slash == std::string::npos ? entry.path : entry.path.substr(slash + 1);
+			ustar_block(("PaxHeaders.0/" + base).substr(0, 100), "", 'x', 0644, pax.size(), entry.mtime, "", out);
+			out += pax;
+			out.append(tar_padding(pax.size()), '\0');
+		}
+		ustar_block(name, prefix, entry.type, entry.mode, size, entry.mtime, entry.link, out);
+	}
+
+	//////// ContextCache
+
+	static const char CACHE_MAGIC[4] = {'D', 'K', 'C', 'C'};
+	static const std::uint32_t CACHE_VERSION = 1;
+	static const std::int64_t RACY_NS = 2000000000LL; // coarsest mtime resolution of common file systems (FAT)
+	static const std::uint64_t COMPACT_MIN = 64ULL * 1024 * 1024;
+	static const std::size_t CACHE_BUFFER = 1024 * 1024;
+
+	static std::uint64_t fnv1a(std::uint64_t hash, const char *data, std::size_t size)
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	static const std::uint64_t FNV_BASIS = 14695981039346656037ULL;
+
+	static std::int64_t stat_ns(const struct timespec &t)
+	{
+		return static_cast<std::int64_t>(t.tv_sec) * 1000000000LL + t.tv_nsec;
+	}
+
+	static void put_int(std::string &out, std::uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out += static_cast<char>((v >> (8 * i)) & 0xff);
+	}
+
+	static bool get_int(const std::string &in, std::size_t &pos, std::uint64_t &v, int bytes)
+	{
+		if (in.size() - pos < static_cast<std::size_t>(bytes)) return false;
+		v = 0;
+		for (int i = 0; i < bytes; i++)
+			v |= std::uint64_t(static_cast<unsigned char>(in[pos + i])) << (8 * i);
+		pos += static_cast<std::size_t>(bytes);
+		return true;
+	}
+
+	static bool write_all(int fd, const char *data, std::size_t size, std::uint64_t offset)
+	{
+		while (size > 0)
+		{
+			ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			data += n;
+			size -= static_cast<std::size_t>(n);
+			offset += static_cast<std::uint64_t>(n);
+		}
+		return true;
+	}
+
+	static bool read_at(int fd, char *data, std::size_t size, std::uint64_t offset)
+	{
+		while (size > 0)
+		{
+			ssize_t n = ::pread(fd, data, size, static_cast<off_t>(offset));
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			data += n;
+			size -= static_cast<std::size_t>(n);
+			offset += static_cast<std::uint64_t>(n);
+		}
+		return true;
+	}
+
+	/**
+	 * Store of file contents and index of the files of the last archive of one context, in a directory:
+	 * "blobs-<generation>" holds the contents one after the other, "index" is "DKCC", u32 version, u64 generation,
+	 * u64 stamp (time of the scan, ns), u64 size of the store, u32 count, then for every file its path (u32 length +
+	 * bytes), u64 size, mtime, ctime (ns), inode, hash (FNV-1a) and offset in the store. Integers are little-endian.
+	 * "lock" is held with flock() while the cache is in use. Not thread-safe: the packer writes from one thread, its
+	 * workers only pread() the store.
+	 */
+	class ContextCache
+	{
+	public:
+		struct Record
+		{
+			std::uint64_t size;
+			std::int64_t mtime;
+			std::int64_t ctime;
+			std::uint64_t inode;
+			std::uint64_t hash;
+			std::uint64_t offset;
+		};
+
+		explicit ContextCache(const std::string &dir)
+			: _dir(dir), _lock(-1), _store(-1), _generation(0), _stamp(0), _storeSize(0), _blobStart(0), _flushed(0), _hash(0), _failed(false)
+		{
+		}
+
+		~ContextCache()
+		{
+			if (_store >= 0) ::close(_store);
+			if (_lock >= 0) ::close(_lock); // releases the flock
+		}
+
+		/// Locks and loads the cache; false if it is in use or cannot be created
+		bool open()
+		{
+			std::size_t slash = 0;
+			while ((slash = _dir.find('/', slash + 1)) != std::string::npos)
+				::mkdir(_dir.substr(0, slash).c_str(), 0755);
+			::mkdir(_dir.c_str(), 0755);
+			_lock = ::open((_dir + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+			if (_lock < 0 || ::flock(_lock, LOCK_EX | LOCK_NB) != 0) return false;
+
+			_load();
+			_store = ::open(_storePath(_generation).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+			if (_store < 0) return false;
+			// Drops what a build that did not finish appended after the indexed contents
+			struct stat st;
+			if (::fstat(_store, &st) != 0 || static_cast<std::uint64_t>(st.st_size) < _storeSize)
+			{
+				_records.clear();
+				_blobs.clear();
+				_storeSize = 0;
+			}
+			if (::ftruncate(_store, static_cast<off_t>(_storeSize)) != 0) return false;
+			return true;
+		}
+
+		int store() const { return _store; }
+
+		/// Record of a file if it is unchanged since it was indexed
+		const Record *lookup(const std::string &path, std::uint64_t size, std::int64_t mtime, std::int64_t ctime, std::uint64_t inode) const
+		{
+			auto it = _records.find(path);
+			if (it == _records.end()) return nullptr;
+			const Record &r = it->second;
+			if (r.size != size || r.mtime != mtime || r.ctime != ctime || r.inode != inode) return nullptr;
+			return r.mtime < _stamp - RACY_NS ? &r : nullptr;
+		}
+
+		/// Starts the contents of a file, passed to write() as they are sent
+		void begin()
+		{
+			_blobStart = _storeSize;
+			_flushed = _storeSize;
+			_buffer.clear();
+			_hash = FNV_BASIS;
+		}
+
+		void write(const char *data, std::size_t size)
+		{
+			_hash = fnv1a(_hash, data, size);
+			if (_failed) return;
+			_buffer.append(data, size);
+			if (_buffer.size() >= CACHE_BUFFER) _flush();
+		}
+
+		/**
+		 * Ends the contents of a file: sets their hash and offset in the store, where identical contents are kept once.
+		 * A blob with the same hash and size is only reused once its bytes are found equal: the hash is not a proof.
+		 */
+		void end(std::uint64_t size, std::uint64_t &hash, std::uint64_t &offset)
+		{
+			hash = _hash;
+			auto it = _blobs.find(std::make_pair(hash, size));
+			if (it != _blobs.end() && _equals(it->second, size))
+			{
+				offset = it->second;
+				_buffer.clear();
+				if (_flushed > _blobStart && ::ftruncate(_store, static_cast<off_t>(_blobStart)) != 0) _failed = true;
+				return;
+			}
+			_flush();
+			offset = _blobStart;
+			_storeSize = _blobStart + size;
+			_blobs.insert(std::make_pair(std::make_pair(hash, size), offset)); // a colliding blob keeps the entry
+		}
+
+		/// Replaces the index with the files of an archive, compacting the store first if most of it is unused
+		bool save(std::vector<std::pair<std::string, Record> > &records, std::int64_t stamp)
+		{
+			if (_failed) return false;
+			std::uint64_t live = 0;
+			std::map<std::uint64_t, std::uint64_t> used; // offset -> size of the blobs still indexed
+			for (const auto &r : records)
+			{
+				if (used.insert(std::make_pair(r.second.offset, r.second.size)).second) live += r.second.size;
+			}
+			std::uint64_t generation = _generation;
+			if (_storeSize > COMPACT_MIN && _storeSize > 2 * live)
+			{
+				if (!_compact(used, records)) return false;
+				generation = _generation + 1;
+				_storeSize = live;
+			}
+			else if (::fdatasync(_store) != 0)
+			{
+				return false;
+			}
+
+			std::string out(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+			put_int(out, CACHE_VERSION, 4);
+			put_int(out, generation, 8);
+			put_int(out, static_cast<std::uint64_t>(stamp), 8);
+			put_int(out, _storeSize, 8);
+			put_int(out, records.size(), 4);
+			for (const auto &r : records)
+			{
+				put_int(out, r.first.size(), 4);
+				out += r.first;
+				put_int(out, r.second.size, 8);
+				put_int(out, static_cast<std::uint64_t>(r.second.mtime), 8);
+				put_int(out, static_cast<std::uint64_t>(r.second.ctime), 8);
+				put_int(out, r.second.inode, 8);
+				put_int(out, r.second.hash, 8);
+				put_int(out, r.second.offset, 8);
+			}
+			std::string tmp = _dir + "/index.tmp";
+			{
+				std::ofstream file(tmp.c_str(), std::ios::binary | std::ios::trunc);
+				if (!file.write(out.data(), static_cast<std::streamsize>(out.size())) || !file.flush()) return false;
+			}
+			if (std::rename(tmp.c_str(), (_dir + "/index").c_str()) != 0) return false;
+			if (generation != _generation) ::unlink(_storePath(_generation).c_str());
+			_generation = generation;
+			return true;
+		}
+
+	private:
+		std::string _storePath(std::uint64_t generation) const { return _dir + "/blobs-" + std::to_string(generation); }
+
+		void _load()
+		{
+			std::ifstream file((_dir + "/index").c_str(), std::ios::binary);
+			std::stringstream content;
+			content << file.rdbuf();
+			std::string in = content.str();
+			std::size_t pos = sizeof(CACHE_MAGIC);
+			std::uint64_t version, stamp, count;
+			if (in.size() < pos || in.compare(0, pos, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || !get_int(in, pos, version, 4) ||
+				version != CACHE_VERSION || !get_int(in, pos, _generation, 8) || !get_int(in, pos, stamp, 8) ||
+				!get_int(in, pos, _storeSize, 8) || !get_int(in, pos, count, 4))
+			{
+				_generation = 0;
+				_storeSize = 0;
+				return;
+			}
+			_stamp = static_cast<std::int64_t>(stamp);
+			for (std::uint64_t i = 0; i < count; ++i)
+			{
+				std::uint64_t length, mtime, ctime;
+				Record r;
+				if (!get_int(in, pos, length, 4) || in.size() - pos < length) break;
+				std::string path = in.substr(pos, static_cast<std::size_t>(length));
+				pos += static_cast<std::size_t>(length);
+				if (!get_int(in, pos, r.size, 8) || !get_int(in, pos, mtime, 8) || !get_int(in, pos, ctime, 8) ||
+					!get_int(in, pos, r.inode, 8) || !get_int(in, pos, r.hash, 8) || !get_int(in, pos, r.offset, 8))
+					break;
+				if (r.offset + r.size > _storeSize) continue;
+				r.mtime = static_cast<std::int64_t>(mtime);
+				r.ctime = static_cast<std::int64_t>(ctime);
+				_records[path] = r;
+				_blobs[std::make_pair(r.hash, r.size)] = r.offset;
+			}
+		}
+
+		void _flush()
+		{
+			if (_failed || _buffer.empty()) return;
+			if (!write_all(_store, _buffer.data(), _buffer.size(), _flushed)) _failed = true;
+			_flushed += _buffer.size();
+			_buffer.clear();
+		}
+
+		// True if the contents being written (flushed from _blobStart, then buffered) equal the blob at `offset`
+		bool _equals(std::uint64_t offset, std::uint64_t size)
+		{
+			if (_failed) return false;
+			const std::uint64_t flushed = _flushed - _blobStart;
+			std::vector<char> stored(static_cast<std::size_t>(std::min<std::uint64_t>(size, CACHE_BUFFER)));
+			std::vector<char> written(static_cast<std::size_t>(std::min<std::uint64_t>(std::min(size, flushed), CACHE_BUFFER)));
+			for (std::uint64_t done = 0; done < size;)
+			{
+				std::uint64_t left = done < flushed ? flushed - done : size - done;
+				std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(left, CACHE_BUFFER));
+				const char *mine = _buffer.data() + (done - std::min(done, flushed));
+				if (done < flushed)
+				{
+					if (!read_at(_store, &written[0], want, _blobStart + done)) return false;
+					mine = &written[0];
+				}
+				if (!read_at(_store, &stored[0], want, offset + done) || std::memcmp(&stored[0], mine, want) != 0) return false;
+				done += want;
+			}
+			return true;
+		}
+
+		// Copies the blobs in use to a new store and moves the records to their new offsets
+		bool _compact(const std::map<std::uint64_t, std::uint64_t> &used, std::vector<std::pair<std::string, Record> > &records)
+		{
+			int out = ::open(_storePath(_generation + 1).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (out < 0) return false;
+			std::map<std::uint64_t, std::uint64_t> moved;
+			std::vector<char> buf(CACHE_BUFFER);
+			std::uint64_t to = 0;
+			bool ok = true;
+			for (auto it = used.begin(); ok && it != used.end(); ++it)
+			{
+				moved[it->first] = to;
+				for (std::uint64_t done = 0; ok && done < it->second;)
+				{
+					std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(buf.size(), it->second - done));
+					ssize_t n = ::pread(_store, &buf[0], want, static_cast<off_t>(it->first + done));
+					if (n < 0 && errno == EINTR) continue;
+					ok = n > 0 && write_all(out, &buf[0], static_cast<std::size_t>(n), to);
+					done += static_cast<std::uint64_t>(n);
+					to += static_cast<std::uint64_t>(n);
+				}
+			}
+			ok = ok && ::fdatasync(out) == 0;
+			if (!ok)
+			{
+				::close(out);
+				::unlink(_storePath(_generation + 1).c_str());
+				return false;
+			}
+			for (auto &r : records)
+				r.second.offset = moved[r.second.offset];
+			::close(_store);
+			_store = out;
+			return true;
+		}
+
+		std::string _dir;
+		int _lock;
+		int _store;
+		std::uint64_t _generation;
+		std::int64_t _stamp;
+		std::uint64_t _storeSize; //!< End of the indexed contents and of the blobs added since
+		std::unordered_map<std::string, Record> _records;
+		std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint64_t> _blobs; //!< (hash, size) -> offset
+
+		// Contents being written
+		std::string _buffer;
+		std::uint64_t _blobStart;
+		std::uint64_t _flushed; //!< End of what was written to the store
+		std::uint64_t _hash;
+		bool _failed;
+	};
+
+	//////// ContextPacker
+
+	ContextPacker::ContextPacker(const std::string &dir, const ContextOptions &options)
+		: _dir(dir), _options(options), _dataSize(0), _scanned(false), _stamp(0), _reused(0), _reusedBytes(0), _storing(false),
+		  _next(0), _current(0), _stopping(false), _stage(NEXT_ENTRY), _outPos(0), _dataPos(0), _remaining(0)
+	{
+		while (_dir.size() > 1 && _dir[_dir.size() - 1] == '/') _dir.erase(_dir.size() - 1);
+		if (_options.dockerfile.compare(0, 2, "./") == 0) _options.dockerfile.erase(0, 2);
+		_options.blockSize = std::max<std::size_t>(_options.blockSize, 512);
+	}
+
+	ContextPacker::ContextPacker(const std::vector<std::string> &paths, const ContextOptions &options)
+		: ContextPacker(std::string(), options)
+	{
+		_paths = paths;
+	}
+
+	ContextPacker::~ContextPacker()
+	{
+		_stop();
+	}
+
+	std::string ContextPacker::cachePath(const std::string &cacheDir, const std::string &dir)
+	{
+		char resolved[PATH_MAX];
+		std::string path = ::realpath(dir.c_str(), resolved) ? std::string(resolved) : dir;
+		char name[17];
+		std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(fnv1a(FNV_BASIS, path.data(), path.size())));
+		return cacheDir + '/' + name;
+	}
+
+	// The Dockerfile and .dockerignore are sent even when excluded, as the daemon needs them
+	bool ContextPacker::_keep(const std::string &path) const
+	{
+		return path == _options.dockerfile || path == ".dockerignore";
+	}
+
+	bool ContextPacker::scan()
+	{
+		if (_scanned) return _error.empty();
+		_scanned = true;
+		_stamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		if (!_paths.empty())
+		{
+			for (std::string path : _paths)
+			{
+				while (path.size() > 1 && path[path.size() - 1] == '/') path.erase(path.size() - 1);
+				std::string name = path.substr(path.rfind('/') + 1);
+				if (name.empty() || name == "." || name == "..")
+				{
+					_error = "cannot archive " + path + ": it has no name";
+					return false;
+				}
+				if (!_add(path, name, DockerIgnore())) return false;
+			}
+			return true;
+		}
+		DockerIgnore ignore;
+		if (!ignore.load(_dir))
+		{
+			_error = system_error("cannot read", _dir + "/.dockerignore");
+			return false;
+		}
+		if (!_walk(_dir, "", ignore)) return false;
+		if (!_options.cacheDir.empty()) _openCache();
+		return true;
+	}
+
+	void ContextPacker::_openCache()
+	{
+		_cache.reset(new ContextCache(cachePath(_options.cacheDir, _dir)));
+		if (!_cache->open())
+		{
+			_cache.reset(); // in use by another packer
+			return;
+		}
+		for (std::size_t i = 0; i < _entries.size(); ++i)
+		{
+			const ContextEntry &entry = _entries[i];
+			CacheState &state = _states[i];
+			if (entry.type != '0' || entry.size == 0) continue;
+			const ContextCache::Record *r = _cache->lookup(entry.path, entry.size, state.mtime, state.ctime, state.inode);
+			if (!r) continue;
+			state.hit = true;
+			state.hash = r->hash;
+			state.offset = r->offset;
+			++_reused;
+			_reusedBytes += entry.size;
+		}
+	}
+
+	void ContextPacker::_saveCache()
+	{
+		std::vector<std::pair<std::string, ContextCache::Record> > records;
+		for (std::size_t i = 0; i < _entries.size(); ++i)
+		{
+			const ContextEntry &entry = _entries[i];
+			const CacheState &state = _states[i];
+			if (entry.type != '0' || entry.size == 0) continue;
+			ContextCache::Record r = {entry.size, state.mtime, state.ctime, state.inode, state.hash, state.offset};
+			records.push_back(std::make_pair(entry.path, r));
+		}
+		_cache->save(records, _stamp); // a cache that cannot be saved only costs the next archive its reuse
+		_cache.reset();
+	}
+
+	bool ContextPacker::_walk(const std::string &dir, const std::string &prefix, const DockerIgnore &ignore)
+	{
+		DIR *d = ::opendir(dir.c_str());
+		if (!d)
+		{
+			_error = system_error("cannot open", dir);
+			return false;
+		}
+		std::vector<std::string> names;
+		while (dirent *e = ::readdir(d))
+		{
+			if (std::strcmp(e->d_name, ".") != 0 && std::strcmp(e->d_name, "..") != 0)
+				names.push_back(e->d_name);
+		}
+		::closedir(d);
+		std::sort(names.begin(), names.end());
+
+		for (const std::string &name : names)
+		{
+			if (!_add(dir + '/' + name, prefix + name, ignore)) return false;
+		}
+		return true;
+	}
+
+	// Adds the file at `source` as `path` in the archive, with the content of a directory
+	bool ContextPacker::_add(const std::string &source, const std::string &path, const DockerIgnore &ignore)
+	{
+		ContextEntry entry;
+		entry.path = path;
+		struct stat st;
+		if (::lstat(source.c_str(), &st) != 0)
+		{
+			_error = system_error("cannot stat", source);
+			return false;
+		}
+		entry.mode = static_cast<unsigned int>(st.st_mode & 07777);
+		entry.size = 0;
+		entry.mtime = static_cast<std::int64_t>(st.st_mtime);
+		CacheState state;
+#ifdef __APPLE__
+		state.mtime = stat_ns(st.st_mtimespec);
+		state.ctime = stat_ns(st.st_ctimespec);
+#else
+		state.mtime = stat_ns(st.st_mtim);
+		state.ctime = stat_ns(st.st_ctim);
+#endif
+		state.inode = static_cast<std::uint64_t>(st.st_ino);
+		bool skip = ignore.excluded(entry.path) && !_keep(entry.path);
+
+		if (S_ISDIR(st.st_mode))
+		{
+			bool holdsDockerfile = _options.dockerfile.compare(0, entry.path.size() + 1, entry.path + '/') == 0;
+			if (skip && !holdsDockerfile && !ignore.mayIncludeBelow(entry.path)) return true;
+			if (!skip)
+			{
+				entry.type = '5';
+				_entries.push_back(entry);
+				_sources.push_back(source);
+				_states.push_back(state);
+			}
+			return _walk(source, entry.path + '/', ignore);
+		}
+		if (skip) return true;
+		if (S_ISREG(st.st_mode))
+		{
+			entry.type = '0';
+			entry.size = static_cast<std::uint64_t>(st.st_size);
+			_dataSize += entry.size;
+		}
+		else if (S_ISLNK(st.st_mode))
+		{
+			std::vector<char> target(static_cast<std::size_t>(st.st_size) + 1);
+			ssize_t n = ::readlink(source.c_str(), &target[0], target.size());
+			if (n < 0)
+			{
+				_error = system_error("cannot read link", source);
+				return false;
+			}
+			entry.type = '2';
+			entry.link.assign(&target[0], static_cast<std::size_t>(n));
+		}
+		else
+		{
+			return true; // sockets, pipes and devices are not sent
+		}
+		_entries.push_back(entry);
+		_sources.push_back(source);
+		_states.push_back(state);
+		return true;
+	}
+
+	void ContextPacker::_start()
+	{
+		unsigned int threads = _options.threads;
+		if (threads == 0) threads = std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+		std::size_t slots = std::max<std::size_t>(_options.readAhead / _options.blockSize, threads);
+		slots = std::min(slots, _entries.size());
+		threads = static_cast<unsigned int>(std::min<std::size_t>(threads, slots));
+		_slots.resize(slots);
+		for (unsigned int i = 0; i < threads; ++i)
+			_workers.push_back(std::thread(&ContextPacker::_work, this));
+	}
+
+	void ContextPacker::_stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_workReady.notify_all();
+		for (std::thread &t : _workers)
+			t.join();
+		_workers.clear();
+		for (Slot &slot : _slots)
+		{
+			if (slot.fd >= 0 && slot.owned) ::close(slot.fd);
+			slot.fd = -1;
+		}
+	}
+
+	void ContextPacker::_work()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		for (;;)
+		{
+			_workReady.wait(lock, [this] { return _stopping || _next >= _entries.size() || _next < _current + _slots.size(); });
+			if (_stopping || _next >= _entries.size()) return;
+			std::size_t index = _next++;
+			Slot &slot = _slots[index % _slots.size()];
+			lock.unlock();
+			_fill(index, slot);
+			lock.lock();
+			slot.ready = true;
+			_slotReady.notify_one();
+		}
+	}
+
+	// Opens a file and reads its head, from the cache if it has it; the descriptor stays open if there is more
+	void ContextPacker::_fill(std::size_t index, Slot &slot)
+	{
+		const ContextEntry &entry = _entries[index];
+		if (entry.type != '0' || entry.size == 0) return;
+		std::size_t head = static_cast<std::size_t>(std::min<std::uint64_t>(entry.size, _options.blockSize));
+		CacheState &state = _states[index];
+		if (state.hit)
+		{
+			slot.data.resize(head);
+			std::size_t got = 0;
+			while (got < head)
+			{
+				ssize_t n = ::pread(_cache->store(), &slot.data[got], head - got, static_cast<off_t>(state.offset + got));
+				if (n < 0 && errno == EINTR) continue;
+				if (n <= 0) break;
+				got += static_cast<std::size_t>(n);
+			}
+			if (got == head)
+			{
+				slot.fd = entry.size > head ? _cache->store() : -1;
+				slot.owned = false;
+				slot.offset = state.offset + head;
+				return;
+			}
+			state.hit = false; // the store was cut short: read the file
+		}
+		int fd = ::open(_sources[index].c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			slot.error = system_error("cannot open", _sources[index]);
+			return;
+		}
+#ifdef POSIX_FADV_SEQUENTIAL
+		if (entry.size > _options.blockSize) ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		slot.data.resize(head);
+		slot.owned = true;
+		slot.offset = head;
+		std::size_t got = 0;
+		while (got < head)
+		{
+			ssize_t n = ::read(fd, &slot.data[got], head - got);
+			if (n < 0 && errno == EINTR) continue;
+			if (n < 0)
+			{
+				slot.error = system_error("cannot read", _sources[index]);
+				::close(fd);
+				return;
+			}
+			if (n == 0) break;
+			got += static_cast<std::size_t>(n);
+		}
+		slot.data.resize(got);
+		if (got == head && entry.size > head) slot.fd = fd;
+		else ::close(fd);
+	}
+
+	// Frees the slot of the current entry for the workers and moves to the next entry
+	void ContextPacker::_release()
+	{
+		Slot &slot = _slots[_current % _slots.size()];
+		if (slot.fd >= 0 && slot.owned) ::close(slot.fd);
+		slot.fd = -1;
+		slot.data.clear();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			slot.ready = false;
+			++_current;
+		}
+		_workReady.notify_all();
+	}
+
+	bool ContextPacker::_nextEntry()
+	{
+		Slot &slot = _slots[_current % _slots.size()];
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_slotReady.wait(lock, [&slot] { return slot.ready; });
+		}
+		if (!slot.error.empty())
+		{
+			_error = slot.error;
+			return false;
+		}
+		const ContextEntry &entry = _entries[_current];
+		_out.clear();
+		tar_header(entry, _out);
+		_outPos = 0;
+		_dataPos = 0;
+		_remaining = entry.type == '0' ? entry.size - slot.data.size() : 0;
+		_storing = _cache && entry.type == '0' && entry.size > 0 && !_states[_current].hit;
+		if (_storing) _cache->begin();
+		_stage = HEADER;
+		return true;
+	}
+
+	void ContextPacker::_toCache(const char *data, std::size_t size)
+	{
+		if (_storing) _cache->write(data, size);
+	}
+
+	long ContextPacker::read(char *data, std::size_t size)
+	{
+		if (!scan() || !_error.empty()) return -1;
+		if (_slots.empty() && !_entries.empty()) _start();
+
+		std::size_t written = 0;
+		while (written < size && _stage != END)
+		{
+			switch (_stage)
+			{
+				case NEXT_ENTRY:
+					if (_current == _entries.size())
+					{
+						_out.assign(1024, '\0'); // two empty blocks end the archive
+						_outPos = 0;
+						_stage = TRAILER;
+					}
+					else if (!_nextEntry())
+					{
+						return -1;
+					}
+					break;
+
+				case HEADER:
+				case PADDING:
+				case TRAILER:
+				{
+					std::size_t n = std::min(size - written, _out.size() - _outPos);
+					std::memcpy(data + written, _out.data() + _outPos, n);
+					written += n;
+					_outPos += n;
+					if (_outPos < _out.size()) break;
+					if (_stage == HEADER)
+					{
+						_stage = DATA;
+					}
+					else if (_stage == PADDING)
+					{
+						_release();
+						_stage = NEXT_ENTRY;
+					}
+					else
+					{
+						_stage = END;
+						if (_cache) _saveCache();
+					}
+					break;
+				}
+
+				case DATA:
+				{
+					const std::string &head = _slots[_current % _slots.size()].data;
+					std::size_t n = std::min(size - written, head.size() - _dataPos);
+					std::memcpy(data + written, head.data() + _dataPos, n);
+					_toCache(data + written, n);
+					written += n;
+					_dataPos += n;
+					if (_dataPos == head.size()) _stage = REST;
+					break;
+				}
+
+				case REST:
+				{
+					if (_remaining == 0)
+					{
+						if (_storing)
+						{
+							CacheState &state = _states[_current];
+							_cache->end(_entries[_current].size, state.hash, state.offset);
+							_storing = false;
+						}
+						_out.assign(tar_padding(_entries[_current].size), '\0');
+						_outPos = 0;
+						_stage = PADDING;
+						break;
+					}
+					// The rest of a large file goes straight from the file (or the cache) to the caller's buffer
+					Slot &slot = _slots[_current % _slots.size()];
+					std::size_t want = static_cast<std::size_t>(std::min<std::uint64_t>(_remaining, size - written));
+					ssize_t n = slot.fd >= 0 ? ::pread(slot.fd, data + written, want, static_cast<off_t>(slot.offset)) : 0;
+					if (n < 0 && errno == EINTR) break;
+					if (n < 0)
+					{
+						_error = system_error("cannot read", _sources[_current]);
+						return -1;
+					}
+					if (n == 0)
+					{
+						std::memset(data + written, 0, want); // the file shrank
+						n = static_cast<ssize_t>(want);
+					}
+					_toCache(data + written, static_cast<std::size_t>(n));
+					slot.offset += static_cast<std::uint64_t>(n);
+					written += static_cast<std::size_t>(n);
+					_remaining -= static_cast<std::uint64_t>(n);
+					break;
+				}
+
+				case END:
+					break;
+			}
+		}
+		return static_cast<long>(written);
+	}
+} // namespace docker_cpp
@@ -0,0 +1,97 @@
+#include <docker_cpp/docker_cleanup.h>
+
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace docker_cpp
+{
+	static bool isDangling(const ImageInfo &image)
+	{
+		for (const std::string &tag : image.repoTags)
+		{
+			if (tag != "<none>:<none>") return false;
+		}
+		return true;
+	}
+
+	// inUse: IDs of the images used by containers, null if only the image counts are known
+	static void plan(const ImageList &images, const ImageCleanupPolicy &policy, std::int64_t now, const std::set<std::string> *inUse,
+	                 ImageRemovalPlan &out)
+	{
+		std::unordered_map<std::string, const ImageInfo *> byId;
+		byId.reserve(images.size());
+		for (const ImageInfo &image : images)
+		{
+			byId[image.id] = &image;
+		}
+
+		// Children that have not been scheduled yet, including the ones that will never be
+		std::unordered_map<std::string, std::size_t> pendingChildren;
+		for (const ImageInfo &image : images)
+		{
+			if (byId.count(image.parentId)) pendingChildren[image.parentId]++;
+		}
+
+		std::unordered_set<std::string> candidates;
+		std::vector<std::string> wave;
+		for (const ImageInfo &image : images)
+		{
+			std::int64_t own = image.size;
+			auto parent = byId.find(image.parentId);
+			if (parent != byId.end() && image.size >= parent->second->size)
+				own = image.size - parent->second->size;
+
+			if (policy.minAge > 0 && now - image.created < policy.minAge) continue;
+			if (own < policy.minSize) continue;
+			if (policy.danglingOnly && !isDangling(image)) continue;
+			if (policy.keepInUse)
+			{
+				// /images/json leaves the count at -1 (not computed): unknown usage counts as in use
+				if (image.containers > 0 || (inUse ? inUse->count(image.id) > 0 : image.containers < 0)) continue;
+			}
+
+			candidates.insert(image.id);
+			out.bytes[image.id] = own;
+			if (!pendingChildren.count(image.id)) wave.push_back(image.id);
+		}
+
+		std::size_t scheduled = 0;
+		while (!wave.empty())
+		{
+			std::vector<std::string> next;
+			for (const std::string &id : wave)
+			{
+				const std::string &parentId = byId[id]->parentId;
+				out.totalBytes += out.bytes[id];
+				if (!candidates.count(parentId)) continue;
+				out.parents[id] = parentId;
+				if (--pendingChildren[parentId] == 0) next.push_back(parentId);
+			}
+			scheduled += wave.size();
+			out.waves.push_back(std::move(wave));
+			wave = std::move(next);
+		}
+
+		if (scheduled == candidates.size()) return;
+		for (const ImageInfo &image : images)
+		{
+			if (candidates.count(image.id) && pendingChildren[image.id] > 0)
+			{
+				out.blocked.push_back(image.id);
+				out.bytes.erase(image.id);
+			}
+		}
+	}
+
+	void planImageCleanup(const ImageList &images, const ImageCleanupPolicy &policy, std::int64_t now, ImageRemovalPlan &out)
+	{
+		plan(images, policy, now, nullptr, out);
+	}
+
+	void planImageCleanup(const ImageList &images, const ImageCleanupPolicy &policy, std::int64_t now, const std::set<std::string> &inUse,
+	                      ImageRemovalPlan &out)
+	{
+		plan(images, policy, now, &inUse, out);
+	}
+} // namespace docker_cpp
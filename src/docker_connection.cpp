@@ -0,0 +1,672 @@
+#include <docker_cpp/docker_connection.h>
+#include <docker_cpp/docker_deadline.h>
+#include <docker_cpp/docker_metrics.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace docker_cpp
+{
+	static const std::size_t READ_CHUNK = 64 * 1024;
+	static const std::size_t UPLOAD_CHUNK = 256 * 1024;
+
+	static std::string lower(std::string s)
+	{
+		std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return s;
+	}
+
+	static std::string trim(const std::string &s)
+	{
+		std::size_t b = s.find_first_not_of(" \t");
+		if (b == std::string::npos) return std::string();
+		std::size_t e = s.find_last_not_of(" \t\r");
+		return s.substr(b, e - b + 1);
+	}
+
+	bool DockerUrl::parse(const std::string &url, DockerUrl &out)
+	{
+		std::size_t sep = url.find("://");
+		if (sep == std::string::npos) return false;
+		out.scheme = lower(url.substr(0, sep));
+		std::string rest = url.substr(sep + 3);
+
+		if (out.scheme == "unix")
+		{
+			std::size_t end = 0;
+			while ((end = rest.find(".sock", end)) != std::string::npos)
+			{
+				end += 5;
+				if (end == rest.size() || rest[end] == '/') break;
+			}
+			if (end == std::string::npos) end = rest.size();
+			out.host = rest.substr(0, end);
+			out.port = 0;
+			out.path = end < rest.size() ? rest.substr(end) : "/";
+			return !out.host.empty();
+		}
+		if (out.scheme != "http" && out.scheme != "tcp") return false;
+
+		std::size_t slash = rest.find('/');
+		std::string authority = rest.substr(0, slash);
+		out.path = slash == std::string::npos ? "/" : rest.substr(slash);
+		out.port = 80;
+
+		std::size_t colon = authority.rfind(':');
+		std::size_t bracket = authority.rfind(']');
+		if (colon != std::string::npos && (bracket == std::string::npos || colon > bracket))
+		{
+			out.port = std::atoi(authority.c_str() + colon + 1);
+			authority = authority.substr(0, colon);
+		}
+		if (!authority.empty() && authority.front() == '[' && authority.back() == ']')
+			authority = authority.substr(1, authority.size() - 2);
+		out.host = authority;
+		return !out.host.empty() && out.port > 0;
+	}
+
+	// connect() bounded by the deadline of the calls of this thread, if any
+	static bool connect_socket(int fd, const sockaddr *addr, socklen_t size)
+	{
+		if (!current_call_context())
+			return ::connect(fd, addr, size) == 0;
+
+		int flags = ::fcntl(fd, F_GETFL);
+		::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+		bool ok = ::connect(fd, addr, size) == 0;
+		if (!ok && (errno == EINPROGRESS || errno == EAGAIN) && call_wait(fd, POLLOUT))
+		{
+			int err = 0;
+			socklen_t len = sizeof(err);
+			ok = ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0;
+		}
+		::fcntl(fd, F_SETFL, flags);
+		return ok;
+	}
+
+	DockerConnection::DockerConnection() : _fd(-1), _pos(0), _keepAlive(false)
+	{
+	}
+
+	DockerConnection::~DockerConnection()
+	{
+		close();
+	}
+
+	void DockerConnection::close()
+	{
+		if (_fd >= 0) ::close(_fd);
+		_fd = -1;
+		_buf.clear();
+		_pos = 0;
+		_keepAlive = false;
+	}
+
+	bool DockerConnection::connect(const DockerUrl &url)
+	{
+		if (_fd >= 0 && _keepAlive && _url.sameDaemon(url)) return true;
+		close();
+
+		if (url.scheme == "unix")
+		{
+			sockaddr_un addr;
+			std::memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			if (url.host.size() >= sizeof(addr.sun_path)) return false;
+			std::memcpy(addr.sun_path, url.host.c_str(), url.host.size());
+			_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (_fd < 0) return false;
+			if (!connect_socket(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)))
+			{
+				close();
+				return false;
+			}
+		}
+		else
+		{
+			addrinfo hints;
+			std::memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			addrinfo *res = nullptr;
+			if (::getaddrinfo(url.host.c_str(), std::to_string(url.port).c_str(), &hints, &res) != 0) return false;
+			for (addrinfo *ai = res; ai && _fd < 0; ai = ai->ai_next)
+			{
+				_fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+				if (_fd < 0) continue;
+				if (!connect_socket(_fd, ai->ai_addr, ai->ai_addrlen))
+				{
+					::close(_fd);
+					_fd = -1;
+				}
+			}
+			::freeaddrinfo(res);
+			if (_fd < 0) return false;
+			int one = 1;
+			::setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		}
+#ifdef SO_NOSIGPIPE
+		int one = 1;
+		::setsockopt(_fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+		_url = url;
+		_keepAlive = true;
+		return true;
+	}
+
+	void DockerConnection::adopt(int fd)
+	{
+		close();
+		_fd = fd;
+		_url = DockerUrl();
+	}
+
+	bool DockerConnection::write(const char *data, std::size_t size)
+	{
+		while (size > 0)
+		{
+			if (!call_wait(_fd, POLLOUT)) return false;
+			ssize_t n = ::send(_fd, data, size, MSG_NOSIGNAL);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			data += n;
+			size -= static_cast<std::size_t>(n);
+		}
+		return true;
+	}
+
+	bool DockerConnection::shutdownWrite()
+	{
+		return _fd >= 0 && ::shutdown(_fd, SHUT_WR) == 0;
+	}
+
+	bool DockerConnection::sendRequest(const std::string &method, const std::string &path, const std::string &body, const header_map &headers)
+	{
+		if (_fd < 0) return false;
+		std::string head;
+		head.reserve(256 + path.size());
+		head += method + ' ' + path + " HTTP/1.1\r\n";
+		head += "Host: " + (_url.scheme == "unix" ? std::string("docker") : _url.host) + "\r\n";
+		bool hasLength = false, hasType = false;
+		for (auto &h : headers)
+		{
+			head += h.first + ": " + h.second + "\r\n";
+			std::string name = lower(h.first);
+			hasLength = hasLength || name == "content-length" || name == "transfer-encoding";
+			hasType = hasType || name == "content-type";
+		}
+		if (!hasType && !body.empty())
+			head += "Content-Type: application/json\r\n"; // every docker API body is JSON unless told otherwise
+		if (!hasLength && (!body.empty() || method == "POST" || method == "PUT"))
+			head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+		head += "\r\n";
+
+		if (body.size() < 4096)
+		{
+			head += body;
+			return write(head.data(), head.size());
+		}
+		return write(head.data(), head.size()) && write(body.data(), body.size());
+	}
+
+	bool DockerConnection::sendRequest(const std::string &method, const std::string &path, const StreamSource &body, const header_map &headers)
+	{
+		header_map chunked = headers;
+		chunked["Transfer-Encoding"] = "chunked";
+		if (!sendRequest(method, path, std::string(), chunked)) return false;
+
+		// Every chunk goes out in one write: room for its size line before the data and its CRLF after
+		const std::size_t prefix = 2 * sizeof(long) + 2;
+		std::vector<char> chunk(prefix + UPLOAD_CHUNK + 2);
+		for (;;)
+		{
+			long n = body(&chunk[prefix], UPLOAD_CHUNK);
+			if (n < 0) return false;
+			if (n == 0) break;
+			char line[prefix + 1];
+			int size = std::snprintf(line, sizeof(line), "%lx\r\n", static_cast<unsigned long>(n));
+			char *start = &chunk[prefix] - size;
+			std::memcpy(start, line, static_cast<std::size_t>(size));
+			chunk[prefix + n] = '\r';
+			chunk[prefix + n + 1] = '\n';
+			if (!write(start, static_cast<std::size_t>(size) + static_cast<std::size_t>(n) + 2)) return false;
+		}
+		return write("0\r\n\r\n", 5);
+	}
+
+#ifdef __linux__
+	// The body goes from the page cache to the socket, UPLOAD_CHUNK at a time so that deadlines are checked
+	bool DockerConnection::_sendFile(const std::string &method, const std::string &path, const FileSource &file, long long size,
+									 const header_map &headers, bool &sourceFailed)
+	{
+		header_map framed = headers;
+		framed["Content-Length"] = std::to_string(size);
+		if (!sendRequest(method, path, std::string(), framed)) return false;
+
+		// sendfile() has no MSG_NOSIGNAL: SIGPIPE is blocked and a SIGPIPE it raised is discarded
+		sigset_t pipe, previous, pending;
+		sigemptyset(&pipe);
+		sigaddset(&pipe, SIGPIPE);
+		sigpending(&pending);
+		bool wasPending = sigismember(&pending, SIGPIPE) == 1;
+		pthread_sigmask(SIG_BLOCK, &pipe, &previous);
+
+		off_t offset = ::lseek(file.fd(), 0, SEEK_CUR);
+		bool ok = true;
+		while (size > 0)
+		{
+			if (!call_wait(_fd, POLLOUT))
+			{
+				ok = false;
+				break;
+			}
+			ssize_t n = ::sendfile(_fd, file.fd(), &offset, static_cast<std::size_t>(std::min<long long>(size, UPLOAD_CHUNK)));
+			if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+			if (n <= 0)
+			{
+				// 0: the file is shorter than announced
+				sourceFailed = n == 0 || (errno != EPIPE && errno != ECONNRESET && errno != ENOTCONN);
+				if (n < 0 && errno == EPIPE && !wasPending)
+				{
+					struct timespec none = {0, 0};
+					sigtimedwait(&pipe, nullptr, &none);
+				}
+				ok = false;
+				break;
+			}
+			size -= n;
+		}
+		pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+		::lseek(file.fd(), offset, SEEK_SET); // the position moves past what was sent, as with read()
+		return ok;
+	}
+#else
+	bool DockerConnection::_sendFile(const std::string &, const std::string &, const FileSource &, long long, const header_map &, bool &)
+	{
+		return false;
+	}
+#endif
+
+	// The buffers go to the socket as they are, at most IOV_MAX of them per sendmsg()
+	bool DockerConnection::_sendBuffers(const std::string &method, const std::string &path, const BufferSource &buffers, const header_map &headers)
+	{
+		header_map framed = headers;
+		framed["Content-Length"] = std::to_string(buffers.size());
+		if (!sendRequest(method, path, std::string(), framed)) return false;
+
+		std::vector<iovec> iov;
+		iov.reserve(buffers.buffers().size());
+		for (const BufferSource::Buffer &b : buffers.buffers())
+		{
+			iovec v;
+			v.iov_base = const_cast<char *>(b.first);
+			v.iov_len = b.second;
+			iov.push_back(v);
+		}
+		std::size_t first = 0;
+		while (first < iov.size())
+		{
+			if (!call_wait(_fd, POLLOUT)) return false;
+			msghdr msg;
+			std::memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov[first];
+			msg.msg_iovlen = std::min<std::size_t>(iov.size() - first, IOV_MAX);
+			ssize_t n = ::sendmsg(_fd, &msg, MSG_NOSIGNAL);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			// Skips what was sent, which may end within a buffer
+			std::size_t sent = static_cast<std::size_t>(n);
+			while (first < iov.size() && sent >= iov[first].iov_len)
+				sent -= iov[first++].iov_len;
+			if (sent > 0)
+			{
+				iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + sent;
+				iov[first].iov_len -= sent;
+			}
+		}
+		return true;
+	}
+
+	// An idle kept-alive socket with something to read has been closed by the daemon (or is out of sync)
+	bool DockerConnection::_stale() const
+	{
+		pollfd p;
+		p.fd = _fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		return buffered() > 0 || ::poll(&p, 1, 0) != 0;
+	}
+
+	bool DockerConnection::_fill()
+	{
+		if (_pos == _buf.size())
+		{
+			_buf.clear();
+			_pos = 0;
+		}
+		char chunk[READ_CHUNK];
+		for (;;)
+		{
+			if (!call_wait(_fd, POLLIN)) return false;
+			ssize_t n = ::recv(_fd, chunk, sizeof(chunk), 0);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			_buf.append(chunk, static_cast<std::size_t>(n));
+			return true;
+		}
+	}
+
+	bool DockerConnection::_readLine(std::string &line)
+	{
+		for (;;)
+		{
+			std::size_t eol = _buf.find("\r\n", _pos);
+			if (eol != std::string::npos)
+			{
+				line.assign(_buf, _pos, eol - _pos);
+				_pos = eol + 2;
+				return true;
+			}
+			if (!_fill()) return false;
+		}
+	}
+
+	long DockerConnection::read(char *data, std::size_t size)
+	{
+		if (_fd < 0 && buffered() == 0) return -1;
+		if (buffered() > 0)
+		{
+			std::size_t n = std::min(size, buffered());
+			std::memcpy(data, _buf.data() + _pos, n);
+			_pos += n;
+			return static_cast<long>(n);
+		}
+		for (;;)
+		{
+			if (!call_wait(_fd, POLLIN)) return -1;
+			ssize_t n = ::recv(_fd, data, size, 0);
+			if (n < 0 && errno == EINTR) continue;
+			return static_cast<long>(n);
+		}
+	}
+
+	bool DockerConnection::readHead(int &code, header_map &headers)
+	{
+		std::string line;
+		do
+		{
+			if (!_readLine(line)) return false;
+			// "HTTP/1.1 200 OK"
+			std::size_t sp = line.find(' ');
+			if (line.compare(0, 5, "HTTP/") != 0 || sp == std::string::npos) return false;
+			_keepAlive = line.compare(0, 8, "HTTP/1.0") != 0;
+			code = std::atoi(line.c_str() + sp + 1);
+
+			headers.clear();
+			while (_readLine(line) && !line.empty())
+			{
+				std::size_t colon = line.find(':');
+				if (colon == std::string::npos) continue;
+				headers[lower(line.substr(0, colon))] = trim(line.substr(colon + 1));
+			}
+			if (!line.empty()) return false;
+		} while (code == 100);
+
+		if (code == 101)
+		{
+			_keepAlive = false; // the socket now belongs to the upgraded protocol
+			return true;
+		}
+		auto conn = headers.find("connection");
+		if (conn != headers.end())
+		{
+			std::string v = lower(conn->second);
+			if (v.find("close") != std::string::npos) _keepAlive = false;
+			else if (v.find("keep-alive") != std::string::npos) _keepAlive = true;
+		}
+		return true;
+	}
+
+	bool DockerConnection::_readExact(std::size_t size, const StreamSink &sink)
+	{
+		if (buffered() > 0)
+		{
+			std::size_t n = std::min(size, buffered());
+			const char *p = _buf.data() + _pos;
+			_pos += n;
+			size -= n;
+			if (sink && !sink(p, n)) return false;
+		}
+		char chunk[READ_CHUNK];
+		while (size > 0)
+		{
+			long n = read(chunk, std::min(size, sizeof(chunk)));
+			if (n <= 0) return false;
+			size -= static_cast<std::size_t>(n);
+			if (sink && !sink(chunk, static_cast<std::size_t>(n))) return false;
+		}
+		return true;
+	}
+
+	bool DockerConnection::readBody(const std::string &method, int code, const header_map &headers, const StreamSink &sink)
+	{
+		if (method == "HEAD" || (code >= 100 && code < 200 && code != 101) || code == 204 || code == 304)
+			return true;
+
+		bool ok = true;
+		auto te = headers.find("transfer-encoding");
+		auto cl = headers.find("content-length");
+		if (code != 101 && te != headers.end() && lower(te->second).find("chunked") != std::string::npos)
+		{
+			std::string line;
+			for (;;)
+			{
+				if (!_readLine(line)) { ok = false; break; }
+				std::size_t size = std::strtoul(line.c_str(), nullptr, 16);
+				if (size == 0)
+				{
+					while (_readLine(line) && !line.empty()) {} // trailers
+					break;
+				}
+				if (!_readExact(size, sink) || !_readLine(line)) { ok = false; break; }
+			}
+		}
+		else if (code != 101 && cl != headers.end())
+		{
+			ok = _readExact(std::strtoull(cl->second.c_str(), nullptr, 10), sink);
+		}
+		else
+		{
+			// Raw stream: the body ends when the daemon closes the connection
+			_keepAlive = false;
+			char chunk[READ_CHUNK];
+			for (;;)
+			{
+				long n = read(chunk, sizeof(chunk));
+				if (n < 0) { ok = false; break; }
+				if (n == 0) break;
+				if (sink && !sink(chunk, static_cast<std::size_t>(n))) { ok = false; break; }
+			}
+		}
+
+		if (!ok || !_keepAlive) close();
+		return ok;
+	}
+
+	// Requests that may be sent again when the daemon drops a kept-alive socket without answering
+	static bool idempotent(const std::string &method)
+	{
+		return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" || method == "OPTIONS";
+	}
+
+	bool DockerConnection::request(const DockerUrl &url, const std::string &method, const std::string &body, const header_map &headers,
+								   int &code, header_map &responseHeaders, const StreamSink &sink)
+	{
+		typedef std::chrono::steady_clock clock;
+		RequestTimings *timings = current_request_timings();
+		if (timings) timings->status = 0;
+
+		// A socket already closed by the daemon is replaced before sending. Once sent, a request may have been
+		// processed even if no answer comes back, so only the idempotent ones are sent again.
+		if (_fd >= 0 && _stale()) close();
+		for (int attempt = 0; attempt < 2; ++attempt)
+		{
+			bool reused = _fd >= 0 && _keepAlive && _url.sameDaemon(url);
+			clock::time_point start = clock::now();
+			if (!connect(url)) return false;
+			if (timings && !reused)
+				timings->connectNs = elapsed_ns(start);
+
+			start = clock::now();
+			if (sendRequest(method, url.path, body, headers) && readHead(code, responseHeaders))
+			{
+				if (!timings)
+					return readBody(method, code, responseHeaders, sink);
+				timings->firstByteNs = elapsed_ns(start);
+				timings->status = code;
+				std::uint64_t &bytes = timings->bytes;
+				start = clock::now();
+				bool ok = readBody(method, code, responseHeaders, [&bytes, &sink](const char *data, std::size_t size) {
+					bytes += size;
+					return !sink || sink(data, size);
+				});
+				timings->transferNs = elapsed_ns(start);
+				return ok;
+			}
+			close();
+			if (!reused || !idempotent(method) || call_interrupted()) return false;
+		}
+		return false;
+	}
+
+	bool DockerConnection::request(const DockerUrl &url, const std::string &method, const StreamSource &body, const header_map &headers,
+								   int &code, header_map &responseHeaders, const StreamSink &sink)
+	{
+		typedef std::chrono::steady_clock clock;
+		RequestTimings *timings = current_request_timings();
+		if (timings) timings->status = 0;
+
+		if (_fd >= 0 && _stale()) close();
+		bool reused = _fd >= 0 && _keepAlive && _url.sameDaemon(url);
+		clock::time_point start = clock::now();
+		if (!connect(url)) return false;
+		if (timings && !reused)
+			timings->connectNs = elapsed_ns(start);
+
+		bool sourceFailed = false;
+		StreamSource guarded = [&body, &sourceFailed](char *data, std::size_t size) {
+			long n = body(data, size);
+			sourceFailed = n < 0;
+			return n;
+		};
+		start = clock::now();
+#ifdef __linux__
+		const FileSource *file = body.target<FileSource>();
+		long long fileSize = file ? file->remaining() : -1;
+#else
+		const FileSource *file = nullptr;
+		long long fileSize = -1;
+#endif
+		const BufferSource *buffers = body.target<BufferSource>();
+		bool sent;
+		if (fileSize >= 0)
+			sent = _sendFile(method, url.path, *file, fileSize, headers, sourceFailed);
+		else if (buffers)
+			sent = _sendBuffers(method, url.path, *buffers, headers);
+		else
+			sent = sendRequest(method, url.path, guarded, headers);
+		if ((!sent && (sourceFailed || call_interrupted())) || !readHead(code, responseHeaders))
+		{
+			close();
+			return false;
+		}
+		if (!sent)
+			_keepAlive = false; // the daemon answered before the whole body was sent
+
+		if (!timings)
+			return readBody(method, code, responseHeaders, sink);
+		timings->firstByteNs = elapsed_ns(start);
+		timings->status = code;
+		std::uint64_t &bytes = timings->bytes;
+		start = clock::now();
+		bool ok = readBody(method, code, responseHeaders, [&bytes, &sink](const char *data, std::size_t size) {
+			bytes += size;
+			return !sink || sink(data, size);
+		});
+		timings->transferNs = elapsed_ns(start);
+		return ok;
+	}
+
+	bool DockerConnection::upgrade(const DockerUrl &url, const std::string &method, const std::string &body, const header_map &headers,
+								   int &code, header_map &responseHeaders)
+	{
+		header_map h = headers;
+		h["Connection"] = "Upgrade";
+		h["Upgrade"] = "tcp";
+		if (!connect(url) || !sendRequest(method, url.path, body, h) || !readHead(code, responseHeaders))
+		{
+			close();
+			return false;
+		}
+		if (code >= 200 && code < 300)
+			_keepAlive = false; // a raw stream without length: the daemon closes it at the end
+		return true;
+	}
+
+	std::unique_ptr<DockerConnection> ConnectionPool::acquire(const DockerUrl &url)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (std::size_t i = _idle.size(); i-- > 0;)
+			{
+				if (!_idle[i]->daemon().sameDaemon(url)) continue;
+				std::unique_ptr<DockerConnection> conn = std::move(_idle[i]);
+				_idle[i] = std::move(_idle.back());
+				_idle.pop_back();
+				return conn;
+			}
+		}
+		return std::unique_ptr<DockerConnection>(new DockerConnection());
+	}
+
+	void ConnectionPool::release(std::unique_ptr<DockerConnection> conn)
+	{
+		if (!conn || !conn->reusable()) return;
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_idle.size() < _maxIdle) _idle.push_back(std::move(conn));
+	}
+
+	std::size_t ConnectionPool::idle() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _idle.size();
+	}
+} // namespace docker_cpp
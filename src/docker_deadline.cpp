@@ -0,0 +1,219 @@
+#include <docker_cpp/docker_deadline.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <random>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace docker_cpp
+{
+	CancellationToken::State::State() : cancelled(false)
+	{
+		fds[0] = fds[1] = -1;
+		if (::pipe(fds) != 0)
+			return;
+		for (int fd : fds)
+		{
+			::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+			::fcntl(fd, F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	CancellationToken::State::~State()
+	{
+		for (int fd : fds)
+		{
+			if (fd >= 0) ::close(fd);
+		}
+	}
+
+	CancellationToken CancellationToken::create()
+	{
+		CancellationToken token;
+		token._state = std::make_shared<State>();
+		return token;
+	}
+
+	void CancellationToken::cancel()
+	{
+		if (_state) _cancel(_state);
+	}
+
+	void CancellationToken::_cancel(const std::shared_ptr<State> &state)
+	{
+		std::vector<std::weak_ptr<State> > children;
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (state->cancelled.exchange(true, std::memory_order_acq_rel))
+				return;
+			children.swap(state->children);
+		}
+		char byte = 1;
+		if (state->fds[1] >= 0 && ::write(state->fds[1], &byte, 1) < 0) {} // the pipe stays readable from now on
+		for (std::weak_ptr<State> &c : children)
+		{
+			if (std::shared_ptr<State> child = c.lock()) _cancel(child);
+		}
+	}
+
+	CancellationToken CancellationToken::child() const
+	{
+		CancellationToken token = create();
+		if (!_state)
+			return token;
+		bool cancelledParent;
+		{
+			std::lock_guard<std::mutex> lock(_state->mutex);
+			cancelledParent = _state->cancelled.load(std::memory_order_acquire);
+			if (!cancelledParent)
+			{
+				// drop the children that are gone so that a long-lived parent does not grow
+				auto &c = _state->children;
+				c.erase(std::remove_if(c.begin(), c.end(), [](const std::weak_ptr<State> &w) { return w.expired(); }), c.end());
+				c.push_back(token._state);
+			}
+		}
+		if (cancelledParent)
+			token.cancel();
+		return token;
+	}
+
+	bool CallContext::cancelled() const
+	{
+		for (const CancellationToken &t : tokens)
+		{
+			if (t.cancelled()) return true;
+		}
+		return false;
+	}
+
+	int CallContext::remainingMs() const
+	{
+		if (!hasDeadline())
+			return -1;
+		clock::duration left = deadline - clock::now();
+		if (left <= clock::duration::zero())
+			return 0;
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(left + std::chrono::milliseconds(1) - clock::duration(1)).count();
+		return static_cast<int>(std::min<decltype(ms)>(ms, 0x7fffffff));
+	}
+
+	CallContext *&current_call_context()
+	{
+		static thread_local CallContext *context = nullptr;
+		return context;
+	}
+
+	// Polls `fd` (if any) and the tokens of the context. Returns 1 if `fd` is ready, 0 on timeout or cancellation,
+	// -1 on error
+	static int poll_context(const CallContext &context, int fd, short events, int timeoutMs)
+	{
+		std::vector<pollfd> fds;
+		fds.reserve(context.tokens.size() + 1);
+		if (fd >= 0)
+			fds.push_back(pollfd{fd, events, 0});
+		for (const CancellationToken &t : context.tokens)
+		{
+			if (t.handle() >= 0)
+				fds.push_back(pollfd{t.handle(), POLLIN, 0});
+		}
+		for (;;)
+		{
+			if (context.cancelled())
+				return 0;
+			int left = context.remainingMs();
+			int wait = left < 0 ? timeoutMs : timeoutMs < 0 ? left : std::min(left, timeoutMs);
+			int r = ::poll(fds.data(), static_cast<nfds_t>(fds.size()), wait);
+			if (r < 0 && errno == EINTR)
+				continue;
+			if (r < 0)
+				return -1;
+			if (context.cancelled())
+				return 0;
+			if (fd >= 0 && fds[0].revents)
+				return 1;
+			if (r == 0 || context.expired())
+				return 0;
+		}
+	}
+
+	bool call_wait(int fd, short events)
+	{
+		CallContext *context = current_call_context();
+		if (!context)
+			return true;
+		return poll_context(*context, fd, events, -1) == 1;
+	}
+
+	bool call_sleep(std::chrono::milliseconds duration)
+	{
+		CallContext *context = current_call_context();
+		if (!context)
+		{
+			std::this_thread::sleep_for(duration);
+			return true;
+		}
+		CallContext::clock::time_point end = CallContext::clock::now() + duration;
+		if (context->hasDeadline() && end > context->deadline)
+		{
+			poll_context(*context, -1, 0, -1);
+			return false;
+		}
+		for (;;)
+		{
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(end - CallContext::clock::now()).count();
+			if (left <= 0)
+				return true;
+			if (poll_context(*context, -1, 0, static_cast<int>(left)) != 0 || context->cancelled())
+				return false;
+		}
+	}
+
+	CallScope::CallScope(std::chrono::milliseconds timeout, const CancellationToken &token)
+	{
+		_install(timeout.count() > 0 ? CallContext::clock::now() + timeout : CallContext::clock::time_point::max(), token);
+	}
+
+	CallScope::CallScope(const CancellationToken &token)
+	{
+		_install(CallContext::clock::time_point::max(), token);
+	}
+
+	CallScope::CallScope(const CallContext &context) : _context(context)
+	{
+		_outer = current_call_context();
+		current_call_context() = &_context;
+	}
+
+	CallScope::~CallScope()
+	{
+		current_call_context() = _outer;
+	}
+
+	void CallScope::_install(CallContext::clock::time_point deadline, const CancellationToken &token)
+	{
+		_outer = current_call_context();
+		if (_outer)
+			_context = *_outer;
+		_context.deadline = std::min(_context.deadline, deadline);
+		if (!token.empty())
+			_context.tokens.push_back(token);
+		current_call_context() = &_context;
+	}
+
+	std::chrono::milliseconds RetryPolicy::delay(int retry) const
+	{
+		static thread_local std::minstd_rand random(static_cast<unsigned>(
+			std::hash<std::thread::id>()(std::this_thread::get_id()) ^ static_cast<std::size_t>(CallContext::clock::now().time_since_epoch().count())));
+		std::int64_t cap = backoff.count() << std::min(retry, 30);
+		if (cap > maxBackoff.count() || cap < 0)
+			cap = maxBackoff.count();
+		if (cap <= 0)
+			return std::chrono::milliseconds(0);
+		return std::chrono::milliseconds(std::uniform_int_distribution<std::int64_t>(0, cap)(random));
+	}
+} // namespace docker_cpp
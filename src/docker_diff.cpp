@@ -0,0 +1,54 @@
+#include <docker_cpp/docker_diff.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace docker_cpp
+{
+	typedef std::vector<std::pair<std::string, std::string> > label_list;
+
+	static bool sameLabels(const label_list &a, const label_list &b)
+	{
+		if (a.size() != b.size()) return false;
+		if (a == b) return true;
+		label_list sa(a), sb(b);
+		std::sort(sa.begin(), sa.end());
+		std::sort(sb.begin(), sb.end());
+		return sa == sb;
+	}
+
+	void diff(const ContainerList &previous, const ContainerList &current, ContainerListDelta &out)
+	{
+		out.added.clear();
+		out.removed.clear();
+		out.changed.clear();
+
+		std::unordered_map<std::string, const ContainerInfo *> before;
+		before.reserve(previous.size());
+		for (const ContainerInfo &c : previous)
+		{
+			before[c.id] = &c;
+		}
+
+		for (const ContainerInfo &c : current)
+		{
+			auto it = before.find(c.id);
+			if (it == before.end())
+			{
+				out.added.push_back(c);
+				continue;
+			}
+			const ContainerInfo &old = *it->second;
+			if (old.state != c.state || old.status != c.status || !sameLabels(old.labels, c.labels))
+			{
+				out.changed.push_back(c);
+			}
+			before.erase(it);
+		}
+
+		for (const ContainerInfo &c : previous)
+		{
+			if (before.count(c.id)) out.removed.push_back(c);
+		}
+	}
+} // namespace docker_cpp
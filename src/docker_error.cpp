@@ -1,22 +1,191 @@
 #include "docker_cpp/docker_error.h"
 
+#include <cstdlib>
+
 namespace docker_cpp
 {
+    dockErrKind error_kind(int httpStatus)
+    {
+        if (httpStatus >= 200 && httpStatus < 300) return ERR_NONE;
+        switch (httpStatus)
+        {
+            case 0: return ERR_CONNECTION;
+            case 304: return ERR_NOT_MODIFIED;
+            case 400: return ERR_BAD_PARAMETER;
+            case 401:
+            case 403: return ERR_UNAUTHORIZED;
+            case 404: return ERR_NOT_FOUND;
+            case 406: return ERR_NOT_ACCEPTABLE;
+            case 409: return ERR_CONFLICT;
+            case 503: return ERR_UNAVAILABLE;
+            default: return httpStatus >= 500 && httpStatus < 600 ? ERR_SERVER : ERR_OTHER;
+        }
+    }
+
+    static const char *skip_space(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+        return p;
+    }
+
+    static void append_utf8(std::string &out, unsigned long c)
+    {
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xc0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xe0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+
+    static unsigned long hex4(const char *p)
+    {
+        char digits[5] = {p[0], p[1], p[2], p[3], 0};
+        return std::strtoul(digits, nullptr, 16);
+    }
+
+    // Reads the JSON string starting at the quote `p` points to. Returns the position after it, or null if it is not
+    // terminated. The string is only decoded when `out` is given.
+    static const char *read_string(const char *p, const char *end, std::string *out)
+    {
+        for (++p; p < end; ++p)
+        {
+            if (*p == '"') return p + 1;
+            if (*p != '\\') {
+                if (out) *out += *p;
+                continue;
+            }
+            if (++p == end) return nullptr;
+            if (!out) {
+                if (*p == 'u') p += 4;
+                continue;
+            }
+            switch (*p)
+            {
+                case 'n': *out += '\n'; break;
+                case 'r': *out += '\r'; break;
+                case 't': *out += '\t'; break;
+                case 'b': *out += '\b'; break;
+                case 'f': *out += '\f'; break;
+                case 'u':
+                {
+                    if (end - p < 5) return nullptr;
+                    unsigned long c = hex4(p + 1);
+                    p += 4;
+                    if (c >= 0xd800 && c < 0xdc00 && end - p >= 7 && p[1] == '\\' && p[2] == 'u') {
+                        unsigned long low = hex4(p + 3);
+                        if (low >= 0xdc00 && low < 0xe000) {
+                            c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+                            p += 6;
+                        }
+                    }
+                    append_utf8(*out, c);
+                    break;
+                }
+                default: *out += *p; // '"', '\\', '/'
+            }
+        }
+        return nullptr;
+    }
+
+    std::string error_message(const char *body, std::size_t size)
+    {
+        const char *end = body + size;
+        const char *p = skip_space(body, end);
+        if (p == end) return std::string();
+        if (*p != '{') {
+            const char *e = end;
+            while (e > p && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r' || e[-1] == '\n')) --e;
+            return std::string(p, e);
+        }
+
+        // Scan the object without building it, looking for a "message" key at the top level
+        int depth = 0;
+        bool key = false; // the next string of the top-level object is a key
+        while (p < end)
+        {
+            char c = *p;
+            if (c == '"') {
+                const char *start = p;
+                p = read_string(p, end, nullptr);
+                if (!p) break;
+                if (depth == 1 && key) {
+                    bool isMessage = p - start == 9 && std::string(start + 1, 7) == "message";
+                    p = skip_space(p, end);
+                    if (p < end && *p == ':') p = skip_space(p + 1, end);
+                    key = false;
+                    if (isMessage && p < end && *p == '"') {
+                        std::string msg;
+                        return read_string(p, end, &msg) ? msg : std::string();
+                    }
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                ++depth;
+                key = depth == 1;
+            } else if (c == '}' || c == ']') {
+                --depth;
+            } else if (c == ',' && depth == 1) {
+                key = true;
+            }
+            ++p;
+        }
+        return std::string();
+    }
+
+    static const char *status_message(dockErrKind kind)
+    {
+        switch (kind)
+        {
+            case ERR_NOT_MODIFIED: return "Not modified";
+            case ERR_BAD_PARAMETER: return "Bad parameter";
+            case ERR_UNAUTHORIZED: return "Unauthorized";
+            case ERR_NOT_FOUND: return "Not found";
+            case ERR_NOT_ACCEPTABLE: return "Not acceptable";
+            case ERR_CONFLICT: return "Conflict";
+            case ERR_SERVER: return "Server error";
+            case ERR_UNAVAILABLE: return "Service unavailable";
+            default: return nullptr;
+        }
+    }
+
     DockerError::DockerError(dockErr code, const std::string& msg, const int codeAPI)
     {
         this->errorCode = code;
         this->msg = msg;
         this->apiErrorCode = codeAPI;
+        if (code == DOCKER_TIMEOUT) kind = ERR_TIMEOUT;
+        else if (code == DOCKER_CANCELLED) kind = ERR_CANCELLED;
+        else if (code == DOCKER_OK) kind = ERR_NONE;
+        else kind = codeAPI == 0 ? ERR_OTHER : error_kind(codeAPI);
     }
 
-    bool DockerError::isOk()
+    bool DockerError::isOk() const
     {
         return errorCode == DOCKER_OK || errorCode == DOCKER_INFO;
     }
 
-    bool DockerError::isError()
+    bool DockerError::isError() const
+    {
+        return errorCode != DOCKER_OK && errorCode != DOCKER_INFO;
+    }
+
+    std::string DockerError::message() const
     {
-        return errorCode == DOCKER_ERROR;
+        if (!msg.empty()) return msg;
+        const char *generic = status_message(kind);
+        if (generic) return generic;
+        return apiErrorCode >= 300 ? "HTTP status " + std::to_string(apiErrorCode) : msg;
     }
 
     DockerError DockerError::D_OK()
@@ -34,9 +203,31 @@ namespace docker_cpp
         return DockerError(DOCKER_ERROR, msg, codeAPI);
     }
 
+    DockerError DockerError::D_TIMEOUT()
+    {
+        return DockerError(DOCKER_TIMEOUT, "Deadline exceeded", 0);
+    }
+
+    DockerError DockerError::D_CANCELLED()
+    {
+        return DockerError(DOCKER_CANCELLED, "Operation cancelled", 0);
+    }
+
+    DockerError DockerError::D_HTTP(int code, const char *body, std::size_t size)
+    {
+        return DockerError(code < 400 ? DOCKER_INFO : DOCKER_ERROR, size > 0 ? error_message(body, size) : std::string(), code);
+    }
+
+    DockerError DockerError::D_CONNECTION()
+    {
+        DockerError err(DOCKER_ERROR, "Could not communicate with the docker daemon", 0);
+        err.kind = ERR_CONNECTION;
+        return err;
+    }
+
     std::ostream& operator<<(std::ostream& os, const DockerError& err)
     {
-        os << "(" << err.errorCode << ")[" << err.apiErrorCode << "] : " << err.msg;
+        os << "(" << err.errorCode << ")[" << err.apiErrorCode << "] : " << err.message();
         return os;
     }
 } // namespace docker_cpp
@@ -0,0 +1,33 @@
+#include <docker_cpp/docker_health.h>
+
+namespace docker_cpp
+{
+	const char *health_name(ContainerHealth health)
+	{
+		switch (health)
+		{
+			case HEALTH_STARTING: return "starting";
+			case HEALTH_HEALTHY: return "healthy";
+			case HEALTH_UNHEALTHY: return "unhealthy";
+			default: return "none";
+		}
+	}
+
+	ContainerHealth parse_health(const std::string &status)
+	{
+		// The daemon appends the health to the status: "Up 5 minutes (healthy)"
+		if (status.empty() || status[status.size() - 1] != ')')
+			return HEALTH_NONE;
+		std::size_t open = status.rfind('(');
+		if (open == std::string::npos)
+			return HEALTH_NONE;
+		const std::string health = status.substr(open + 1, status.size() - open - 2);
+		if (health == "healthy")
+			return HEALTH_HEALTHY;
+		if (health == "unhealthy")
+			return HEALTH_UNHEALTHY;
+		if (health == "health: starting")
+			return HEALTH_STARTING;
+		return HEALTH_NONE;
+	}
+} // namespace docker_cpp
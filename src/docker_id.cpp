@@ -0,0 +1,122 @@
+#include <docker_cpp/docker_id.h>
+#include <docker_cpp/docker_types.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DOCKER_ID_SSE2 1
+#endif
+
+namespace docker_cpp
+{
+	static int hex_value(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		c = static_cast<char>(c | 0x20);
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		return -1;
+	}
+
+#ifdef DOCKER_ID_SSE2
+	// 16 hex digits -> 8 bytes
+	static bool hex_decode16(const char *hex, unsigned char *out)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hex));
+		// digits: v - '0' in [0, 9]; letters: (v | 0x20) - 'a' in [0, 5]. Bytes >= 0x80 wrap outside both ranges
+		const __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+		const __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		const __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(d, _mm_set1_epi8(-1)), _mm_cmplt_epi8(d, _mm_set1_epi8(10)));
+		const __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8(-1)), _mm_cmplt_epi8(l, _mm_set1_epi8(6)));
+		if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff) return false;
+
+		const __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, d), _mm_and_si128(isLetter, _mm_add_epi8(l, _mm_set1_epi8(10))));
+		// every 16-bit lane holds (high digit | low digit << 8): pack it into (high << 4 | low)
+		const __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(nibbles, 8));
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(pairs, pairs));
+		return true;
+	}
+
+	// 8 bytes -> 16 hex digits
+	static void hex_encode8(const unsigned char *data, char *out)
+	{
+		const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+		const __m128i mask = _mm_set1_epi8(0x0f);
+		const __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		const __m128i low = _mm_and_si128(v, mask);
+		const __m128i nibbles = _mm_unpacklo_epi8(high, low);
+		const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters));
+	}
+#endif
+
+	bool hex_decode(const char *hex, std::size_t size, unsigned char *out)
+	{
+		std::size_t i = 0;
+#ifdef DOCKER_ID_SSE2
+		for (; i + 8 <= size; i += 8)
+		{
+			if (!hex_decode16(hex + 2 * i, out + i)) return false;
+		}
+#endif
+		for (; i < size; ++i)
+		{
+			int high = hex_value(hex[2 * i]), low = hex_value(hex[2 * i + 1]);
+			if (high < 0 || low < 0) return false;
+			out[i] = static_cast<unsigned char>(high << 4 | low);
+		}
+		return true;
+	}
+
+	void hex_encode(const unsigned char *data, std::size_t size, char *out)
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::size_t i = 0;
+#ifdef DOCKER_ID_SSE2
+		for (; i + 8 <= size; i += 8)
+			hex_encode8(data + i, out + 2 * i);
+#endif
+		for (; i < size; ++i)
+		{
+			out[2 * i] = digits[data[i] >> 4];
+			out[2 * i + 1] = digits[data[i] & 0xf];
+		}
+	}
+
+	bool IdPrefix::parse(const std::string &hex)
+	{
+		std::size_t skip = hex.compare(0, 7, "sha256:") == 0 ? 7 : 0;
+		std::size_t digits = hex.size() - skip;
+		std::memset(_bytes, 0, sizeof(_bytes));
+		_digits = 0;
+		if (digits > 2 * ID_SIZE || !hex_decode(hex.data() + skip, digits / 2, _bytes))
+		{
+			std::memset(_bytes, 0, sizeof(_bytes));
+			return false;
+		}
+		if (digits % 2)
+		{
+			int high = hex_value(hex[skip + digits - 1]);
+			if (high < 0)
+			{
+				std::memset(_bytes, 0, sizeof(_bytes));
+				return false;
+			}
+			_bytes[digits / 2] = static_cast<unsigned char>(high << 4);
+		}
+		_digits = digits;
+		return true;
+	}
+
+	bool container_matches(const ContainerInfo &info, const std::string &key)
+	{
+		if (key.empty())
+			return false;
+		if (info.id.compare(0, key.size(), key) == 0)
+			return true;
+		for (const std::string &name : info.names)
+		{
+			if (name == key || (name.size() == key.size() + 1 && name[0] == '/' && name.compare(1, key.size(), key) == 0))
+				return true;
+		}
+		return false;
+	}
+} // namespace docker_cpp
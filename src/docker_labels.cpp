@@ -0,0 +1,313 @@
+#include <docker_cpp/docker_labels.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace docker_cpp
+{
+	//////// LabelSelector
+
+	static void skip_space(const std::string &s, std::size_t &i)
+	{
+		while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+	}
+
+	static bool is_label_char(char c)
+	{
+		return !std::isspace(static_cast<unsigned char>(c)) && c != ',' && c != '=' && c != '!' && c != '(' && c != ')';
+	}
+
+	static std::string read_token(const std::string &s, std::size_t &i)
+	{
+		skip_space(s, i);
+		std::size_t start = i;
+		while (i < s.size() && is_label_char(s[i])) ++i;
+		return s.substr(start, i - start);
+	}
+
+	// "(a, b, c)"
+	static bool read_set(const std::string &s, std::size_t &i, std::vector<std::string> &values)
+	{
+		skip_space(s, i);
+		if (i == s.size() || s[i] != '(') return false;
+		++i;
+		for (;;)
+		{
+			std::string v = read_token(s, i);
+			skip_space(s, i);
+			if (i == s.size()) return false;
+			if (!v.empty()) values.push_back(v);
+			if (s[i] == ')') break;
+			if (s[i] != ',' || v.empty()) return false;
+			++i;
+		}
+		++i;
+		return !values.empty();
+	}
+
+	bool LabelSelector::parse(const std::string &text, LabelSelector &out)
+	{
+		LabelSelector selector;
+		std::size_t i = 0;
+		skip_space(text, i);
+		while (i < text.size())
+		{
+			bool negated = text[i] == '!';
+			if (negated) ++i;
+			std::string key = read_token(text, i);
+			if (key.empty()) return false;
+			skip_space(text, i);
+
+			if (negated)
+			{
+				selector.notExists(key);
+			}
+			else if (i == text.size() || text[i] == ',')
+			{
+				selector.exists(key);
+			}
+			else if (text.compare(i, 2, "!=") == 0 || text[i] == '=')
+			{
+				bool different = text[i] == '!';
+				i += different || text.compare(i, 2, "==") == 0 ? 2 : 1;
+				std::string value = read_token(text, i); // may be empty: "key="
+				if (different) selector.notEquals(key, value);
+				else selector.equals(key, value);
+			}
+			else
+			{
+				std::string op = read_token(text, i);
+				std::vector<std::string> values;
+				if ((op != "in" && op != "notin") || !read_set(text, i, values)) return false;
+				if (op == "in") selector.in(key, values);
+				else selector.notIn(key, values);
+			}
+
+			skip_space(text, i);
+			if (i == text.size()) break;
+			if (text[i] != ',') return false;
+			++i;
+			skip_space(text, i);
+			if (i == text.size()) return false;
+		}
+		out = selector;
+		return true;
+	}
+
+	LabelSelector &LabelSelector::_add(const std::string &key, LabelRequirement::Op op, const std::vector<std::string> &values)
+	{
+		LabelRequirement r;
+		r.key = key;
+		r.op = op;
+		r.values = values;
+		_requirements.push_back(r);
+		return *this;
+	}
+
+	LabelSelector &LabelSelector::exists(const std::string &key) { return _add(key, LabelRequirement::EXISTS, std::vector<std::string>()); }
+	LabelSelector &LabelSelector::notExists(const std::string &key) { return _add(key, LabelRequirement::NOT_EXISTS, std::vector<std::string>()); }
+	LabelSelector &LabelSelector::equals(const std::string &key, const std::string &value) { return _add(key, LabelRequirement::EQUALS, std::vector<std::string>(1, value)); }
+	LabelSelector &LabelSelector::notEquals(const std::string &key, const std::string &value) { return _add(key, LabelRequirement::NOT_EQUALS, std::vector<std::string>(1, value)); }
+	LabelSelector &LabelSelector::in(const std::string &key, const std::vector<std::string> &values) { return _add(key, LabelRequirement::IN, values); }
+	LabelSelector &LabelSelector::notIn(const std::string &key, const std::vector<std::string> &values) { return _add(key, LabelRequirement::NOT_IN, values); }
+
+	bool LabelSelector::matches(const label_list &labels) const
+	{
+		for (const LabelRequirement &r : _requirements)
+		{
+			const std::string *value = nullptr;
+			for (const auto &l : labels)
+			{
+				if (l.first == r.key)
+				{
+					value = &l.second;
+					break;
+				}
+			}
+			bool inValues = value && std::find(r.values.begin(), r.values.end(), *value) != r.values.end();
+			switch (r.op)
+			{
+				case LabelRequirement::EXISTS: if (!value) return false; break;
+				case LabelRequirement::NOT_EXISTS: if (value) return false; break;
+				case LabelRequirement::EQUALS:
+				case LabelRequirement::IN: if (!inValues) return false; break;
+				case LabelRequirement::NOT_EQUALS:
+				case LabelRequirement::NOT_IN: if (inValues) return false; break;
+			}
+		}
+		return true;
+	}
+
+	std::string LabelSelector::str() const
+	{
+		std::string out;
+		for (const LabelRequirement &r : _requirements)
+		{
+			if (!out.empty()) out += ',';
+			switch (r.op)
+			{
+				case LabelRequirement::EXISTS: out += r.key; break;
+				case LabelRequirement::NOT_EXISTS: out += '!' + r.key; break;
+				case LabelRequirement::EQUALS: out += r.key + '=' + r.values[0]; break;
+				case LabelRequirement::NOT_EQUALS: out += r.key + "!=" + r.values[0]; break;
+				case LabelRequirement::IN:
+				case LabelRequirement::NOT_IN:
+				{
+					out += r.key + (r.op == LabelRequirement::IN ? " in (" : " notin (");
+					for (std::size_t i = 0; i < r.values.size(); ++i)
+						out += (i ? "," : "") + r.values[i];
+					out += ')';
+				}
+			}
+		}
+		return out;
+	}
+
+	//////// LabelIndex
+
+	void LabelIndex::_clear(std::size_t size)
+	{
+		_keys.clear();
+		_size = size;
+	}
+
+	void LabelIndex::_add(std::uint32_t position, const label_list &labels)
+	{
+		for (const auto &l : labels)
+		{
+			KeyPostings &k = _keys[l.first];
+			if (!k.all.empty() && k.all.back() == position) continue; // repeated key: the first value counts, as in matches()
+			k.all.push_back(position);
+			k.byValue[l.second].push_back(position);
+		}
+	}
+
+	void LabelIndex::build(const ContainerList &containers)
+	{
+		build(containers.size(), [&](std::size_t i) -> const label_list & { return containers[i].labels; });
+	}
+
+	void LabelIndex::build(const ImageList &images)
+	{
+		build(images.size(), [&](std::size_t i) -> const label_list & { return images[i].labels; });
+	}
+
+	const LabelIndex::positions *LabelIndex::_postings(const std::string &key, const std::string *value) const
+	{
+		auto k = _keys.find(key);
+		if (k == _keys.end()) return nullptr;
+		if (!value) return &k->second.all;
+		auto v = k->second.byValue.find(*value);
+		return v == k->second.byValue.end() ? nullptr : &v->second;
+	}
+
+	// Positions having one of the values of the requirement
+	void LabelIndex::_union(const LabelRequirement &r, positions &out) const
+	{
+		out.clear();
+		for (const std::string &value : r.values)
+		{
+			const positions *p = _postings(r.key, &value);
+			if (!p) continue;
+			if (out.empty())
+			{
+				out = *p;
+				continue;
+			}
+			positions merged;
+			merged.reserve(out.size() + p->size());
+			std::set_union(out.begin(), out.end(), p->begin(), p->end(), std::back_inserter(merged));
+			out.swap(merged);
+		}
+	}
+
+	void LabelIndex::select(const LabelSelector &selector, positions &out) const
+	{
+		// Lists every positive requirement must intersect, owned here when they are unions of several values
+		std::vector<const positions *> include;
+		std::vector<positions> unions;
+		unions.reserve(selector.requirements().size());
+		for (const LabelRequirement &r : selector.requirements())
+		{
+			if (r.op == LabelRequirement::EXISTS || (r.op == LabelRequirement::EQUALS) || (r.op == LabelRequirement::IN && r.values.size() == 1))
+			{
+				const positions *p = _postings(r.key, r.op == LabelRequirement::EXISTS ? nullptr : &r.values[0]);
+				if (!p)
+				{
+					out.clear();
+					return;
+				}
+				include.push_back(p);
+			}
+			else if (r.op == LabelRequirement::IN)
+			{
+				unions.push_back(positions());
+				_union(r, unions.back());
+				include.push_back(&unions.back());
+			}
+		}
+
+		if (include.empty())
+		{
+			out.resize(_size);
+			for (std::size_t i = 0; i < _size; ++i)
+				out[i] = static_cast<std::uint32_t>(i);
+		}
+		else
+		{
+			// Intersect from the shortest list so that the working set only shrinks
+			std::sort(include.begin(), include.end(), [](const positions *a, const positions *b) { return a->size() < b->size(); });
+			out = *include[0];
+			positions next;
+			for (std::size_t i = 1; i < include.size() && !out.empty(); ++i)
+			{
+				next.clear();
+				std::set_intersection(out.begin(), out.end(), include[i]->begin(), include[i]->end(), std::back_inserter(next));
+				out.swap(next);
+			}
+		}
+
+		positions excluded, next;
+		for (const LabelRequirement &r : selector.requirements())
+		{
+			if (out.empty()) return;
+			const positions *p = nullptr;
+			if (r.op == LabelRequirement::NOT_EXISTS)
+			{
+				p = _postings(r.key, nullptr);
+			}
+			else if (r.op == LabelRequirement::NOT_EQUALS || (r.op == LabelRequirement::NOT_IN && r.values.size() == 1))
+			{
+				p = _postings(r.key, &r.values[0]);
+			}
+			else if (r.op == LabelRequirement::NOT_IN)
+			{
+				_union(r, excluded);
+				p = &excluded;
+			}
+			if (!p || p->empty()) continue;
+			next.clear();
+			std::set_difference(out.begin(), out.end(), p->begin(), p->end(), std::back_inserter(next));
+			out.swap(next);
+		}
+	}
+
+	std::size_t LabelIndex::count(const LabelSelector &selector) const
+	{
+		positions p;
+		select(selector, p);
+		return p.size();
+	}
+
+	std::vector<std::pair<std::string, std::size_t> > LabelIndex::values(const std::string &key) const
+	{
+		std::vector<std::pair<std::string, std::size_t> > out;
+		auto k = _keys.find(key);
+		if (k == _keys.end()) return out;
+		for (const auto &v : k->second.byValue)
+			out.push_back(std::make_pair(v.first, v.second.size()));
+		std::sort(out.begin(), out.end());
+		return out;
+	}
+} // namespace docker_cpp
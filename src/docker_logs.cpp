@@ -0,0 +1,232 @@
+#include <docker_cpp/docker_logs.h>
+#include <docker_cpp/docker_http.h>
+
+#include <cstring>
+
+namespace docker_cpp
+{
+	static bool digits(const char *text, std::size_t count, int &value)
+	{
+		value = 0;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (text[i] < '0' || text[i] > '9') return false;
+			value = value * 10 + (text[i] - '0');
+		}
+		return true;
+	}
+
+	// Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+	static std::int64_t days_from_civil(int y, int m, int d)
+	{
+		y -= m <= 2;
+		const std::int64_t era = (y >= 0 ? y : y - 399) / 400;
+		const std::int64_t yoe = y - era * 400;
+		const std::int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+		const std::int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + doe - 719468;
+	}
+
+	bool parse_timestamp(const char *text, std::size_t size, std::int64_t &ns)
+	{
+		// 2006-01-02T15:04:05[.999999999](Z|+07:00)
+		int year, month, day, hour, minute, second;
+		if (size < 20 || text[4] != '-' || text[7] != '-' || (text[10] != 'T' && text[10] != 't') || text[13] != ':' || text[16] != ':')
+			return false;
+		if (!digits(text, 4, year) || !digits(text + 5, 2, month) || !digits(text + 8, 2, day) ||
+			!digits(text + 11, 2, hour) || !digits(text + 14, 2, minute) || !digits(text + 17, 2, second))
+			return false;
+		if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+			return false;
+
+		std::size_t pos = 19;
+		std::int64_t fraction = 0;
+		if (text[pos] == '.')
+		{
+			std::size_t count = 0;
+			for (++pos; pos < size && text[pos] >= '0' && text[pos] <= '9'; ++pos, ++count)
+			{
+				if (count < 9) fraction = fraction * 10 + (text[pos] - '0');
+			}
+			if (count == 0) return false;
+			for (; count < 9; ++count) fraction *= 10;
+		}
+
+		std::int64_t offset = 0;
+		if (pos < size && (text[pos] == 'Z' || text[pos] == 'z'))
+		{
+			++pos;
+		}
+		else if (pos + 6 <= size && (text[pos] == '+' || text[pos] == '-') && text[pos + 3] == ':')
+		{
+			int oh, om;
+			if (!digits(text + pos + 1, 2, oh) || !digits(text + pos + 4, 2, om)) return false;
+			offset = (text[pos] == '+' ? 1 : -1) * (oh * 3600 + om * 60);
+			pos += 6;
+		}
+		else
+		{
+			return false;
+		}
+		if (pos != size) return false;
+
+		std::int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+		ns = seconds * 1000000000 + fraction;
+		return true;
+	}
+
+	std::string LogCursor::since() const
+	{
+		return ns_timestamp_param(timestamp);
+	}
+
+	bool LogQueue::push(LogBatch &&batch)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		bool interrupted = false;
+		_notFull.wait(lock, [&] {
+			interrupted = call_interrupted();
+			return _closed || interrupted || _bytes < _capacity || _batches.empty();
+		});
+		if (_closed || interrupted)
+			return false;
+		_bytes += batch.bytes();
+		_batches.push_back(std::move(batch));
+		_notEmpty.notify_one();
+		return true;
+	}
+
+	std::size_t LogQueue::pop(std::vector<LogBatch> &out, std::size_t max, std::chrono::milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait_for(lock, timeout, [this] { return _closed || !_batches.empty(); });
+		std::size_t count = 0;
+		for (; count < max && !_batches.empty(); ++count)
+		{
+			_bytes -= _batches.front().bytes();
+			out.push_back(std::move(_batches.front()));
+			_batches.pop_front();
+		}
+		if (count > 0)
+			_notFull.notify_all();
+		return count;
+	}
+
+	void LogQueue::interrupt()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_notFull.notify_all();
+	}
+
+	void LogQueue::close()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+		_notFull.notify_all();
+		_notEmpty.notify_all();
+	}
+
+	bool LogQueue::closed() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _closed;
+	}
+
+	std::size_t LogQueue::size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _batches.size();
+	}
+
+	std::size_t LogQueue::bytes() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _bytes;
+	}
+
+	LogParser::LogParser(const std::string &container, LogCursor &cursor, const BatchHandler &onBatch, std::size_t batchLines, std::size_t batchBytes)
+		: _container(container), _cursor(cursor), _onBatch(onBatch), _batchLines(batchLines), _batchBytes(batchBytes),
+		  _pending(cursor), _skipAt(cursor.timestamp), _skip(cursor.count), _lines(0),
+		  _out([this](const char *line, std::size_t size) { return _line(StreamDemuxer::STDOUT, line, size); }),
+		  _err([this](const char *line, std::size_t size) { return _line(StreamDemuxer::STDERR, line, size); })
+	{
+	}
+
+	bool LogParser::_line(std::uint8_t stream, const char *line, std::size_t size)
+	{
+		std::int64_t timestamp = 0;
+		const char *space = static_cast<const char *>(std::memchr(line, ' ', size));
+		std::size_t prefix = space ? static_cast<std::size_t>(space - line) : size;
+		bool stamped = parse_timestamp(line, prefix, timestamp);
+		if (stamped)
+		{
+			line += prefix + (space ? 1 : 0);
+			size -= prefix + (space ? 1 : 0);
+			if (_skip > 0 && timestamp == _skipAt)
+			{
+				--_skip;
+				return true;
+			}
+			_skip = 0;
+		}
+
+		// The cursor of a full batch must not cover this line yet
+		if (!_batch.entries.empty() && (_batch.entries.size() >= _batchLines || _batch.data.size() + size > _batchBytes) && !_flush())
+			return false;
+		if (stamped && timestamp > _pending.timestamp)
+		{
+			_pending.timestamp = timestamp;
+			_pending.count = 1;
+		}
+		else if (stamped && timestamp == _pending.timestamp)
+		{
+			++_pending.count;
+		}
+		LogEntry entry;
+		entry.timestamp = timestamp;
+		entry.offset = static_cast<std::uint32_t>(_batch.data.size());
+		entry.size = static_cast<std::uint32_t>(size);
+		entry.stream = stream;
+		_batch.data.append(line, size);
+		_batch.entries.push_back(entry);
+		return true;
+	}
+
+	bool LogParser::_flush()
+	{
+		if (_batch.entries.empty())
+			return true;
+		_batch.container = _container;
+		_batch.cursor = _pending;
+		std::size_t lines = _batch.entries.size();
+		bool more = _onBatch(_batch);
+		_batch = LogBatch();
+		// A refused batch was not delivered: a resumed request sends its lines again
+		if (!more)
+		{
+			_pending = _cursor;
+			return false;
+		}
+		_cursor = _pending;
+		_lines += lines;
+		return true;
+	}
+
+	bool LogParser::feed(const char *data, std::size_t size)
+	{
+		if (size == 0)
+			return true;
+		if (!_demux)
+		{
+			// A multiplexed stream starts with the header of a frame ({0, 1 or 2}, 0, 0, 0), a timestamp with a digit
+			bool raw = static_cast<unsigned char>(data[0]) > StreamDemuxer::STDERR;
+			_demux.reset(new StreamDemuxer(_out.sink(), _err.sink(), raw));
+		}
+		return _demux->feed(data, size) && _flush();
+	}
+
+	bool LogParser::finish()
+	{
+		return _out.finish() && _err.finish() && _flush();
+	}
+} // namespace docker_cpp
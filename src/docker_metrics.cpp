@@ -0,0 +1,176 @@
+#include <docker_cpp/docker_metrics.h>
+
+#include <sstream>
+
+namespace docker_cpp
+{
+	namespace
+	{
+		const char *const operation_names[OP_COUNT] = {
+			"version", "ping",
+			"imageList", "imageCreate", "imageTag", "imageRemove", "imagePrune", "imageBuild", "imageExport", "imageLoad",
+			"containerList", "containerStart", "containerStop", "containerRestart", "containerKill",
+			"containerRename", "containerPause", "containerUnpause", "containerWait", "containerRemove",
+			"containerArchiveInfo", "containerArchiveGet", "containerArchivePut", "containerLogs",
+			"events", "execCreate", "execStart", "execResize", "execInspect"};
+
+		int highest_bit(std::uint64_t v)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return 63 - __builtin_clzll(v);
+#else
+			int n = 0;
+			while (v >>= 1)
+				n++;
+			return n;
+#endif
+		}
+
+		void write_histogram(std::ostream &out, const char *name, const LatencyHistogram &h)
+		{
+			out << ",\"" << name << "\":{\"count\":" << h.count() << ",\"mean\":" << std::uint64_t(h.mean())
+				<< ",\"p50\":" << h.percentile(0.5) << ",\"p90\":" << h.percentile(0.9)
+				<< ",\"p99\":" << h.percentile(0.99) << ",\"max\":" << h.max() << "}";
+		}
+	} // namespace
+
+	const char *operation_name(DockerOperation op)
+	{
+		return op >= 0 && op < OP_COUNT ? operation_names[op] : "unknown";
+	}
+
+	RequestTimings *&current_request_timings()
+	{
+		static thread_local RequestTimings *timings = nullptr;
+		return timings;
+	}
+
+	int LatencyHistogram::bucket(std::uint64_t value)
+	{
+		if (value < std::uint64_t(SUB_BUCKETS))
+			return int(value);
+		int shift = highest_bit(value) - SUB_BITS;
+		return (shift + 1) * SUB_BUCKETS + int((value >> shift) & (SUB_BUCKETS - 1));
+	}
+
+	std::uint64_t LatencyHistogram::bucketLow(int bucket)
+	{
+		if (bucket < SUB_BUCKETS)
+			return std::uint64_t(bucket);
+		int shift = bucket / SUB_BUCKETS - 1;
+		return std::uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	}
+
+	void LatencyHistogram::record(std::uint64_t value)
+	{
+		_buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_sum.fetch_add(value, std::memory_order_relaxed);
+		std::uint64_t m = _max.load(std::memory_order_relaxed);
+		while (value > m && !_max.compare_exchange_weak(m, value, std::memory_order_relaxed))
+			;
+	}
+
+	void LatencyHistogram::reset()
+	{
+		for (auto &b : _buckets)
+			b.store(0, std::memory_order_relaxed);
+		_count = 0;
+		_sum = 0;
+		_max = 0;
+	}
+
+	std::uint64_t LatencyHistogram::percentile(double q) const
+	{
+		std::uint64_t n = count();
+		if (n == 0)
+			return 0;
+		std::uint64_t rank = std::uint64_t(q * double(n));
+		if (rank >= n)
+			rank = n - 1;
+		std::uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++)
+		{
+			seen += _buckets[i].load(std::memory_order_relaxed);
+			if (seen > rank)
+			{
+				// middle of the bucket, never above the largest recorded value
+				std::uint64_t low = bucketLow(i);
+				std::uint64_t high = i + 1 < BUCKETS ? bucketLow(i + 1) - 1 : low;
+				std::uint64_t mid = low + (high - low) / 2;
+				return mid < max() ? mid : max();
+			}
+		}
+		return max();
+	}
+
+	void OperationMetrics::reset()
+	{
+		total.reset();
+		connect.reset();
+		firstByte.reset();
+		transfer.reset();
+		parse.reset();
+		bytes = 0;
+		for (auto &s : status)
+			s = 0;
+	}
+
+	void DockerMetrics::record(DockerOperation op, const RequestTimings &timings, std::int64_t totalNs)
+	{
+		OperationMetrics &m = _ops[op];
+		m.total.record(std::uint64_t(totalNs));
+		if (timings.connectNs >= 0)
+			m.connect.record(std::uint64_t(timings.connectNs));
+		if (timings.firstByteNs >= 0)
+			m.firstByte.record(std::uint64_t(timings.firstByteNs));
+		if (timings.transferNs >= 0)
+			m.transfer.record(std::uint64_t(timings.transferNs));
+		if (timings.parseNs >= 0)
+			m.parse.record(std::uint64_t(timings.parseNs));
+		m.bytes.fetch_add(timings.bytes, std::memory_order_relaxed);
+		int cls = timings.status >= 100 && timings.status < 600 ? timings.status / 100 : 0;
+		m.status[cls].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void DockerMetrics::reset()
+	{
+		for (auto &op : _ops)
+			op.reset();
+	}
+
+	std::string DockerMetrics::toJson() const
+	{
+		std::ostringstream out;
+		out << "{";
+		bool first = true;
+		for (int i = 0; i < OP_COUNT; i++)
+		{
+			const OperationMetrics &m = _ops[i];
+			if (m.total.count() == 0)
+				continue;
+			out << (first ? "" : ",") << "\"" << operation_names[i] << "\":{\"count\":" << m.total.count()
+				<< ",\"bytes\":" << m.bytes.load() << ",\"status\":{";
+			static const char *const classes[6] = {"failed", "1xx", "2xx", "3xx", "4xx", "5xx"};
+			bool firstStatus = true;
+			for (int c = 0; c < 6; c++)
+			{
+				std::uint64_t n = m.status[c].load();
+				if (n == 0)
+					continue;
+				out << (firstStatus ? "" : ",") << "\"" << classes[c] << "\":" << n;
+				firstStatus = false;
+			}
+			out << "}";
+			write_histogram(out, "total_ns", m.total);
+			write_histogram(out, "connect_ns", m.connect);
+			write_histogram(out, "first_byte_ns", m.firstByte);
+			write_histogram(out, "transfer_ns", m.transfer);
+			write_histogram(out, "parse_ns", m.parse);
+			out << "}";
+			first = false;
+		}
+		out << "}";
+		return out.str();
+	}
+} // namespace docker_cpp
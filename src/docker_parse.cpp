@@ -1,5 +1,6 @@
 #include <docker_cpp/docker_parse.h>
 
+#include <asl/JSON.h>
 #include <asl/String.h>
 #include <asl/Var.h>
 
@@ -13,6 +14,8 @@ namespace docker_cpp
 			ImageInfo info;
 			info.id = *image["Id"].toString();
 			info.parentId = *image["ParentId"].toString();
+			info.key.parse(info.id);
+			info.parentKey.parse(info.parentId);
 			foreach (asl::Var &tag, image["RepoTags"])
 			{
 				info.repoTags.push_back(*tag.toString());
@@ -21,15 +24,15 @@ namespace docker_cpp
 			{
 				info.repoDigests.push_back(*repo.toString());
 			}
-			info.created = image["Created"];
-			info.size = image["Size"];
-			info.virtualSize = image["VirtualSize"];
-			info.sharedSize = image["SharedSize"];
+			info.created = static_cast<asl::Long>(image["Created"]);
+			info.size = static_cast<asl::Long>(image["Size"]);
+			info.virtualSize = static_cast<asl::Long>(image["VirtualSize"]);
+			info.sharedSize = static_cast<asl::Long>(image["SharedSize"]);
 			if (image.has("Labels"))
 			{
 				for (auto &l : image["Labels"].object())
 				{
-					auto entry = std::make_pair(*l.key, *l.value.toString());
+					std::pair<std::string, std::string> entry(*l.key, *l.value.toString());
 					info.labels.push_back(entry);
 				}
 			}
@@ -53,7 +56,17 @@ namespace docker_cpp
 		if (in.has("ImagesDeleted")) {
 			parse(in["ImagesDeleted"], out.imagesDeleted);
 		}
-		out.spaceReclaimed = (asl::ULong)in["SpaceReclamed"];
+		out.spaceReclaimed = (asl::ULong)in["SpaceReclaimed"];
+	}
+
+	void parse(const asl::Var &in, BuildMessage &out)
+	{
+		if (in.has("stream")) out.stream = *in["stream"].toString();
+		if (in.has("status")) out.status = *in["status"].toString();
+		if (in.has("id")) out.id = *in["id"].toString();
+		if (in.has("progress")) out.progress = *in["progress"].toString();
+		if (in.has("error")) out.error = *in["error"].toString();
+		if (in.has("aux") && in["aux"].has("ID")) out.imageId = *in["aux"]["ID"].toString();
 	}
 
 	void parse(const asl::Var &in, ContainerList &out)
@@ -68,6 +81,8 @@ namespace docker_cpp
 			}
 			info.image = *container["Image"].toString();
 			info.imageID = *container["ImageID"].toString();
+			info.key.parse(info.id);
+			info.imageKey.parse(info.imageID);
 			info.command = *container["Command"].toString();
 			info.created = static_cast<asl::Long>(container["Created"]);
 			if (container.has("Ports"))
@@ -85,7 +100,7 @@ namespace docker_cpp
 			{
 				for (auto &l : container["Labels"].object())
 				{
-					auto entry = std::make_pair(*l.key, *l.value.toString());
+					std::pair<std::string, std::string> entry(*l.key, *l.value.toString());
 					info.labels.push_back(entry);
 				}
 			}
@@ -165,6 +180,22 @@ namespace docker_cpp
 		out.goVersion = *(in["GoVersion"].toString());
 	}
 
+	void parse(const asl::Var &in, EventMessage &out)
+	{
+		out.type = *in["Type"].toString();
+		out.action = *in["Action"].toString();
+		if (in.has("Actor"))
+		{
+			out.actorId = *in["Actor"]["ID"].toString();
+			if (in["Actor"].has("Attributes"))
+			{
+				for (auto &a : in["Actor"]["Attributes"].object())
+					out.attributes.push_back(std::make_pair(*a.key, *a.value.toString()));
+			}
+		}
+		out.timeNano = static_cast<asl::Long>(in["timeNano"]);
+	}
+
 	void parse(const asl::Var &in, WaitInfo &out)
 	{
 		out.statusCode = in["StatusCode"];
@@ -200,4 +231,47 @@ namespace docker_cpp
 		}
 	}
 
+	void parse(const asl::Var &in, PathStat &out)
+	{
+		out.name = *in["name"].toString();
+		out.size = static_cast<asl::Long>(in["size"]);
+		out.mode = static_cast<unsigned int>(static_cast<asl::Long>(in["mode"]));
+		out.mtime = *in["mtime"].toString();
+		if (in.has("linkTarget")) out.linkTarget = *in["linkTarget"].toString();
+	}
+
+	static int base64_value(char c)
+	{
+		if (c >= 'A' && c <= 'Z') return c - 'A';
+		if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if (c >= '0' && c <= '9') return c - '0' + 52;
+		if (c == '+' || c == '-') return 62;
+		if (c == '/' || c == '_') return 63;
+		return -1;
+	}
+
+	bool parse_path_stat(const std::string &header, PathStat &out)
+	{
+		std::string json;
+		unsigned int bits = 0;
+		int count = 0;
+		for (char c : header)
+		{
+			if (c == '=' || c == ' ' || c == '\r' || c == '\n') continue;
+			int v = base64_value(c);
+			if (v < 0) return false;
+			bits = (bits << 6) | static_cast<unsigned int>(v);
+			count += 6;
+			if (count >= 8)
+			{
+				count -= 8;
+				json += static_cast<char>((bits >> count) & 0xff);
+			}
+		}
+		asl::Var stat = asl::Json::decode(asl::String(json.c_str()));
+		if (!stat.has("name")) return false;
+		parse(stat, out);
+		return true;
+	}
+
 } // namespace docker_cpp
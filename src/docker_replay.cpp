@@ -0,0 +1,173 @@
+#include <docker_cpp/docker_replay.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace docker_cpp
+{
+	static const char LOG_MAGIC[4] = {'D', 'K', 'R', 'L'};
+	static const std::uint32_t LOG_VERSION = 1;
+
+	static void put_int(std::string &out, std::uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out += static_cast<char>((v >> (8 * i)) & 0xff);
+	}
+
+	static void put_string(std::string &out, const std::string &s)
+	{
+		put_int(out, s.size(), 4);
+		out += s;
+	}
+
+	static bool get_int(std::istream &in, std::uint64_t &v, int bytes)
+	{
+		unsigned char b[8];
+		if (!in.read(reinterpret_cast<char *>(b), bytes))
+			return false;
+		v = 0;
+		for (int i = 0; i < bytes; i++)
+			v |= std::uint64_t(b[i]) << (8 * i);
+		return true;
+	}
+
+	// `end`: size of the stream, which bounds the length read from it before anything is allocated
+	static bool get_string(std::istream &in, std::string &s, std::uint64_t end)
+	{
+		std::uint64_t size;
+		if (!get_int(in, size, 4))
+			return false;
+		std::streamoff pos = in.tellg();
+		if (pos < 0 || size > end - static_cast<std::uint64_t>(pos))
+			return false;
+		s.resize(static_cast<std::size_t>(size));
+		return size == 0 || in.read(&s[0], static_cast<std::streamsize>(size));
+	}
+
+	void ExchangeLog::add(const RecordedExchange &exchange)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exchanges.push_back(exchange);
+	}
+
+	std::vector<RecordedExchange> ExchangeLog::exchanges() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _exchanges;
+	}
+
+	std::size_t ExchangeLog::size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _exchanges.size();
+	}
+
+	void ExchangeLog::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exchanges.clear();
+	}
+
+	bool ExchangeLog::save(const std::string &path) const
+	{
+		std::string out(LOG_MAGIC, sizeof(LOG_MAGIC));
+		put_int(out, LOG_VERSION, 4);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const RecordedExchange &e : _exchanges)
+			{
+				put_int(out, e.offsetNs, 8);
+				put_int(out, e.durationNs, 8);
+				put_int(out, static_cast<std::uint32_t>(e.code), 4);
+				put_string(out, e.method);
+				put_string(out, e.path);
+				put_string(out, e.request);
+				put_string(out, e.response);
+			}
+		}
+		std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+		return file.write(out.data(), static_cast<std::streamsize>(out.size())) && file.flush();
+	}
+
+	bool ExchangeLog::load(const std::string &path)
+	{
+		std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+		std::streamoff end = file.tellg();
+		file.seekg(0);
+		char magic[4];
+		std::uint64_t version;
+		if (end < 0 || !file.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, LOG_MAGIC) ||
+			!get_int(file, version, 4) || version != LOG_VERSION)
+			return false;
+
+		std::vector<RecordedExchange> exchanges;
+		for (;;)
+		{
+			RecordedExchange e;
+			std::uint64_t code;
+			if (!get_int(file, e.offsetNs, 8))
+				break; // end of the log
+			if (!get_int(file, e.durationNs, 8) || !get_int(file, code, 4) || !get_string(file, e.method, end) ||
+				!get_string(file, e.path, end) || !get_string(file, e.request, end) || !get_string(file, e.response, end))
+				return false;
+			e.code = static_cast<int>(static_cast<std::int32_t>(code));
+			exchanges.push_back(e);
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exchanges.swap(exchanges);
+		return true;
+	}
+
+	std::string ExchangeLog::relativePath(const std::string &uri)
+	{
+		DockerUrl url;
+		return DockerUrl::parse(uri, url) ? url.path : uri;
+	}
+
+	void ReplayHttp::load(const ExchangeLog &log)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queues.clear();
+		_misses = 0;
+		for (const RecordedExchange &e : log.exchanges())
+			_queues[e.method + " " + e.path].push_back(e);
+	}
+
+	bool ReplayHttp::load(const std::string &path)
+	{
+		ExchangeLog log;
+		if (!log.load(path))
+			return false;
+		load(log);
+		return true;
+	}
+
+	std::size_t ReplayHttp::misses() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _misses;
+	}
+
+	std::size_t ReplayHttp::remaining() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::size_t n = 0;
+		for (auto &q : _queues)
+			n += q.second.size();
+		return n;
+	}
+
+	bool ReplayHttp::_next(const std::string &method, const std::string &uri, RecordedExchange &exchange)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _queues.find(method + " " + ExchangeLog::relativePath(uri));
+		if (it == _queues.end() || it->second.empty())
+		{
+			_misses++;
+			return false;
+		}
+		exchange = std::move(it->second.front());
+		it->second.pop_front();
+		return true;
+	}
+} // namespace docker_cpp
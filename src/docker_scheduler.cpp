@@ -0,0 +1,268 @@
+#include <docker_cpp/docker_scheduler.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace docker_cpp
+{
+	namespace
+	{
+		const char *const priority_names[PRIORITY_COUNT] = {"health", "control", "bulk"};
+
+		// Segments of the API path of a request, without the version prefix, and its query
+		void api_path(const std::string &uri, std::vector<std::string> &segments, std::string &query)
+		{
+			DockerUrl url;
+			std::string path = DockerUrl::parse(uri, url) ? url.path : uri;
+			std::size_t mark = path.find('?');
+			query = mark == std::string::npos ? std::string() : path.substr(mark + 1);
+			path.resize(std::min(mark, path.size()));
+
+			std::size_t start = 0;
+			while (start < path.size())
+			{
+				std::size_t end = path.find('/', start);
+				if (end == std::string::npos) end = path.size();
+				if (end > start) segments.push_back(path.substr(start, end - start));
+				start = end + 1;
+			}
+			if (!segments.empty() && segments[0].size() > 1 && segments[0][0] == 'v' && segments[0].find('.') != std::string::npos &&
+				segments[0].find_first_not_of("0123456789.", 1) == std::string::npos)
+				segments.erase(segments.begin());
+		}
+
+		// Value of a boolean query parameter: 1 for true, 0 for false, -1 if it is missing
+		int query_flag(const std::string &query, const std::string &name)
+		{
+			std::size_t pos = 0;
+			while (pos < query.size())
+			{
+				std::size_t end = query.find('&', pos);
+				if (end == std::string::npos) end = query.size();
+				if (query.compare(pos, name.size() + 1, name + "=") == 0)
+				{
+					std::string value = query.substr(pos + name.size() + 1, end - pos - name.size() - 1);
+					return value == "1" || value == "true" || value == "True" ? 1 : 0;
+				}
+				pos = end + 1;
+			}
+			return -1;
+		}
+
+		void write_histogram(std::ostream &out, const char *name, const LatencyHistogram &h)
+		{
+			out << ",\"" << name << "\":{\"count\":" << h.count() << ",\"mean\":" << std::uint64_t(h.mean())
+				<< ",\"p50\":" << h.percentile(0.5) << ",\"p90\":" << h.percentile(0.9)
+				<< ",\"p99\":" << h.percentile(0.99) << ",\"max\":" << h.max() << "}";
+		}
+
+		RequestPriority &scope_priority()
+		{
+			static thread_local RequestPriority priority = PRIORITY_COUNT;
+			return priority;
+		}
+	} // namespace
+
+	const char *priority_name(RequestPriority priority)
+	{
+		return priority >= 0 && priority < PRIORITY_COUNT ? priority_names[priority] : "unknown";
+	}
+
+	RequestPriority request_priority(const std::string &method, const std::string &uri)
+	{
+		std::vector<std::string> s;
+		std::string query;
+		api_path(uri, s, query);
+		if (s.empty())
+			return PRIORITY_CONTROL;
+		if (s.size() == 1 && (s[0] == "_ping" || s[0] == "version" || s[0] == "info"))
+			return PRIORITY_HEALTH;
+		if (s[0] == "build")
+			return PRIORITY_BULK;
+		if (s[0] == "images" && s.size() >= 2)
+		{
+			// Image names may hold slashes: /images/{name}/get, /images/{name}/push
+			if (s.size() == 2 && (s[1] == "create" || s[1] == "load" || s[1] == "get" || s[1] == "prune"))
+				return PRIORITY_BULK;
+			if (method == "DELETE" || (s.size() >= 3 && (s.back() == "get" || s.back() == "push")))
+				return PRIORITY_BULK;
+		}
+		if (s[0] == "containers" && s.size() == 2 && s[1] == "prune")
+			return PRIORITY_BULK;
+		if (s[0] == "containers" && s.size() == 3 && ((s[2] == "archive" && method != "HEAD") || s[2] == "export"))
+			return PRIORITY_BULK;
+		if (s.size() == 2 && s[1] == "prune" && (s[0] == "volumes" || s[0] == "networks"))
+			return PRIORITY_BULK;
+		if (s.size() == 2 && s[0] == "system" && s[1] == "df")
+			return PRIORITY_BULK;
+		return PRIORITY_CONTROL;
+	}
+
+	bool request_long_lived(const std::string &method, const std::string &uri)
+	{
+		std::vector<std::string> s;
+		std::string query;
+		api_path(uri, s, query);
+		if (s.size() == 1 && s[0] == "events")
+			return true;
+		// An attached exec lasts as long as its command
+		if (s.size() == 3 && s[0] == "exec" && s[2] == "start")
+			return method == "POST";
+		if (s.size() != 3 || s[0] != "containers")
+			return false;
+		if (s[2] == "wait" || s[2] == "attach")
+			return method == "POST";
+		if (s[2] == "logs")
+			return query_flag(query, "follow") == 1;
+		if (s[2] == "stats")
+			return query_flag(query, "stream") != 0;
+		return false;
+	}
+
+	//////// PriorityScope
+
+	PriorityScope::PriorityScope(RequestPriority priority) : _outer(scope_priority())
+	{
+		scope_priority() = priority;
+	}
+
+	PriorityScope::~PriorityScope()
+	{
+		scope_priority() = _outer;
+	}
+
+	RequestPriority PriorityScope::current()
+	{
+		return scope_priority();
+	}
+
+	//////// RequestScheduler
+
+	RequestScheduler::RequestScheduler(const SchedulerOptions &options) : _options(options), _total(0), _controlTurns(0)
+	{
+		_options.maxInFlight = std::max(_options.maxInFlight, 1u);
+		_options.maxBulk = std::min(std::max(_options.maxBulk, 1u), _options.maxInFlight);
+		for (int i = 0; i < PRIORITY_COUNT; i++)
+		{
+			_maxQueued[i] = 0;
+			_inFlight[i] = 0;
+			_admitted[i] = 0;
+			_abandoned[i] = 0;
+		}
+	}
+
+	bool RequestScheduler::acquire(RequestPriority priority)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Waiter waiter;
+		std::unique_lock<std::mutex> lock(_mutex);
+		std::deque<Waiter *> &queue = _queues[priority];
+		queue.push_back(&waiter);
+		_dispatch();
+		if (!waiter.admitted)
+			_maxQueued[priority] = std::max(_maxQueued[priority], queue.size());
+
+		while (!waiter.admitted)
+		{
+			CallContext *context = current_call_context();
+			if (!context)
+			{
+				waiter.cv.wait(lock);
+				continue;
+			}
+			if (context->expired() || context->cancelled())
+			{
+				queue.erase(std::find(queue.begin(), queue.end(), &waiter));
+				_abandoned[priority].fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			// Cancellation tokens cannot wake the wait up: check them every few milliseconds
+			int ms = context->remainingMs();
+			waiter.cv.wait_for(lock, std::chrono::milliseconds(ms < 0 || ms > 10 ? 10 : ms));
+		}
+		_wait[priority].record(static_cast<std::uint64_t>(elapsed_ns(start)));
+		return true;
+	}
+
+	void RequestScheduler::release(RequestPriority priority)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		--_inFlight[priority];
+		--_total;
+		_dispatch();
+	}
+
+	void RequestScheduler::_dispatch()
+	{
+		while (_total < _options.maxInFlight)
+		{
+			if (!_queues[PRIORITY_HEALTH].empty())
+			{
+				_admit(PRIORITY_HEALTH);
+				continue;
+			}
+			bool control = !_queues[PRIORITY_CONTROL].empty();
+			bool bulk = !_queues[PRIORITY_BULK].empty() && _inFlight[PRIORITY_BULK] < _options.maxBulk;
+			if (control && (!bulk || _controlTurns < _options.controlWeight))
+			{
+				_admit(PRIORITY_CONTROL);
+				++_controlTurns;
+			}
+			else if (bulk)
+			{
+				_admit(PRIORITY_BULK);
+				_controlTurns = 0;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	void RequestScheduler::_admit(RequestPriority priority)
+	{
+		Waiter *waiter = _queues[priority].front();
+		_queues[priority].pop_front();
+		waiter->admitted = true;
+		++_inFlight[priority];
+		++_total;
+		_admitted[priority].fetch_add(1, std::memory_order_relaxed);
+		waiter->cv.notify_one();
+	}
+
+	std::size_t RequestScheduler::queued(RequestPriority priority) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _queues[priority].size();
+	}
+
+	std::size_t RequestScheduler::maxQueued(RequestPriority priority) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _maxQueued[priority];
+	}
+
+	std::size_t RequestScheduler::inFlight(RequestPriority priority) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _inFlight[priority];
+	}
+
+	std::string RequestScheduler::toJson() const
+	{
+		std::ostringstream out;
+		out << "{";
+		for (int i = 0; i < PRIORITY_COUNT; i++)
+		{
+			RequestPriority p = static_cast<RequestPriority>(i);
+			out << (i ? "," : "") << "\"" << priority_names[i] << "\":{\"queued\":" << queued(p) << ",\"max_queued\":" << maxQueued(p)
+				<< ",\"in_flight\":" << inFlight(p) << ",\"admitted\":" << admitted(p) << ",\"abandoned\":" << abandoned(p);
+			write_histogram(out, "wait_ns", _wait[i]);
+			out << "}";
+		}
+		out << "}";
+		return out.str();
+	}
+} // namespace docker_cpp
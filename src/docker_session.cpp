@@ -0,0 +1,96 @@
+#include <docker_cpp/docker_session.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace docker_cpp
+{
+	ExecSession::ExecSession(const StreamSink &onStdout, const StreamSink &onStderr)
+		: _out(onStdout), _err(onStderr), _demux(onStdout, onStderr), _tty(false)
+	{
+	}
+
+	void ExecSession::start(bool tty, const ResizeFunction &resize)
+	{
+		_tty = tty;
+		_demux = StreamDemuxer(_out, _err, tty);
+		_resize = resize;
+	}
+
+	bool ExecSession::setNonBlocking(bool nonBlocking)
+	{
+		int flags = ::fcntl(handle(), F_GETFL, 0);
+		if (flags < 0) return false;
+		flags = nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+		return ::fcntl(handle(), F_SETFL, flags) == 0;
+	}
+
+	long ExecSession::read(const iovec *iov, int iovcnt)
+	{
+		long n = 0;
+		if (_conn.buffered() > 0)
+		{
+			// Bytes that arrived together with the response head
+			for (int i = 0; i < iovcnt && _conn.buffered() > 0; ++i)
+			{
+				long r = _conn.read(static_cast<char *>(iov[i].iov_base), iov[i].iov_len);
+				if (r > 0) n += r;
+			}
+		}
+		else
+		{
+			do
+			{
+				n = ::readv(handle(), iov, iovcnt);
+			} while (n < 0 && errno == EINTR);
+		}
+		if (n <= 0) return n;
+
+		std::size_t left = static_cast<std::size_t>(n);
+		for (int i = 0; i < iovcnt && left > 0; ++i)
+		{
+			std::size_t size = std::min(left, iov[i].iov_len);
+			if (!_demux.feed(static_cast<const char *>(iov[i].iov_base), size))
+			{
+				errno = EPROTO;
+				return -1;
+			}
+			left -= size;
+		}
+		return n;
+	}
+
+	long ExecSession::write(const iovec *iov, int iovcnt)
+	{
+		msghdr msg = msghdr();
+		msg.msg_iov = const_cast<iovec *>(iov);
+		msg.msg_iovlen = iovcnt;
+		long n;
+		do
+		{
+			n = ::sendmsg(handle(), &msg, MSG_NOSIGNAL);
+		} while (n < 0 && errno == EINTR);
+		return n;
+	}
+
+	long ExecSession::write(const char *data, std::size_t size)
+	{
+		iovec iov;
+		iov.iov_base = const_cast<char *>(data);
+		iov.iov_len = size;
+		return write(&iov, 1);
+	}
+
+	DockerError ExecSession::resize(int h, int w)
+	{
+		if (!_resize) return DockerError::D_ERROR("The session is not attached to an exec instance", 0);
+		return _resize(h, w);
+	}
+} // namespace docker_cpp
@@ -0,0 +1,376 @@
+#include <docker_cpp/docker_snapshot.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace docker_cpp
+{
+	const std::uint32_t MetadataSnapshot::FORMAT_VERSION;
+
+	static const char SNAPSHOT_MAGIC[4] = {'D', 'K', 'M', 'S'};
+	static const std::size_t HEADER_SIZE = 4 + 4 + 8 + 8 + 8;
+
+	enum SnapshotSection { SECTION_VERSION = 1, SECTION_IMAGES = 2, SECTION_CONTAINERS = 3 };
+
+	// FNV-1a steps over 64-bit words rather than bytes, with a shift to fold the high bits back, to check large files quickly
+	static std::uint64_t checksum(const char *data, std::size_t size)
+	{
+		std::uint64_t hash = 14695981039346656037ULL;
+		std::size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			std::uint64_t word = 0;
+			for (int b = 0; b < 8; ++b)
+				word |= std::uint64_t(static_cast<unsigned char>(data[i + b])) << (8 * b);
+			hash = (hash ^ word) * 1099511628211ULL;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; ++i)
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+		return hash;
+	}
+
+	//////// Writing
+
+	static void put_int(std::string &out, std::uint64_t v, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out += static_cast<char>((v >> (8 * i)) & 0xff);
+	}
+
+	static void put_string(std::string &out, const std::string &s)
+	{
+		put_int(out, s.size(), 4);
+		out += s;
+	}
+
+	static void put_strings(std::string &out, const std::vector<std::string> &list)
+	{
+		put_int(out, list.size(), 4);
+		for (const std::string &s : list)
+			put_string(out, s);
+	}
+
+	static void put_pairs(std::string &out, const std::vector<std::pair<std::string, std::string> > &list)
+	{
+		put_int(out, list.size(), 4);
+		for (const auto &p : list)
+		{
+			put_string(out, p.first);
+			put_string(out, p.second);
+		}
+	}
+
+	static void put_section(std::string &out, SnapshotSection tag, const std::string &data)
+	{
+		put_int(out, tag, 4);
+		put_int(out, data.size(), 8);
+		out += data;
+	}
+
+	static std::string encode(const VersionInfo &v)
+	{
+		std::string out;
+		put_int(out, v.components.size(), 4);
+		for (const Component &c : v.components)
+		{
+			put_string(out, c.name);
+			put_string(out, c.version);
+		}
+		for (const std::string *s : {&v.version, &v.apiVersion, &v.minApiVersion, &v.gitCommit, &v.goVersion, &v.os, &v.arch, &v.kernelVersion, &v.buildTime})
+			put_string(out, *s);
+		put_int(out, v.experimental ? 1 : 0, 1);
+		return out;
+	}
+
+	static std::string encode(const ImageList &images)
+	{
+		std::string out;
+		put_int(out, images.size(), 4);
+		for (const ImageInfo &im : images)
+		{
+			put_string(out, im.id);
+			put_string(out, im.parentId);
+			put_strings(out, im.repoTags);
+			put_strings(out, im.repoDigests);
+			put_int(out, static_cast<std::uint64_t>(im.created), 8);
+			put_int(out, static_cast<std::uint64_t>(im.size), 8);
+			put_int(out, static_cast<std::uint64_t>(im.virtualSize), 8);
+			put_int(out, static_cast<std::uint64_t>(im.sharedSize), 8);
+			put_pairs(out, im.labels);
+			put_int(out, static_cast<std::uint32_t>(im.containers), 4);
+		}
+		return out;
+	}
+
+	static std::string encode(const ContainerList &containers)
+	{
+		std::string out;
+		put_int(out, containers.size(), 4);
+		for (const ContainerInfo &c : containers)
+		{
+			put_string(out, c.id);
+			put_strings(out, c.names);
+			put_string(out, c.image);
+			put_string(out, c.imageID);
+			put_string(out, c.command);
+			put_int(out, static_cast<std::uint64_t>(c.created), 8);
+			put_int(out, c.ports.size(), 4);
+			for (const Port &p : c.ports)
+			{
+				put_string(out, p.ip);
+				put_int(out, p.privatePort, 4);
+				put_int(out, p.publicPort, 4);
+				put_string(out, p.type);
+			}
+			put_int(out, static_cast<std::uint64_t>(c.sizeRw), 8);
+			put_int(out, static_cast<std::uint64_t>(c.sizeRootFs), 8);
+			put_pairs(out, c.labels);
+			put_string(out, c.state);
+			put_string(out, c.status);
+			put_string(out, c.hostConfig.first);
+			put_string(out, c.hostConfig.second);
+		}
+		return out;
+	}
+
+	bool MetadataSnapshot::save(const std::string &path) const
+	{
+		std::string payload;
+		put_section(payload, SECTION_VERSION, encode(version));
+		put_section(payload, SECTION_IMAGES, encode(images));
+		put_section(payload, SECTION_CONTAINERS, encode(containers));
+
+		std::string out(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+		put_int(out, FORMAT_VERSION, 4);
+		put_int(out, static_cast<std::uint64_t>(takenAt), 8);
+		put_int(out, payload.size(), 8);
+		put_int(out, checksum(payload.data(), payload.size()), 8);
+		out += payload;
+
+		// Written aside and renamed over the snapshot, so that readers see the old or the new file, never a partial one
+		std::string tmp = path + ".XXXXXX";
+		int fd = ::mkstemp(&tmp[0]);
+		if (fd < 0)
+			return false;
+		bool ok = true;
+		for (std::size_t pos = 0; ok && pos < out.size();)
+		{
+			ssize_t n = ::write(fd, out.data() + pos, out.size() - pos);
+			if (n < 0 && errno == EINTR) continue;
+			ok = n > 0;
+			pos += ok ? static_cast<std::size_t>(n) : 0;
+		}
+		ok = ok && ::fchmod(fd, 0644) == 0 && ::fsync(fd) == 0;
+		ok = ::close(fd) == 0 && ok;
+		if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+		{
+			std::remove(tmp.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	//////// Reading
+
+	// Bounds-checked reader of mapped bytes: any read past the end clears ok and returns zeros
+	struct SnapshotReader
+	{
+		const char *p;
+		const char *end;
+		bool ok;
+
+		SnapshotReader(const char *data, std::size_t size) : p(data), end(data + size), ok(true) {}
+
+		std::uint64_t get(int bytes)
+		{
+			if (!ok || end - p < bytes)
+			{
+				ok = false;
+				return 0;
+			}
+			std::uint64_t v = 0;
+			for (int i = 0; i < bytes; i++)
+				v |= std::uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+			p += bytes;
+			return v;
+		}
+
+		std::int64_t i64() { return static_cast<std::int64_t>(get(8)); }
+
+		void str(std::string &s)
+		{
+			std::uint64_t size = get(4);
+			if (!ok || static_cast<std::uint64_t>(end - p) < size)
+			{
+				ok = false;
+				return;
+			}
+			s.assign(p, static_cast<std::size_t>(size));
+			p += size;
+		}
+
+		// Number of items of a list, each taking at least `minSize` bytes: a corrupted count cannot make us allocate
+		std::size_t count(std::size_t minSize)
+		{
+			std::uint64_t n = get(4);
+			if (ok && n * minSize > static_cast<std::uint64_t>(end - p))
+				ok = false;
+			return ok ? static_cast<std::size_t>(n) : 0;
+		}
+
+		void strings(std::vector<std::string> &list)
+		{
+			list.resize(count(4));
+			for (std::string &s : list)
+				str(s);
+		}
+
+		void pairs(std::vector<std::pair<std::string, std::string> > &list)
+		{
+			list.resize(count(8));
+			for (auto &pair : list)
+			{
+				str(pair.first);
+				str(pair.second);
+			}
+		}
+	};
+
+	static bool decode(SnapshotReader in, VersionInfo &v)
+	{
+		v.components.resize(in.count(8));
+		for (Component &c : v.components)
+		{
+			in.str(c.name);
+			in.str(c.version);
+		}
+		for (std::string *s : {&v.version, &v.apiVersion, &v.minApiVersion, &v.gitCommit, &v.goVersion, &v.os, &v.arch, &v.kernelVersion, &v.buildTime})
+			in.str(*s);
+		v.experimental = in.get(1) != 0;
+		return in.ok;
+	}
+
+	static bool decode(SnapshotReader in, ImageList &images)
+	{
+		images.resize(in.count(4 * 6 + 8 * 4));
+		for (ImageInfo &im : images)
+		{
+			in.str(im.id);
+			in.str(im.parentId);
+			im.key.parse(im.id);
+			im.parentKey.parse(im.parentId);
+			in.strings(im.repoTags);
+			in.strings(im.repoDigests);
+			im.created = in.i64();
+			im.size = in.i64();
+			im.virtualSize = in.i64();
+			im.sharedSize = in.i64();
+			in.pairs(im.labels);
+			im.containers = static_cast<int>(static_cast<std::int32_t>(in.get(4)));
+		}
+		return in.ok;
+	}
+
+	static bool decode(SnapshotReader in, ContainerList &containers)
+	{
+		containers.resize(in.count(4 * 11 + 8 * 3));
+		for (ContainerInfo &c : containers)
+		{
+			in.str(c.id);
+			c.key.parse(c.id);
+			in.strings(c.names);
+			in.str(c.image);
+			in.str(c.imageID);
+			c.imageKey.parse(c.imageID);
+			in.str(c.command);
+			c.created = in.i64();
+			c.ports.resize(in.count(16));
+			for (Port &p : c.ports)
+			{
+				in.str(p.ip);
+				p.privatePort = static_cast<unsigned int>(in.get(4));
+				p.publicPort = static_cast<unsigned int>(in.get(4));
+				in.str(p.type);
+			}
+			c.sizeRw = in.i64();
+			c.sizeRootFs = in.i64();
+			in.pairs(c.labels);
+			in.str(c.state);
+			in.str(c.status);
+			in.str(c.hostConfig.first);
+			in.str(c.hostConfig.second);
+		}
+		return in.ok;
+	}
+
+	static bool decode_snapshot(const char *data, std::size_t size, MetadataSnapshot &out)
+	{
+		SnapshotReader header(data, size);
+		if (size < HEADER_SIZE || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+			return false;
+		header.get(4);
+		if (header.get(4) != MetadataSnapshot::FORMAT_VERSION)
+			return false;
+		std::int64_t takenAt = header.i64();
+		std::uint64_t payloadSize = header.get(8);
+		std::uint64_t sum = header.get(8);
+		if (payloadSize != size - HEADER_SIZE || checksum(data + HEADER_SIZE, size - HEADER_SIZE) != sum)
+			return false;
+
+		MetadataSnapshot snapshot;
+		snapshot.takenAt = takenAt;
+		SnapshotReader payload(data + HEADER_SIZE, size - HEADER_SIZE);
+		while (payload.ok && payload.p < payload.end)
+		{
+			std::uint64_t tag = payload.get(4);
+			std::uint64_t length = payload.get(8);
+			if (!payload.ok || length > static_cast<std::uint64_t>(payload.end - payload.p))
+				return false;
+			SnapshotReader section(payload.p, static_cast<std::size_t>(length));
+			payload.p += length;
+			bool ok = true;
+			if (tag == SECTION_VERSION)
+				ok = decode(section, snapshot.version);
+			else if (tag == SECTION_IMAGES)
+				ok = decode(section, snapshot.images);
+			else if (tag == SECTION_CONTAINERS)
+				ok = decode(section, snapshot.containers);
+			if (!ok)
+				return false;
+		}
+		if (!payload.ok)
+			return false;
+		out = std::move(snapshot);
+		return true;
+	}
+
+	bool MetadataSnapshot::load(const std::string &path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(HEADER_SIZE))
+		{
+			::close(fd);
+			return false;
+		}
+		std::size_t size = static_cast<std::size_t>(st.st_size);
+		void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (map == MAP_FAILED)
+			return false;
+		::madvise(map, size, MADV_SEQUENTIAL);
+		bool ok = decode_snapshot(static_cast<const char *>(map), size, *this);
+		::munmap(map, size);
+		return ok;
+	}
+} // namespace docker_cpp
@@ -0,0 +1,195 @@
+#include <docker_cpp/docker_stream.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DOCKER_STREAM_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace docker_cpp
+{
+	long FileSource::operator()(char *data, std::size_t size) const
+	{
+		for (;;)
+		{
+			ssize_t n = ::read(_fd, data, size);
+			if (n < 0 && errno == EINTR) continue;
+			return static_cast<long>(n);
+		}
+	}
+
+	long long FileSource::remaining() const
+	{
+		struct stat st;
+		if (::fstat(_fd, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+		off_t pos = ::lseek(_fd, 0, SEEK_CUR);
+		if (pos < 0) return -1;
+		return std::max<long long>(0, static_cast<long long>(st.st_size) - pos);
+	}
+
+	BufferSource &BufferSource::add(const char *data, std::size_t size)
+	{
+		if (size > 0) _buffers.push_back(Buffer(data, size));
+		return *this;
+	}
+
+	long BufferSource::operator()(char *data, std::size_t size)
+	{
+		std::size_t written = 0;
+		while (written < size && _index < _buffers.size())
+		{
+			const Buffer &b = _buffers[_index];
+			std::size_t n = std::min(size - written, b.second - _offset);
+			std::memcpy(data + written, b.first + _offset, n);
+			written += n;
+			_offset += n;
+			if (_offset == b.second)
+			{
+				++_index;
+				_offset = 0;
+			}
+		}
+		return static_cast<long>(written);
+	}
+
+	std::size_t BufferSource::size() const
+	{
+		std::size_t total = 0;
+		for (const Buffer &b : _buffers) total += b.second;
+		return total;
+	}
+
+	bool FileSink::operator()(const char *data, std::size_t size) const
+	{
+		while (size > 0)
+		{
+			ssize_t n = ::write(_fd, data, size);
+			if (n < 0 && errno == EINTR) continue;
+			if (n <= 0) return false;
+			data += n;
+			size -= static_cast<std::size_t>(n);
+		}
+		return true;
+	}
+
+	StreamDemuxer::StreamDemuxer(const StreamSink &out, const StreamSink &err, bool raw)
+		: _out(out), _err(err), _raw(raw), _headerSize(0), _remaining(0), _stream(STDOUT)
+	{
+	}
+
+	bool StreamDemuxer::feed(const char *data, std::size_t size)
+	{
+		if (_raw)
+			return !_out || _out(data, size);
+
+		while (size > 0)
+		{
+			if (_remaining == 0)
+			{
+				std::size_t n = std::min(size, sizeof(_header) - _headerSize);
+				std::copy(data, data + n, _header + _headerSize);
+				_headerSize += n;
+				data += n;
+				size -= n;
+				if (_headerSize < sizeof(_header))
+					return true;
+				if (_header[0] > STDERR)
+					return false;
+				_stream = _header[0];
+				_remaining = (std::size_t(_header[4]) << 24) | (std::size_t(_header[5]) << 16) |
+							 (std::size_t(_header[6]) << 8) | std::size_t(_header[7]);
+				_headerSize = 0;
+				continue;
+			}
+
+			std::size_t n = std::min(size, _remaining);
+			const StreamSink &sink = _stream == STDERR ? _err : _out;
+			if (sink && !sink(data, n))
+				return false;
+			_remaining -= n;
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+
+#ifdef DOCKER_STREAM_SSE2
+	static inline unsigned int lowest_bit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long i;
+		_BitScanForward(&i, mask);
+		return static_cast<unsigned int>(i);
+#else
+		return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+	}
+#endif
+
+	bool LineSplitter::_line(const char *line, std::size_t size)
+	{
+		if (size > 0 && line[size - 1] == '\r') --size;
+		return size == 0 || _handler(line, size);
+	}
+
+	bool LineSplitter::_end(const char *start, const char *eol)
+	{
+		if (_partial.empty())
+			return _line(start, static_cast<std::size_t>(eol - start));
+		_partial.append(start, eol);
+		bool more = _line(_partial.data(), _partial.size());
+		_partial.clear();
+		return more;
+	}
+
+	bool LineSplitter::feed(const char *data, std::size_t size)
+	{
+		const char *end = data + size;
+		const char *start = data; // first byte of the line being scanned
+		const char *p = data;
+#ifdef DOCKER_STREAM_SSE2
+		// Log and JSON lines are short: compare 16 bytes at a time and walk the bits of the line ends found, rather
+		// than paying a memchr() call per line
+		const __m128i nl = _mm_set1_epi8('\n');
+		for (; end - p >= 16; p += 16)
+		{
+			unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), nl)));
+			while (mask != 0)
+			{
+				const char *eol = p + lowest_bit(mask);
+				mask &= mask - 1;
+				if (!_end(start, eol))
+					return false;
+				start = eol + 1;
+			}
+		}
+#endif
+		while (p < end)
+		{
+			const char *eol = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+			if (!eol)
+				break;
+			if (!_end(start, eol))
+				return false;
+			start = p = eol + 1;
+		}
+		_partial.append(start, end);
+		return true;
+	}
+
+	bool LineSplitter::finish()
+	{
+		std::string last;
+		last.swap(_partial);
+		return _line(last.data(), last.size());
+	}
+} // namespace docker_cpp
@@ -0,0 +1,86 @@
+#include <docker_cpp/docker_version.h>
+
+#include <map>
+#include <mutex>
+
+namespace docker_cpp
+{
+	//////// ApiVersion
+
+	static bool read_number(const std::string &text, std::size_t &pos, int &value)
+	{
+		std::size_t start = pos;
+		value = 0;
+		for (; pos < text.size() && text[pos] >= '0' && text[pos] <= '9' && pos - start < 6; ++pos)
+			value = value * 10 + (text[pos] - '0');
+		return pos > start;
+	}
+
+	bool ApiVersion::parse(const std::string &text, ApiVersion &out)
+	{
+		std::size_t pos = 0;
+		int first, second;
+		if (!read_number(text, pos, first) || pos >= text.size() || text[pos++] != '.' || !read_number(text, pos, second) || pos != text.size())
+			return false;
+		out = ApiVersion(first, second);
+		return true;
+	}
+
+	DockerError negotiate_api_version(const VersionInfo &daemon, ApiVersion &result)
+	{
+		ApiVersion newest, oldest;
+		if (!ApiVersion::parse(daemon.apiVersion, newest))
+			return DockerError::D_ERROR("the daemon did not report a valid API version: \"" + daemon.apiVersion + "\"", 0);
+		if (!daemon.minApiVersion.empty() && !ApiVersion::parse(daemon.minApiVersion, oldest))
+			return DockerError::D_ERROR("the daemon did not report a valid minimum API version: \"" + daemon.minApiVersion + "\"", 0);
+
+		ApiVersion chosen = newest < DOCKER_API_MAX ? newest : DOCKER_API_MAX;
+		if (chosen < DOCKER_API_MIN || chosen < oldest)
+			return DockerError::D_ERROR("no API version in common: the daemon supports " + (oldest.empty() ? std::string("up to ") : oldest.str() + " to ") +
+										newest.str() + ", the client " + DOCKER_API_MIN.str() + " to " + DOCKER_API_MAX.str(), 0);
+		result = chosen;
+		return DockerError::D_OK();
+	}
+
+	//////// ApiVersionCache
+
+	static std::mutex &cache_mutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static std::map<std::string, ApiVersion> &cache_versions()
+	{
+		static std::map<std::string, ApiVersion> versions;
+		return versions;
+	}
+
+	bool ApiVersionCache::lookup(const std::string &endpoint, ApiVersion &version)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex());
+		auto it = cache_versions().find(endpoint);
+		if (it == cache_versions().end())
+			return false;
+		version = it->second;
+		return true;
+	}
+
+	void ApiVersionCache::store(const std::string &endpoint, const ApiVersion &version)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex());
+		cache_versions()[endpoint] = version;
+	}
+
+	void ApiVersionCache::forget(const std::string &endpoint)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex());
+		cache_versions().erase(endpoint);
+	}
+
+	void ApiVersionCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex());
+		cache_versions().clear();
+	}
+} // namespace docker_cpp
@@ -46,4 +46,25 @@ TEST_CASE("Construction of query parameters with empty string literal") {
 TEST_CASE("Construction of query parameters with < 0 value") {
     std::string q = query_params(q_arg("foo", "bar"), q_arg("lorem", -1));
     CHECK(q == "?foo=bar");
-}
\ No newline at end of file
+}
+
+TEST_CASE("Parse daemon URLs") {
+    DockerUrl u;
+    CHECK(DockerUrl::parse("http://127.0.0.1:2375/v1.40/containers/json?all=true", u) == true);
+    CHECK(u.scheme == "http");
+    CHECK(u.host == "127.0.0.1");
+    CHECK(u.port == 2375);
+    CHECK(u.path == "/v1.40/containers/json?all=true");
+
+    CHECK(DockerUrl::parse("unix:///var/run/docker.sock/v1.40/_ping", u) == true);
+    CHECK(u.scheme == "unix");
+    CHECK(u.host == "/var/run/docker.sock");
+    CHECK(u.path == "/v1.40/_ping");
+
+    CHECK(DockerUrl::parse("tcp://[::1]:2376", u) == true);
+    CHECK(u.host == "::1");
+    CHECK(u.port == 2376);
+    CHECK(u.path == "/");
+
+    CHECK(DockerUrl::parse("container_list/v1.40/containers/json", u) == false);
+}
@@ -0,0 +1,444 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#include <sys/stat.h>
+#include <sys/time.h>
+
+using namespace docker_cpp;
+
+// A directory under /tmp, removed with its content at the end of the test
+struct TempDir
+{
+    std::string path;
+
+    TempDir()
+    {
+        char name[] = "/tmp/docker_cpp_build_XXXXXX";
+        path = ::mkdtemp(name) ? name : "";
+    }
+    ~TempDir()
+    {
+        if (!path.empty()) std::system(("rm -rf '" + path + "'").c_str());
+    }
+
+    void write(const std::string &file, const std::string &content) const
+    {
+        std::string full = path + "/" + file;
+        for (std::size_t slash = full.find('/', path.size() + 1); slash != std::string::npos; slash = full.find('/', slash + 1))
+            ::mkdir(full.substr(0, slash).c_str(), 0755);
+        std::ofstream(full.c_str(), std::ios::binary) << content;
+    }
+};
+
+struct TarMember
+{
+    std::string name;
+    char type;
+    std::string data;
+    std::string link;
+};
+
+static std::uint64_t octal(const char *field, std::size_t width)
+{
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < width && field[i] >= '0' && field[i] <= '7'; ++i) v = v * 8 + static_cast<std::uint64_t>(field[i] - '0');
+    return v;
+}
+
+// Minimal ustar/PAX reader for the archives of the packer
+static bool read_tar(const std::string &tar, std::vector<TarMember> &out)
+{
+    std::size_t pos = 0;
+    std::string paxPath;
+    while (pos + 512 <= tar.size()) {
+        const char *h = tar.data() + pos;
+        if (h[0] == '\0') return tar.size() - pos == 1024; // the two empty blocks of the end
+        unsigned int sum = 0;
+        for (std::size_t i = 0; i < 512; ++i) sum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(h[i]);
+        if (sum != octal(h + 148, 8)) return false;
+        std::uint64_t size = octal(h + 124, 12);
+        std::string data = tar.substr(pos + 512, static_cast<std::size_t>(size));
+        pos += 512 + (size + 511) / 512 * 512;
+        if (h[156] == 'x') {
+            std::size_t p = data.find(" path=");
+            if (p != std::string::npos) paxPath = data.substr(p + 6, data.find('\n', p) - p - 6);
+            continue;
+        }
+        TarMember m;
+        std::string prefix(h + 345, strnlen(h + 345, 155));
+        m.name = std::string(h, strnlen(h, 100));
+        if (!prefix.empty()) m.name = prefix + "/" + m.name;
+        if (!paxPath.empty()) m.name = paxPath;
+        paxPath.clear();
+        m.type = h[156];
+        m.data = data;
+        m.link = std::string(h + 157, strnlen(h + 157, 100));
+        out.push_back(m);
+    }
+    return false;
+}
+
+// Sets the modification time of a file to some seconds ago
+static void age(const std::string &path, int seconds)
+{
+    struct timeval times[2];
+    ::gettimeofday(&times[0], nullptr);
+    times[0].tv_sec -= seconds;
+    times[1] = times[0];
+    ::utimes(path.c_str(), times);
+}
+
+static std::string read_all(ContextPacker &packer, std::size_t step)
+{
+    std::string tar;
+    std::vector<char> buf(step);
+    long n;
+    while ((n = packer.read(&buf[0], buf.size())) > 0) tar.append(&buf[0], static_cast<std::size_t>(n));
+    return n == 0 ? tar : std::string();
+}
+
+TEST_SUITE("BUILD") {
+    TEST_CASE("Check .dockerignore patterns") {
+        DockerIgnore ignore;
+        ignore.parse("# comment\n*.log\n!keep.log\nnode_modules\n/build/\n**/*.tmp\ndocs/[a-c]?.md\n  \n");
+        CHECK(ignore.excluded("debug.log") == true);
+        CHECK(ignore.excluded("keep.log") == false);
+        CHECK(ignore.excluded("sub/debug.log") == false); // '*' does not cross directories
+        CHECK(ignore.excluded("node_modules") == true);
+        CHECK(ignore.excluded("node_modules/left-pad/index.js") == true);
+        CHECK(ignore.excluded("build/out.o") == true);
+        CHECK(ignore.excluded("src/build/out.o") == false);
+        CHECK(ignore.excluded("a.tmp") == true);
+        CHECK(ignore.excluded("x/y/z.tmp") == true);
+        CHECK(ignore.excluded("docs/b1.md") == true);
+        CHECK(ignore.excluded("docs/d1.md") == false);
+        CHECK(ignore.excluded("src/main.cpp") == false);
+        CHECK(ignore.mayIncludeBelow("node_modules") == false);
+
+        DockerIgnore exceptions;
+        exceptions.parse("vendor\n!vendor/keep/**\n");
+        CHECK(exceptions.excluded("vendor/other/a.go") == true);
+        CHECK(exceptions.excluded("vendor/keep/a.go") == false);
+        CHECK(exceptions.mayIncludeBelow("vendor") == true);
+        CHECK(exceptions.mayIncludeBelow("vendor/other") == false);
+
+        DockerIgnore escaped;
+        escaped.add("file\\*");
+        escaped.add("./a/../b");
+        CHECK(escaped.excluded("file*") == true);
+        CHECK(escaped.excluded("file1") == false);
+        CHECK(escaped.excluded("b") == true);
+        CHECK(escaped.empty() == false);
+    }
+
+    TEST_CASE("Check lines are split across chunks") {
+        std::vector<std::string> lines;
+        LineSplitter splitter([&](const char *line, std::size_t size) { lines.push_back(std::string(line, size)); return true; });
+        std::string input = "{\"stream\":\"a\"}\r\n{\"stream\":\"b\"}\n\n{\"aux\":{}}\r\n{\"stream\":\"tail\"}";
+        for (std::size_t i = 0; i < input.size(); i += 3)
+            CHECK(splitter.feed(input.data() + i, std::min<std::size_t>(3, input.size() - i)) == true);
+        REQUIRE(lines.size() == 3);
+        CHECK(lines[0] == "{\"stream\":\"a\"}");
+        CHECK(lines[2] == "{\"aux\":{}}");
+        CHECK(splitter.finish() == true);
+        CHECK(lines.back() == "{\"stream\":\"tail\"}");
+
+        LineSplitter stop([](const char *, std::size_t) { return false; });
+        CHECK(stop.feed("x\ny\n", 4) == false);
+    }
+
+    TEST_CASE("Check a directory is packed as a tar archive") {
+        TempDir dir;
+        REQUIRE(dir.path.empty() == false);
+        std::mt19937 random(7);
+        std::string big(300 * 1024 + 17, '\0');
+        for (char &c : big) c = static_cast<char>(random());
+        std::string deep = std::string(60, 'd') + "/" + std::string(60, 'e') + "/file.txt";
+        std::string longName = std::string(120, 'n') + ".txt";
+
+        dir.write("Dockerfile", "FROM scratch\nCOPY . /\n");
+        dir.write(".dockerignore", "node_modules\n*.log\n!keep.log\nDockerfile\n");
+        dir.write("big.bin", big);
+        dir.write("empty", "");
+        dir.write("src/main.cpp", "int main() {}\n");
+        dir.write(deep, "deep");
+        dir.write(longName, "long");
+        dir.write("debug.log", "no");
+        dir.write("keep.log", "yes");
+        dir.write("node_modules/pkg/index.js", "no");
+        REQUIRE(::symlink("src/main.cpp", (dir.path + "/link").c_str()) == 0);
+
+        ContextOptions options;
+        options.blockSize = 4096; // big.bin is streamed past its read-ahead head
+        options.readAhead = 4 * 4096;
+        options.threads = 3;
+        ContextPacker packer(dir.path, options);
+        REQUIRE(packer.scan() == true);
+        CHECK(packer.dataSize() == big.size() + 22 + 40 + 14 + 4 + 4 + 3);
+        std::string tar = read_all(packer, 1000);
+        REQUIRE(tar.empty() == false);
+        CHECK(tar.size() % 512 == 0);
+
+        std::vector<TarMember> members;
+        REQUIRE(read_tar(tar, members) == true);
+        std::map<std::string, TarMember> byName;
+        for (const TarMember &m : members) byName[m.name] = m;
+        CHECK(byName.count("Dockerfile") == 1); // sent even though .dockerignore excludes it
+        CHECK(byName.count(".dockerignore") == 1);
+        CHECK(byName["big.bin"].data == big);
+        CHECK(byName["empty"].data.empty() == true);
+        CHECK(byName["src/"].type == '5');
+        CHECK(byName["src/main.cpp"].data == "int main() {}\n");
+        CHECK(byName[deep].data == "deep");
+        CHECK(byName[longName].data == "long");
+        CHECK(byName["keep.log"].data == "yes");
+        CHECK(byName.count("debug.log") == 0);
+        CHECK(byName.count("node_modules/") == 0);
+        CHECK(byName.count("node_modules/pkg/index.js") == 0);
+        CHECK(byName["link"].type == '2');
+        CHECK(byName["link"].link == "src/main.cpp");
+
+        // The archive does not depend on the number of threads or the size of the reads
+        ContextOptions single = options;
+        single.threads = 1;
+        ContextPacker other(dir.path, single);
+        CHECK(read_all(other, 64 * 1024) == tar);
+    }
+
+    TEST_CASE("Check long names and large sizes get PAX headers") {
+        ContextEntry entry;
+        entry.path = std::string(200, 'p'); // no '/' to split at
+        entry.type = '0';
+        entry.mode = 0644;
+        entry.size = 10;
+        entry.mtime = 0;
+        std::string header;
+        tar_header(entry, header);
+        CHECK(header.size() == 512 * 3);
+        CHECK(header[156] == 'x');
+        CHECK(header.find("path=" + entry.path + "\n") != std::string::npos);
+
+        entry.path = "huge";
+        entry.size = 9ULL << 30;
+        header.clear();
+        tar_header(entry, header);
+        CHECK(header.find("size=" + std::to_string(entry.size) + "\n") != std::string::npos);
+    }
+
+    TEST_CASE("Check the context cache sends unchanged files from its store") {
+        TempDir dir, cache;
+        REQUIRE(dir.path.empty() == false);
+        REQUIRE(cache.path.empty() == false);
+        std::mt19937 random(11);
+        std::string big(100 * 1024, '\0');
+        for (char &c : big) c = static_cast<char>(random());
+        dir.write("Dockerfile", "FROM scratch\n");
+        dir.write("big.bin", big);
+        dir.write("a.txt", "same");
+        dir.write("b.txt", "same");
+        dir.write("c.txt", "changes");
+        for (const char *file : {"Dockerfile", "big.bin", "a.txt", "b.txt", "c.txt"}) age(dir.path + "/" + file, 60);
+
+        ContextOptions options;
+        options.blockSize = 4096;
+        options.cacheDir = cache.path + "/contexts";
+        std::size_t reused = 0;
+        auto pack = [&]() {
+            ContextPacker packer(dir.path, options);
+            std::string tar = read_all(packer, 1000);
+            reused = packer.reused();
+            return tar;
+        };
+
+        std::string first = pack();
+        REQUIRE(first.empty() == false);
+        CHECK(reused == 0);
+        struct stat st;
+        REQUIRE(::stat((ContextPacker::cachePath(options.cacheDir, dir.path) + "/blobs-0").c_str(), &st) == 0);
+        CHECK(static_cast<std::size_t>(st.st_size) == 13 + big.size() + 4 + 7); // identical files are stored once
+
+        CHECK(pack() == first);
+        CHECK(reused == 5);
+
+        dir.write("c.txt", "changed!");
+        age(dir.path + "/c.txt", 30);
+        ContextOptions uncached = options;
+        uncached.cacheDir.clear();
+        ContextPacker fresh(dir.path, uncached);
+        std::string expected = read_all(fresh, 4096);
+        CHECK(pack() == expected);
+        CHECK(reused == 4);
+
+        {
+            // Another packer of the context packs without the cache while it is in use
+            ContextPacker holder(dir.path, options);
+            REQUIRE(holder.scan() == true);
+            CHECK(holder.reused() == 5);
+            CHECK(pack() == expected);
+            CHECK(reused == 0);
+        }
+
+        // A file modified just before it was cached is read again, as its mtime may hide a later change
+        dir.write("a.txt", "new!");
+        pack();
+        CHECK(reused == 4);
+        CHECK(pack().find("new!") != std::string::npos);
+        CHECK(reused == 4);
+    }
+
+    TEST_CASE("Check the context cache does not trust a hash alone") {
+        TempDir dir, cache;
+        REQUIRE(dir.path.empty() == false);
+        dir.write("x.txt", "aaaa");
+        age(dir.path + "/x.txt", 60);
+        ContextOptions options;
+        options.cacheDir = cache.path + "/contexts";
+        std::size_t reused = 0;
+        auto pack = [&]() {
+            ContextPacker packer(dir.path, options);
+            std::string tar = read_all(packer, 4096);
+            reused = packer.reused();
+            return tar;
+        };
+        REQUIRE(pack().empty() == false);
+
+        // Gives the blob of x.txt the hash of "bbbb", as a collision of two contents of the same size would
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (char c : std::string("bbbb")) hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+        const std::string indexPath = ContextPacker::cachePath(options.cacheDir, dir.path) + "/index";
+        std::string index;
+        {
+            std::ifstream in(indexPath.c_str(), std::ios::binary);
+            index.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        }
+        std::size_t record = index.find("x.txt");
+        REQUIRE(record != std::string::npos);
+        std::size_t pos = record + 5 + 4 * 8; // size, mtime, ctime, inode
+        REQUIRE(pos + 16 <= index.size());
+        for (int i = 0; i < 8; ++i) index[pos + i] = static_cast<char>((hash >> (8 * i)) & 0xff);
+        std::ofstream(indexPath.c_str(), std::ios::binary | std::ios::trunc) << index;
+
+        dir.write("y.txt", "bbbb");
+        age(dir.path + "/y.txt", 60);
+        pack();
+        CHECK(reused == 1);
+
+        ContextOptions uncached = options;
+        uncached.cacheDir.clear();
+        ContextPacker fresh(dir.path, uncached);
+        std::string expected = read_all(fresh, 4096);
+        CHECK(pack() == expected);
+        CHECK(reused == 2);
+        std::vector<TarMember> members;
+        REQUIRE(read_tar(expected, members) == true);
+        REQUIRE(members.size() == 2);
+        CHECK(members[1].data == "bbbb");
+    }
+
+    TEST_CASE("Check host paths are packed under their base names") {
+        TempDir dir;
+        REQUIRE(dir.path.empty() == false);
+        dir.write("etc/app.conf", "port=80\n");
+        dir.write("certs/ca.pem", "CERT");
+        dir.write("certs/.dockerignore", "*.pem\n"); // not applied to host paths
+        REQUIRE(::symlink("app.conf", (dir.path + "/etc/current").c_str()) == 0);
+
+        ContextPacker packer(std::vector<std::string>{dir.path + "/etc/app.conf", dir.path + "/certs/", dir.path + "/etc/current"});
+        std::string tar = read_all(packer, 700);
+        std::vector<TarMember> members;
+        REQUIRE(read_tar(tar, members) == true);
+        REQUIRE(members.size() == 5);
+        CHECK(members[0].name == "app.conf");
+        CHECK(members[0].data == "port=80\n");
+        CHECK(members[1].name == "certs/");
+        CHECK(members[1].type == '5');
+        CHECK(members[2].name == "certs/.dockerignore");
+        CHECK(members[3].name == "certs/ca.pem");
+        CHECK(members[3].data == "CERT");
+        CHECK(members[4].name == "current");
+        CHECK(members[4].type == '2');
+        CHECK(members[4].link == "app.conf");
+
+        ContextPacker missing(std::vector<std::string>{dir.path + "/none"});
+        CHECK(missing.scan() == false);
+        CHECK(missing.error().empty() == false);
+        ContextPacker dot(std::vector<std::string>{"."});
+        CHECK(dot.scan() == false);
+    }
+
+    TEST_CASE("Check a missing context directory fails") {
+        ContextPacker packer("/nonexistent/docker_cpp_context");
+        char buf[512];
+        CHECK(packer.read(buf, sizeof(buf)) == -1);
+        CHECK(packer.error().empty() == false);
+
+        Docker<MockResponseHttp> docker("image_build");
+        std::string id;
+        DockerError err = docker.imageBuild("/nonexistent/docker_cpp_context", BuildOptions(), BuildMessageHandler(), id);
+        CHECK(err.isError() == true);
+    }
+
+    TEST_CASE("Check an image is built from a streamed context") {
+        TempDir dir;
+        dir.write("Dockerfile", "FROM alpine\n");
+        dir.write("app/data.txt", std::string(100000, 'x'));
+
+        MockDaemon daemon;
+        std::string received, query;
+        daemon.route("POST", "/build", [&](const MockDaemon::Request &r) {
+            received = r.body;
+            query = r.query;
+            MockDaemon::Response res;
+            res.chunked = true;
+            res.chunkSize = 7;
+            res.body = "{\"stream\":\"Step 1/1 : FROM alpine\\n\"}\r\n{\"aux\":{\"ID\":\"sha256:0123\"}}\r\n{\"stream\":\"Successfully built 0123\\n\"}\r\n";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        BuildOptions options;
+        options.tags = {"app:1", "app:latest"};
+        options.buildArgs = {{"VERSION", "1 2"}};
+        std::vector<BuildMessage> messages;
+        std::string id;
+        DockerError err = docker.imageBuild(dir.path, options, [&](const BuildMessage &m) { messages.push_back(m); return true; }, id);
+        CHECK(err.isOk() == true);
+        CHECK(messages.size() == 3);
+        CHECK(id == "sha256:0123");
+        CHECK(query.find("t=app%3A1") != std::string::npos);
+        CHECK(query.find("t=app%3Alatest") != std::string::npos);
+        CHECK(query.find("buildargs=%7B%22VERSION%22%3A%221%202%22%7D") != std::string::npos);
+
+        std::vector<TarMember> members;
+        REQUIRE(read_tar(received, members) == true);
+        CHECK(members.size() == 3);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check a failed build is reported") {
+        TempDir dir;
+        dir.write("Dockerfile", "FROM nothing\n");
+        MockDaemon daemon;
+        MockDaemon::Response failed;
+        failed.chunked = true;
+        failed.body = "{\"errorDetail\":{\"message\":\"pull access denied\"},\"error\":\"pull access denied\"}\r\n";
+        daemon.route("POST", "/build", failed);
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        std::string id;
+        DockerError err = docker.imageBuild(dir.path, BuildOptions(), BuildMessageHandler(), id);
+        CHECK(err.isError() == true);
+        CHECK(err.message() == "pull access denied");
+        CHECK(id.empty() == true);
+        daemon.stop();
+    }
+}
@@ -0,0 +1,192 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace docker_cpp;
+
+// Runs `calls` containerList requests on each of `threads` threads sharing one client.
+// Returns the number of requests per second and counts the wrong answers in `failures`.
+template <typename T>
+static double hammer(Docker<T> &docker, int threads, int calls, std::atomic<int> &failures)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < calls; ++i) {
+                ContainerList r;
+                DockerError e = docker.containerList(r, true);
+                if (!e.isOk() || r.size() != 1 || r[0].id != "8dfafdbc3a40") ++failures;
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * calls / elapsed.count();
+}
+
+template <typename T>
+static void stress(const char *transport)
+{
+    MockDaemon daemon;
+    daemon.routeFixture("GET", "/containers/json", "container_list_get.json");
+    REQUIRE(daemon.start() == true);
+
+    Docker<T> docker(daemon.url());
+    REQUIRE(Docker<T>::isThreadSafe() == true);
+
+    const int calls = 200;
+    double single = 0;
+    std::size_t expected = 0;
+    for (int threads : {1, 2, 4, 8}) {
+        std::atomic<int> failures(0);
+        double rate = hammer(docker, threads, calls, failures);
+        expected += static_cast<std::size_t>(threads * calls);
+        CHECK(failures == 0);
+        if (threads == 1) single = rate;
+        MESSAGE(transport << ": " << threads << " threads, " << static_cast<long>(rate) << " req/s (x" << rate / single << ")");
+    }
+    CHECK(daemon.requests() == expected);
+    daemon.stop();
+}
+
+// Daemon answering the first request of each connection, then dropping the second once it is read
+struct DroppingDaemon
+{
+    int listener = -1;
+    int port = 0;
+    std::atomic<int> requests{0}, posts{0}, connections{0};
+    std::thread acceptor;
+
+    bool start()
+    {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), len) != 0 || ::listen(listener, 8) != 0) return false;
+        ::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread([this] {
+            int fd;
+            while ((fd = ::accept(listener, nullptr, nullptr)) >= 0) {
+                ++connections;
+                serve(fd);
+                ::close(fd);
+            }
+        });
+        return true;
+    }
+
+    // Reads one request with its Content-Length body
+    bool read(int fd, std::string &buf)
+    {
+        char chunk[4096];
+        for (;;) {
+            std::size_t end = buf.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                std::size_t cl = buf.find("Content-Length: ");
+                std::size_t body = cl != std::string::npos && cl < end ? std::stoul(buf.substr(cl + 16)) : 0;
+                if (buf.size() >= end + 4 + body) {
+                    ++requests;
+                    if (buf.compare(0, 5, "POST ") == 0) ++posts;
+                    buf.erase(0, end + 4 + body);
+                    return true;
+                }
+            }
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buf.append(chunk, static_cast<std::size_t>(n));
+        }
+    }
+
+    void serve(int fd)
+    {
+        std::string buf;
+        if (!read(fd, buf)) return;
+        const char answer[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nOK";
+        if (::send(fd, answer, sizeof(answer) - 1, MSG_NOSIGNAL) < 0) return;
+        read(fd, buf);
+    }
+
+    void stop()
+    {
+        ::shutdown(listener, SHUT_RDWR);
+        ::close(listener);
+        if (acceptor.joinable()) acceptor.join();
+    }
+};
+
+TEST_SUITE("CONCURRENCY") {
+    TEST_CASE("Check a SocketHttp client can be shared between threads") {
+        stress<SocketHttp>("SocketHttp");
+    }
+
+    TEST_CASE("Check an ASLHttp client can be shared between threads") {
+        stress<ASLHttp>("ASLHttp");
+    }
+
+    TEST_CASE("Check SocketHttp reuses one connection per concurrent caller") {
+        MockDaemon daemon;
+        daemon.routeFixture("GET", "/_ping", "ping_get.json");
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+        for (int i = 0; i < 10; ++i) CHECK(docker.ping().isOk() == true);
+        CHECK(daemon.requests() == 10);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check only idempotent requests are retried on a dropped kept-alive socket") {
+        DroppingDaemon daemon;
+        REQUIRE(daemon.start() == true);
+        DockerUrl url;
+        REQUIRE(DockerUrl::parse("http://127.0.0.1:" + std::to_string(daemon.port) + "/v1.41/_ping", url) == true);
+        DockerConnection conn;
+        int code = 0;
+        header_map headers;
+        std::string body;
+        StreamSink sink = [&body](const char *p, std::size_t n) { body.append(p, n); return true; };
+
+        CHECK(conn.request(url, "GET", "", header_map(), code, headers, sink) == true);
+        CHECK(code == 200);
+        CHECK(conn.reusable() == true);
+
+        // The daemon read the POST before dropping it: sending it again could run it twice
+        DockerUrl post = url;
+        post.path = "/v1.41/containers/create";
+        CHECK(conn.request(post, "POST", "{}", header_map(), code, headers, sink) == false);
+        CHECK(daemon.posts == 1);
+        CHECK(daemon.connections == 1);
+
+        // A GET is sent again on a new socket
+        CHECK(conn.request(url, "GET", "", header_map(), code, headers, sink) == true);
+        CHECK(conn.request(url, "GET", "", header_map(), code, headers, sink) == true);
+        CHECK(code == 200);
+        CHECK(daemon.requests == 5);
+        CHECK(daemon.connections == 3);
+        CHECK(daemon.posts == 1);
+        conn.close();
+        daemon.stop();
+    }
+
+    TEST_CASE("Check connection pool hands out distinct connections") {
+        ConnectionPool pool(1);
+        DockerUrl url;
+        DockerUrl::parse("http://127.0.0.1:2375/_ping", url);
+        std::unique_ptr<DockerConnection> a = pool.acquire(url);
+        std::unique_ptr<DockerConnection> b = pool.acquire(url);
+        CHECK(a.get() != b.get());
+        pool.release(std::move(a)); // not connected: not kept
+        CHECK(pool.idle() == 0);
+    }
+}
@@ -1,5 +1,11 @@
 #include <doctest/doctest.h>
 #include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/stat.h>
 
 using namespace docker_cpp;
 
@@ -207,4 +213,253 @@ TEST_SUITE("CONTAINER") {
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
     }
-}
\ No newline at end of file
+
+    TEST_CASE("Check containerStopBatch returns OK for every container") {
+        Docker<MockErrorHttp> d("204");
+        std::vector<std::string> ids = {"a", "b", "c"};
+        DockerErrorList errors;
+        DockerError e = d.containerStopBatch(ids, errors);
+        CHECK(e.isOk() == true);
+        CHECK(errors.size() == ids.size());
+        for (DockerError &err : errors) CHECK(err.isOk() == true);
+    }
+
+    TEST_CASE("Check containerStopBatch reports errors per container") {
+        Docker<MockSlowHttp> d("slow");
+        std::vector<std::string> ids = {"a", "missing", "c"};
+        DockerErrorList errors;
+        DockerError e = d.containerStopBatch(ids, errors);
+        CHECK(e.isError() == true);
+        CHECK(e.apiErrorCode == 404);
+        CHECK(errors[0].isOk() == true);
+        CHECK(errors[1].isError() == true);
+        CHECK(errors[1].apiErrorCode == 404);
+        CHECK(errors[2].isOk() == true);
+    }
+
+    TEST_CASE("Check container batch operations respect the concurrency limit") {
+        Docker<MockSlowHttp> d("slow");
+        std::vector<std::string> ids(16, "id");
+        DockerErrorList errors;
+        MockSlowHttp::reset();
+        auto start = std::chrono::steady_clock::now();
+        DockerError e = d.containerKillBatch(ids, errors, "SIGKILL", 4);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        CHECK(e.isOk() == true);
+        CHECK(MockSlowHttp::peak() > 1);
+        CHECK(MockSlowHttp::peak() <= 4);
+        CHECK(elapsed < std::chrono::milliseconds(16 * 20));
+    }
+
+    TEST_CASE("Check container batch operations run serially with concurrency 1") {
+        Docker<MockSlowHttp> d("slow");
+        std::vector<std::string> ids(4, "id");
+        DockerErrorList errors;
+        MockSlowHttp::reset();
+        DockerError e = d.containerRemoveBatch(ids, errors, false, false, 1);
+        CHECK(e.isOk() == true);
+        CHECK(MockSlowHttp::peak() == 1);
+    }
+
+    TEST_CASE("Check container batch operations handle an empty list") {
+        Docker<MockErrorHttp> d("500");
+        DockerErrorList errors;
+        DockerError e = d.containerStartBatch(std::vector<std::string>(), errors);
+        CHECK(e.isOk() == true);
+        CHECK(errors.empty() == true);
+    }
+
+    TEST_CASE("Check containerStartBatch takes its detach keys before the concurrency") {
+        Docker<MockSlowHttp> d("slow");
+        std::vector<std::string> ids(4, "id");
+        DockerErrorList errors;
+        MockSlowHttp::reset();
+        CHECK(d.containerStartBatch(ids, errors, "ctrl-x").isOk() == true);
+        CHECK(MockSlowHttp::peak() > 1);
+        MockSlowHttp::reset();
+        CHECK(d.containerStartBatch(ids, errors, "ctrl-x", 1).isOk() == true);
+        CHECK(MockSlowHttp::peak() == 1);
+    }
+
+    static ContainerInfo makeContainer(const std::string &id, const std::string &state, const std::string &status) {
+        ContainerInfo c;
+        c.id = id;
+        c.state = state;
+        c.status = status;
+        return c;
+    }
+
+    TEST_CASE("Check container list diff reports added, removed and changed containers") {
+        ContainerList before = {makeContainer("a", "running", "Up 1 minute"), makeContainer("b", "running", "Up 1 minute"),
+                                makeContainer("c", "running", "Up 1 minute")};
+        ContainerList after = {makeContainer("a", "running", "Up 1 minute"), makeContainer("b", "exited", "Exited (0)"),
+                               makeContainer("d", "created", "Created")};
+        ContainerListDelta delta;
+        diff(before, after, delta);
+        CHECK(delta.added.size() == 1);
+        CHECK(delta.added[0].id == "d");
+        CHECK(delta.removed.size() == 1);
+        CHECK(delta.removed[0].id == "c");
+        CHECK(delta.changed.size() == 1);
+        CHECK(delta.changed[0].id == "b");
+        CHECK(delta.changed[0].state == "exited");
+    }
+
+    TEST_CASE("Check container list diff detects label changes regardless of order") {
+        ContainerInfo a = makeContainer("a", "running", "Up");
+        a.labels = {{"k1", "v1"}, {"k2", "v2"}};
+        ContainerInfo reordered = a;
+        reordered.labels = {{"k2", "v2"}, {"k1", "v1"}};
+        ContainerInfo relabeled = a;
+        relabeled.labels = {{"k1", "v1"}, {"k2", "other"}};
+
+        ContainerListDelta same;
+        diff({a}, {reordered}, same);
+        CHECK(same.empty() == true);
+
+        ContainerListDelta changed;
+        diff({a}, {relabeled}, changed);
+        CHECK(changed.changed.size() == 1);
+    }
+
+    TEST_CASE("Check containerListDelta reports every container on the first call") {
+        Docker<MockResponseHttp> d("container_list");
+        ContainerList snapshot;
+        ContainerListDelta delta;
+        DockerError e = d.containerListDelta(snapshot, delta);
+        CHECK(e.isOk() == true);
+        CHECK(delta.added.size() == snapshot.size());
+        CHECK(snapshot.empty() == false);
+
+        ContainerListDelta next;
+        e = d.containerListDelta(snapshot, next);
+        CHECK(e.isOk() == true);
+        CHECK(next.empty() == true);
+    }
+
+    TEST_CASE("Check containerListDelta can reuse the same delta between polls") {
+        MockDaemon daemon;
+        std::atomic<int> polls(0);
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &) {
+            MockDaemon::Response res;
+            if (polls++ == 0)
+                res.body = "[{\"Id\":\"a\",\"State\":\"running\",\"Status\":\"Up\"},{\"Id\":\"b\",\"State\":\"running\",\"Status\":\"Up\"}]";
+            else
+                res.body = "[{\"Id\":\"a\",\"State\":\"exited\",\"Status\":\"Exited (0)\"},{\"Id\":\"c\",\"State\":\"running\",\"Status\":\"Up\"}]";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        ContainerList snapshot;
+        ContainerListDelta delta;
+        CHECK(docker.containerListDelta(snapshot, delta).isOk() == true);
+        CHECK(delta.added.size() == 2);
+
+        CHECK(docker.containerListDelta(snapshot, delta).isOk() == true);
+        REQUIRE(delta.added.size() == 1);
+        CHECK(delta.added[0].id == "c");
+        REQUIRE(delta.removed.size() == 1);
+        CHECK(delta.removed[0].id == "b");
+        REQUIRE(delta.changed.size() == 1);
+        CHECK(delta.changed[0].id == "a");
+
+        CHECK(docker.containerListDelta(snapshot, delta).isOk() == true);
+        CHECK(delta.empty() == true);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check containerArchiveGet writes the archive and describes the path") {
+        // {"name":"app","size":4096,"mode":2147484141,"mtime":"2020-01-01T00:00:00Z","linkTarget":""}
+        const std::string stat64 = "eyJuYW1lIjoiYXBwIiwic2l6ZSI6NDA5NiwibW9kZSI6MjE0NzQ4NDE0MSwibXRpbWUiOiIyMDIwLTAxLTAxVDAwOjAwOjAwWiIsImxpbmtUYXJnZXQiOiIifQ==";
+        std::string archive(200 * 1024, '\0');
+        for (std::size_t i = 0; i < archive.size(); ++i) archive[i] = static_cast<char>(i * 7);
+        MockDaemon daemon;
+        std::string query;
+        auto handler = [&](const MockDaemon::Request &r) {
+            query = r.query;
+            MockDaemon::Response res;
+            res.contentType = "application/x-tar";
+            res.headers["X-Docker-Container-Path-Stat"] = stat64;
+            res.chunked = true;
+            res.chunkSize = 16 * 1024;
+            res.body = archive;
+            return res;
+        };
+        daemon.route("GET", "/containers/*/archive", handler);
+        daemon.route("HEAD", "/containers/*/archive", handler);
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        PathStat info;
+        CHECK(docker.containerArchiveInfo("web", "/srv/app", info).isOk() == true);
+        CHECK(query == "path=%2Fsrv%2Fapp");
+        CHECK(info.name == "app");
+        CHECK(info.size == 4096);
+        CHECK(info.isDir() == true);
+        CHECK(info.isLink() == false);
+
+        std::FILE *file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        PathStat stat;
+        CHECK(docker.containerArchiveGet("web", "/srv/app", fileno(file), &stat).isOk() == true);
+        CHECK(stat.mtime == "2020-01-01T00:00:00Z");
+        std::string written(archive.size() + 1, '\0');
+        CHECK(::pread(fileno(file), &written[0], written.size(), 0) == static_cast<ssize_t>(archive.size()));
+        written.resize(archive.size());
+        CHECK(written == archive);
+        std::fclose(file);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check containerArchivePut sends buffers, files and host paths") {
+        MockDaemon daemon;
+        std::string received, query;
+        daemon.route("PUT", "/containers/*/archive", [&](const MockDaemon::Request &r) {
+            received = r.body;
+            query = r.query;
+            return MockDaemon::Response();
+        });
+        MockDaemon::Response missing;
+        missing.code = 404;
+        missing.body = "{\"message\":\"No such container: gone\"}";
+        daemon.route("PUT", "/containers/gone/archive", missing);
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        // Buffers are written as they are
+        std::string head(512, 'h'), data(100000, 'd'), tail(1024, '\0');
+        BufferSource buffers;
+        buffers.add(head).add(data).add(tail);
+        CHECK(docker.containerArchivePut("web", "/etc/app", buffers, true).isOk() == true);
+        CHECK(received == head + data + tail);
+        CHECK(query == "path=%2Fetc%2Fapp&noOverwriteDirNonDir=true");
+
+        // Files go with sendfile()
+        std::FILE *file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        REQUIRE(::write(fileno(file), data.data(), data.size()) == static_cast<ssize_t>(data.size()));
+        ::lseek(fileno(file), 0, SEEK_SET);
+        CHECK(docker.containerArchivePut("web", "/etc/app", fileno(file)).isOk() == true);
+        CHECK(received == data);
+        std::fclose(file);
+
+        // Host paths are packed on the fly under their base names
+        char name[] = "/tmp/docker_cpp_archive_XXXXXX";
+        REQUIRE(::mkdtemp(name) != nullptr);
+        std::string dir = name;
+        std::ofstream((dir + "/app.conf").c_str()) << "port=80\n";
+        ::mkdir((dir + "/certs").c_str(), 0755);
+        std::ofstream((dir + "/certs/ca.pem").c_str()) << "CERT";
+        CHECK(docker.containerArchivePut("web", "/etc/app", std::vector<std::string>{dir + "/app.conf", dir + "/certs/"}).isOk() == true);
+        CHECK(received.size() % 512 == 0);
+        CHECK(std::string(received.c_str()) == "app.conf");
+        CHECK(received.find("certs/ca.pem") != std::string::npos);
+        CHECK(received.find("port=80\n") != std::string::npos);
+        CHECK(docker.containerArchivePut("web", "/etc/app", std::vector<std::string>{dir + "/missing"}).isError() == true);
+        std::system(("rm -rf '" + dir + "'").c_str());
+
+        CHECK(docker.containerArchivePut("gone", "/etc/app", buffers).isNotFound() == true);
+        daemon.stop();
+    }
+}
@@ -0,0 +1,221 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+#include "fixture_http.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace docker_cpp;
+
+static std::chrono::milliseconds since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
+TEST_SUITE("DEADLINE") {
+    TEST_CASE("Check a call past its deadline times out") {
+        MockDaemon daemon;
+        MockDaemon::Response slow;
+        slow.body = "{\"StatusCode\":0}";
+        slow.latencyUs = 500000;
+        daemon.route("POST", "/containers/*/wait", slow);
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        WaitInfo info;
+        auto start = std::chrono::steady_clock::now();
+        {
+            CallScope scope(std::chrono::milliseconds(50));
+            DockerError e = docker.containerWait("abc", info);
+            CHECK(e.isTimeout() == true);
+            CHECK(e.isError() == true);
+            CHECK(e.errorCode == DOCKER_TIMEOUT);
+        }
+        CHECK(since(start) < std::chrono::milliseconds(400));
+        CHECK(docker.transport().idleConnections() == 0); // the interrupted connection is not reused
+
+        CHECK(docker.containerWait("abc", info).isOk() == true); // no deadline outside the scope
+        daemon.stop();
+    }
+
+    TEST_CASE("Check a call is cancelled from another thread") {
+        MockDaemon daemon;
+        MockDaemon::Response slow;
+        slow.body = "{\"StatusCode\":0}";
+        slow.latencyUs = 500000;
+        daemon.route("POST", "/containers/*/wait", slow);
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        CancellationToken token = CancellationToken::create();
+        std::thread canceller([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            token.cancel();
+        });
+        auto start = std::chrono::steady_clock::now();
+        WaitInfo info;
+        DockerError e = DockerError::D_OK();
+        {
+            CallScope scope(token);
+            e = docker.containerWait("abc", info);
+        }
+        canceller.join();
+        CHECK(e.isCancelled() == true);
+        CHECK(since(start) < std::chrono::milliseconds(400));
+        daemon.stop();
+    }
+
+    TEST_CASE("Check interrupted calls are not sent") {
+        Docker<FixtureHttp> docker("http://127.0.0.1:2375");
+        docker.transport().route("GET", "/_ping", 200, "OK");
+
+        CancellationToken token = CancellationToken::create();
+        CancellationToken child = token.child();
+        token.cancel();
+        CHECK(child.cancelled() == true);
+        CHECK(token.child().cancelled() == true);
+        {
+            CallScope scope(child);
+            CHECK(docker.ping().isCancelled() == true);
+        }
+        {
+            CallScope scope(std::chrono::milliseconds(1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            CHECK(docker.ping().isTimeout() == true);
+        }
+        CHECK(docker.transport().requests() == 0);
+        CHECK(docker.ping().isOk() == true);
+    }
+
+    TEST_CASE("Check nested scopes keep the earliest deadline and every token") {
+        CHECK(current_call_context() == nullptr);
+        CancellationToken outerToken = CancellationToken::create();
+        {
+            CallScope outer(std::chrono::milliseconds(50), outerToken);
+            auto deadline = current_call_context()->deadline;
+            {
+                CallScope inner(std::chrono::seconds(10), CancellationToken::create());
+                CHECK(current_call_context()->deadline == deadline);
+                CHECK(current_call_context()->tokens.size() == 2);
+                outerToken.cancel();
+                CHECK(call_interrupted() == true);
+            }
+            CHECK(current_call_context()->tokens.size() == 1);
+        }
+        CHECK(current_call_context() == nullptr);
+        CHECK(call_interrupted() == false);
+    }
+
+    TEST_CASE("Check a wait is cancelled by any of many nested tokens") {
+        int pair[2];
+        REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+        std::vector<CancellationToken> tokens;
+        std::vector<std::unique_ptr<CallScope> > scopes;
+        scopes.emplace_back(new CallScope(std::chrono::seconds(2)));
+        for (int i = 0; i < 40; ++i) {
+            tokens.push_back(CancellationToken::create());
+            scopes.emplace_back(new CallScope(tokens.back()));
+        }
+        REQUIRE(current_call_context()->tokens.size() == 40);
+        std::thread canceller([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            tokens.back().cancel();
+        });
+        auto start = std::chrono::steady_clock::now();
+        CHECK(call_wait(pair[0], POLLIN) == false);
+        CHECK(since(start) < std::chrono::milliseconds(1000));
+        canceller.join();
+        while (!scopes.empty()) scopes.pop_back();
+        ::close(pair[0]);
+        ::close(pair[1]);
+    }
+
+    TEST_CASE("Check idempotent GETs are retried with backoff") {
+        MockDaemon daemon;
+        std::atomic<int> calls(0);
+        daemon.route("GET", "/_ping", [&](const MockDaemon::Request &) {
+            MockDaemon::Response res;
+            res.code = ++calls % 3 == 0 ? 200 : 503;
+            res.body = res.code == 200 ? "OK" : "{\"message\":\"busy\"}";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        DockerError e = docker.ping();
+        CHECK(e.apiErrorCode == 503);
+        CHECK(calls == 1);
+
+        calls = 0;
+        RetryPolicy policy;
+        policy.attempts = 3;
+        policy.backoff = std::chrono::milliseconds(1);
+        docker.setRetryPolicy(policy);
+        CHECK(docker.ping().isOk() == true);
+        CHECK(calls == 3);
+
+        calls = 0;
+        policy.backoff = std::chrono::milliseconds(10000);
+        policy.maxBackoff = std::chrono::milliseconds(10000);
+        docker.setRetryPolicy(policy);
+        auto start = std::chrono::steady_clock::now();
+        {
+            // the backoff does not outlive the deadline
+            CallScope scope(std::chrono::milliseconds(50));
+            e = docker.ping();
+        }
+        CHECK(e.isOk() == false);
+        CHECK(since(start) < std::chrono::milliseconds(1000));
+        daemon.stop();
+    }
+
+    TEST_CASE("Check retry delays are jittered and capped") {
+        RetryPolicy policy;
+        policy.backoff = std::chrono::milliseconds(100);
+        policy.maxBackoff = std::chrono::milliseconds(300);
+        bool varied = false;
+        for (int i = 0; i < 100; ++i) {
+            CHECK(policy.delay(0) <= std::chrono::milliseconds(100));
+            CHECK(policy.delay(10) <= std::chrono::milliseconds(300));
+            varied = varied || policy.delay(1) != policy.delay(1);
+        }
+        CHECK(varied == true);
+    }
+
+    TEST_CASE("Check a hedged GET answers before a stuck request") {
+        MockDaemon daemon;
+        std::atomic<int> calls(0);
+        std::string list = read_fixture("container_list_get.json");
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &) {
+            MockDaemon::Response res;
+            res.body = list;
+            res.latencyUs = ++calls == 1 ? 500000 : 0;
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        RetryPolicy policy;
+        policy.hedgeAfter = std::chrono::milliseconds(20);
+        docker.setRetryPolicy(policy);
+
+        ContainerList containers;
+        auto start = std::chrono::steady_clock::now();
+        CHECK(docker.containerList(containers, true).isOk() == true);
+        CHECK(since(start) < std::chrono::milliseconds(400));
+        CHECK(containers.size() == 1);
+        CHECK(calls == 2);
+
+        // a fast answer cancels the hedged request before it is sent
+        CHECK(docker.containerList(containers, true).isOk() == true);
+        CHECK(calls == 3);
+        daemon.stop();
+    }
+}
@@ -0,0 +1,92 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+
+#include <cstring>
+
+using namespace docker_cpp;
+
+static std::string message_of(const char *body)
+{
+    return error_message(body, std::strlen(body));
+}
+
+TEST_SUITE("ERROR") {
+    TEST_CASE("Check HTTP statuses map to error kinds") {
+        CHECK(error_kind(200) == ERR_NONE);
+        CHECK(error_kind(204) == ERR_NONE);
+        CHECK(error_kind(304) == ERR_NOT_MODIFIED);
+        CHECK(error_kind(400) == ERR_BAD_PARAMETER);
+        CHECK(error_kind(401) == ERR_UNAUTHORIZED);
+        CHECK(error_kind(403) == ERR_UNAUTHORIZED);
+        CHECK(error_kind(404) == ERR_NOT_FOUND);
+        CHECK(error_kind(406) == ERR_NOT_ACCEPTABLE);
+        CHECK(error_kind(409) == ERR_CONFLICT);
+        CHECK(error_kind(500) == ERR_SERVER);
+        CHECK(error_kind(502) == ERR_SERVER);
+        CHECK(error_kind(503) == ERR_UNAVAILABLE);
+        CHECK(error_kind(0) == ERR_CONNECTION);
+        CHECK(error_kind(418) == ERR_OTHER);
+    }
+
+    TEST_CASE("Check the message of error bodies") {
+        CHECK(message_of("{\"message\":\"No such container: foo\"}") == "No such container: foo");
+        CHECK(message_of("{\n    \"message\" : \"Something went wrong.\"\n}") == "Something went wrong.");
+        CHECK(message_of("{\"message\":\"say \\\"hi\\\"\\n\\u00e9\\ud83d\\ude00\"}") == "say \"hi\"\n\xc3\xa9\xf0\x9f\x98\x80");
+        CHECK(message_of("{\"detail\":{\"message\":\"inner\"},\"list\":[\"message\"],\"message\":\"outer\"}") == "outer");
+        CHECK(message_of("{\"msg\":\"message\"}") == "");
+        CHECK(message_of("{\"message\":\"unterminated") == "");
+        CHECK(message_of("  page not found\n") == "page not found");
+        CHECK(message_of("") == "");
+        CHECK(message_of(" \r\n") == "");
+    }
+
+    TEST_CASE("Check the message of daemon errors") {
+        const char body[] = "{\"message\":\"Conflict. The container name is already in use\"}";
+        DockerError e = DockerError::D_HTTP(409, body, sizeof(body) - 1);
+        CHECK(e.isError() == true);
+        CHECK(e.isConflict() == true);
+        CHECK(e.apiErrorCode == 409);
+        CHECK(e.msg == "Conflict. The container name is already in use");
+        CHECK(e.message() == e.msg);
+
+        DockerError copy = e;
+        CHECK(copy.message() == e.message());
+
+        DockerError empty = DockerError::D_HTTP(404, "", 0);
+        CHECK(empty.isNotFound() == true);
+        CHECK(empty.msg.empty() == true);
+        CHECK(empty.message() == "Not found");
+
+        DockerError odd = DockerError::D_HTTP(418, "", 0);
+        CHECK(odd.kind == ERR_OTHER);
+        CHECK(odd.message() == "HTTP status 418");
+
+        CHECK(DockerError::D_ERROR("client side", 0).message() == "client side");
+        CHECK(DockerError::D_CONNECTION().kind == ERR_CONNECTION);
+        CHECK(DockerError::D_TIMEOUT().kind == ERR_TIMEOUT);
+        CHECK(DockerError::D_OK().kind == ERR_NONE);
+    }
+
+    TEST_CASE("Check error kinds of daemon responses") {
+        Docker<MockErrorHttp> notModified("304");
+        DockerError e = notModified.containerStop("containerID");
+        CHECK(e.isOk() == true);
+        CHECK(e.isNotModified() == true);
+        CHECK(e.message() == "Not modified");
+
+        Docker<MockErrorHttp> notFound("404");
+        e = notFound.containerKill("containerID");
+        CHECK(e.isError() == true);
+        CHECK(e.isNotFound() == true);
+
+        Docker<MockErrorHttp> failing("500");
+        e = failing.containerStart("containerID");
+        CHECK(e.kind == ERR_SERVER);
+        CHECK(e.message() == "Something went wrong.");
+
+        Docker<MockResponseHttp> ok("200");
+        e = ok.containerStart("containerID");
+        CHECK(e.kind == ERR_NONE);
+        CHECK(e.message().empty() == true);
+    }
+}
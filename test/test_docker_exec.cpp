@@ -85,4 +85,125 @@ TEST_SUITE("EXEC") {
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
     }
-}
\ No newline at end of file
+
+    TEST_CASE("Check exec run captures demultiplexed output and exit code") {
+        Docker<MockResponseHttp> d("exec_run");
+        ExecConfig config;
+        config.cmd = {"sh", "-c", "exit 2"};
+        ExecRunResult r;
+        DockerError e = d.execRun("containerId", config, r);
+        CHECK(e.isOk() == true);
+        CHECK(r.exitCode == 2);
+        CHECK(r.stdOut == "hello\nworld\n");
+        CHECK(r.stdErr == "oops\n");
+    }
+
+    TEST_CASE("Check exec run streams output to callbacks") {
+        Docker<MockResponseHttp> d("exec_run");
+        ExecConfig config;
+        std::vector<std::string> lines;
+        int exitCode = -1;
+        DockerError e = d.execRun("containerId", config,
+            [&](const char *data, std::size_t size) { lines.push_back("out:" + std::string(data, size)); return true; },
+            [&](const char *data, std::size_t size) { lines.push_back("err:" + std::string(data, size)); return true; },
+            exitCode);
+        CHECK(e.isOk() == true);
+        CHECK(exitCode == 2);
+        CHECK(lines == std::vector<std::string>({"out:hello\n", "err:oops\n", "out:world\n"}));
+    }
+
+    TEST_CASE("Check exec run handles error") {
+        Docker<MockErrorHttp> d("404");
+        ExecConfig config;
+        ExecRunResult r;
+        DockerError e = d.execRun("containerId", config, r);
+        CHECK(e.isError() == true);
+        CHECK(r.exitCode == -1);
+    }
+
+    TEST_CASE("Check exec run batch runs a command in every container") {
+        Docker<MockResponseHttp> d("exec_run");
+        ExecConfig config;
+        std::vector<std::string> ids(5, "containerId");
+        std::vector<ExecRunResult> results;
+        DockerErrorList errors;
+        DockerError e = d.execRunBatch(ids, config, results, errors, 3);
+        CHECK(e.isOk() == true);
+        CHECK(results.size() == ids.size());
+        for (ExecRunResult &r : results) {
+            CHECK(r.exitCode == 2);
+            CHECK(r.stdOut == "hello\nworld\n");
+        }
+    }
+
+    TEST_CASE("Check stream demuxer handles frames split across reads") {
+        std::string out, err;
+        StreamDemuxer demux(append_to(out), append_to(err));
+        const char stream[] = "\x01\0\0\0\0\0\0\x03" "abc" "\x02\0\0\0\0\0\0\x02" "de" "\x01\0\0\0\0\0\0\0";
+        for (std::size_t i = 0; i < sizeof(stream) - 1; ++i)
+            CHECK(demux.feed(stream + i, 1) == true);
+        CHECK(out == "abc");
+        CHECK(err == "de");
+        CHECK(demux.idle() == true);
+    }
+
+    TEST_CASE("Check stream demuxer rejects malformed streams") {
+        std::string out, err;
+        StreamDemuxer demux(append_to(out), append_to(err));
+        const char stream[] = "\x07\0\0\0\0\0\0\x01x";
+        CHECK(demux.feed(stream, sizeof(stream) - 1) == false);
+    }
+
+    TEST_CASE("Check exec config is serialized as valid JSON") {
+        ExecConfig config;
+        config.cmd = {"sh", "-c", "echo \"hi\""};
+        std::string json = config.str();
+        CHECK(json.find("\"DetachKeys\":\"ctrl-p,ctrl-q\"") != std::string::npos);
+        CHECK(json.find("\"echo \\\"hi\\\"\"") != std::string::npos);
+        CHECK(json.find("\"User\":\"\"") != std::string::npos);
+    }
+
+    TEST_CASE("Check exec attach reads output into scatter buffers") {
+        Docker<MockResponseHttp> d("exec_run");
+        std::string out, err;
+        ExecSession session(append_to(out), append_to(err));
+        DockerError e = d.execAttach("execId", session);
+        CHECK(e.isOk() == true);
+        CHECK(session.isOpen() == true);
+
+        char a[7], b[64];
+        iovec iov[2] = {{a, sizeof(a)}, {b, sizeof(b)}};
+        long total = 0, n;
+        while ((n = session.read(iov, 2)) > 0) total += n;
+        CHECK(n == 0);
+        CHECK(total == 3 * 8 + 6 + 5 + 6);
+        CHECK(out == "hello\nworld\n");
+        CHECK(err == "oops\n");
+    }
+
+    TEST_CASE("Check exec attach writes stdin with gather buffers") {
+        Docker<MockResponseHttp> d("exec_run");
+        ExecSession session;
+        DockerError e = d.execAttach("execId", session, true);
+        CHECK(e.isOk() == true);
+        CHECK(session.tty() == true);
+        CHECK(session.setNonBlocking(true) == true);
+
+        iovec iov[2] = {{const_cast<char *>("echo "), 5}, {const_cast<char *>("hi\n"), 3}};
+        CHECK(session.write(iov, 2) == 8);
+        CHECK(session.closeStdin() == true);
+        char received[16] = {0};
+        CHECK(::read(MockResponseHttp::peer(), received, sizeof(received)) == 8);
+        CHECK(std::string(received) == "echo hi\n");
+        CHECK(session.resize(24, 80).isOk() == true);
+    }
+
+    TEST_CASE("Check exec attach handles error") {
+        Docker<MockErrorHttp> d("409");
+        ExecSession session;
+        DockerError e = d.execAttach("execId", session);
+        CHECK(e.isError() == true);
+        CHECK(session.isOpen() == false);
+        CHECK(session.resize(24, 80).isError() == true);
+    }
+}
@@ -0,0 +1,202 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdio>
+
+using namespace docker_cpp;
+
+// Full ID whose short form differs for every n
+static std::string container_id(int n)
+{
+    char text[9];
+    std::snprintf(text, sizeof(text), "%08x", static_cast<unsigned int>(n * 2654435761u));
+    std::string id;
+    for (int i = 0; i < 8; ++i) id += text;
+    return id;
+}
+
+// Containers of a mock daemon, served by /containers/json whatever the filters
+struct Population
+{
+    struct Container
+    {
+        std::string id, name, state, status;
+    };
+
+    std::mutex mutex;
+    std::vector<Container> containers;
+    std::atomic<int> lists{0};
+
+    void add(const std::string &id, const std::string &name, const std::string &state, const std::string &status)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        containers.push_back(Container{id, name, state, status});
+    }
+
+    void set(const std::string &name, const std::string &state, const std::string &status)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Container &c : containers) {
+            if (c.name == name) { c.state = state; c.status = status; }
+        }
+    }
+
+    void remove(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        containers.erase(std::remove_if(containers.begin(), containers.end(), [&](const Container &c) { return c.name == name; }), containers.end());
+    }
+
+    void route(MockDaemon &daemon)
+    {
+        daemon.route("GET", "/containers/json", [this](const MockDaemon::Request &) {
+            ++lists;
+            std::lock_guard<std::mutex> lock(mutex);
+            MockDaemon::Response res;
+            res.body = "[";
+            for (std::size_t i = 0; i < containers.size(); ++i) {
+                const Container &c = containers[i];
+                res.body += (i ? ",{\"Id\":\"" : "{\"Id\":\"") + c.id + "\",\"Names\":[\"/" + c.name + "\"],\"State\":\"" + c.state + "\",\"Status\":\"" + c.status + "\"}";
+            }
+            res.body += "]";
+            return res;
+        });
+    }
+};
+
+TEST_SUITE("HEALTH") {
+    TEST_CASE("Check health is read from the container status") {
+        CHECK(parse_health("Up 5 minutes (healthy)") == HEALTH_HEALTHY);
+        CHECK(parse_health("Up 2 seconds (health: starting)") == HEALTH_STARTING);
+        CHECK(parse_health("Up About an hour (unhealthy)") == HEALTH_UNHEALTHY);
+        CHECK(parse_health("Up 5 minutes") == HEALTH_NONE);
+        CHECK(parse_health("Exited (137) 2 hours ago") == HEALTH_NONE);
+        CHECK(parse_health("Up 5 minutes (Paused)") == HEALTH_NONE);
+        CHECK(parse_health("") == HEALTH_NONE);
+        CHECK(std::string(health_name(HEALTH_UNHEALTHY)) == "unhealthy");
+    }
+
+    TEST_CASE("Check status changes reach the subscribers and intervals adapt") {
+        MockDaemon daemon;
+        Population population;
+        population.add(container_id(1), "web", "running", "Up 5 minutes (healthy)");
+        population.add(container_id(2), "db", "running", "Up 2 seconds (health: starting)");
+        population.add(container_id(3), "job", "exited", "Exited (0) 1 second ago");
+        population.route(daemon);
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        HealthMonitorOptions options;
+        options.minInterval = std::chrono::milliseconds(20);
+        options.maxInterval = std::chrono::milliseconds(80);
+        HealthMonitor<SocketHttp> monitor(options);
+        std::mutex mutex;
+        std::vector<StatusChange> changes;
+        auto count = [&] { std::lock_guard<std::mutex> lock(mutex); return changes.size(); };
+        std::size_t subscription = monitor.subscribe([&](const StatusChange &c) {
+            std::lock_guard<std::mutex> lock(mutex);
+            changes.push_back(c);
+        });
+
+        CHECK(monitor.watch(docker, "web") == true);
+        CHECK(monitor.watch(docker, "web") == false);
+        CHECK(monitor.watch(docker, container_id(2).substr(0, 12)) == true);
+        CHECK(monitor.watch(docker, "job") == true);
+        REQUIRE(eventually([&] { return count() >= 3; }) == true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const StatusChange &c : changes) {
+                CHECK(c.daemon == daemon.url());
+                CHECK(c.before.state.empty() == true);
+            }
+        }
+        CHECK(monitor.status(docker, "web").health == HEALTH_HEALTHY);
+        CHECK(monitor.status(docker, "job").state == "exited");
+
+        // Stable containers are polled less and less often; a starting one keeps the shortest interval
+        REQUIRE(eventually([&] { return monitor.interval(docker, "web") == std::chrono::milliseconds(80); }) == true);
+        REQUIRE(eventually([&] { return monitor.interval(docker, "job") == std::chrono::milliseconds(80); }) == true);
+        CHECK(monitor.interval(docker, container_id(2).substr(0, 12)) == std::chrono::milliseconds(20));
+        CHECK(count() == 3);
+
+        population.set("db", "running", "Up 30 seconds (healthy)");
+        population.set("web", "running", "Up 6 minutes (unhealthy)");
+        REQUIRE(eventually([&] { return count() >= 5; }) == true);
+        CHECK(monitor.interval(docker, "web") == std::chrono::milliseconds(20));
+        CHECK(monitor.status(docker, container_id(2).substr(0, 12)).health == HEALTH_HEALTHY);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::size_t i = 3; i < changes.size(); ++i) {
+                if (changes[i].id == "web") {
+                    CHECK(changes[i].before.health == HEALTH_HEALTHY);
+                    CHECK(changes[i].after.health == HEALTH_UNHEALTHY);
+                } else {
+                    CHECK(changes[i].before.health == HEALTH_STARTING);
+                    CHECK(changes[i].after.health == HEALTH_HEALTHY);
+                }
+            }
+        }
+
+        // Removed containers are reported once and no longer watched
+        population.remove("job");
+        REQUIRE(eventually([&] { return count() >= 6; }) == true);
+        CHECK(monitor.watched() == 2);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            CHECK(changes.back().id == "job");
+            CHECK(changes.back().before.state == "exited");
+            CHECK(changes.back().after.state == "removed");
+        }
+
+        // A daemon that stops answering keeps the last status of its containers
+        monitor.unsubscribe(subscription);
+        daemon.stop();
+        REQUIRE(eventually([&] { return monitor.error(docker).isError(); }) == true);
+        CHECK(monitor.status(docker, "web").health == HEALTH_UNHEALTHY);
+        CHECK(monitor.unwatch(docker, "web") == true);
+        CHECK(monitor.unwatch(docker, "web") == false);
+        monitor.stop();
+    }
+
+    TEST_CASE("Check large populations are polled in batches") {
+        const int count = 250;
+        MockDaemon first, second;
+        Population one, two;
+        for (int i = 0; i < count; ++i) {
+            one.add(container_id(i + 1), "a" + std::to_string(i), "running", "Up 1 hour");
+            two.add(container_id(1000 + i), "b" + std::to_string(i), "running", "Up 1 hour (healthy)");
+        }
+        one.route(first);
+        two.route(second);
+        REQUIRE(first.start() == true);
+        REQUIRE(second.start() == true);
+        Docker<SocketHttp> a(first.url()), b(second.url());
+
+        HealthMonitorOptions options;
+        options.minInterval = std::chrono::milliseconds(50);
+        options.maxInterval = std::chrono::milliseconds(50);
+        options.batchSize = 100;
+        HealthMonitor<SocketHttp> monitor(options);
+        std::atomic<int> changes(0);
+        monitor.subscribe([&](const StatusChange &) { ++changes; });
+        for (int i = 0; i < count; ++i) {
+            monitor.watch(a, container_id(i + 1));
+            monitor.watch(b, "b" + std::to_string(i));
+        }
+        REQUIRE(eventually([&] { return changes == 2 * count; }) == true);
+        CHECK(monitor.watched() == 2 * count);
+
+        // Every container is polled about ten times in half a second, by lists of a hundred
+        int before = one.lists + two.lists;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        int lists = one.lists + two.lists - before;
+        CHECK(lists > 0);
+        CHECK(lists < 2 * 12 * 4);
+        CHECK(first.requests() == static_cast<std::size_t>(one.lists));
+        CHECK(changes == 2 * count);
+        monitor.stop();
+        first.stop();
+        second.stop();
+    }
+}
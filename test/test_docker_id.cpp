@@ -0,0 +1,138 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+using namespace docker_cpp;
+
+static const std::string IMAGE_HEX = "d74508fb6632491cea586a1fd7d748dfc5274cd6fdfedee309ecdcbc2bf5cb82";
+
+TEST_SUITE("ID") {
+    TEST_CASE("Check IDs round-trip through hex") {
+        ImageId image = ImageId::fromHex("sha256:" + IMAGE_HEX);
+        CHECK(image.empty() == false);
+        CHECK(image.hex() == IMAGE_HEX);
+        CHECK(image.str() == "sha256:" + IMAGE_HEX);
+        CHECK(image == ImageId::fromHex(IMAGE_HEX));
+
+        std::string upper = IMAGE_HEX;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        CHECK(ImageId::fromHex(upper) == image);
+
+        ContainerId container = ContainerId::fromHex(IMAGE_HEX);
+        CHECK(container.str() == IMAGE_HEX);
+        CHECK(container.shortHex() == "d74508fb6632");
+        CHECK(std::string(container) == IMAGE_HEX);
+    }
+
+    TEST_CASE("Check malformed IDs are rejected") {
+        CHECK(ContainerId::fromHex("8dfafdbc3a40").empty() == true); // short IDs are not full IDs
+        CHECK(ContainerId::fromHex("my-container").empty() == true);
+        CHECK(ContainerId::fromHex("").empty() == true);
+        CHECK(ContainerId::fromHex(IMAGE_HEX + "0").empty() == true);
+        const char bad[] = {'g', 'G', ' ', '/', ':', '@', '`', '\x80', '\xff', '\0'};
+        for (std::size_t i = 0; i < IMAGE_HEX.size(); ++i) {
+            for (char c : bad) {
+                std::string hex = IMAGE_HEX;
+                hex[i] = c;
+                ContainerId id;
+                CHECK(id.parse(hex) == false);
+                CHECK(id.empty() == true);
+            }
+        }
+    }
+
+    TEST_CASE("Check hex encoding of every byte value") {
+        unsigned char bytes[256], decoded[256];
+        for (int i = 0; i < 256; ++i) bytes[i] = static_cast<unsigned char>(i);
+        char hex[512];
+        hex_encode(bytes, sizeof(bytes), hex);
+        CHECK(std::string(hex, 6) == "000102");
+        CHECK(std::string(hex + 506, 6) == "fdfeff");
+        CHECK(hex_decode(hex, sizeof(decoded), decoded) == true);
+        CHECK(std::equal(bytes, bytes + 256, decoded) == true);
+    }
+
+    TEST_CASE("Check prefix matching") {
+        ContainerId id = ContainerId::fromHex(IMAGE_HEX);
+        IdPrefix prefix;
+        CHECK(prefix.parse("d74508fb6632") == true);
+        CHECK(id.matches(prefix) == true);
+        CHECK(prefix.parse("d7450") == true); // odd number of digits
+        CHECK(prefix.digits() == 5);
+        CHECK(id.matches(prefix) == true);
+        CHECK(prefix.parse("d7451") == true);
+        CHECK(id.matches(prefix) == false);
+        CHECK(prefix.parse("sha256:d745") == true);
+        CHECK(id.matches(prefix) == true);
+        CHECK(prefix.parse(IMAGE_HEX) == true);
+        CHECK(id.matches(prefix) == true);
+        CHECK(prefix.parse("") == true);
+        CHECK(id.matches(prefix) == true);
+        CHECK(prefix.parse("d74z") == false);
+        CHECK(prefix.parse(IMAGE_HEX + "0") == false);
+    }
+
+    TEST_CASE("Check containers are matched by ID prefix or name") {
+        ContainerInfo info;
+        info.id = IMAGE_HEX;
+        info.names.push_back("/job42");
+        CHECK(container_matches(info, IMAGE_HEX.substr(0, 12)) == true);
+        CHECK(container_matches(info, IMAGE_HEX) == true);
+        CHECK(container_matches(info, "job42") == true);
+        CHECK(container_matches(info, "/job42") == true);
+        CHECK(container_matches(info, "job4") == false);
+        CHECK(container_matches(info, "") == false);
+    }
+
+    TEST_CASE("Check prefixes resolve in a sorted list") {
+        std::vector<ContainerId> ids = {
+            ContainerId::fromHex(std::string(64, 'a')),
+            ContainerId::fromHex("ab" + std::string(62, '0')),
+            ContainerId::fromHex("ab" + std::string(62, 'f')),
+            ContainerId::fromHex(IMAGE_HEX),
+        };
+        std::sort(ids.begin(), ids.end());
+        CHECK(ids.front().hex() == std::string(64, 'a'));
+
+        IdPrefix prefix;
+        prefix.parse("ab");
+        auto range = prefix_range(ids, prefix);
+        CHECK(range.second - range.first == 2);
+        prefix.parse("abf");
+        range = prefix_range(ids, prefix);
+        CHECK(range.second - range.first == 1);
+        CHECK(range.first->hex() == "ab" + std::string(62, 'f'));
+        prefix.parse("d7");
+        range = prefix_range(ids, prefix);
+        CHECK(range.second - range.first == 1);
+        prefix.parse("b");
+        range = prefix_range(ids, prefix);
+        CHECK(range.first == range.second);
+    }
+
+    TEST_CASE("Check containers join to their images by key") {
+        ImageList images(2);
+        images[0].id = "sha256:" + IMAGE_HEX;
+        images[0].key.parse(images[0].id);
+        images[1].id = "sha256:" + std::string(64, 'e');
+        images[1].key.parse(images[1].id);
+
+        std::unordered_map<ImageId, const ImageInfo *> byKey;
+        for (const ImageInfo &image : images) byKey[image.key] = &image;
+
+        ContainerInfo container;
+        container.imageID = "sha256:" + IMAGE_HEX;
+        container.imageKey.parse(container.imageID);
+        auto it = byKey.find(container.imageKey);
+        REQUIRE(it != byKey.end());
+        CHECK(it->second == &images[0]);
+    }
+
+    TEST_CASE("Check IDs can be passed to the endpoint methods") {
+        Docker<MockResponseHttp> d("200");
+        CHECK(d.containerStart(ContainerId::fromHex(IMAGE_HEX)).isOk() == true);
+    }
+}
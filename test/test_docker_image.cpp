@@ -1,8 +1,32 @@
 #include <doctest/doctest.h>
 #include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdio>
+#include <random>
+#include <set>
 
 using namespace docker_cpp;
 
+// Contents of a descriptor from its start
+static std::string read_fd(int fd)
+{
+    std::string out;
+    char buf[4096];
+    ::lseek(fd, 0, SEEK_SET);
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) out.append(buf, static_cast<std::size_t>(n));
+    return out;
+}
+
+static std::string random_bytes(std::size_t size)
+{
+    std::mt19937 random(3);
+    std::string data(size, '\0');
+    for (char &c : data) c = static_cast<char>(random());
+    return data;
+}
+
 TEST_SUITE("IMAGE") {
     TEST_CASE("Check image_list returns a list of images") {
         Docker<MockResponseHttp> d("image_list");
@@ -32,7 +56,7 @@ TEST_SUITE("IMAGE") {
         DockerError e = d.imageList(r);
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
-        CHECK(e.msg.empty() == false);
+        CHECK(e.message().empty() == false);
     }
 
     TEST_CASE("Check image_tag returns OK") {
@@ -48,7 +72,7 @@ TEST_SUITE("IMAGE") {
         DockerError e = d.imageTag("foo", "bar", "test");
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
-        CHECK(e.msg.empty() == false);
+        CHECK(e.message().empty() == false);
     }
 
     TEST_CASE("Check image_remove returns OK") {
@@ -68,7 +92,7 @@ TEST_SUITE("IMAGE") {
         DockerError e = d.imageRemove("foo", r);
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
-        CHECK(e.msg.empty() == false);
+        CHECK(e.message().empty() == false);
     }
 
     TEST_CASE("Check image_prune returns OK") {
@@ -89,6 +113,231 @@ TEST_SUITE("IMAGE") {
         DockerError e = d.imagePrune("foo", r);
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
-        CHECK(e.msg.empty() == false);
+        CHECK(e.message().empty() == false);
+    }
+
+    static ImageInfo makeImage(const std::string &id, const std::string &parent, std::int64_t size, int containers = 0, std::int64_t created = 0) {
+        ImageInfo i;
+        i.id = id;
+        i.parentId = parent;
+        i.size = i.virtualSize = size;
+        i.sharedSize = 0;
+        i.created = created;
+        i.containers = containers;
+        return i;
+    }
+
+    TEST_CASE("Check image cleanup plan removes children before parents") {
+        ImageList images = {makeImage("leaf", "mid", 180), makeImage("mid", "base", 150),
+                            makeImage("base", "", 100), makeImage("other", "base", 120)};
+        ImageCleanupPolicy policy;
+        ImageRemovalPlan plan;
+        planImageCleanup(images, policy, 0, plan);
+        CHECK(plan.waves.size() == 3);
+        CHECK(plan.waves[0] == std::vector<std::string>({"leaf", "other"}));
+        CHECK(plan.waves[1] == std::vector<std::string>({"mid"}));
+        CHECK(plan.waves[2] == std::vector<std::string>({"base"}));
+        CHECK(plan.blocked.empty() == true);
+        CHECK(plan.bytes["leaf"] == 30);
+        CHECK(plan.bytes["base"] == 100);
+        CHECK(plan.totalBytes == 180 + 20);
+    }
+
+    TEST_CASE("Check image cleanup plan keeps parents of images in use") {
+        ImageList images = {makeImage("leaf", "mid", 180), makeImage("mid", "base", 150),
+                            makeImage("base", "", 100), makeImage("other", "base", 120, 1)};
+        ImageCleanupPolicy policy;
+        ImageRemovalPlan plan;
+        planImageCleanup(images, policy, 0, plan);
+        CHECK(plan.waves.size() == 2);
+        CHECK(plan.waves[0] == std::vector<std::string>({"leaf"}));
+        CHECK(plan.waves[1] == std::vector<std::string>({"mid"}));
+        CHECK(plan.blocked == std::vector<std::string>({"base"}));
+        CHECK(plan.totalBytes == 80);
+    }
+
+    TEST_CASE("Check image cleanup plan applies age and size policy") {
+        ImageList images = {makeImage("old", "", 500, 0, 1000), makeImage("new", "", 500, 0, 9000),
+                            makeImage("small", "", 10, 0, 1000)};
+        ImageCleanupPolicy policy;
+        policy.minAge = 3600;
+        policy.minSize = 100;
+        ImageRemovalPlan plan;
+        planImageCleanup(images, policy, 10000, plan);
+        CHECK(plan.waves.size() == 1);
+        CHECK(plan.waves[0] == std::vector<std::string>({"old"}));
+        CHECK(plan.totalBytes == 500);
+    }
+
+    TEST_CASE("Check image cleanup plan keeps images whose usage is unknown") {
+        // imageList reports -1 containers per image: the count was not computed
+        ImageList images = {makeImage("leaf", "base", 150, -1), makeImage("base", "", 100, -1), makeImage("other", "", 50, -1)};
+        ImageCleanupPolicy policy;
+        ImageRemovalPlan plan;
+        planImageCleanup(images, policy, 0, plan);
+        CHECK(plan.waves.empty() == true);
+
+        std::set<std::string> inUse = {"leaf"};
+        plan = ImageRemovalPlan();
+        planImageCleanup(images, policy, 0, inUse, plan);
+        CHECK(plan.waves.size() == 1);
+        CHECK(plan.waves[0] == std::vector<std::string>({"other"}));
+        CHECK(plan.blocked == std::vector<std::string>({"base"}));
+
+        policy.keepInUse = false;
+        plan = ImageRemovalPlan();
+        planImageCleanup(images, policy, 0, inUse, plan);
+        CHECK(plan.waves.size() == 2);
+    }
+
+    TEST_CASE("Check imageCleanup keeps the images of stopped containers") {
+        MockDaemon daemon;
+        MockDaemon::Response images, containers, removed;
+        std::mutex mutex;
+        std::string listQuery;
+        std::vector<std::string> removals;
+        images.body = "[{\"Id\":\"sha256:aaa\",\"ParentId\":\"\",\"RepoTags\":[\"app:1\"],\"Size\":100,\"Containers\":-1},"
+                      "{\"Id\":\"sha256:bbb\",\"ParentId\":\"\",\"RepoTags\":[\"app:2\"],\"Size\":100,\"Containers\":-1}]";
+        containers.body = "[{\"Id\":\"c1\",\"Names\":[\"/old\"],\"Image\":\"app:1\",\"ImageID\":\"sha256:aaa\",\"State\":\"exited\"}]";
+        removed.body = "[{\"Deleted\":\"sha256:bbb\"}]";
+        daemon.route("GET", "/images/json", images);
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &req) {
+            std::lock_guard<std::mutex> lock(mutex);
+            listQuery = req.query;
+            return containers;
+        });
+        daemon.route("DELETE", "/images/*", [&](const MockDaemon::Request &req) {
+            std::lock_guard<std::mutex> lock(mutex);
+            removals.push_back(req.path);
+            return removed;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        ImageCleanupPolicy policy;
+        ImageCleanupResult r;
+        CHECK(docker.imageCleanup(policy, r).isOk() == true);
+        REQUIRE(r.deleted.size() == 1);
+        CHECK(r.deleted[0].deleted == "sha256:bbb");
+        CHECK(r.spaceReclaimed == 100);
+        CHECK(removals == std::vector<std::string>({"/images/sha256:bbb"}));
+        CHECK(listQuery.find("all=true") != std::string::npos);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check imageCleanup handles Errors") {
+        Docker<MockErrorHttp> d("500");
+        ImageCleanupPolicy policy;
+        ImageCleanupResult r;
+        DockerError e = d.imageCleanup(policy, r);
+        CHECK(e.isError() == true);
+        CHECK(r.deleted.empty() == true);
+        CHECK(r.spaceReclaimed == 0);
+    }
+
+    TEST_CASE("Check imageExport streams the archive to a file") {
+        std::string archive = random_bytes(300 * 1024 + 5);
+        MockDaemon daemon;
+        std::string exported, query;
+        daemon.route("GET", "/images/*/get", [&](const MockDaemon::Request &r) {
+            exported = r.path;
+            MockDaemon::Response res;
+            res.contentType = "application/x-tar";
+            res.chunked = true;
+            res.chunkSize = 32 * 1024;
+            res.body = archive;
+            return res;
+        });
+        daemon.route("GET", "/images/get", [&](const MockDaemon::Request &r) {
+            query = r.query;
+            MockDaemon::Response res;
+            res.contentType = "application/x-tar";
+            res.body = archive;
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        std::FILE *file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        CHECK(docker.imageExport("app", fileno(file)).isOk() == true);
+        CHECK(exported == "/images/app/get");
+        CHECK(read_fd(fileno(file)) == archive);
+
+        std::FILE *several = std::tmpfile();
+        REQUIRE(several != nullptr);
+        CHECK(docker.imageExport(std::vector<std::string>{"app:1", "base"}, fileno(several)).isOk() == true);
+        CHECK(query == "names=app%3A1&names=base");
+        CHECK(read_fd(fileno(several)) == archive);
+
+        std::size_t received = 0;
+        DockerError stopped = docker.imageExport(std::vector<std::string>{"app"}, [&](const char *, std::size_t size) {
+            received += size;
+            return received < 1000;
+        });
+        CHECK(stopped.isCancelled() == true);
+        std::fclose(file);
+        std::fclose(several);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check imageExport of a missing image writes nothing") {
+        MockDaemon daemon;
+        MockDaemon::Response missing;
+        missing.code = 404;
+        missing.body = "{\"message\":\"reference does not exist\"}";
+        daemon.route("GET", "/images/*/get", missing);
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        std::FILE *file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        DockerError err = docker.imageExport("missing", fileno(file));
+        CHECK(err.isNotFound() == true);
+        CHECK(read_fd(fileno(file)).empty() == true);
+        std::fclose(file);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check imageLoad sends files and pipes") {
+        std::string archive = random_bytes(1024 * 1024 + 3);
+        MockDaemon daemon;
+        std::string received, query;
+        daemon.route("POST", "/images/load", [&](const MockDaemon::Request &r) {
+            received = r.body;
+            query = r.query;
+            MockDaemon::Response res;
+            res.body = "{\"stream\":\"Loaded image: app:1\\n\"}\r\n{\"stream\":\"Loaded image ID: sha256:abc\\n\"}\r\n";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        // A regular file goes with sendfile() from its current position
+        std::FILE *file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        REQUIRE(::write(fileno(file), "skip", 4) == 4);
+        REQUIRE(::write(fileno(file), archive.data(), archive.size()) == static_cast<ssize_t>(archive.size()));
+        ::lseek(fileno(file), 4, SEEK_SET);
+        std::vector<std::string> loaded;
+        CHECK(docker.imageLoad(fileno(file), loaded).isOk() == true);
+        CHECK(received == archive);
+        CHECK(query == "quiet=true");
+        CHECK((loaded == std::vector<std::string>{"app:1", "sha256:abc"}));
+        CHECK(::lseek(fileno(file), 0, SEEK_CUR) == static_cast<off_t>(archive.size() + 4));
+        std::fclose(file);
+
+        // A pipe is streamed in chunks
+        int fds[2];
+        REQUIRE(::pipe(fds) == 0);
+        std::string small = archive.substr(0, 20000);
+        REQUIRE(::write(fds[1], small.data(), small.size()) == static_cast<ssize_t>(small.size()));
+        ::close(fds[1]);
+        loaded.clear();
+        CHECK(docker.imageLoad(fds[0], loaded).isOk() == true);
+        CHECK(received == small);
+        CHECK(loaded.size() == 2);
+        ::close(fds[0]);
+        daemon.stop();
     }
-}
\ No newline at end of file
+}
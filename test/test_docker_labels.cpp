@@ -0,0 +1,137 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+
+#include <random>
+
+using namespace docker_cpp;
+
+static ContainerInfo labelled(const std::string &id, const label_list &labels)
+{
+    ContainerInfo c;
+    c.id = id;
+    c.labels = labels;
+    return c;
+}
+
+static ContainerList sample_containers()
+{
+    ContainerList list;
+    list.push_back(labelled("web1", {{"app", "web"}, {"tier", "front"}, {"env", "prod"}}));
+    list.push_back(labelled("web2", {{"app", "web"}, {"tier", "front"}, {"env", "staging"}}));
+    list.push_back(labelled("api", {{"app", "api"}, {"tier", "api"}, {"env", "prod"}, {"deprecated", ""}}));
+    list.push_back(labelled("db", {{"app", "db"}, {"env", "prod"}}));
+    list.push_back(labelled("plain", {}));
+    return list;
+}
+
+static std::vector<std::string> ids(const std::vector<const ContainerInfo *> &containers)
+{
+    std::vector<std::string> out;
+    for (const ContainerInfo *c : containers) out.push_back(c->id);
+    return out;
+}
+
+TEST_SUITE("LABELS") {
+    TEST_CASE("Check selectors are parsed") {
+        LabelSelector s;
+        REQUIRE(LabelSelector::parse("app=web, tier in (front, api),!deprecated,env!=prod,debug,version==2,x notin (a)", s) == true);
+        REQUIRE(s.requirements().size() == 7);
+        CHECK(s.requirements()[0].op == LabelRequirement::EQUALS);
+        CHECK(s.requirements()[1].op == LabelRequirement::IN);
+        CHECK(s.requirements()[1].values.size() == 2);
+        CHECK(s.requirements()[2].op == LabelRequirement::NOT_EXISTS);
+        CHECK(s.requirements()[3].op == LabelRequirement::NOT_EQUALS);
+        CHECK(s.requirements()[4].op == LabelRequirement::EXISTS);
+        CHECK(s.requirements()[5].values[0] == "2");
+        CHECK(s.requirements()[6].op == LabelRequirement::NOT_IN);
+        CHECK(s.str() == "app=web,tier in (front,api),!deprecated,env!=prod,debug,version=2,x notin (a)");
+
+        CHECK(LabelSelector::parse("", s) == true);
+        CHECK(s.empty() == true);
+        CHECK(LabelSelector::parse("com.example.role=worker", s) == true);
+        CHECK(s.requirements()[0].key == "com.example.role");
+
+        CHECK(LabelSelector::parse("app=web,", s) == false);
+        CHECK(LabelSelector::parse("tier in front", s) == false);
+        CHECK(LabelSelector::parse("tier in ()", s) == false);
+        CHECK(LabelSelector::parse("tier among (a)", s) == false);
+        CHECK(LabelSelector::parse("!app=web", s) == false);
+        CHECK(LabelSelector::parse("=web", s) == false);
+    }
+
+    TEST_CASE("Check the index answers selectors") {
+        ContainerList containers = sample_containers();
+        LabelIndex index(containers);
+        CHECK(index.size() == 5);
+
+        auto query = [&](const std::string &text) {
+            LabelSelector s;
+            REQUIRE(LabelSelector::parse(text, s) == true);
+            return ids(index.select(containers, s));
+        };
+        CHECK((query("app=web") == std::vector<std::string>{"web1", "web2"}));
+        CHECK((query("app=web,env=prod") == std::vector<std::string>{"web1"}));
+        CHECK((query("tier") == std::vector<std::string>{"web1", "web2", "api"}));
+        CHECK((query("!tier") == std::vector<std::string>{"db", "plain"}));
+        CHECK((query("env!=prod") == std::vector<std::string>{"web2", "plain"}));
+        CHECK((query("app in (api, db, cache)") == std::vector<std::string>{"api", "db"}));
+        CHECK((query("env=prod,app notin (web, db)") == std::vector<std::string>{"api"}));
+        CHECK((query("deprecated") == std::vector<std::string>{"api"}));
+        CHECK(query("app=cache").empty() == true);
+        CHECK(query("missing").empty() == true);
+        CHECK(query("").size() == 5);
+
+        CHECK(index.count(LabelSelector().equals("env", "prod").notExists("deprecated")) == 2);
+        auto envs = index.values("env");
+        REQUIRE(envs.size() == 2);
+        CHECK(envs[0].first == "prod");
+        CHECK(envs[0].second == 3);
+        CHECK(index.values("missing").empty() == true);
+    }
+
+    TEST_CASE("Check the index indexes image labels") {
+        ImageList images(3);
+        images[0].labels = {{"maintainer", "a"}};
+        images[1].labels = {{"maintainer", "b"}, {"stable", "1"}};
+        LabelIndex index(images);
+        LabelIndex::positions p;
+        index.select(LabelSelector().exists("maintainer").notEquals("maintainer", "a"), p);
+        CHECK(p == LabelIndex::positions{1});
+    }
+
+    TEST_CASE("Check the index agrees with direct evaluation") {
+        std::mt19937 random(42);
+        const char *keys[] = {"app", "tier", "env", "team", "zone"};
+        const char *values[] = {"a", "b", "c", "d"};
+        ContainerList containers(2000);
+        for (ContainerInfo &c : containers) {
+            for (const char *k : keys) {
+                if (random() % 3) c.labels.push_back(std::make_pair(k, values[random() % 4]));
+            }
+        }
+        LabelIndex index(containers);
+
+        for (int q = 0; q < 200; ++q) {
+            LabelSelector s;
+            int terms = 1 + static_cast<int>(random() % 3);
+            for (int t = 0; t < terms; ++t) {
+                std::string key = keys[random() % 5];
+                std::string value = values[random() % 4];
+                switch (random() % 6) {
+                    case 0: s.exists(key); break;
+                    case 1: s.notExists(key); break;
+                    case 2: s.equals(key, value); break;
+                    case 3: s.notEquals(key, value); break;
+                    case 4: s.in(key, {value, values[random() % 4]}); break;
+                    default: s.notIn(key, {value, values[random() % 4]});
+                }
+            }
+            LabelIndex::positions expected, actual;
+            for (std::size_t i = 0; i < containers.size(); ++i) {
+                if (s.matches(containers[i].labels)) expected.push_back(static_cast<std::uint32_t>(i));
+            }
+            index.select(s, actual);
+            CHECK(actual == expected);
+        }
+    }
+}
@@ -0,0 +1,300 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+
+using namespace docker_cpp;
+
+static const std::int64_t second = 1000000000;
+
+// One frame of a multiplexed stream
+static std::string frame(int stream, const std::string &payload)
+{
+    std::string out(8, '\0');
+    out[0] = static_cast<char>(stream);
+    for (int i = 0; i < 4; ++i) out[4 + i] = static_cast<char>((payload.size() >> (24 - 8 * i)) & 0xff);
+    return out + payload;
+}
+
+// RFC 3339 timestamp with nanoseconds, as the daemon writes them
+static std::string stamp(std::int64_t ns)
+{
+    std::time_t seconds = static_cast<std::time_t>(ns / second);
+    char text[64];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", std::gmtime(&seconds));
+    char fraction[16];
+    std::snprintf(fraction, sizeof(fraction), ".%09lldZ", static_cast<long long>(ns % second));
+    return std::string(text) + fraction;
+}
+
+static std::vector<std::string> texts(const std::vector<LogBatch> &batches)
+{
+    std::vector<std::string> out;
+    for (const LogBatch &b : batches) {
+        for (const LogEntry &e : b.entries) out.push_back(b.text(e));
+    }
+    return out;
+}
+
+TEST_SUITE("LOGS") {
+    TEST_CASE("Check line ends are found at any position of the input") {
+        std::mt19937 random(3);
+        std::string stream;
+        std::vector<std::string> expected;
+        for (int i = 0; i < 2000; ++i) {
+            std::string line(random() % 40, 'x');
+            for (char &c : line) c = static_cast<char>('a' + random() % 26);
+            if (!line.empty()) expected.push_back(line);
+            stream += line + (random() % 4 == 0 ? "\r\n" : "\n");
+        }
+        for (std::size_t step : {1, 7, 16, 17, 100, 4096}) {
+            std::vector<std::string> lines;
+            LineSplitter splitter([&](const char *line, std::size_t size) { lines.push_back(std::string(line, size)); return true; });
+            for (std::size_t pos = 0; pos < stream.size(); pos += step)
+                REQUIRE(splitter.feed(stream.data() + pos, std::min(step, stream.size() - pos)) == true);
+            CHECK(splitter.finish() == true);
+            CHECK(lines == expected);
+        }
+    }
+
+    TEST_CASE("Check log timestamps are parsed") {
+        std::int64_t ns = 0;
+        const std::string plain = "2020-01-01T00:00:00Z";
+        CHECK(parse_timestamp(plain.data(), plain.size(), ns) == true);
+        CHECK(ns == 1577836800LL * second);
+        const std::string nanos = "2020-01-01T00:00:00.123456789Z";
+        CHECK(parse_timestamp(nanos.data(), nanos.size(), ns) == true);
+        CHECK(ns == 1577836800LL * second + 123456789);
+        const std::string shortFraction = "2021-03-04T05:06:07.5+01:00";
+        CHECK(parse_timestamp(shortFraction.data(), shortFraction.size(), ns) == true);
+        CHECK(ns == (1614834367LL - 3600) * second + 500000000);
+        CHECK(stamp(1577836800LL * second + 42) == "2020-01-01T00:00:00.000000042Z");
+
+        for (const std::string bad : {"", "hello world", "2020-01-01 00:00:00Z", "2020-13-01T00:00:00Z", "2020-01-01T00:00:00.Z", "2020-01-01T00:00:00"})
+            CHECK(parse_timestamp(bad.data(), bad.size(), ns) == false);
+
+        LogCursor cursor;
+        cursor.timestamp = 1577836800LL * second + 5;
+        CHECK(cursor.since() == "1577836800.000000005");
+    }
+
+    TEST_CASE("Check the parser batches lines and resumes after its cursor") {
+        const std::int64_t t0 = 1600000000LL * second;
+        std::string stream = frame(1, stamp(t0) + " one\n") + frame(2, stamp(t0 + 1) + " two\n") +
+                             frame(1, stamp(t0 + 1) + " thr") + frame(1, "ee\n") + frame(1, stamp(t0 + 2) + " four\n");
+
+        std::vector<LogBatch> batches;
+        LogCursor cursor;
+        LogParser parser("web", cursor, [&](LogBatch &b) { batches.push_back(std::move(b)); return true; }, 2);
+        CHECK(parser.feed(stream.data(), stream.size()) == true);
+        CHECK(parser.finish() == true);
+        CHECK((texts(batches) == std::vector<std::string>{"one", "two", "three", "four"}));
+        CHECK(parser.lines() == 4);
+        CHECK(cursor.timestamp == t0 + 2);
+        CHECK(cursor.count == 1);
+        REQUIRE(batches.size() == 2);
+        CHECK(batches[0].container == "web");
+        CHECK(batches[0].entries[1].stream == StreamDemuxer::STDERR);
+        CHECK(batches[0].entries[1].timestamp == t0 + 1);
+        CHECK(batches[0].cursor.timestamp == t0 + 1); // the cursor of a batch stops at its last line
+        CHECK(batches[0].cursor.count == 1);
+        CHECK(batches[1].cursor.timestamp == t0 + 2);
+
+        // Every feed() hands over the lines it completed
+        std::vector<LogBatch> bytewise;
+        LogCursor other;
+        LogParser slow("web", other, [&](LogBatch &b) { bytewise.push_back(std::move(b)); return true; });
+        for (char c : stream) REQUIRE(slow.feed(&c, 1) == true);
+        CHECK(bytewise.size() == 4);
+        CHECK(texts(bytewise) == texts(batches));
+        CHECK(bytewise[2].cursor.count == 2);
+
+        // Resuming after "two": the daemon sends "two" again (since is inclusive) and the parser drops it
+        LogCursor resumed = batches[0].cursor;
+        batches.clear();
+        LogParser again("web", resumed, [&](LogBatch &b) { batches.push_back(std::move(b)); return true; });
+        std::size_t first = frame(1, stamp(t0) + " one\n").size();
+        CHECK(again.feed(stream.data() + first, stream.size() - first) == true);
+        CHECK((texts(batches) == std::vector<std::string>{"three", "four"}));
+        CHECK(resumed.timestamp == t0 + 2);
+
+        // The raw output of a container with a TTY is not multiplexed
+        std::string raw = stamp(t0) + " tty line\r\n" + stamp(t0 + 1) + " last";
+        batches.clear();
+        LogCursor fresh;
+        LogParser tty("web", fresh, [&](LogBatch &b) { batches.push_back(std::move(b)); return true; });
+        CHECK(tty.feed(raw.data(), raw.size()) == true);
+        CHECK(tty.finish() == true);
+        CHECK((texts(batches) == std::vector<std::string>{"tty line", "last"}));
+
+        LogCursor stop;
+        LogParser stopping("web", stop, [](LogBatch &) { return false; });
+        CHECK(stopping.feed(stream.data(), stream.size()) == false);
+        CHECK(stop.empty() == true); // a refused batch does not move the cursor
+        CHECK(stopping.lines() == 0);
+
+        LogCursor partial;
+        std::size_t accepted = 0;
+        LogParser refusing("web", partial, [&](LogBatch &) { return accepted++ == 0; }, 2);
+        CHECK(refusing.feed(stream.data(), stream.size()) == false);
+        CHECK(refusing.lines() == 2);
+        CHECK(partial.timestamp == t0 + 1);
+        CHECK(partial.count == 1);
+    }
+
+    TEST_CASE("Check the queue holds producers back while it is full") {
+        LogQueue queue(100);
+        LogBatch batch;
+        batch.data.assign(200, 'x'); // larger than the queue, accepted while it is empty
+        CHECK(queue.push(std::move(batch)) == true);
+        CHECK(queue.bytes() == 200);
+
+        std::atomic<bool> pushed(false);
+        std::thread producer([&] {
+            LogBatch next;
+            next.data = "y";
+            pushed = queue.push(std::move(next));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(pushed == false);
+        std::vector<LogBatch> out;
+        CHECK(queue.pop(out, 1) == 1);
+        producer.join();
+        CHECK(pushed == true);
+        CHECK(queue.pop(out) == 1);
+        CHECK(out[1].data == "y");
+        CHECK(queue.pop(out, 64, std::chrono::milliseconds(10)) == 0);
+
+        // A blocked producer gives up when its calls are cancelled
+        LogBatch full;
+        full.data.assign(100, 'z');
+        CHECK(queue.push(std::move(full)) == true);
+        CancellationToken token = CancellationToken::create();
+        std::thread cancelled([&] {
+            CallScope scope(token);
+            LogBatch next;
+            next.data = "w";
+            pushed = queue.push(std::move(next));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        token.cancel();
+        queue.interrupt();
+        cancelled.join();
+        CHECK(pushed == false);
+
+        queue.close();
+        CHECK(queue.push(LogBatch()) == false);
+        CHECK(queue.pop(out) == 1); // queued batches are still delivered
+        CHECK(queue.pop(out) == 0);
+    }
+
+    TEST_CASE("Check the follower resumes from its cursor after disconnections") {
+        // 30 lines, three per timestamp; every connection serves at most 4 lines from `since`, then ends
+        const std::int64_t t0 = 1600000000LL * second;
+        std::vector<std::pair<std::int64_t, std::string> > log;
+        for (int i = 0; i < 30; ++i) log.push_back(std::make_pair(t0 + (i / 3) * 1000, "line " + std::to_string(i)));
+
+        MockDaemon daemon;
+        std::mutex mutex;
+        std::vector<std::string> queries;
+        daemon.route("GET", "/containers/web/logs", [&](const MockDaemon::Request &r) {
+            std::int64_t since = 0;
+            std::size_t p = r.query.find("since=");
+            if (p != std::string::npos) {
+                std::string value = r.query.substr(p + 6, r.query.find('&', p) - p - 6);
+                std::size_t dot = value.find('.');
+                since = std::atoll(value.substr(0, dot).c_str()) * second + std::atoll(value.substr(dot + 1).c_str());
+            }
+            MockDaemon::Response res;
+            res.contentType = "application/vnd.docker.raw-stream";
+            res.chunked = true;
+            res.chunkSize = 13;
+            int sent = 0;
+            for (const auto &line : log) {
+                if (line.first < since || sent == 4) continue;
+                res.body += frame(1 + sent % 2, stamp(line.first) + " " + line.second + "\n");
+                ++sent;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            queries.push_back(r.query);
+            return res;
+        });
+        MockDaemon::Response missing;
+        missing.code = 404;
+        missing.body = "{\"message\":\"No such container: gone\"}";
+        daemon.route("GET", "/containers/gone/logs", missing);
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        LogQueue queue(256);
+        LogFollowOptions options;
+        options.retryDelay = std::chrono::milliseconds(1);
+        options.maxRetryDelay = std::chrono::milliseconds(20);
+        LogFollower<SocketHttp> follower(docker, queue, options);
+        CHECK(follower.follow("web") == true);
+        CHECK(follower.follow("web") == false);
+        CHECK(follower.follow("gone") == true);
+
+        std::vector<LogBatch> batches;
+        eventually([&] {
+            queue.pop(batches, 64, std::chrono::milliseconds(50));
+            return texts(batches).size() >= log.size();
+        }, std::chrono::seconds(10));
+        std::vector<std::string> expected;
+        for (const auto &line : log) expected.push_back(line.second);
+        CHECK(texts(batches) == expected);
+        eventually([&] { return follower.cursor("web").count >= 3; }); // set once the push returns
+        CHECK(follower.cursor("web").timestamp == log.back().first);
+        CHECK(follower.cursor("web").count == 3);
+        CHECK(follower.following("web") == true);
+        CHECK(follower.following("gone") == false);
+        CHECK(follower.error("gone").isNotFound() == true);
+
+        follower.stop("web");
+        CHECK(follower.following("web") == false);
+        CHECK(follower.cursor("web").timestamp == log.back().first);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(queries.size() > 8);
+            CHECK(queries[0].find("since") == std::string::npos);
+            CHECK(queries[0].find("follow=true") != std::string::npos);
+            CHECK(queries[0].find("timestamps=true") != std::string::npos);
+            CHECK(queries[1].find("since=1600000000.000001000") != std::string::npos);
+            CHECK(queries[1].find("tail=all") != std::string::npos);
+        }
+        CHECK(queue.pop(batches, 64, std::chrono::milliseconds(10)) == 0); // nothing delivered twice
+        daemon.stop();
+    }
+
+    TEST_CASE("Check the follower stops once the queue is closed") {
+        const std::int64_t t0 = 1600000000LL * second;
+        MockDaemon daemon;
+        std::atomic<int> requests(0);
+        daemon.route("GET", "/containers/web/logs", [&](const MockDaemon::Request &) {
+            ++requests;
+            MockDaemon::Response res;
+            res.contentType = "application/vnd.docker.raw-stream";
+            res.body = frame(1, stamp(t0) + " line\n");
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        LogQueue queue(1024);
+        LogFollowOptions options;
+        options.retryDelay = std::chrono::milliseconds(1);
+        options.maxRetryDelay = std::chrono::milliseconds(1);
+        LogFollower<SocketHttp> follower(docker, queue, options);
+        queue.close();
+        CHECK(follower.follow("web") == true);
+        eventually([&] { return !follower.following("web"); });
+        CHECK(follower.following("web") == false);
+        CHECK(requests == 1);
+        CHECK(follower.cursor("web").empty() == true); // the refused line comes again on the next follow
+        daemon.stop();
+    }
+}
@@ -0,0 +1,120 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <thread>
+#include <vector>
+
+using namespace docker_cpp;
+
+TEST_SUITE("METRICS") {
+    TEST_CASE("Check histogram buckets and percentiles") {
+        for (std::uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull}) {
+            int b = LatencyHistogram::bucket(v);
+            CHECK(b < LatencyHistogram::BUCKETS);
+            CHECK(LatencyHistogram::bucketLow(b) <= v);
+            if (b + 1 < LatencyHistogram::BUCKETS) CHECK(LatencyHistogram::bucketLow(b + 1) > v);
+        }
+
+        LatencyHistogram h;
+        CHECK(h.percentile(0.5) == 0);
+        for (std::uint64_t v = 1; v <= 1000; ++v) h.record(v * 1000);
+        CHECK(h.count() == 1000);
+        CHECK(h.max() == 1000000);
+        CHECK(h.mean() == doctest::Approx(500500.0));
+        // log-linear buckets: within 12.5%
+        CHECK(h.percentile(0.5) == doctest::Approx(500000.0).epsilon(0.125));
+        CHECK(h.percentile(0.99) == doctest::Approx(990000.0).epsilon(0.125));
+        CHECK(h.percentile(1.0) <= h.max());
+        h.reset();
+        CHECK(h.count() == 0);
+    }
+
+    TEST_CASE("Check histograms can be recorded from several threads") {
+        LatencyHistogram h;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t)
+            workers.emplace_back([&h]() { for (int i = 0; i < 10000; ++i) h.record(static_cast<std::uint64_t>(i)); });
+        for (auto &w : workers) w.join();
+        CHECK(h.count() == 40000);
+        CHECK(h.max() == 9999);
+    }
+
+    TEST_CASE("Check nothing is recorded without metrics") {
+        Docker<MockResponseHttp> docker("container_list");
+        CHECK(docker.metrics() == nullptr);
+        ContainerList result;
+        CHECK(docker.containerList(result).isOk());
+        CHECK(current_request_timings() == nullptr);
+    }
+
+    TEST_CASE("Check operations are recorded per endpoint") {
+        DockerMetrics metrics;
+        Docker<MockResponseHttp> docker("container_list");
+        docker.setMetrics(&metrics);
+
+        ContainerList result;
+        for (int i = 0; i < 3; ++i) CHECK(docker.containerList(result).isOk());
+
+        const OperationMetrics &m = metrics.operation(OP_CONTAINER_LIST);
+        CHECK(m.total.count() == 3);
+        CHECK(m.firstByte.count() == 3);
+        CHECK(m.parse.count() == 3);
+        CHECK(m.connect.count() == 0);
+        CHECK(m.status[2] == 3);
+        CHECK(m.bytes > 0);
+        CHECK(metrics.operation(OP_IMAGE_LIST).total.count() == 0);
+        CHECK(current_request_timings() == nullptr);
+
+        std::string json = metrics.toJson();
+        CHECK(json.find("\"containerList\":{\"count\":3") != std::string::npos);
+        CHECK(json.find("\"2xx\":3") != std::string::npos);
+        CHECK(json.find("imageList") == std::string::npos);
+
+        metrics.reset();
+        CHECK(metrics.toJson() == "{}");
+    }
+
+    TEST_CASE("Check failed operations are recorded by status class") {
+        DockerMetrics metrics;
+        Docker<MockErrorHttp> docker("404");
+        docker.setMetrics(&metrics);
+        CHECK(docker.containerStart("abc").isError());
+        CHECK(metrics.operation(OP_CONTAINER_START).status[4] == 1);
+        CHECK(metrics.operation(OP_CONTAINER_START).parse.count() == 0);
+    }
+
+    TEST_CASE("Check nested operations are recorded separately") {
+        DockerMetrics metrics;
+        Docker<MockResponseHttp> docker("exec_run");
+        docker.setMetrics(&metrics);
+        ExecRunResult result;
+        CHECK(docker.execRun("abc", ExecConfig(), result).isOk());
+        CHECK(metrics.operation(OP_EXEC_CREATE).total.count() == 1);
+        CHECK(metrics.operation(OP_EXEC_START).total.count() == 1);
+        CHECK(metrics.operation(OP_EXEC_INSPECT).total.count() == 1);
+    }
+
+    TEST_CASE("Check SocketHttp reports connection, first byte and transfer times") {
+        MockDaemon daemon;
+        daemon.routeFixture("GET", "/containers/json", "container_list_get.json");
+        REQUIRE(daemon.start() == true);
+
+        DockerMetrics metrics;
+        Docker<SocketHttp> docker(daemon.url());
+        docker.setMetrics(&metrics);
+        ContainerList result;
+        for (int i = 0; i < 5; ++i) CHECK(docker.containerList(result, true).isOk());
+
+        const OperationMetrics &m = metrics.operation(OP_CONTAINER_LIST);
+        CHECK(m.total.count() == 5);
+        CHECK(m.connect.count() == 1); // the connection is kept alive
+        CHECK(m.firstByte.count() == 5);
+        CHECK(m.transfer.count() == 5);
+        CHECK(m.bytes == 5 * read_fixture("container_list_get.json").size());
+        CHECK(m.status[2] == 5);
+        CHECK(m.total.max() >= m.firstByte.max());
+        MESSAGE(metrics.toJson());
+        daemon.stop();
+    }
+}
@@ -0,0 +1,107 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+using namespace docker_cpp;
+
+TEST_SUITE("REPLAY") {
+    TEST_CASE("Check exchanges are recorded with their timings") {
+        Docker<RecordingHttp<MockResponseHttp> > docker("container_list");
+        ContainerList result;
+        CHECK(docker.containerList(result).isOk() == true);
+        CHECK(docker.containerStart("abc").isOk() == true);
+
+        std::vector<RecordedExchange> log = docker.transport().log().exchanges();
+        REQUIRE(log.size() == 2);
+        CHECK(log[0].method == "GET");
+        CHECK(log[0].path.find("/containers/json") != std::string::npos);
+        CHECK(log[0].code == 200);
+        CHECK(log[0].response == read_fixture("container_list_get.json"));
+        CHECK(log[1].method == "POST");
+        CHECK(log[1].offsetNs >= log[0].offsetNs + log[0].durationNs);
+    }
+
+    TEST_CASE("Check a saved log is replayed") {
+        std::string path = "/tmp/docker_cpp_replay_" + std::to_string(::getpid()) + ".dlog";
+        {
+            Docker<RecordingHttp<MockResponseHttp> > docker("exec_run");
+            ExecRunResult run;
+            CHECK(docker.execRun("abc", ExecConfig(), run).isOk() == true);
+            CHECK(docker.transport().log().save(path) == true);
+        }
+
+        Docker<ReplayHttp> docker("exec_run");
+        REQUIRE(docker.transport().load(path) == true);
+        CHECK(docker.transport().remaining() == 3);
+        ExecRunResult run;
+        CHECK(docker.execRun("abc", ExecConfig(), run).isOk() == true);
+        CHECK(run.stdOut == "hello\nworld\n");
+        CHECK(run.stdErr == "oops\n");
+        CHECK(run.exitCode == 2);
+        CHECK(docker.transport().remaining() == 0);
+        CHECK(docker.transport().misses() == 0);
+
+        // a request that was not recorded
+        CHECK(docker.execRun("abc", ExecConfig(), run).isError() == true);
+        CHECK(docker.transport().misses() == 1);
+        std::remove(path.c_str());
+    }
+
+    TEST_CASE("Check errors are replayed") {
+        Docker<RecordingHttp<MockErrorHttp> > recorder("404");
+        CHECK(recorder.containerStop("abc").isError() == true);
+
+        Docker<ReplayHttp> docker("404");
+        docker.transport().load(recorder.transport().log());
+        DockerError e = docker.containerStop("abc");
+        CHECK(e.isError() == true);
+        CHECK(e.apiErrorCode == 404);
+    }
+
+    TEST_CASE("Check replay speed") {
+        Docker<RecordingHttp<MockSlowHttp> > recorder("slow");
+        for (int i = 0; i < 3; ++i) CHECK(recorder.containerStart("abc").isOk() == true);
+
+        Docker<ReplayHttp> docker("slow");
+        docker.transport().load(recorder.transport().log());
+        auto start = std::chrono::steady_clock::now();
+        CHECK(docker.containerStart("abc").isOk() == true);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(15));
+
+        docker.transport().setSpeed(1);
+        start = std::chrono::steady_clock::now();
+        CHECK(docker.containerStart("abc").isOk() == true);
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+        docker.transport().setSpeed(4);
+        start = std::chrono::steady_clock::now();
+        CHECK(docker.containerStart("abc").isOk() == true);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(15));
+    }
+
+    TEST_CASE("Check invalid logs are rejected") {
+        ExchangeLog log;
+        CHECK(log.load("/nonexistent/file.dlog") == false);
+
+        // A string length past the end of the file is rejected before anything is allocated
+        std::string path = "/tmp/docker_cpp_replay_bad_" + std::to_string(::getpid()) + ".dlog";
+        std::string data("DKRL\x01\x00\x00\x00", 8);
+        data += std::string(16, '\0');               // offset and duration
+        data += std::string("\xc8\x00\x00\x00", 4); // code 200
+        data += std::string("\xff\xff\xff\xff", 4); // method of 4 GiB
+        data += "GET";
+        {
+            std::ofstream out(path.c_str(), std::ios::binary);
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        CHECK(log.load(path) == false);
+        CHECK(log.size() == 0);
+        std::remove(path.c_str());
+        CHECK(ExchangeLog::relativePath("http://127.0.0.1:2375/v1.40/_ping?x=1") == "/v1.40/_ping?x=1");
+        CHECK(ExchangeLog::relativePath("unix:///var/run/docker.sock/v1.40/_ping") == "/v1.40/_ping");
+    }
+}
@@ -0,0 +1,229 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+using namespace docker_cpp;
+
+TEST_SUITE("SCHEDULER") {
+    TEST_CASE("Check requests are classified by endpoint") {
+        const std::string base = "http://127.0.0.1:2375/v1.40";
+        CHECK(request_priority("GET", base + "/_ping") == PRIORITY_HEALTH);
+        CHECK(request_priority("GET", "unix:///var/run/docker.sock/version") == PRIORITY_HEALTH);
+        CHECK(request_priority("GET", base + "/containers/json?all=1") == PRIORITY_CONTROL);
+        CHECK(request_priority("POST", base + "/containers/web/start") == PRIORITY_CONTROL);
+        CHECK(request_priority("HEAD", base + "/containers/web/archive?path=%2Fetc") == PRIORITY_CONTROL);
+        CHECK(request_priority("GET", base + "/containers/web/archive?path=%2Fetc") == PRIORITY_BULK);
+        CHECK(request_priority("POST", base + "/images/create?fromImage=alpine") == PRIORITY_BULK);
+        CHECK(request_priority("DELETE", base + "/images/registry.local/team/web:1") == PRIORITY_BULK);
+        CHECK(request_priority("GET", base + "/images/registry.local/team/web:1/get") == PRIORITY_BULK);
+        CHECK(request_priority("GET", base + "/images/json") == PRIORITY_CONTROL);
+        CHECK(request_priority("POST", base + "/build?t=web") == PRIORITY_BULK);
+        CHECK(request_priority("POST", base + "/images/prune") == PRIORITY_BULK);
+
+        CHECK(request_long_lived("POST", base + "/containers/web/wait") == true);
+        CHECK(request_long_lived("POST", base + "/exec/3f2c/start") == true);
+        CHECK(request_long_lived("GET", base + "/exec/3f2c/json") == false);
+        CHECK(request_long_lived("GET", base + "/containers/web/logs?follow=true&stdout=1") == true);
+        CHECK(request_long_lived("GET", base + "/containers/web/logs?stdout=1") == false);
+        CHECK(request_long_lived("GET", base + "/containers/web/stats") == true);
+        CHECK(request_long_lived("GET", base + "/containers/web/stats?stream=false") == false);
+        CHECK(request_long_lived("GET", base + "/events") == true);
+        CHECK(request_long_lived("GET", base + "/containers/json") == false);
+
+        CHECK(PriorityScope::current() == PRIORITY_COUNT);
+        {
+            PriorityScope background(PRIORITY_BULK);
+            CHECK(PriorityScope::current() == PRIORITY_BULK);
+            {
+                PriorityScope urgent(PRIORITY_HEALTH);
+                CHECK(PriorityScope::current() == PRIORITY_HEALTH);
+            }
+            CHECK(PriorityScope::current() == PRIORITY_BULK);
+        }
+        CHECK(PriorityScope::current() == PRIORITY_COUNT);
+    }
+
+    TEST_CASE("Check waiting requests are admitted by priority and weight") {
+        SchedulerOptions options;
+        options.maxInFlight = 1;
+        options.controlWeight = 2;
+        RequestScheduler scheduler(options);
+        REQUIRE(scheduler.acquire(PRIORITY_BULK) == true); // holds the only slot
+
+        std::mutex mutex;
+        std::vector<std::string> order;
+        std::vector<std::thread> threads;
+        auto request = [&](RequestPriority priority, const std::string &name) {
+            std::size_t before = scheduler.queued(priority);
+            threads.emplace_back([&, priority, name] {
+                if (!scheduler.acquire(priority)) return;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    order.push_back(name);
+                }
+                scheduler.release(priority);
+            });
+            REQUIRE(eventually([&] { return scheduler.queued(priority) >= before + 1; }) == true);
+        };
+        for (int i = 0; i < 3; ++i) request(PRIORITY_BULK, "b" + std::to_string(i));
+        for (int i = 0; i < 3; ++i) request(PRIORITY_CONTROL, "c" + std::to_string(i));
+        request(PRIORITY_HEALTH, "h");
+        CHECK(scheduler.maxQueued(PRIORITY_BULK) == 3);
+
+        scheduler.release(PRIORITY_BULK);
+        for (std::thread &t : threads) t.join();
+        CHECK((order == std::vector<std::string>{"h", "c0", "c1", "b0", "c2", "b1", "b2"}));
+        CHECK(scheduler.admitted(PRIORITY_BULK) == 4);
+        CHECK(scheduler.waitTime(PRIORITY_CONTROL).count() == 3);
+        CHECK(scheduler.inFlight(PRIORITY_BULK) == 0);
+        CHECK(scheduler.queued(PRIORITY_CONTROL) == 0);
+    }
+
+    TEST_CASE("Check bulk requests leave slots to the others") {
+        SchedulerOptions options;
+        options.maxInFlight = 3;
+        options.maxBulk = 2;
+        RequestScheduler scheduler(options);
+        REQUIRE(scheduler.acquire(PRIORITY_BULK) == true);
+        REQUIRE(scheduler.acquire(PRIORITY_BULK) == true);
+        {
+            // A third one waits although a slot is free, until its deadline
+            CallScope scope(std::chrono::milliseconds(30));
+            CHECK(scheduler.acquire(PRIORITY_BULK) == false);
+        }
+        CHECK(scheduler.abandoned(PRIORITY_BULK) == 1);
+        CHECK(scheduler.queued(PRIORITY_BULK) == 0);
+        CHECK(scheduler.acquire(PRIORITY_CONTROL) == true);
+        CHECK(scheduler.inFlight(PRIORITY_CONTROL) == 1);
+
+        // A cancelled wait gives up too
+        CancellationToken token = CancellationToken::create();
+        std::atomic<int> result(-1);
+        std::thread waiting([&] {
+            CallScope scope(token);
+            result = scheduler.acquire(PRIORITY_HEALTH) ? 1 : 0;
+        });
+        REQUIRE(eventually([&] { return scheduler.queued(PRIORITY_HEALTH) >= 1; }) == true);
+        token.cancel();
+        waiting.join();
+        CHECK(result == 0);
+
+        scheduler.release(PRIORITY_CONTROL);
+        scheduler.release(PRIORITY_BULK);
+        scheduler.release(PRIORITY_BULK);
+        const std::string json = scheduler.toJson();
+        CHECK(json.find("\"bulk\":{\"queued\":0,\"max_queued\":1,\"in_flight\":0,\"admitted\":2,\"abandoned\":1") != std::string::npos);
+        CHECK(json.find("\"health\":{") != std::string::npos);
+    }
+
+    TEST_CASE("Check a burst of pulls does not delay health checks") {
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        MockDaemon::Response pull;
+        pull.body = "{\"status\":\"Pull complete\"}\r\n";
+        pull.latencyUs = 200000;
+        daemon.route("POST", "/images/create", pull);
+        REQUIRE(daemon.start() == true);
+
+        SchedulerOptions options;
+        options.maxInFlight = 4;
+        options.maxBulk = 2;
+        Docker<SchedulingHttp<SocketHttp> > docker(daemon.url());
+        docker.transport().setScheduler(std::make_shared<RequestScheduler>(options));
+        RequestScheduler &scheduler = docker.transport().scheduler();
+
+        std::vector<std::thread> pulls;
+        std::atomic<int> failed(0);
+        for (int i = 0; i < 6; ++i) {
+            pulls.emplace_back([&] {
+                if (docker.imageCreate("alpine", "", "", "", "").isError()) ++failed;
+            });
+        }
+        REQUIRE(eventually([&] { return scheduler.queued(PRIORITY_BULK) >= 4; }) == true);
+        CHECK(scheduler.inFlight(PRIORITY_BULK) == 2);
+
+        // The health check and the list pass the queued pulls while the first two are still running
+        CHECK(docker.ping().isOk() == true);
+        ContainerList containers;
+        docker.containerList(containers);
+        CHECK(scheduler.admitted(PRIORITY_HEALTH) == 1);
+        CHECK(scheduler.admitted(PRIORITY_CONTROL) == 1);
+        CHECK(scheduler.admitted(PRIORITY_BULK) == 2);
+        CHECK(scheduler.queued(PRIORITY_BULK) == 4);
+
+        for (std::thread &t : pulls) t.join();
+        CHECK(failed == 0);
+        CHECK(scheduler.admitted(PRIORITY_BULK) == 6);
+        CHECK(scheduler.maxQueued(PRIORITY_BULK) == 4);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check running execs do not hold scheduler slots") {
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        std::atomic<bool> started(false), finish(false);
+        const std::string output = read_fixture("exec_run_post.stream");
+        daemon.route("POST", "/exec/*/start", [&](const MockDaemon::Request &) {
+            // A command that runs until the test ends it
+            started = true;
+            eventually([&] { return finish.load(); });
+            MockDaemon::Response res;
+            res.body = output;
+            res.contentType = "application/vnd.docker.raw-stream";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        SchedulerOptions options;
+        options.maxInFlight = 1;
+        Docker<SchedulingHttp<SocketHttp> > docker(daemon.url());
+        docker.transport().setScheduler(std::make_shared<RequestScheduler>(options));
+        RequestScheduler &scheduler = docker.transport().scheduler();
+
+        ExecConfig config;
+        config.cmd.push_back("tail");
+        ExecRunResult result;
+        DockerError err = DockerError::D_OK();
+        std::thread exec([&] { err = docker.execRun("web", config, result); });
+        REQUIRE(eventually([&] { return started.load(); }) == true);
+        CHECK(scheduler.inFlight(PRIORITY_CONTROL) == 0);
+        CHECK(docker.ping().isOk() == true);
+        ContainerList containers;
+        CHECK(docker.containerList(containers).isOk() == true);
+
+        finish = true;
+        exec.join();
+        CHECK(err.isOk() == true);
+        CHECK(result.stdOut.empty() == false);
+        CHECK(scheduler.admitted(PRIORITY_CONTROL) == 3); // exec create, list and exec inspect
+        daemon.stop();
+    }
+
+    TEST_CASE("Check hedged requests keep the priority of their call") {
+        MockDaemon daemon;
+        std::atomic<int> calls(0);
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &) {
+            MockDaemon::Response res;
+            res.body = "[]";
+            res.latencyUs = ++calls == 1 ? 300000 : 0;
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SchedulingHttp<SocketHttp> > docker(daemon.url());
+        RetryPolicy policy;
+        policy.hedgeAfter = std::chrono::milliseconds(20);
+        docker.setRetryPolicy(policy);
+        RequestScheduler &scheduler = docker.transport().scheduler();
+
+        ContainerList containers;
+        {
+            PriorityScope background(PRIORITY_BULK);
+            CHECK(docker.containerList(containers).isOk() == true);
+        }
+        CHECK(calls == 2);
+        CHECK(scheduler.admitted(PRIORITY_BULK) == 2);
+        CHECK(scheduler.admitted(PRIORITY_CONTROL) == 0);
+        daemon.stop();
+    }
+}
@@ -0,0 +1,196 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace docker_cpp;
+
+// A file name under /tmp, removed at the end of the test
+struct TempPath
+{
+    std::string path;
+
+    TempPath()
+    {
+        char name[] = "/tmp/docker_cpp_snapshot_XXXXXX";
+        int fd = ::mkstemp(name);
+        if (fd >= 0) ::close(fd);
+        path = name;
+    }
+    ~TempPath() { std::remove(path.c_str()); }
+};
+
+static MetadataSnapshot sample_snapshot()
+{
+    MetadataSnapshot s;
+    s.takenAt = 1600000000123456789LL;
+    s.version.version = "19.03.12";
+    s.version.apiVersion = "1.40";
+    s.version.os = "linux";
+    s.version.experimental = true;
+    s.version.components.push_back(Component{"Engine", "19.03.12"});
+
+    ImageInfo image;
+    image.id = "sha256:" + std::string(64, 'a');
+    image.parentId = "sha256:" + std::string(64, 'b');
+    image.repoTags = {"web:1", "web:latest"};
+    image.created = 1500000000;
+    image.size = 123456789;
+    image.virtualSize = 123456789;
+    image.sharedSize = -1;
+    image.labels = {{"app", "web"}};
+    image.containers = 2;
+    s.images.push_back(image);
+
+    for (int i = 0; i < 3; ++i) {
+        ContainerInfo c;
+        c.id = std::string(63, 'c') + std::to_string(i);
+        c.names = {"/web" + std::to_string(i)};
+        c.image = "web:1";
+        c.imageID = image.id;
+        c.command = "nginx -g 'daemon off;'";
+        c.created = 1600000000 + i;
+        c.ports.push_back(Port{"0.0.0.0", 80, static_cast<unsigned int>(8080 + i), "tcp"});
+        c.sizeRw = 0;
+        c.sizeRootFs = 0;
+        c.labels = {{"app", "web"}, {"index", std::to_string(i)}};
+        c.state = "running";
+        c.status = "Up 2 hours";
+        c.hostConfig = std::make_pair("NetworkMode", "default");
+        s.containers.push_back(c);
+    }
+    return s;
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::ofstream(path.c_str(), std::ios::binary | std::ios::trunc) << data;
+}
+
+TEST_SUITE("SNAPSHOT") {
+    TEST_CASE("Check a snapshot is saved and loaded") {
+        TempPath file;
+        MetadataSnapshot saved = sample_snapshot();
+        REQUIRE(saved.save(file.path) == true);
+
+        MetadataSnapshot loaded;
+        REQUIRE(loaded.load(file.path) == true);
+        CHECK(loaded.takenAt == saved.takenAt);
+        CHECK(loaded.version.version == "19.03.12");
+        CHECK(loaded.version.os == "linux");
+        CHECK(loaded.version.experimental == true);
+        REQUIRE(loaded.version.components.size() == 1);
+        CHECK(loaded.version.components[0].name == "Engine");
+
+        REQUIRE(loaded.images.size() == 1);
+        const ImageInfo &image = loaded.images[0];
+        CHECK(image.id == saved.images[0].id);
+        CHECK(image.key == ImageId::fromHex(image.id)); // binary keys are rebuilt
+        CHECK(image.parentKey.empty() == false);
+        CHECK(image.repoTags == saved.images[0].repoTags);
+        CHECK(image.size == 123456789);
+        CHECK(image.sharedSize == -1);
+        CHECK(image.labels == saved.images[0].labels);
+        CHECK(image.containers == 2);
+
+        REQUIRE(loaded.containers.size() == 3);
+        const ContainerInfo &c = loaded.containers[2];
+        CHECK(c.id == saved.containers[2].id);
+        CHECK(c.key == ContainerId::fromHex(c.id));
+        CHECK(c.imageKey == image.key);
+        CHECK(c.names[0] == "/web2");
+        CHECK(c.command == "nginx -g 'daemon off;'");
+        CHECK(c.created == 1600000002);
+        REQUIRE(c.ports.size() == 1);
+        CHECK(c.ports[0].publicPort == 8082);
+        CHECK(c.ports[0].type == "tcp");
+        CHECK(c.labels == saved.containers[2].labels);
+        CHECK(c.status == "Up 2 hours");
+        CHECK(c.hostConfig.second == "default");
+
+        // An empty snapshot is valid too
+        MetadataSnapshot empty;
+        REQUIRE(empty.save(file.path) == true);
+        CHECK(loaded.load(file.path) == true);
+        CHECK(loaded.containers.empty() == true);
+        CHECK(loaded.takenAt == 0);
+    }
+
+    TEST_CASE("Check damaged snapshots are rejected") {
+        TempPath file;
+        REQUIRE(sample_snapshot().save(file.path) == true);
+        const std::string good = read_file(file.path);
+        MetadataSnapshot loaded;
+        REQUIRE(loaded.load(file.path) == true);
+
+        for (std::size_t pos : {std::size_t(0), std::size_t(5), std::size_t(40), good.size() / 2, good.size() - 1}) {
+            std::string bad = good;
+            bad[pos] = static_cast<char>(bad[pos] ^ 0x10);
+            write_file(file.path, bad);
+            CHECK(loaded.load(file.path) == false);
+        }
+        write_file(file.path, good.substr(0, good.size() - 3));
+        CHECK(loaded.load(file.path) == false);
+        write_file(file.path, good + "x");
+        CHECK(loaded.load(file.path) == false);
+        write_file(file.path, "");
+        CHECK(loaded.load(file.path) == false);
+        CHECK(loaded.load("/nonexistent/docker_cpp.snapshot") == false);
+        CHECK(loaded.containers.size() == 3); // a failed load leaves the contents as they were
+    }
+
+    TEST_CASE("Check the cache serves the snapshot until the daemon answers") {
+        TempPath file;
+        MetadataSnapshot old;
+        old.containers.resize(1);
+        old.containers[0].id = "old";
+        REQUIRE(old.save(file.path) == true);
+
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        daemon.setLatency(20000);
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        MetadataCache<SocketHttp> cache(docker, file.path);
+        CHECK(cache.current()->containers.empty() == true);
+        REQUIRE(cache.load() == true);
+        CHECK(cache.fresh() == false);
+        REQUIRE(cache.current()->containers.size() == 1);
+        CHECK(cache.current()->containers[0].id == "old");
+
+        std::shared_ptr<const MetadataSnapshot> held = cache.current();
+        cache.reconcile();
+        CHECK(cache.wait().isOk() == true);
+        CHECK(daemon.requests() == 3);
+        CHECK(cache.fresh() == true);
+        CHECK(cache.current()->takenAt > 0);
+        CHECK(cache.current()->containers.size() == 4);
+        CHECK(cache.current()->images.empty() == false);
+        CHECK(cache.current()->version.apiVersion.empty() == false);
+        CHECK(held->containers[0].id == "old"); // readers keep the data they got
+        CHECK(cache.load() == true);
+        CHECK(cache.current()->takenAt > 0); // a snapshot does not replace the daemon's data
+
+        MetadataSnapshot next;
+        REQUIRE(next.load(file.path) == true); // saved for the next run
+        CHECK(next.takenAt == cache.current()->takenAt);
+        CHECK(next.containers.size() == cache.current()->containers.size());
+        daemon.stop();
+
+        // Without a daemon the snapshot keeps being served
+        MetadataCache<SocketHttp> offline(docker, file.path);
+        REQUIRE(offline.load() == true);
+        CHECK(offline.refresh().isError() == true);
+        CHECK(offline.fresh() == false);
+        CHECK(offline.current()->takenAt == next.takenAt);
+    }
+}
@@ -1,5 +1,6 @@
 #include <doctest/doctest.h>
 #include "test_utils.h"
+#include "mock_daemon.h"
 
 using namespace docker_cpp;
 
@@ -55,4 +56,100 @@ TEST_SUITE("SYSTEM") {
         CHECK(e.isOk() == false);
         CHECK(e.isError() == true);
     }
+
+    TEST_CASE("Check API versions are parsed and negotiated") {
+        ApiVersion v;
+        CHECK(ApiVersion::parse("1.41", v) == true);
+        CHECK((v == ApiVersion(1, 41)));
+        CHECK(v.str() == "1.41");
+        for (const std::string bad : {"", "1", "1.", ".4", "1.4a", "v1.40", "1.40.1"})
+            CHECK(ApiVersion::parse(bad, v) == false);
+        CHECK((ApiVersion(1, 9) < ApiVersion(1, 10)));
+        CHECK((ApiVersion(2, 0) > ApiVersion(1, 43)));
+
+        VersionInfo daemon;
+        daemon.apiVersion = "1.27";
+        daemon.minApiVersion = "1.12";
+        CHECK(negotiate_api_version(daemon, v).isOk() == true);
+        CHECK((v == ApiVersion(1, 27))); // an older daemon: its version
+        daemon.apiVersion = "1.45";
+        daemon.minApiVersion = "1.24";
+        CHECK(negotiate_api_version(daemon, v).isOk() == true);
+        CHECK((v == DOCKER_API_MAX)); // a newer daemon: the newest one of the client
+        daemon.minApiVersion = "";
+        CHECK(negotiate_api_version(daemon, v).isOk() == true);
+
+        v = ApiVersion(1, 1);
+        daemon.apiVersion = "1.24";
+        CHECK(negotiate_api_version(daemon, v).isError() == true); // too old for the client
+        daemon.apiVersion = "2.1";
+        daemon.minApiVersion = "2.0";
+        CHECK(negotiate_api_version(daemon, v).isError() == true); // dropped the versions of the client
+        daemon.apiVersion = "latest";
+        CHECK(negotiate_api_version(daemon, v).isError() == true);
+        CHECK((v == ApiVersion(1, 1))); // left as it was
+    }
+
+    TEST_CASE("Check the negotiated API version is cached per endpoint") {
+        MockDaemon daemon;
+        std::vector<std::string> waits;
+        std::mutex mutex;
+        daemon.routeFixture("GET", "/version", "version_get.json"); // API 1.27
+        daemon.route("GET", "/_ping", MockDaemon::Response());
+        daemon.route("POST", "/containers/*/wait", [&](const MockDaemon::Request &r) {
+            std::lock_guard<std::mutex> lock(mutex);
+            waits.push_back(r.query);
+            MockDaemon::Response res;
+            res.body = "{\"StatusCode\":0}";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> first(daemon.url());
+        CHECK((first.apiVersion() == DOCKER_API_DEFAULT));
+        REQUIRE(first.negotiateApiVersion().isOk() == true);
+        CHECK(daemon.requests() == 1);
+        CHECK((first.apiVersion() == ApiVersion(1, 27)));
+        ApiVersion cached;
+        CHECK(ApiVersionCache::lookup(daemon.url(), cached) == true);
+        CHECK((cached == ApiVersion(1, 27)));
+
+        // Later clients of the same daemon start with its version, without asking again
+        Docker<SocketHttp> second(daemon.url());
+        CHECK((second.apiVersion() == ApiVersion(1, 27)));
+        CHECK(second.negotiateApiVersion().isOk() == true);
+        CHECK(daemon.requests() == 1);
+        CHECK(second.negotiateApiVersion(true).isOk() == true);
+        CHECK(daemon.requests() == 2);
+
+        // The (ip, port) constructor talks to the same daemon
+        Docker<SocketHttp> byAddress("127.0.0.1", static_cast<unsigned int>(daemon.port()));
+        CHECK(byAddress.ping().isOk() == true);
+        CHECK((byAddress.apiVersion() == ApiVersion(1, 27)));
+
+        // Parameters newer than the version in use are not sent
+        WaitInfo info;
+        CHECK(second.apiSupports(ApiVersion(1, 30)) == false);
+        CHECK(second.containerWait("web", info, "next-exit").isOk() == true);
+        second.setApiVersion(ApiVersion(1, 41));
+        CHECK(second.apiSupports(ApiVersion(1, 30)) == true);
+        CHECK(second.containerWait("web", info, "next-exit").isOk() == true);
+        second.setApiVersion(ApiVersion(1, 25));
+        CHECK(second.containerWait("web", info, "next-exit").isOk() == true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(waits.size() == 3);
+            CHECK(waits[0].empty() == true);
+            CHECK(waits[1] == "condition=next-exit");
+            CHECK(waits[2].empty() == true);
+        }
+
+        ApiVersionCache::forget(daemon.url());
+        CHECK(ApiVersionCache::lookup(daemon.url(), cached) == false);
+        Docker<SocketHttp> unknown(daemon.url());
+        CHECK((unknown.apiVersion() == DOCKER_API_DEFAULT));
+        daemon.stop();
+        CHECK(unknown.negotiateApiVersion().isError() == true);
+        CHECK((unknown.apiVersion() == DOCKER_API_DEFAULT));
+    }
 }
\ No newline at end of file
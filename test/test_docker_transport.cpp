@@ -0,0 +1,150 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+#include "fixture_http.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace docker_cpp;
+
+TEST_SUITE("TRANSPORT") {
+    TEST_CASE("Check SocketHttp talks to a daemon on a Unix socket") {
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        std::string path = "/tmp/docker_cpp_test_" + std::to_string(::getpid()) + ".sock";
+        REQUIRE(daemon.startUnix(path) == true);
+        CHECK(daemon.url() == "unix://" + path);
+
+        Docker<SocketHttp> docker(daemon.url());
+        ContainerList containers;
+        CHECK(docker.ping().isOk() == true);
+        CHECK(docker.containerList(containers, true).isOk() == true);
+        CHECK(containers.size() == 1);
+        CHECK(docker.containerStart("8dfafdbc3a40").isOk() == true);
+        CHECK(daemon.requests() == 3);
+        CHECK(daemon.connections() == 1);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check chunked streams are decoded end to end") {
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        ExecConfig config;
+        ExecRunResult result;
+        CHECK(docker.execRun("8dfafdbc3a40", config, result).isOk() == true);
+        CHECK(result.stdOut == "hello\nworld\n");
+        CHECK(result.stdErr == "oops\n");
+        CHECK(result.exitCode == 2);
+        CHECK(daemon.connections() == 1);
+
+        MockDaemon::Response list;
+        list.body = repeat_fixture(read_fixture("container_list_get.json"), 50);
+        list.chunked = true;
+        list.chunkSize = 100;
+        daemon.route("GET", "/containers/json", list);
+        ContainerList containers;
+        CHECK(docker.containerList(containers, true).isOk() == true);
+        CHECK(containers.size() == 50);
+        CHECK(containers[49].id == "8dfafdbc3a40-49");
+        daemon.stop();
+    }
+
+    TEST_CASE("Check latency and disabled keep-alive are simulated") {
+        MockDaemon daemon;
+        daemon.routeDockerApi();
+        daemon.setLatency(20000);
+        daemon.setKeepAlive(false);
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 3; ++i) CHECK(docker.ping().isOk() == true);
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(60));
+        CHECK(daemon.connections() == 3);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check generated responses and wildcard routes") {
+        MockDaemon daemon;
+        daemon.route("POST", "/containers/*/kill", [](const MockDaemon::Request &r) {
+            MockDaemon::Response res;
+            res.code = r.path == "/containers/missing/kill" ? 404 : 204;
+            res.body = res.code == 404 ? "{\"message\":\"No such container\"}" : "";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+
+        Docker<SocketHttp> docker(daemon.url());
+        CHECK(docker.containerKill("abc").isOk() == true);
+        DockerError e = docker.containerKill("missing");
+        CHECK(e.isError() == true);
+        CHECK(e.apiErrorCode == 404);
+        CHECK(e.message() == "No such container");
+        daemon.stop();
+    }
+
+    TEST_CASE("Check the in-memory transport serves pre-loaded fixtures") {
+        Docker<FixtureHttp> docker("http://127.0.0.1:2375");
+        docker.transport().routeDockerApi(TEST_RESPONSES_PATH);
+
+        ContainerList containers;
+        CHECK(docker.containerList(containers, true).isOk() == true);
+        CHECK(containers.size() == 1);
+        CHECK(docker.containerStart("abc").isOk() == true);
+        ExecRunResult run;
+        CHECK(docker.execRun("abc", ExecConfig(), run).isOk() == true);
+        CHECK(run.stdOut == "hello\nworld\n");
+        CHECK(run.exitCode == 2);
+
+        DockerError e = docker.containerRename("abc", "other");
+        CHECK(e.isOk() == true);
+        CHECK(docker.transport().requests() == 6);
+
+        CHECK(docker.execResizeInstance("abc", 24, 80).isOk() == true);
+        docker.transport().route("POST", "/exec/*/resize", 404, "{\"message\":\"No such exec instance\"}");
+        DockerError notFound = docker.execResizeInstance("abc", 24, 80);
+        CHECK(notFound.isError() == true);
+        CHECK(notFound.message() == "No such exec instance");
+    }
+
+    TEST_CASE("Check injected errors and latency") {
+        Docker<FixtureHttp> docker("http://127.0.0.1:2375");
+        docker.transport().route("POST", "/containers/*/start", 204, "");
+        docker.transport().setErrorRate(0.5, 503);
+
+        int failed = 0;
+        for (int i = 0; i < 1000; ++i) {
+            DockerError e = docker.containerStart("abc");
+            if (e.isError()) {
+                CHECK(e.apiErrorCode == 503);
+                ++failed;
+            }
+        }
+        CHECK(failed > 400);
+        CHECK(failed < 600);
+        CHECK(docker.transport().injectedErrors() == static_cast<std::size_t>(failed));
+
+        // Each instance draws its own sequence from its seed, unaffected by the other instances on the thread
+        Docker<FixtureHttp> other("http://127.0.0.1:2375");
+        other.transport().route("POST", "/containers/*/start", 204, "");
+        other.transport().setErrorRate(0.5, 503);
+        docker.transport().setSeed(7);
+        other.transport().setSeed(7);
+        for (int i = 0; i < 100; ++i) {
+            bool a = docker.containerStart("abc").isError();
+            docker.containerStart("abc");
+            CHECK(other.containerStart("abc").isError() == a);
+            other.containerStart("abc");
+        }
+
+        docker.transport().setErrorRate(0);
+        docker.transport().setLatency(5000, 1000);
+        auto start = std::chrono::steady_clock::now();
+        CHECK(docker.containerStart("abc").isOk() == true);
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(5));
+    }
+}
@@ -0,0 +1,262 @@
+#include <doctest/doctest.h>
+#include "test_utils.h"
+#include "mock_daemon.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <set>
+
+using namespace docker_cpp;
+
+static std::string full_id(int n)
+{
+    char text[65];
+    std::snprintf(text, sizeof(text), "%064x", n);
+    return text;
+}
+
+static std::string container_json(const std::string &id, const std::string &name, const std::string &state)
+{
+    return "{\"Id\":\"" + id + "\",\"Names\":[\"/" + name + "\"],\"Image\":\"batch\",\"State\":\"" + state + "\",\"Status\":\"\"}";
+}
+
+static std::string die_event(const std::string &id, int exitCode, std::int64_t timeNano)
+{
+    return "{\"Type\":\"container\",\"Action\":\"die\",\"Actor\":{\"ID\":\"" + id + "\",\"Attributes\":{\"exitCode\":\"" +
+           std::to_string(exitCode) + "\",\"image\":\"batch\"}},\"time\":" + std::to_string(timeNano / 1000000000) +
+           ",\"timeNano\":" + std::to_string(timeNano) + "}\n";
+}
+
+// Events endpoint of the mock: each request is held until events are pushed, which it returns before closing
+struct EventFeed
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string pending;
+    std::vector<std::string> queries;
+    bool done = false;
+
+    void push(const std::string &events)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += events;
+        cv.notify_all();
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_all();
+    }
+
+    std::size_t requests()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queries.size();
+    }
+
+    MockDaemon::Response serve(const MockDaemon::Request &r)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queries.push_back(r.query);
+        cv.wait_for(lock, std::chrono::seconds(10), [this] { return done || !pending.empty(); });
+        MockDaemon::Response res;
+        res.body.swap(pending);
+        return res;
+    }
+};
+
+TEST_SUITE("WAITER") {
+    TEST_CASE("Check events are decoded and filtered") {
+        MockDaemon daemon;
+        std::string query;
+        daemon.route("GET", "/events", [&](const MockDaemon::Request &r) {
+            query = r.query;
+            MockDaemon::Response res;
+            res.body = die_event(full_id(1), 137, 1700000000123456789LL) +
+                       "{\"Type\":\"container\",\"Action\":\"start\",\"Actor\":{\"ID\":\"" + full_id(2) + "\"},\"timeNano\":1700000001000000000}\n";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+        DockerMetrics metrics;
+        docker.setMetrics(&metrics);
+
+        EventOptions options;
+        options.since = "1700000000";
+        options.until = "1700000002";
+        options.filters["type"].push_back("container");
+        options.filters["event"].push_back("die");
+        options.filters["event"].push_back("start");
+        std::vector<EventMessage> events;
+        CHECK(docker.events(options, [&](const EventMessage &e) { events.push_back(e); return true; }).isOk() == true);
+        CHECK(query == "since=1700000000&until=1700000002&filters=" + url_encode("{\"event\":[\"die\",\"start\"],\"type\":[\"container\"]}"));
+        REQUIRE(events.size() == 2);
+        CHECK(events[0].action == "die");
+        CHECK(events[0].actorId == full_id(1));
+        CHECK(events[0].attribute("exitCode") == "137");
+        CHECK(events[0].attribute("missing").empty() == true);
+        CHECK(events[0].timeNano == 1700000000123456789LL);
+        CHECK(events[1].action == "start");
+        CHECK(events[1].attributes.empty() == true);
+        CHECK(ns_timestamp_param(events[0].timeNano) == "1700000000.123456789");
+
+        // Stopping the stream from the handler
+        events.clear();
+        CHECK(docker.events(options, [&](const EventMessage &e) { events.push_back(e); return false; }).isCancelled() == true);
+        CHECK(events.size() == 1);
+        CHECK(metrics.operation(OP_EVENTS).total.count() == 2);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check exits are found in the list or the events") {
+        MockDaemon daemon;
+        EventFeed feed;
+        daemon.route("GET", "/events", [&](const MockDaemon::Request &r) { return feed.serve(r); });
+        std::atomic<int> lists(0), waits(0);
+        std::atomic<bool> race(false);
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &) {
+            ++lists;
+            if (race.exchange(false)) {
+                // job3 exits while it is looked up: the list still shows it running
+                feed.push(die_event(full_id(3), 1, 1700000000200000000LL));
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            MockDaemon::Response res;
+            res.body = "[" + container_json(full_id(1), "job1", "running") + "," + container_json(full_id(2), "job2", "exited") + "," +
+                       container_json(full_id(3), "job3", "running") + "]";
+            return res;
+        });
+        daemon.route("POST", "/containers/*/wait", [&](const MockDaemon::Request &) {
+            ++waits;
+            MockDaemon::Response res;
+            res.body = "{\"StatusCode\":3}";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        std::future<ContainerExit> exited, running, missing, stopped;
+        {
+            ContainerWaiter<SocketHttp> waiter(docker);
+            exited = waiter.wait("job2");
+            running = waiter.wait(full_id(1).substr(0, 12));
+            missing = waiter.wait("missing");
+            REQUIRE(exited.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            REQUIRE(missing.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            eventually([&] { return waiter.pending() <= 1; });
+            CHECK(waiter.pending() == 1);
+
+            ContainerExit e = exited.get();
+            CHECK(e.id == "job2");
+            CHECK(e.error.isOk() == true);
+            CHECK(e.info.statusCode == 3);
+            CHECK(waits == 1);
+            e = missing.get();
+            CHECK(e.id == "missing");
+            CHECK(e.error.isNotFound() == true);
+
+            // The running container completes on its die event, then the stream resumes after that event
+            feed.push(die_event(full_id(1), 7, 1700000000123456789LL));
+            REQUIRE(running.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            e = running.get();
+            CHECK(e.id == full_id(1).substr(0, 12));
+            CHECK(e.error.isOk() == true);
+            CHECK(e.info.statusCode == 7);
+
+            eventually([&] { return waiter.pending() == 0 && feed.requests() >= 2; });
+            CHECK(waiter.pending() == 0);
+            {
+                std::lock_guard<std::mutex> lock(feed.mutex);
+                REQUIRE(feed.queries.size() >= 2);
+                CHECK(feed.queries[0].compare(0, 6, "since=") == 0);
+                CHECK(feed.queries[1].compare(0, 27, "since=1700000000.123456789&") == 0);
+            }
+
+            // An exit received during the lookup of a container settles it
+            race = true;
+            stopped = waiter.wait("job3");
+            REQUIRE(stopped.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+            CHECK(stopped.get().info.statusCode == 1);
+
+            // Whatever is still pending when the waiter is destroyed is cancelled
+            stopped = waiter.wait("job1");
+            feed.close();
+        }
+        REQUIRE(stopped.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        CHECK(stopped.get().error.isCancelled() == true);
+        CHECK(lists >= 2);
+        daemon.stop();
+    }
+
+    TEST_CASE("Check many containers share one events stream") {
+        const int count = 500;
+        MockDaemon daemon;
+        EventFeed feed;
+        daemon.route("GET", "/events", [&](const MockDaemon::Request &r) { return feed.serve(r); });
+        std::mutex mutex;
+        std::set<std::string> dead; // containers whose die event was sent
+        std::atomic<int> listed(0), waits(0);
+        daemon.route("GET", "/containers/json", [&](const MockDaemon::Request &r) {
+            // filters={"id":["..",".."]}: two quotes per value and two for the key
+            std::size_t quotes = 0;
+            for (std::size_t pos = r.query.find("%22"); pos != std::string::npos; pos = r.query.find("%22", pos + 3)) ++quotes;
+            listed += static_cast<int>(quotes / 2 - 1);
+            std::lock_guard<std::mutex> lock(mutex);
+            MockDaemon::Response res;
+            res.body = "[";
+            for (int i = 0; i < count; ++i) {
+                const std::string id = full_id(i + 1);
+                res.body += (i ? "," : "") + container_json(id, "job" + std::to_string(i + 1), dead.count(id) ? "exited" : "running");
+            }
+            res.body += "]";
+            return res;
+        });
+        daemon.route("POST", "/containers/*/wait", [&](const MockDaemon::Request &r) {
+            ++waits;
+            MockDaemon::Response res;
+            res.body = "{\"StatusCode\":" + std::to_string((std::stoul(r.path.substr(12 + 56, 8), nullptr, 16) - 1) % 256) + "}";
+            return res;
+        });
+        REQUIRE(daemon.start() == true);
+        Docker<SocketHttp> docker(daemon.url());
+
+        ContainerWaiterOptions options;
+        options.batchSize = 100;
+        ContainerWaiter<SocketHttp> waiter(docker, options);
+        std::map<std::string, int> codes;
+        for (int i = 0; i < count; ++i) {
+            waiter.wait(full_id(i + 1), [&](const ContainerExit &e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                codes[e.id] = e.error.isOk() ? e.info.statusCode : -1;
+            });
+        }
+        eventually([&] { return listed >= count; }, std::chrono::seconds(10));
+        CHECK(waiter.pending() == count);
+
+        std::string events;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < count; ++i) {
+                events += die_event(full_id(i + 1), i % 256, 1700000000000000000LL + i);
+                dead.insert(full_id(i + 1));
+            }
+        }
+        feed.push(events);
+        eventually([&] { return waiter.pending() == 0; }, std::chrono::seconds(10));
+        CHECK(waiter.pending() == 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            REQUIRE(codes.size() == count);
+            CHECK(codes[full_id(1)] == 0);
+            CHECK(codes[full_id(300)] == 299 % 256);
+        }
+        CHECK(feed.requests() <= 2);
+        CHECK(waits == 0);
+        CHECK(daemon.requests() <= 2 + count / 50); // the events stream and a few batched lists
+        feed.close();
+        waiter.stop();
+        daemon.stop();
+    }
+}
@@ -8,19 +8,53 @@
 #include <asl/File.h>
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <map>
+
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace docker_cpp
 {
+    // Polls `condition` until it holds, for at most `timeout`
+    template <typename F>
+    bool eventually(F condition, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() - start > timeout) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
     struct MockResponseHttp : DockerHttpInterface<MockResponseHttp>
     {
-        asl::HttpResponse _fromFile(const std::string& uri, const std::string& method) { 
-            asl::String filename = asl::String(uri.c_str()).split("/v1.")[0];
-            asl::String filepath = asl::String(TEST_RESPONSES_PATH) + "/" + filename + "_" + asl::String(method.c_str()) + ".json";
-            asl::Array<byte> data = asl::File(filepath, asl::File::READ).content();
+        static const bool thread_safe = true;
+
+        // Fixture files are read once and then served from memory
+        static asl::HttpResponse _cached(const std::string &filepath) {
+            static std::mutex mutex;
+            static std::map<std::string, asl::HttpResponse> cache;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(filepath);
+            if (it != cache.end()) return it->second;
+            asl::Array<byte> data = asl::File(filepath.c_str(), asl::File::READ).content();
             asl::HttpResponse r = asl::HttpResponse();
             r.put(data);
             r.setCode(200);
-            return r;
+            return cache[filepath] = r;
+        }
+
+        asl::HttpResponse _fromFile(const std::string& uri, const std::string& method) { 
+            const std::string filepath = std::string(TEST_RESPONSES_PATH) + "/" + uri.substr(0, uri.find("/v1.")) + "_" + method + ".json";
+            return timed_response([&] { return _cached(filepath); });
         }
 
         asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
@@ -44,16 +78,88 @@ namespace docker_cpp
 		{
 			return _fromFile(uri, "delet");
 		};
+
+        // Reads the raw fixture <name>_<method>.stream
+        bool _streamFixture(const std::string &uri, const std::string &method, std::string &data) {
+            std::string name = uri.substr(0, uri.find("/v1."));
+            std::string lowerMethod = method == "DELETE" ? "delet" : method;
+            std::transform(lowerMethod.begin(), lowerMethod.end(), lowerMethod.begin(), ::tolower);
+            const std::string filepath = std::string(TEST_RESPONSES_PATH) + "/" + name + "_" + lowerMethod + ".stream";
+            static std::mutex mutex;
+            static std::map<std::string, std::string> cache;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(filepath);
+            if (it == cache.end()) {
+                std::ifstream in(filepath, std::ios::binary);
+                if (!in) return false;
+                it = cache.insert(std::make_pair(filepath, std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()))).first;
+            }
+            data = it->second;
+            return true;
+        }
+
+        asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            std::string data;
+            bool found = _streamFixture(uri, method, data);
+            asl::HttpResponse r = asl::HttpResponse();
+            r.setCode(found ? 200 : 404);
+            if (found && sink) sink(data.data(), data.size());
+            return r;
+        }
+
+        // Body of the last upload
+        static std::string &uploaded() { static std::string body; return body; }
+
+        // Reads the whole streamed body, then answers with the stream fixture
+        asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            std::string data;
+            char buf[64 * 1024];
+            long n;
+            while ((n = body(buf, sizeof(buf))) > 0) data.append(buf, static_cast<std::size_t>(n));
+            uploaded() = data;
+            if (n < 0) return no_response();
+            return streamImpl(method, uri, std::string(), sink, headers);
+        }
+
+        // Other end of the last hijacked connection, to read what a session writes
+        static int &peer() { static int fd = -1; return fd; }
+
+        // Hijacks one end of a socket pair that already holds the stream fixture
+        asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            std::string data;
+            int fds[2];
+            asl::HttpResponse r = asl::HttpResponse();
+            if (!_streamFixture(uri, method, data) || ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                r.setCode(404);
+                return r;
+            }
+            if (::write(fds[1], data.data(), data.size()) != static_cast<ssize_t>(data.size())) r.setCode(500);
+            ::shutdown(fds[1], SHUT_WR);
+            if (peer() >= 0) ::close(peer());
+            peer() = fds[1];
+            conn.adopt(fds[0]);
+            r.setCode(101);
+            return r;
+        }
     };
 
     struct MockErrorHttp : DockerHttpInterface<MockErrorHttp>
     {
+        static const bool thread_safe = true;
+
+        // Answers with the status of the uri prefix, and the body of "<status>.json" if there is one (empty otherwise)
         asl::HttpResponse _errorFromUri(const std::string &uri) {
             asl::String error_code = asl::String(uri.c_str()).split("/v1.")[0];
             int errCode = (int)error_code;
-            auto r = asl::HttpResponse();
-            r.setCode(errCode);
-            return r;
+            const std::string filepath = std::string(TEST_RESPONSES_PATH) + "/" + *error_code + ".json";
+            return timed_response([&] {
+                auto r = std::ifstream(filepath.c_str()) ? MockResponseHttp::_cached(filepath) : asl::HttpResponse();
+                r.setCode(errCode);
+                return r;
+            });
         }
 
         asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
@@ -77,6 +183,65 @@ namespace docker_cpp
 		{
             return _errorFromUri(uri);
 		};
+
+        asl::HttpResponse streamImpl(const std::string &method, const std::string &uri, const std::string &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _errorFromUri(uri);
+        }
+
+        asl::HttpResponse uploadImpl(const std::string &method, const std::string &uri, const StreamSource &body, const StreamSink &sink, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _errorFromUri(uri);
+        }
+
+        asl::HttpResponse upgradeImpl(const std::string &method, const std::string &uri, const std::string &body, DockerConnection &conn, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _errorFromUri(uri);
+        }
+    };
+
+    // Answers every request with 204 after a short delay (404 when the uri contains "missing"),
+    // tracking the peak number of requests in flight.
+    struct MockSlowHttp : DockerHttpInterface<MockSlowHttp>
+    {
+        static const bool thread_safe = true;
+
+        static std::atomic<int>& inFlight() { static std::atomic<int> v(0); return v; }
+        static std::atomic<int>& peak() { static std::atomic<int> v(0); return v; }
+        static void reset() { inFlight() = 0; peak() = 0; }
+
+        asl::HttpResponse _slow(const std::string &uri) {
+            int now = ++inFlight();
+            int p = peak();
+            while (now > p && !peak().compare_exchange_weak(p, now)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --inFlight();
+            auto r = asl::HttpResponse();
+            r.setCode(uri.find("missing") != std::string::npos ? 404 : 204);
+            return r;
+        }
+
+        asl::HttpResponse getImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+        {
+            return _slow(uri);
+        }
+
+		template <typename T>
+		asl::HttpResponse postImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{ 
+            return _slow(uri);
+		};
+
+		template <typename T>
+		asl::HttpResponse putImpl(const std::string &uri, const T &body, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{ 
+            return _slow(uri);
+		};
+
+		asl::HttpResponse deletImpl(const std::string &uri, const std::map<std::string, std::string> &headers = std::map<std::string, std::string>())
+		{
+            return _slow(uri);
+		};
     };
 }
 